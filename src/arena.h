@@ -0,0 +1,242 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cassert>
+
+/*-------------------------------------
+Name: FrameArena
+Description: A bump allocator for data that only lives for one frame. Memory is
+	handed out from large blocks by moving an offset forward; nothing is freed
+	individually, reset() makes the whole arena available again. If a frame
+	needs more than the current blocks hold, another block is added, and the
+	next reset() merges everything into a single block of the high-water size
+	so later frames never allocate. Alignment is applied to the address, not
+	the offset into the block, since a block is only as aligned as new
+	makes it: alignas(64) types get 64-byte aligned memory too.
+
+Purpose: Per-frame scratch (hit lists, visibility sets, screenshot copies)
+	without heap churn inside the 16 ms frame budget.
+--------------------------------------*/
+class FrameArena {
+public:
+	explicit FrameArena(const size_t capacity = 1 << 20){
+		add_block(capacity);
+	}
+
+	void *allocate(const size_t bytes, const size_t align = alignof(std::max_align_t)){
+		assert(align && (align & (align - 1)) == 0);
+		Block &block = blocks.back();
+		const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+		const size_t start = ((base + block.used + align - 1) & ~uintptr_t(align - 1)) - base;
+		if(start + bytes > block.size){
+			add_block(std::max(bytes + align, block.size*2));
+			return allocate(bytes, align);
+		}
+		block.used = start + bytes;
+		in_use += bytes;
+		high_water = std::max(high_water, in_use);
+		return block.data.get() + start;
+	}
+
+	template<typename T>
+	T *alloc_array(const size_t count){
+		return static_cast<T*>(allocate(sizeof(T)*count, alignof(T)));
+	}
+
+	void reset(){
+		if(blocks.size() > 1){
+			size_t total = 0;
+			for(const Block &b : blocks) total += b.size;
+			blocks.clear();
+			add_block(total);
+		}
+		blocks.back().used = 0;
+		in_use = 0;
+	}
+
+	size_t capacity() const {
+		size_t total = 0;
+		for(const Block &b : blocks) total += b.size;
+		return total;
+	}
+	size_t peak() const { return high_water; }
+
+private:
+	struct Block {
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+		size_t used;
+	};
+	void add_block(const size_t size){
+		blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[size]), size, 0});
+	}
+	std::vector<Block> blocks;
+	size_t in_use = 0;
+	size_t high_water = 0;
+};
+
+
+/*-------------------------------------
+Name: ArenaAllocator
+Description: A standard allocator that takes its memory from a FrameArena.
+	deallocate does nothing; the memory comes back when the arena is reset.
+
+Purpose: Lets per-frame std::vectors live in the arena, e.g.
+	std::vector<RayHit, ArenaAllocator<RayHit>> hits(ArenaAllocator<RayHit>(arena));
+	Such containers must not outlive the frame.
+--------------------------------------*/
+template<typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+	FrameArena *arena;
+
+	explicit ArenaAllocator(FrameArena &a) : arena(&a) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(const size_t n){ return arena->alloc_array<T>(n); }
+	void deallocate(T *, size_t){}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+
+/*-------------------------------------
+Name: ObjectPool
+Description: A pool of fixed-size slots for objects of type T that live across
+	frames. Slots are carved from chunks of chunk_size objects and recycled
+	through a free list, so creating and destroying objects only touches the
+	heap when the pool has to grow.
+
+Purpose: Long-lived objects (actors, projectiles, loaded assets) that come and
+	go during play without calling operator new in steady state.
+--------------------------------------*/
+template<typename T, size_t chunk_size = 256>
+class ObjectPool {
+public:
+	ObjectPool() = default;
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	template<typename... Args>
+	T *create(Args&&... args){
+		if(!free_list) grow();
+		Slot *slot = free_list;
+		free_list = slot->next;
+		live++;
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T *object){
+		object->~T();
+		Slot *slot = reinterpret_cast<Slot*>(object);
+		slot->next = free_list;
+		free_list = slot;
+		live--;
+	}
+
+	//reserves room for count objects up front, e.g. at level load
+	void reserve(const size_t count){
+		while(chunks.size()*chunk_size < count) grow();
+	}
+
+	size_t size() const { return live; }
+
+private:
+	union Slot {
+		Slot *next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+	void grow(){
+		chunks.emplace_back(new Slot[chunk_size]);
+		Slot *chunk = chunks.back().get();
+		for(size_t i=0; i<chunk_size; i++){
+			chunk[i].next = free_list;
+			free_list = &chunk[i];
+		}
+	}
+	std::vector<std::unique_ptr<Slot[]>> chunks;
+	Slot *free_list = nullptr;
+	size_t live = 0;
+};
+
+
+/*-------------------------------------
+Name: allocation_count
+Description: The number of calls to operator new made so far by the program.
+	Counting is only compiled in when COUNT_ALLOCATIONS is defined before this
+	header is included (e.g. g++ -DCOUNT_ALLOCATIONS); it replaces the global
+	operator new and delete, so it must be enabled in exactly one translation
+	unit, which is always the case for the single-file programs here.
+	Without it allocation_count() always returns 0. Every replaceable
+	form is replaced, plain, array, nothrow and over-aligned (which
+	containers of alignas(64) types reach), so none slips past the count.
+
+Purpose: Lets the frame loop and frame_alloc_check catch any heap allocation
+	that sneaks into steady-state frames.
+--------------------------------------*/
+#ifdef COUNT_ALLOCATIONS
+inline std::atomic<size_t> operator_new_calls(0);
+
+inline size_t allocation_count(){ return operator_new_calls.load(std::memory_order_relaxed); }
+
+//kept out of line so the optimizer does not pair the malloc and free inside
+//them with the new and delete expressions that called them
+__attribute__((noinline)) void *operator new(size_t size){
+	operator_new_calls.fetch_add(1, std::memory_order_relaxed);
+	if(void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+__attribute__((noinline)) void *operator new[](size_t size){ return operator new(size); }
+__attribute__((noinline)) void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	operator_new_calls.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+__attribute__((noinline)) void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+__attribute__((noinline)) void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	operator_new_calls.fetch_add(1, std::memory_order_relaxed);
+	const size_t align = std::max(size_t(alignment), sizeof(void*));
+	//aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1)/align*align);
+}
+__attribute__((noinline)) void *operator new(size_t size, std::align_val_t alignment){
+	if(void *p = operator new(size, alignment, std::nothrow)) return p;
+	throw std::bad_alloc();
+}
+__attribute__((noinline)) void *operator new[](size_t size, std::align_val_t alignment){
+	return operator new(size, alignment);
+}
+__attribute__((noinline)) void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept {
+	return operator new(size, alignment, tag);
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(p);
+}
+#else
+inline size_t allocation_count(){ return 0; }
+#endif
+
+#endif
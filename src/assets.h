@@ -0,0 +1,273 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <iostream>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+/*-------------------------------------
+Name: ByteStream
+Description: An std::istream reading bytes that are already in memory, in
+	place; the bytes must outlive the stream.
+
+Purpose: Lets the stream parsers of the file formats (parse_pnm, parse_bsp,
+	parse_pvs, ...) decode a file the loader has read, without copying it.
+--------------------------------------*/
+class ByteStream : public std::istream {
+public:
+	explicit ByteStream(const std::vector<uint8_t> &bytes)
+		: std::istream(nullptr), buffer(bytes) { rdbuf(&buffer); }
+
+private:
+	struct Buffer : std::streambuf {
+		explicit Buffer(const std::vector<uint8_t> &bytes){
+			char *begin = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+			setg(begin, begin, begin + bytes.size());
+		}
+	} buffer;
+};
+
+
+/*-------------------------------------
+Name: read_file_bytes
+Description: Reads a whole file into bytes with a single read. Returns false,
+	with a message, if it cannot be opened or read.
+
+Purpose: The I/O half of loading an asset.
+--------------------------------------*/
+inline bool read_file_bytes(const std::string filename, std::vector<uint8_t> &bytes){
+	std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+	if(!ifs){
+		std::cerr << "Failed to open file: " << filename << "\n";
+		return false;
+	}
+	bytes.resize(size_t(ifs.tellg()));
+	ifs.seekg(0);
+	ifs.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	if(!ifs){
+		std::cerr << "Failed to read file: " << filename << "\n";
+		return false;
+	}
+	return true;
+}
+
+
+/*-------------------------------------
+Name: AssetStatus, AssetHandle
+Description: An asset being loaded. state goes from loading to ready or
+	failed exactly once, with release order, so whoever sees ready also sees
+	the finished value. read_ms and decode_ms are the time its files took
+	to read and to decode, ready_ms the time from the request until it was
+	ready.
+
+	An AssetHandle is what AssetLoader::load returns. The owner polls it
+	once per frame: take moves the value out once it is ready, so the frame
+	loop swaps the placeholder for the real asset between two frames and no
+	frame ever draws a mix of both.
+
+Purpose: Lets the game start drawing before its assets are loaded.
+--------------------------------------*/
+enum class AssetState : int { loading, ready, failed };
+
+struct AssetStatus {
+	std::string name;
+	std::atomic<AssetState> state{AssetState::loading};
+	double read_ms = 0;
+	double decode_ms = 0;
+	double ready_ms = 0;
+};
+
+template<typename T>
+struct AssetSlot : AssetStatus {
+	T value;
+};
+
+template<typename T>
+class AssetHandle {
+public:
+	AssetHandle() = default;
+	explicit AssetHandle(std::shared_ptr<AssetSlot<T>> slot) : slot(std::move(slot)) {}
+
+	bool pending() const { return slot && !taken && slot->state.load(std::memory_order_acquire) == AssetState::loading; }
+	bool failed() const { return slot && slot->state.load(std::memory_order_acquire) == AssetState::failed; }
+	const AssetStatus *status() const { return slot.get(); }
+
+	bool take(T &out){
+		if(!slot || taken || slot->state.load(std::memory_order_acquire) != AssetState::ready) return false;
+		out = std::move(slot->value);
+		taken = true;
+		return true;
+	}
+
+private:
+	std::shared_ptr<AssetSlot<T>> slot;
+	bool taken = false;
+};
+
+
+/*-------------------------------------
+Name: AssetLoader
+Description: Loads assets in the background: one I/O thread reads each
+	request's files whole, in request order, and hands them to
+	decode_threads workers, which parse them into the asset. load takes a
+	name for messages, the files and a decode function
+	bool(const std::vector<std::vector<uint8_t>> &files, T &out), which runs
+	on a worker, and returns at once with a handle.
+
+	An exception thrown while reading or decoding (bad_alloc for a file
+	whose header asks for more than there is memory) is reported and fails
+	that asset alone; it never leaves the loader's threads.
+
+	Destroying the loader abandons whatever has not started decoding yet
+	and marks it failed; a decode in progress is finished.
+
+Purpose: Keeps file reads and decoding off the main thread, so the window
+	opens and draws placeholders while large assets stream in.
+--------------------------------------*/
+class AssetLoader {
+public:
+	explicit AssetLoader(size_t decode_threads = 2){
+		decode_threads = std::max<size_t>(decode_threads, 1);
+		io_thread = std::thread([this](){ read_files(); });
+		for(size_t i=0; i<decode_threads; i++) decoders.emplace_back([this](){ decode(); });
+	}
+	~AssetLoader(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+			for(auto &job : reads) job->status->state.store(AssetState::failed, std::memory_order_release);
+			for(auto &job : decodes) job->status->state.store(AssetState::failed, std::memory_order_release);
+		}
+		read_ready.notify_all();
+		decode_ready.notify_all();
+		io_thread.join();
+		for(std::thread &t : decoders) t.join();
+	}
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader &operator=(const AssetLoader&) = delete;
+
+	template<typename T, typename Decode>
+	AssetHandle<T> load(const std::string name, const std::vector<std::string> files, Decode decode){
+		std::shared_ptr<AssetSlot<T>> slot = std::make_shared<AssetSlot<T>>();
+		slot->name = name;
+		std::unique_ptr<Job> job(new Job);
+		job->files = files;
+		job->status = slot;
+		job->requested = std::chrono::steady_clock::now();
+		AssetSlot<T> *target = slot.get();
+		job->decode = [target, decode](const std::vector<std::vector<uint8_t>> &data){
+			return decode(data, target->value);
+		};
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			reads.push_back(std::move(job));
+			in_flight++;
+		}
+		read_ready.notify_one();
+		return AssetHandle<T>(slot);
+	}
+
+	//requests not yet ready or failed
+	size_t pending() const { return in_flight.load(); }
+
+private:
+	struct Job {
+		std::vector<std::string> files;
+		std::vector<std::vector<uint8_t>> data;
+		std::shared_ptr<AssetStatus> status;
+		std::function<bool(const std::vector<std::vector<uint8_t>>&)> decode;
+		std::chrono::steady_clock::time_point requested;
+	};
+
+	static double ms_since(const std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void finish(Job &job, const bool ok){
+		job.status->ready_ms = ms_since(job.requested);
+		job.status->state.store(ok ? AssetState::ready : AssetState::failed, std::memory_order_release);
+		in_flight--;
+	}
+
+	void read_files(){
+		while(true){
+			std::unique_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				read_ready.wait(lock, [this](){ return quit || !reads.empty(); });
+				if(quit) return;
+				job = std::move(reads.front());
+				reads.pop_front();
+			}
+			const auto start = std::chrono::steady_clock::now();
+			job->data.resize(job->files.size());
+			bool ok = true;
+			try {
+				for(size_t i=0; i<job->files.size() && ok; i++) ok = read_file_bytes(job->files[i], job->data[i]);
+			} catch(const std::exception &e){
+				std::cerr << "Failed to read " << job->status->name << ": " << e.what() << "\n";
+				job->data.clear();
+				ok = false;
+			}
+			job->status->read_ms = ms_since(start);
+			if(!ok){
+				finish(*job, false);
+				continue;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(quit) job->status->state.store(AssetState::failed, std::memory_order_release);
+				else decodes.push_back(std::move(job));
+			}
+			decode_ready.notify_one();
+		}
+	}
+
+	void decode(){
+		while(true){
+			std::unique_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				decode_ready.wait(lock, [this](){ return quit || !decodes.empty(); });
+				if(quit) return;
+				job = std::move(decodes.front());
+				decodes.pop_front();
+			}
+			const auto start = std::chrono::steady_clock::now();
+			bool ok = false;
+			try {
+				ok = job->decode(job->data);
+			} catch(const std::exception &e){
+				std::cerr << "Failed to decode " << job->status->name << ": " << e.what() << "\n";
+			}
+			job->status->decode_ms = ms_since(start);
+			job->data.clear();
+			finish(*job, ok);
+		}
+	}
+
+	std::thread io_thread;
+	std::vector<std::thread> decoders;
+	std::mutex mutex;
+	std::condition_variable read_ready, decode_ready;
+	std::deque<std::unique_ptr<Job>> reads, decodes;
+	std::atomic<size_t> in_flight{0};
+	bool quit = false;
+};
+
+#endif
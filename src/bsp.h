@@ -0,0 +1,609 @@
+#ifndef BSP_H
+#define BSP_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include "raycaster.h"
+
+/*-------------------------------------
+Name: Segment
+Description: A wall in a segment world: a line from (x0, y0) to (x1, y1) in map
+	units, seen from both sides, drawn like grid cells of character cell.
+
+Purpose: The building block of levels that are not restricted to the grid.
+--------------------------------------*/
+struct Segment {
+	float x0 = 0, y0 = 0;
+	float x1 = 0, y1 = 0;
+	char cell = '0';
+};
+
+
+/*-------------------------------------
+Name: load_segment_file
+Description: Reads a segment world, a text file with one "wall <x0> <y0> <x1>
+	<y1> [cell]" line per segment. Other lines (lights and so on) are
+	returned in extra_lines, and lines starting with # are comments.
+
+Purpose: The source format of segment levels, written by hand or by
+	segments_from_grid.
+--------------------------------------*/
+inline bool load_segment_file(const std::string filename,
+			std::vector<Segment> &segments,
+			std::vector<std::string> *extra_lines = nullptr){
+	std::ifstream ifs(filename);
+	if(!ifs){
+		std::cerr << "Failed to open segment file: " << filename << "\n";
+		return false;
+	}
+	segments.clear();
+	std::string line;
+	size_t line_number = 0;
+	while(std::getline(ifs, line)){
+		line_number++;
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		std::istringstream iss(line);
+		std::string kind;
+		if(!(iss >> kind) || kind[0] == '#') continue;
+		if(kind != "wall"){
+			if(extra_lines) extra_lines->push_back(line);
+			continue;
+		}
+		Segment s;
+		if(!(iss >> s.x0 >> s.y0 >> s.x1 >> s.y1)){
+			std::cerr << "Bad wall on line " << line_number << " of " << filename << "\n";
+			return false;
+		}
+		if(!(iss >> s.cell)) s.cell = '0';
+		if(s.x0 == s.x1 && s.y0 == s.y1) continue;
+		segments.push_back(s);
+	}
+	return true;
+}
+
+
+/*-------------------------------------
+Name: segments_from_grid
+Description: Converts a grid map into the segments of its visible walls: every
+	cell face between an empty cell and a wall becomes a segment, and runs
+	of faces along the same line with the same wall character are merged
+	into one.
+
+Purpose: Gives the BSP renderer levels equivalent to the grid ones, both to
+	compare the two engines and to move existing maps over.
+--------------------------------------*/
+inline std::vector<Segment> segments_from_grid(const char *map,
+					const size_t map_width,
+					const size_t map_height){
+	std::vector<Segment> segments;
+	auto wall = [&](long x, long y) -> char {
+		if(x < 0 || y < 0 || size_t(x) >= map_width || size_t(y) >= map_height) return 0;
+		return map[x + y*map_width] != ' ' ? map[x + y*map_width] : 0;
+	};
+	//horizontal faces, on the line y = j, wall on one side and empty on the other
+	for(long j=0; j<=long(map_height); j++){
+		for(int facing=0; facing<2; facing++){
+			long start = -1;
+			char cell = 0;
+			for(long i=0; i<=long(map_width); i++){
+				const long wy = facing ? j : j - 1, ey = facing ? j - 1 : j;
+				const bool open_side = ey >= 0 && size_t(ey) < map_height && i < long(map_width) && !wall(i, ey);
+				const char c = (open_side && i < long(map_width)) ? wall(i, wy) : 0;
+				if(start >= 0 && c != cell){
+					segments.push_back({float(start), float(j), float(i), float(j), cell});
+					start = -1;
+				}
+				if(start < 0 && c){
+					start = i;
+					cell = c;
+				}
+			}
+		}
+	}
+	//vertical faces, on the line x = i
+	for(long i=0; i<=long(map_width); i++){
+		for(int facing=0; facing<2; facing++){
+			long start = -1;
+			char cell = 0;
+			for(long j=0; j<=long(map_height); j++){
+				const long wx = facing ? i : i - 1, ex = facing ? i - 1 : i;
+				const bool open_side = ex >= 0 && size_t(ex) < map_width && j < long(map_height) && !wall(ex, j);
+				const char c = (open_side && j < long(map_height)) ? wall(wx, j) : 0;
+				if(start >= 0 && c != cell){
+					segments.push_back({float(i), float(start), float(i), float(j), cell});
+					start = -1;
+				}
+				if(start < 0 && c){
+					start = j;
+					cell = c;
+				}
+			}
+		}
+	}
+	return segments;
+}
+
+
+/*-------------------------------------
+Name: BspNode, BspTree
+Description: A 2D BSP tree over wall segments. Every node splits the plane with
+	the line through its partition segment (a, b); front is the side to the
+	left of a->b. Segments lying on the line are kept in the node, the
+	others go to the front or back child (-1 for none), cut in two where they
+	cross the line. Each node also keeps the bounding box of everything
+	below it.
+
+Purpose: The compiled form of a segment world, built offline by bsp_build.
+	Walking it front to back visits walls in visibility order from any
+	point, with no sorting at run time.
+--------------------------------------*/
+struct BspNode {
+	float ax = 0, ay = 0;
+	float bx = 0, by = 0;
+	int32_t front = -1;
+	int32_t back = -1;
+	uint32_t first_segment = 0;
+	uint32_t segment_count = 0;
+	float min_x = 0, min_y = 0;
+	float max_x = 0, max_y = 0;
+};
+
+struct BspTree {
+	std::vector<BspNode> nodes; //nodes[0] is the root
+	std::vector<Segment> segments;
+
+	bool empty() const { return nodes.empty(); }
+};
+
+
+/*-------------------------------------
+Name: build_bsp
+Description: Builds a BspTree from a list of segments. At every level up to
+	candidates segments spread through the list are tried as the partition,
+	keeping the one with the lowest 8 * splits + |front - back| score, which
+	keeps the tree balanced without cutting many walls.
+
+Purpose: The offline compile step of a segment world.
+--------------------------------------*/
+inline int32_t build_bsp_node(BspTree &tree, std::vector<Segment> &segments, const size_t candidates){
+	if(segments.empty()) return -1;
+	const float eps = 1e-5f;
+	auto side_of = [](const Segment &p, const float x, const float y){
+		return (p.x1 - p.x0)*(y - p.y0) - (p.y1 - p.y0)*(x - p.x0);
+	};
+	auto normalized = [&](const Segment &p, const float x, const float y){
+		return side_of(p, x, y)/std::hypot(p.x1 - p.x0, p.y1 - p.y0);
+	};
+
+	size_t best = 0;
+	long best_score = -1;
+	const size_t step = std::max<size_t>(1, segments.size()/candidates);
+	for(size_t c=0; c<segments.size(); c+=step){
+		long splits = 0, front = 0, back = 0;
+		for(const Segment &s : segments){
+			const float d0 = normalized(segments[c], s.x0, s.y0);
+			const float d1 = normalized(segments[c], s.x1, s.y1);
+			if(std::fabs(d0) <= eps && std::fabs(d1) <= eps) continue;
+			if(d0 >= -eps && d1 >= -eps) front++;
+			else if(d0 <= eps && d1 <= eps) back++;
+			else splits++;
+		}
+		const long score = 8*splits + std::labs(front - back);
+		if(best_score < 0 || score < best_score){
+			best_score = score;
+			best = c;
+		}
+	}
+
+	const Segment partition = segments[best];
+	std::vector<Segment> on_line, front, back;
+	for(const Segment &s : segments){
+		const float d0 = normalized(partition, s.x0, s.y0);
+		const float d1 = normalized(partition, s.x1, s.y1);
+		if(std::fabs(d0) <= eps && std::fabs(d1) <= eps) on_line.push_back(s);
+		else if(d0 >= -eps && d1 >= -eps) front.push_back(s);
+		else if(d0 <= eps && d1 <= eps) back.push_back(s);
+		else {
+			const float t = d0/(d0 - d1);
+			Segment a = s, b = s;
+			a.x1 = b.x0 = s.x0 + t*(s.x1 - s.x0);
+			a.y1 = b.y0 = s.y0 + t*(s.y1 - s.y0);
+			(d0 > 0 ? front : back).push_back(a);
+			(d0 > 0 ? back : front).push_back(b);
+		}
+	}
+	std::vector<Segment>().swap(segments);
+
+	const int32_t index = int32_t(tree.nodes.size());
+	tree.nodes.emplace_back();
+	{
+		BspNode &node = tree.nodes[index];
+		node.ax = partition.x0; node.ay = partition.y0;
+		node.bx = partition.x1; node.by = partition.y1;
+		node.first_segment = uint32_t(tree.segments.size());
+		node.segment_count = uint32_t(on_line.size());
+		node.min_x = node.min_y = INFINITY;
+		node.max_x = node.max_y = -INFINITY;
+		for(const Segment &s : on_line){
+			node.min_x = std::min({node.min_x, s.x0, s.x1});
+			node.min_y = std::min({node.min_y, s.y0, s.y1});
+			node.max_x = std::max({node.max_x, s.x0, s.x1});
+			node.max_y = std::max({node.max_y, s.y0, s.y1});
+		}
+	}
+	tree.segments.insert(tree.segments.end(), on_line.begin(), on_line.end());
+	const int32_t front_child = build_bsp_node(tree, front, candidates);
+	const int32_t back_child = build_bsp_node(tree, back, candidates);
+	BspNode &node = tree.nodes[index];
+	node.front = front_child;
+	node.back = back_child;
+	for(const int32_t child : {front_child, back_child}){
+		if(child < 0) continue;
+		const BspNode &c = tree.nodes[child];
+		node.min_x = std::min(node.min_x, c.min_x);
+		node.min_y = std::min(node.min_y, c.min_y);
+		node.max_x = std::max(node.max_x, c.max_x);
+		node.max_y = std::max(node.max_y, c.max_y);
+	}
+	return index;
+}
+
+inline BspTree build_bsp(std::vector<Segment> segments, const size_t candidates = 16){
+	BspTree tree;
+	build_bsp_node(tree, segments, std::max<size_t>(candidates, 1));
+	return tree;
+}
+
+
+/*-------------------------------------
+Name: save_bsp, parse_bsp, load_bsp
+Description: Binary BSP file: the magic "BSP1", the node and segment counts as
+	uint32, then the nodes and the segments, every field written on its own
+	in the machine's byte order: a node is its partition (ax, ay, bx, by),
+	front and back as int32, first_segment and segment_count as uint32 and
+	its bounding box, 48 bytes; a segment is x0, y0, x1, y1, the cell
+	character and three zero bytes, 20 bytes. parse_bsp reads one from any
+	stream (filename is only for messages), load_bsp from a file. A file
+	cut short, or with a child that is neither -1 nor a node after its
+	parent (as build_bsp numbers them, so the tree cannot loop) or segments
+	past the end, is rejected.
+
+Purpose: The BSP is compiled once by bsp_build and loaded at startup.
+--------------------------------------*/
+template<typename T>
+inline void write_bsp_field(std::ostream &ofs, const T value){
+	ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+inline bool read_bsp_field(std::istream &ifs, T &value){
+	return bool(ifs.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+inline bool save_bsp(const std::string filename, const BspTree &tree){
+	std::ofstream ofs(filename, std::ios::binary);
+	if(!ofs){
+		std::cerr << "Failed to write BSP file: " << filename << "\n";
+		return false;
+	}
+	ofs.write("BSP1", 4);
+	write_bsp_field(ofs, uint32_t(tree.nodes.size()));
+	write_bsp_field(ofs, uint32_t(tree.segments.size()));
+	for(const BspNode &n : tree.nodes){
+		for(const float v : {n.ax, n.ay, n.bx, n.by}) write_bsp_field(ofs, v);
+		write_bsp_field(ofs, n.front);
+		write_bsp_field(ofs, n.back);
+		write_bsp_field(ofs, n.first_segment);
+		write_bsp_field(ofs, n.segment_count);
+		for(const float v : {n.min_x, n.min_y, n.max_x, n.max_y}) write_bsp_field(ofs, v);
+	}
+	const char pad[3] = {};
+	for(const Segment &seg : tree.segments){
+		for(const float v : {seg.x0, seg.y0, seg.x1, seg.y1}) write_bsp_field(ofs, v);
+		write_bsp_field(ofs, seg.cell);
+		ofs.write(pad, sizeof(pad));
+	}
+	return bool(ofs);
+}
+
+inline bool parse_bsp(std::istream &ifs, const std::string filename, BspTree &tree){
+	char magic[4];
+	uint32_t counts[2];
+	ifs.read(magic, 4);
+	if(!ifs || std::memcmp(magic, "BSP1", 4) != 0 || !read_bsp_field(ifs, counts[0]) ||
+	   !read_bsp_field(ifs, counts[1])){
+		std::cerr << "Not a BSP file: " << filename << "\n";
+		return false;
+	}
+	BspTree loaded;
+	//grown as the file is read, so a bad count cannot ask for gigabytes
+	loaded.nodes.reserve(std::min<uint32_t>(counts[0], 1 << 16));
+	loaded.segments.reserve(std::min<uint32_t>(counts[1], 1 << 16));
+	bool ok = true;
+	for(uint32_t k=0; ok && k<counts[0]; k++){
+		BspNode n;
+		ok = read_bsp_field(ifs, n.ax) && read_bsp_field(ifs, n.ay) && read_bsp_field(ifs, n.bx) &&
+		     read_bsp_field(ifs, n.by) && read_bsp_field(ifs, n.front) && read_bsp_field(ifs, n.back) &&
+		     read_bsp_field(ifs, n.first_segment) && read_bsp_field(ifs, n.segment_count) &&
+		     read_bsp_field(ifs, n.min_x) && read_bsp_field(ifs, n.min_y) && read_bsp_field(ifs, n.max_x) &&
+		     read_bsp_field(ifs, n.max_y);
+		loaded.nodes.push_back(n);
+	}
+	char pad[3];
+	for(uint32_t k=0; ok && k<counts[1]; k++){
+		Segment seg;
+		ok = read_bsp_field(ifs, seg.x0) && read_bsp_field(ifs, seg.y0) && read_bsp_field(ifs, seg.x1) &&
+		     read_bsp_field(ifs, seg.y1) && read_bsp_field(ifs, seg.cell) && ifs.read(pad, sizeof(pad));
+		loaded.segments.push_back(seg);
+	}
+	if(!ok){
+		std::cerr << "BSP file " << filename << " is truncated\n";
+		return false;
+	}
+	for(size_t k=0; k<loaded.nodes.size(); k++){
+		const BspNode &n = loaded.nodes[k];
+		auto valid_child = [&](const int32_t child){
+			return child == -1 || (int64_t(child) > int64_t(k) && int64_t(child) < int64_t(counts[0]));
+		};
+		if(!valid_child(n.front) || !valid_child(n.back) ||
+		   uint64_t(n.first_segment) + n.segment_count > counts[1]){
+			std::cerr << "BSP file " << filename << " is corrupt\n";
+			return false;
+		}
+	}
+	tree = std::move(loaded);
+	return true;
+}
+
+inline bool load_bsp(const std::string filename, BspTree &tree){
+	std::ifstream ifs(filename, std::ios::binary);
+	if(!ifs){
+		std::cerr << "Failed to open BSP file: " << filename << "\n";
+		return false;
+	}
+	return parse_bsp(ifs, filename, tree);
+}
+
+
+/*-------------------------------------
+Name: BspStats
+Description: What the last cast_columns_bsp call did: nodes visited, nodes
+	skipped because every column they could cover was already filled, and
+	segments projected.
+
+Purpose: Shows how early the front to back walk stops.
+--------------------------------------*/
+struct BspStats {
+	size_t nodes_visited = 0;
+	size_t nodes_culled = 0;
+	size_t segments_drawn = 0;
+};
+
+
+/*-------------------------------------
+Name: cast_columns_bsp
+Description: Produces the same per-column hits as cast_columns, for a BSP
+	world. The tree is walked front to back from the player with an explicit
+	stack. Every segment is clipped to the space in front of the player and
+	projected to the span of columns it covers; each column in the span that
+	is still empty gets the exact distance along its ray to the segment and
+	is marked in a coverage mask. The walk ends as soon as every column is
+	filled, and a subtree whose bounding box only covers filled columns is
+	skipped. Distances at or past max_distance count as no hit, as in the
+	grid caster. face_x, face_y are the grid cell just in front of the hit
+	point, so grid light maps still apply to levels converted from a grid.
+
+Purpose: The cast half of the 3D view for segment levels; the hits go
+	through draw_wall_columns like those of the grid caster.
+--------------------------------------*/
+inline void cast_columns_bsp(const BspTree &tree,
+			const float player_x,
+			const float player_y,
+			const float player_a,
+			const float fov,
+			const size_t columns,
+			std::vector<RayHit> &hits,
+			BspStats *stats = nullptr,
+			const float max_distance = 20){
+	hits.assign(columns, RayHit());
+	static thread_local std::vector<uint8_t> covered;
+	static thread_local std::vector<int32_t> stack;
+	covered.assign(columns, 0);
+	size_t remaining = columns;
+	BspStats local;
+	if(tree.empty()){
+		if(stats) *stats = local;
+		return;
+	}
+
+	const float forward_x = cos(player_a), forward_y = sin(player_a);
+	const float start_angle = player_a - fov/2;
+	const float columns_per_radian = columns/fov;
+	const float near = 1e-3f;
+
+	//column span [first, last] of the view-space points (u = forward, v = left to right)
+	auto to_view = [&](const float x, const float y, float &u, float &v){
+		const float dx = x - player_x, dy = y - player_y;
+		u = dx*forward_x + dy*forward_y;
+		v = -dx*forward_y + dy*forward_x;
+	};
+	auto span_of = [&](float u0, float v0, float u1, float v1, long &first, long &last) -> bool {
+		if(u0 < near && u1 < near) return false;
+		if(u0 < near){
+			const float t = (near - u0)/(u1 - u0);
+			v0 += t*(v1 - v0); u0 = near;
+		} else if(u1 < near){
+			const float t = (near - u1)/(u0 - u1);
+			v1 += t*(v0 - v1); u1 = near;
+		}
+		float c0 = (std::atan2(v0, u0) + fov/2)*columns_per_radian;
+		float c1 = (std::atan2(v1, u1) + fov/2)*columns_per_radian;
+		if(c0 > c1) std::swap(c0, c1);
+		first = std::max(0L, long(std::floor(c0)) - 1);
+		last = std::min(long(columns) - 1, long(std::ceil(c1)) + 1);
+		return first <= last;
+	};
+
+	//fills the empty columns a node's segments cover
+	auto draw_node_segments = [&](const BspNode &node){
+		for(uint32_t k = node.first_segment; k < node.first_segment + node.segment_count && remaining > 0; k++){
+			const Segment &s = tree.segments[k];
+			float u0, v0, u1, v1;
+			to_view(s.x0, s.y0, u0, v0);
+			to_view(s.x1, s.y1, u1, v1);
+			long first, last;
+			if(!span_of(u0, v0, u1, v1, first, last)) continue;
+			local.segments_drawn++;
+			const float sx = s.x1 - s.x0, sy = s.y1 - s.y0;
+			const float px = s.x0 - player_x, py = s.y0 - player_y;
+			const uint8_t wall_side = std::fabs(sx) < std::fabs(sy) ? 0 : 1;
+			for(long c = first; c <= last; c++){
+				if(covered[c]) continue;
+				const float angle = start_angle + fov*c/float(columns);
+				const float dx = cos(angle), dy = sin(angle);
+				const float denom = dx*sy - dy*sx;
+				if(denom == 0) continue;
+				const float t = (px*sy - py*sx)/denom;
+				const float along = (px*dy - py*dx)/denom;
+				if(t <= 0 || along < -1e-4f || along > 1 + 1e-4f) continue;
+				covered[c] = 1;
+				remaining--;
+				RayHit &hit = hits[c];
+				if(t >= max_distance){
+					hit.distance = max_distance;
+					hit.x = player_x + max_distance*dx;
+					hit.y = player_y + max_distance*dy;
+					continue;
+				}
+				hit.distance = t;
+				hit.x = player_x + t*dx;
+				hit.y = player_y + t*dy;
+				hit.cell = s.cell;
+				hit.side = wall_side;
+				hit.face_x = int(std::floor(hit.x - 1e-3f*dx));
+				hit.face_y = int(std::floor(hit.y - 1e-3f*dy));
+			}
+		}
+	};
+
+	//entries >= 0 visit a node, entry -1 - i draws the segments of node i,
+	//so a node's own segments come after its near side and before its far
+	//side
+	stack.clear();
+	stack.push_back(0);
+	while(!stack.empty() && remaining > 0){
+		const int32_t entry = stack.back();
+		stack.pop_back();
+		if(entry < 0){
+			const BspNode &node = tree.nodes[-1 - entry];
+			draw_node_segments(node);
+			continue;
+		}
+		const BspNode &node = tree.nodes[entry];
+
+		//skip the subtree if its box is behind the player or lands only
+		//on filled columns; the player inside the box always descends
+		const bool inside = player_x >= node.min_x && player_x <= node.max_x &&
+			player_y >= node.min_y && player_y <= node.max_y;
+		if(!inside){
+			float us[4], vs[4];
+			to_view(node.min_x, node.min_y, us[0], vs[0]);
+			to_view(node.max_x, node.min_y, us[1], vs[1]);
+			to_view(node.min_x, node.max_y, us[2], vs[2]);
+			to_view(node.max_x, node.max_y, us[3], vs[3]);
+			bool behind = true, straddles = false;
+			float lo = INFINITY, hi = -INFINITY;
+			for(int k=0; k<4; k++){
+				if(us[k] >= near){
+					behind = false;
+					const float a = std::atan2(vs[k], us[k]);
+					lo = std::min(lo, a);
+					hi = std::max(hi, a);
+				} else {
+					straddles = true;
+				}
+			}
+			if(behind){
+				local.nodes_culled++;
+				continue;
+			}
+			if(!straddles){
+				const long first = std::max(0L, long(std::floor((lo + fov/2)*columns_per_radian)) - 1);
+				const long last = std::min(long(columns) - 1, long(std::ceil((hi + fov/2)*columns_per_radian)) + 1);
+				long c = first;
+				while(c <= last && covered[c]) c++;
+				if(c > last){
+					local.nodes_culled++;
+					continue;
+				}
+			}
+		}
+		local.nodes_visited++;
+
+		//near side first: pushed last so it is popped first
+		const float side = (node.bx - node.ax)*(player_y - node.ay) - (node.by - node.ay)*(player_x - node.ax);
+		const int32_t near_child = side >= 0 ? node.front : node.back;
+		const int32_t far_child = side >= 0 ? node.back : node.front;
+		if(far_child >= 0) stack.push_back(far_child);
+		stack.push_back(-1 - entry);
+		if(near_child >= 0) stack.push_back(near_child);
+	}
+	//columns that never met a wall look out to max_distance
+	for(size_t c=0; c<columns; c++){
+		if(covered[c]) continue;
+		const float angle = start_angle + fov*c/float(columns);
+		hits[c].distance = max_distance;
+		hits[c].x = player_x + max_distance*cos(angle);
+		hits[c].y = player_y + max_distance*sin(angle);
+	}
+	if(stats) *stats = local;
+}
+
+
+/*-------------------------------------
+Name: draw_segments
+Description: Draws the segments of a BSP world as lines into a view, scaled
+	by scale_x, scale_y pixels per map unit and clipped to it. The vector
+	form draws into a packed image, clipped to clip_width x image_height.
+
+Purpose: The minimap of segment levels.
+--------------------------------------*/
+inline void draw_segments(const FrameView<uint32_t> view,
+			const BspTree &tree,
+			const float scale_x,
+			const float scale_y,
+			const uint32_t color){
+	for(const Segment &s : tree.segments){
+		const float length = std::max(std::fabs(s.x1 - s.x0)*scale_x, std::fabs(s.y1 - s.y0)*scale_y);
+		const size_t steps = size_t(length) + 1;
+		for(size_t k=0; k<=steps; k++){
+			const float t = float(k)/steps;
+			const float px = (s.x0 + t*(s.x1 - s.x0))*scale_x;
+			const float py = (s.y0 + t*(s.y1 - s.y0))*scale_y;
+			if(px < 0 || py < 0 || size_t(px) >= view.width || size_t(py) >= view.height) continue;
+			view.at(size_t(px), size_t(py)) = color;
+		}
+	}
+}
+
+inline void draw_segments(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t clip_width,
+			const BspTree &tree,
+			const float scale_x,
+			const float scale_y,
+			const uint32_t color){
+	draw_segments(frame_view(image, image_width, image_height).sub_view(0, 0, clip_width, image_height),
+		      tree, scale_x, scale_y, color);
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include "pixelformat.h"
+#include "raycaster.h"
+#include "raycache.h"
+#include "mapfile.h"
+#include "bsp.h"
+
+/*-------------------------------------
+Name: make_room_map
+Description: Builds a size x size map of rooms: a solid border, a wall every
+	8 cells in both directions with a doorway in each wall, and a few pillars
+	scattered inside the rooms. The generator is seeded so every run produces
+	the same map.
+
+Purpose: A larger level than the demo map, with the long walls and open
+	rooms that segment levels are made for.
+--------------------------------------*/
+std::string make_room_map(const size_t size, const uint32_t seed){
+	std::mt19937 rng(seed);
+	std::string map(size*size, ' ');
+	for(size_t j=0; j<size; j++){
+		for(size_t i=0; i<size; i++){
+			const bool border = i==0 || j==0 || i==size-1 || j==size-1;
+			const bool room_wall = (i % 8 == 0 && j % 8 != 4) || (j % 8 == 0 && i % 8 != 4);
+			if(border || room_wall) map[i + j*size] = '0' + (i/8 + j/8) % 4;
+			else if(rng() % 40 == 0) map[i + j*size] = '3';
+		}
+	}
+	return map;
+}
+
+
+/*-------------------------------------
+Name: compare
+Description: Renders frames views of a map along a slow turn from
+	(player_x, player_y) with the grid march (cast_columns), a grid traversal
+	per column (cast_ray_grid) and the BSP of the map's segments, checks the
+	BSP hits against the grid traversal and prints the average cast time of
+	each. Returns the number of columns where the BSP disagrees.
+
+Purpose: One level of the comparison.
+--------------------------------------*/
+size_t compare(const std::string &name, const std::string &map, const size_t map_width,
+	       const size_t map_height, const float player_x, const float player_y,
+	       const size_t columns, const bool write_images){
+	typedef std::chrono::steady_clock clock;
+	const int frames = 120;
+	const float fov = M_PI/3.;
+	const std::vector<Segment> segments = segments_from_grid(map.data(), map_width, map_height);
+	auto t0 = clock::now();
+	const BspTree tree = build_bsp(segments);
+	const double build_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+	std::vector<RayHit> march, grid(columns), bsp;
+	BspStats stats, total;
+	double march_s = 0, grid_s = 0, bsp_s = 0;
+	size_t mismatches = 0;
+	for(int f=0; f<frames; f++){
+		const float player_a = -1.5f + .05f*f;
+		auto t1 = clock::now();
+		cast_columns(map.data(), map_width, map_height, player_x, player_y, player_a, fov, columns, march);
+		auto t2 = clock::now();
+		for(size_t i=0; i<columns; i++)
+			grid[i] = cast_ray_grid(map.data(), map_width, map_height, player_x, player_y,
+						player_a - fov/2 + fov*i/float(columns));
+		auto t3 = clock::now();
+		cast_columns_bsp(tree, player_x, player_y, player_a, fov, columns, bsp, &stats);
+		auto t4 = clock::now();
+		march_s += std::chrono::duration<double>(t2-t1).count();
+		grid_s += std::chrono::duration<double>(t3-t2).count();
+		bsp_s += std::chrono::duration<double>(t4-t3).count();
+		total.nodes_visited += stats.nodes_visited;
+		total.nodes_culled += stats.nodes_culled;
+		total.segments_drawn += stats.segments_drawn;
+		for(size_t i=0; i<columns; i++)
+			if(bsp[i].cell != grid[i].cell || std::fabs(bsp[i].distance - grid[i].distance) > 1e-3f)
+				mismatches++;
+		if(f == 0 && write_images){
+			const size_t width = columns, height = columns/2;
+			std::vector<uint32_t> image(width*height, packcolor(200, 200, 200));
+			draw_wall_columns(image, width, height, 0, bsp, packcolor(0, 255, 255));
+			drop_ppm_image("./outBsp.ppm", image, width, height);
+			std::fill(image.begin(), image.end(), packcolor(200, 200, 200));
+			draw_wall_columns(image, width, height, 0, march, packcolor(0, 255, 255));
+			drop_ppm_image("./outGrid.ppm", image, width, height);
+		}
+	}
+	std::cout << name << " " << map_width << "x" << map_height << ", " << segments.size() << " segments, "
+		  << tree.nodes.size() << " nodes, " << tree.segments.size() << " after splits, built in "
+		  << build_ms << " ms\n"
+		  << "  grid march " << march_s*1000/frames << " ms\tgrid traversal " << grid_s*1000/frames
+		  << " ms\tbsp " << bsp_s*1000/frames << " ms\n"
+		  << "  bsp nodes visited " << total.nodes_visited/frames << ", culled " << total.nodes_culled/frames
+		  << ", segments drawn " << total.segments_drawn/frames << " per frame\n"
+		  << "  columns differing from the grid traversal " << mismatches << " of " << frames*columns << "\n";
+	return mismatches;
+}
+
+
+/*-------------------------------------
+Name: check_bsp_file
+Description: Saves tree, checks the file is exactly the size of its fields
+	(no struct padding written) and loads back equal, then checks that
+	parse_bsp rejects the file cut short, with a child index of -2, and
+	with a child pointing back at its own node. Returns the number of
+	failed checks.
+
+Purpose: Keeps the BSP file format stable and its loader safe.
+--------------------------------------*/
+size_t check_bsp_file(const BspTree &tree){
+	const std::string file = "./outBsp.bsp";
+	size_t failures = 0;
+	BspTree loaded;
+	if(!save_bsp(file, tree) || !load_bsp(file, loaded)) return 1;
+	std::ifstream ifs(file, std::ios::binary);
+	const std::string bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+	ifs.close();
+	std::remove(file.c_str());
+	if(bytes.size() != 12 + 48*tree.nodes.size() + 20*tree.segments.size()){
+		std::cerr << "BSP file is " << bytes.size() << " bytes, not the size of its fields\n";
+		failures++;
+	}
+	bool same = loaded.nodes.size() == tree.nodes.size() && loaded.segments.size() == tree.segments.size();
+	for(size_t k=0; same && k<tree.nodes.size(); k++){
+		const BspNode &a = tree.nodes[k], &b = loaded.nodes[k];
+		same = a.ax == b.ax && a.ay == b.ay && a.bx == b.bx && a.by == b.by && a.front == b.front &&
+		       a.back == b.back && a.first_segment == b.first_segment && a.segment_count == b.segment_count &&
+		       a.min_x == b.min_x && a.min_y == b.min_y && a.max_x == b.max_x && a.max_y == b.max_y;
+	}
+	for(size_t k=0; same && k<tree.segments.size(); k++){
+		const Segment &a = tree.segments[k], &b = loaded.segments[k];
+		same = a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1 && a.cell == b.cell;
+	}
+	if(!same){
+		std::cerr << "BSP file did not load back as saved\n";
+		failures++;
+	}
+
+	//the front child of the root sits at byte 12 + 16
+	auto rejects = [&](const std::string &name, const std::string &corrupt){
+		std::istringstream stream(corrupt);
+		BspTree out;
+		if(!parse_bsp(stream, name, out)) return;
+		std::cerr << "BSP file " << name << " loaded\n";
+		failures++;
+	};
+	rejects("cut short", bytes.substr(0, bytes.size() - 1));
+	for(const int32_t child : {-2, 0}){
+		std::string corrupt = bytes;
+		std::memcpy(&corrupt[12 + 16], &child, sizeof(child));
+		rejects("child " + std::to_string(child), corrupt);
+	}
+	return failures;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Compares the BSP renderer with the grid raycaster on the demo map
+	(or a given map file) and on a generated 256x256 map of rooms, both
+	converted to segments with segments_from_grid. The first view of the
+	demo map is written as outBsp.ppm and outGrid.ppm. The demo map's BSP
+	is also put through check_bsp_file.
+
+	usage: bsp_bench [map file] [columns]
+
+Purpose: Shows what the segment engine costs on levels the grid engine can
+	also draw, and that both draw the same walls.
+--------------------------------------*/
+int main(int argc, char **argv){
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height)) return 1;
+	const size_t columns = argc > 2 ? std::stoul(argv[2]) : 1024;
+	size_t mismatches = compare("demo map", map, map_width, map_height, 5.956f, 11.345f, columns, true);
+	const size_t size = 256;
+	mismatches += compare("rooms", make_room_map(size, 1234), size, size, 4.5f, 4.5f, columns, false);
+	const size_t file_failures = check_bsp_file(build_bsp(segments_from_grid(map.data(), map_width, map_height)));
+	std::cout << "BSP file checks failed " << file_failures << "\n";
+	//rays that pass exactly through a wall corner may pick either wall
+	return file_failures || mismatches*1000 > 2*120*columns ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include "mapfile.h"
+#include "bsp.h"
+
+/*-------------------------------------
+Name: main
+Description: Compiles a level into a BSP file. The input is either a segment
+	file (wall lines, see load_segment_file) or a grid map file ending in
+	.map, which is converted with segments_from_grid first.
+
+	usage: bsp_build <segment or map file> <bsp file> [candidates]
+
+Purpose: The offline step for segment levels; gameloop --bsp loads the
+	result.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 3){
+		std::cerr << "usage: bsp_build <segment or map file> <bsp file> [candidates]\n";
+		return 1;
+	}
+	const std::string input = argv[1];
+	std::vector<Segment> segments;
+	if(input.size() > 4 && input.compare(input.size() - 4, 4, ".map") == 0){
+		std::string map;
+		size_t map_width = 0, map_height = 0;
+		if(!load_map_file(input, map, map_width, map_height)) return 1;
+		segments = segments_from_grid(map.data(), map_width, map_height);
+	} else if(!load_segment_file(input, segments)){
+		return 1;
+	}
+	const size_t candidates = argc > 3 ? std::stoul(argv[3]) : 16;
+
+	auto start = std::chrono::steady_clock::now();
+	const BspTree tree = build_bsp(segments, candidates);
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if(!save_bsp(argv[2], tree)) return 1;
+	std::cout << segments.size() << " segments, " << tree.nodes.size() << " nodes, "
+		  << tree.segments.size() - segments.size() << " splits, built in " << ms << " ms\n";
+	return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef BUILTIN_MAP_H
+#define BUILTIN_MAP_H
+
+#include <cstddef>
+
+/*-------------------------------------
+Name: builtin_map
+Description: The demo's built in map, 16 rows of 16 characters and a null
+	terminator. Empty spaces represent an empty space on the map, 0, 1, 2,
+	and 3 represent different types of wall textures to be included.
+
+Purpose: Used when gameloop is started without a map file. It is a constexpr
+	array rather than a std::string so it can also be baked at compile time
+	(see static_map.h).
+--------------------------------------*/
+constexpr size_t builtin_map_width = 16;
+constexpr size_t builtin_map_height = 16;
+constexpr char builtin_map[] = "0000222222220000"\
+			       "1              0"\
+			       "1   11 11111   0"\
+			       "1     0        0"\
+			       "0     0  1110000"\
+			       "0     3        0"\
+			       "0   10000      0"\
+			       "0   0   11100  0"\
+			       "0   0   0      0"\
+			       "0   0   1  00000"\
+			       "0       1      0"\
+			       "2       1111   0"\
+			       "0       0      0"\
+			       "0 0000000      0"\
+			       "0              0"\
+			       "0002222222200000";
+
+static_assert(sizeof(builtin_map) == builtin_map_width*builtin_map_height + 1,
+	      "builtin_map rows must be builtin_map_width characters");
+
+#endif
@@ -0,0 +1,158 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+
+/*-------------------------------------
+Name: WriteCount
+Description: A pixel that counts the times it is assigned. A frame of them
+	composed the way the real frame is shows how often each pixel was
+	written.
+
+Purpose: Lets the bench check the write counts of the compose functions
+	pixel by pixel instead of trusting their return values.
+--------------------------------------*/
+struct WriteCount {
+	uint32_t writes = 0;
+	WriteCount() = default;
+	WriteCount(const WriteCount&) = default;
+	WriteCount &operator=(const WriteCount&){
+		writes++;
+		return *this;
+	}
+};
+
+
+/*-------------------------------------
+Name: check_write_counts
+Description: Composes one frame into WriteCount pixels, the minimap on the
+	left half and the wall spans of hits on the right, as the composed frame
+	below is drawn. Prints an error and returns false unless every pixel
+	was written exactly once and the compose functions returned the number
+	of writes made.
+
+Purpose: The proof that the composed frame has no overdraw and no holes.
+--------------------------------------*/
+bool check_write_counts(const std::string &map,
+			const size_t map_width,
+			const size_t map_height,
+			const std::vector<RayHit> &hits,
+			const size_t width,
+			const size_t height){
+	std::vector<WriteCount> counts(width*height);
+	const FrameView<WriteCount> frame = frame_view(counts, width, height);
+	const WriteCount color;
+	size_t returned = compose_minimap(frame.sub_view(0, 0, width/2, height), map.data(), map_width, map_height,
+					  width/(map_width*2), height/map_height, color,
+					  [&](size_t, size_t){ return color; });
+	const FrameView<WriteCount> world = frame.sub_view(width/2, 0, width, height);
+	const size_t columns = std::min(hits.size(), world.width);
+	std::vector<uint32_t> top(columns), bottom(columns);
+	const std::vector<WriteCount> colors(columns);
+	wall_column_spans(hits, columns, height, top.data(), bottom.data());
+	returned += compose_column_spans(world, columns, top.data(), bottom.data(), colors.data(), color, color);
+
+	size_t writes = 0;
+	for(size_t k=0; k<counts.size(); k++){
+		writes += counts[k].writes;
+		if(counts[k].writes != 1){
+			std::cerr << "pixel " << k % width << " " << k / width << " of " << width << "x" << height
+				  << " written " << counts[k].writes << " times\n";
+			return false;
+		}
+	}
+	if(returned != writes){
+		std::cerr << "compose functions report " << returned << " writes of " << writes << "\n";
+		return false;
+	}
+	return true;
+}
+
+/*-------------------------------------
+Name: main
+Description: Renders the scripted session (minimap and lit, shaded walls) two
+	ways, at 1024x512 and at 3840x2160: the old way, a full-frame clear with
+	the minimap rectangles and the wall columns drawn over it, and composed,
+	with compose_minimap and compose_wall_columns writing each pixel once.
+	Prints the pixels each writes per frame, its time per frame and whether
+	the two frames are identical. Every 16th frame is also composed into
+	write counters (check_write_counts); the program exits with 1 if a
+	pixel is written other than once.
+
+	usage: compose_bench [map file]
+
+Purpose: Confirms the single-pass composition draws the same frame with no
+	pixel written twice, and measures what the overdraw cost.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const uint32_t clear = packcolor(200, 200, 200), wall = packcolor(0, 255, 255);
+	const ShadeTable shading = build_shade_table(20.f, 256, clear);
+	const std::vector<Pose> poses = scripted_session(240);
+	const float fov = M_PI/3.;
+
+	for(const size_t width : {size_t(1024), size_t(3840)}){
+		const size_t height = width == 1024 ? 512 : 2160;
+		const size_t rect_width = width/(map_width*2), rect_height = height/map_height;
+		std::vector<uint32_t> cleared(width*height), composed(width*height);
+		std::vector<RayHit> hits;
+		RayCache ray_cache;
+		double seconds[2] = {0, 0};
+		size_t written[2] = {0, 0}, mismatched_frames = 0, miscounted_frames = 0;
+		for(size_t f=0; f<poses.size(); f++){
+			const Pose &p = poses[f];
+			cast_columns_cached(ray_cache, map.data(), map_width, map_height, p.x, p.y, p.a, fov, width/2, hits);
+
+			auto t0 = clock::now();
+			std::fill(cleared.begin(), cleared.end(), clear);
+			written[0] += cleared.size();
+			for(size_t j=0; j<map_height; j++)
+				for(size_t i=0; i<map_width; i++)
+					if(map[i + j*map_width] != ' ')
+						written[0] += draw_rectangle(cleared, width, height, i*rect_width,
+									     j*rect_height, rect_width, rect_height, wall);
+			draw_wall_columns(cleared, width, height, width/2, hits, wall, &shading, &lighting);
+			auto t1 = clock::now();
+			size_t pixels = compose_minimap(composed, width, height, width/2, map.data(), map_width, map_height,
+							rect_width, rect_height, clear,
+							[&](size_t, size_t){ return wall; });
+			pixels += compose_wall_columns(composed, width, height, width/2, hits, wall, clear, clear,
+						       &shading, &lighting);
+			auto t2 = clock::now();
+			seconds[0] += std::chrono::duration<double>(t1 - t0).count();
+			seconds[1] += std::chrono::duration<double>(t2 - t1).count();
+
+			for(const RayHit &hit : hits)
+				if(hit.cell) written[0] += std::min(float(height)/std::max(hit.distance, .01f), float(height));
+			written[1] += pixels;
+			if(cleared != composed) mismatched_frames++;
+			if(f % 16 == 0 && !check_write_counts(map, map_width, map_height, hits, width, height))
+				miscounted_frames++;
+		}
+		const double frames = poses.size();
+		for(int mode=0; mode<2; mode++){
+			std::cout << "  " << width << "x" << height << (mode ? " composed:" : " cleared: ")
+				  << " " << size_t(written[mode]/frames) << " pixels written per frame ("
+				  << written[mode]/frames/(width*height) << " per framebuffer pixel), "
+				  << seconds[mode]*1000/frames << " ms\n";
+		}
+		std::cout << "  frames that differ " << mismatched_frames << " of " << poses.size() << ", "
+			  << "frames with a pixel not written once " << miscounted_frames << "\n";
+		if(miscounted_frames) return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,547 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <vector>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "workers.h"
+#include "pathfinding.h"
+
+/*-------------------------------------
+Name: EntityType, Entities
+Description: Every actor of a level, stored as one array per field: position
+	x, y and velocity vx, vy in map units (per second), heading in radians,
+	collision radius, type and alive. Entity i is index i of every array.
+	NPCs walk at a constant speed and bounce off walls; projectiles fly
+	straight and die on the first wall or NPC they hit. Dead entities stay
+	in place, skipped, until remove_dead packs the arrays. reorder puts the
+	entities listed in order first, in that order, and drops the rest.
+
+Purpose: Keeps the fields a pass reads contiguous, so updating thousands of
+	actors streams through memory instead of hopping between objects.
+--------------------------------------*/
+enum class EntityType : uint8_t { npc, projectile };
+
+struct Entities {
+	std::vector<float> x, y, vx, vy, heading, radius;
+	std::vector<EntityType> type;
+	std::vector<uint8_t> alive;
+
+	size_t size() const { return x.size(); }
+
+	void reserve(const size_t count){
+		x.reserve(count);
+		y.reserve(count);
+		vx.reserve(count);
+		vy.reserve(count);
+		heading.reserve(count);
+		radius.reserve(count);
+		type.reserve(count);
+		alive.reserve(count);
+	}
+
+	size_t add(const EntityType kind, const float px, const float py, const float angle, const float speed,
+		   const float r){
+		x.push_back(px);
+		y.push_back(py);
+		vx.push_back(std::cos(angle)*speed);
+		vy.push_back(std::sin(angle)*speed);
+		heading.push_back(angle);
+		radius.push_back(r);
+		type.push_back(kind);
+		alive.push_back(1);
+		return x.size() - 1;
+	}
+
+	//packs the live entities to the front, in order; returns how many died
+	size_t remove_dead(){
+		size_t kept = 0;
+		for(size_t i=0; i<size(); i++){
+			if(!alive[i]) continue;
+			x[kept] = x[i];
+			y[kept] = y[i];
+			vx[kept] = vx[i];
+			vy[kept] = vy[i];
+			heading[kept] = heading[i];
+			radius[kept] = radius[i];
+			type[kept] = type[i];
+			alive[kept] = 1;
+			kept++;
+		}
+		const size_t removed = size() - kept;
+		resize(kept);
+		return removed;
+	}
+
+	//with workers the copy is split into chunks across the threads
+	void reorder(const std::vector<uint32_t> &order, TileWorkers *workers = nullptr){
+		//the workers fill the calling thread's scratch, through this reference
+		static thread_local Entities scratch;
+		Entities &sorted = scratch;
+		const size_t count = order.size(), chunk = 8192;
+		sorted.resize(count);
+		auto gather = [&](const size_t c){
+			const size_t end = std::min(count, (c + 1)*chunk);
+			for(size_t k=c*chunk; k<end; k++){
+				const uint32_t i = order[k];
+				sorted.x[k] = x[i];
+				sorted.y[k] = y[i];
+				sorted.vx[k] = vx[i];
+				sorted.vy[k] = vy[i];
+				sorted.heading[k] = heading[i];
+				sorted.radius[k] = radius[i];
+				sorted.type[k] = type[i];
+				sorted.alive[k] = alive[i];
+			}
+		};
+		const size_t chunks = (count + chunk - 1)/chunk;
+		if(workers) workers->run(chunks, gather);
+		else for(size_t c=0; c<chunks; c++) gather(c);
+		x.swap(sorted.x);
+		y.swap(sorted.y);
+		vx.swap(sorted.vx);
+		vy.swap(sorted.vy);
+		heading.swap(sorted.heading);
+		radius.swap(sorted.radius);
+		type.swap(sorted.type);
+		alive.swap(sorted.alive);
+	}
+
+	void resize(const size_t count){
+		x.resize(count);
+		y.resize(count);
+		vx.resize(count);
+		vy.resize(count);
+		heading.resize(count);
+		radius.resize(count);
+		type.resize(count);
+		alive.resize(count);
+	}
+};
+
+//floor without the library call std::floor makes short of SSE4.1
+inline int floor_to_int(const float v){
+	const int i = int(v);
+	return i - (v < float(i));
+}
+
+constexpr float npc_radius = .2f;
+constexpr float npc_speed = 1.5f;
+constexpr float projectile_radius = .05f;
+constexpr float projectile_speed = 8.f;
+
+
+/*-------------------------------------
+Name: circle_hits_walls, move_circle
+Description: circle_hits_walls tells whether a circle of radius r at x, y
+	overlaps a wall cell of the map (outside the map counts as wall), by the
+	distance from the center to the nearest point of each cell it touches.
+
+	move_circle moves a circle by dx, dy, in substeps no longer than its
+	radius so it cannot pass through a wall between two tests, and along
+	each axis separately so it slides along a wall instead of stopping.
+	A move whose whole swept box stays inside one empty cell skips the
+	tests. Returns which axes were blocked: bit 0 for x, bit 1 for y.
+
+Purpose: The swept circle-vs-cell collision of entities against the grid.
+--------------------------------------*/
+inline bool circle_hits_walls(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float x,
+			const float y,
+			const float r){
+	const int x0 = floor_to_int(x - r), x1 = floor_to_int(x + r);
+	const int y0 = floor_to_int(y - r), y1 = floor_to_int(y + r);
+	for(int cy=y0; cy<=y1; cy++){
+		for(int cx=x0; cx<=x1; cx++){
+			const bool wall = cx < 0 || cy < 0 || size_t(cx) >= map_width || size_t(cy) >= map_height ||
+				map[cx + cy*map_width] != ' ';
+			if(!wall) continue;
+			const float nx = std::min(std::max(x, float(cx)), float(cx + 1)) - x;
+			const float ny = std::min(std::max(y, float(cy)), float(cy + 1)) - y;
+			if(nx*nx + ny*ny < r*r) return true;
+		}
+	}
+	return false;
+}
+
+inline uint8_t move_circle(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			float &x,
+			float &y,
+			const float dx,
+			const float dy,
+			const float r){
+	const int cx = floor_to_int(std::min(x, x + dx) - r), cy = floor_to_int(std::min(y, y + dy) - r);
+	if(cx == floor_to_int(std::max(x, x + dx) + r) && cy == floor_to_int(std::max(y, y + dy) + r) &&
+	   cx >= 0 && cy >= 0 && size_t(cx) < map_width && size_t(cy) < map_height && map[cx + cy*map_width] == ' '){
+		x += dx;
+		y += dy;
+		return 0;
+	}
+	const size_t steps = size_t(std::max(std::fabs(dx), std::fabs(dy))/std::max(r, .01f)) + 1;
+	const float sx = dx/steps, sy = dy/steps;
+	uint8_t blocked = 0;
+	for(size_t i=0; i<steps && blocked != 3; i++){
+		if(!(blocked & 1)){
+			if(circle_hits_walls(map, map_width, map_height, x + sx, y, r)) blocked |= 1;
+			else x += sx;
+		}
+		if(!(blocked & 2)){
+			if(circle_hits_walls(map, map_width, map_height, x, y + sy, r)) blocked |= 2;
+			else y += sy;
+		}
+	}
+	return blocked;
+}
+
+
+/*-------------------------------------
+Name: SpatialHash, build_spatial_hash
+Description: The live entities bucketed by the square cell of side cell_size
+	they stand in, with the cell coordinates hashed into a power of two
+	buckets (at least twice the entity count), so the world needs no
+	bounds. The hash is cx + cy*row_stride wrapped to the bucket count: a
+	uniform grid folded onto itself, which keeps neighboring cells in
+	neighboring buckets. build_spatial_hash sorts the entity indices by
+	bucket with a counting sort: bucket b holds entries[start[b]] up to
+	start[b + 1], each bucket in index order.
+
+	With workers the sort runs in parallel: the entities are split into a
+	chunk per thread, and each chunk counts its entities per bucket into
+	its own row of chunk_counts. The buckets are then split into a power
+	of two ranges, and each range turns its column of counts into offsets,
+	chunk by chunk. Only the prefix sum over the range totals in
+	range_base is left serial. Each chunk then scatters its entities from
+	its own offsets, so a bucket lists the entities of earlier chunks first
+	and the result is the same for any thread count. serial_us is the time
+	the last build spent outside the parallel passes.
+
+	query calls fn(index) for every entity in the cells a circle of radius
+	at most cell_size around x, y touches. Those are at most three cells
+	in each of at most three rows, and the cells of a row are consecutive
+	buckets, so each row is one run of entries (two where it wraps around
+	the bucket count). Rows are row_stride buckets apart, so no bucket is
+	visited twice. Entities of other cells sharing a bucket come along,
+	so fn checks the distance.
+
+Purpose: Entity-entity queries in a constant number of buckets instead of a
+	scan over every entity.
+--------------------------------------*/
+struct SpatialHash {
+	float cell_size = 1;
+	size_t mask = 0;
+	size_t row_stride = 1;
+	std::vector<uint32_t> start;
+	std::vector<uint32_t> entries;
+	std::vector<uint32_t> bucket_of;
+	std::vector<uint32_t> chunk_counts;
+	std::vector<uint32_t> range_base;
+	double serial_us = 0;
+
+	size_t bucket(const int cx, const int cy) const {
+		return (uint32_t(cx) + uint32_t(cy)*uint32_t(row_stride)) & mask;
+	}
+
+	template<typename Fn>
+	void query(const float x, const float y, const float radius, Fn fn) const {
+		assert(radius <= cell_size);
+		if(start.empty()) return;
+		//a radius up to cell_size spans at most 3 cells, rounding aside
+		const int x0 = floor_to_int((x - radius)/cell_size);
+		const int x1 = std::min(x0 + 2, floor_to_int((x + radius)/cell_size));
+		const int y0 = floor_to_int((y - radius)/cell_size);
+		const int y1 = std::min(y0 + 2, floor_to_int((y + radius)/cell_size));
+		const size_t span = x1 - x0 + 1;
+		for(int cy=y0; cy<=y1; cy++){
+			const size_t b = bucket(x0, cy);
+			const size_t wrapped = b + span > mask + 1 ? b + span - (mask + 1) : 0;
+			for(uint32_t k=start[b]; k<start[b + span - wrapped]; k++) fn(entries[k]);
+			for(uint32_t k=start[0]; k<start[wrapped]; k++) fn(entries[k]);
+		}
+	}
+};
+
+inline void build_spatial_hash(SpatialHash &hash, const Entities &entities, const float cell_size,
+			TileWorkers *workers = nullptr){
+	typedef std::chrono::steady_clock clock;
+	auto us_since = [](const clock::time_point t){
+		return std::chrono::duration<double, std::micro>(clock::now() - t).count();
+	};
+	auto t = clock::now();
+	size_t buckets = 64, row_stride = 8;
+	while(buckets < entities.size()*2){
+		buckets *= 2;
+		if(buckets > row_stride*row_stride) row_stride *= 2;
+	}
+	hash.cell_size = cell_size;
+	hash.mask = buckets - 1;
+	hash.row_stride = row_stride;
+	//a chunk of at least 4096 entities per thread, and at least as many
+	//bucket ranges, each a power of two buckets long
+	const size_t count = entities.size();
+	const size_t chunks = std::max<size_t>(1, std::min(workers ? workers->size() : 1, count/4096));
+	size_t ranges = 1, range_shift = 0;
+	while(ranges < chunks && ranges < buckets) ranges *= 2;
+	while((size_t(1) << range_shift)*ranges < buckets) range_shift++;
+	const size_t range_size = size_t(1) << range_shift;
+	hash.start.resize(buckets + 1);
+	hash.bucket_of.resize(count);
+	hash.chunk_counts.resize(chunks*buckets);
+	hash.range_base.resize(ranges + 1);
+	auto run = [&](const size_t tiles, auto &&fn){
+		if(workers) workers->run(tiles, fn);
+		else for(size_t tile=0; tile<tiles; tile++) fn(tile);
+	};
+	auto chunk_begin = [&](const size_t c){ return c*count/chunks; };
+	hash.serial_us = us_since(t);
+
+	//each chunk buckets its entities and counts them per bucket
+	run(chunks, [&](const size_t c){
+		uint32_t *counts = &hash.chunk_counts[c*buckets];
+		std::fill(counts, counts + buckets, 0);
+		const size_t end = chunk_begin(c + 1);
+		for(size_t i=chunk_begin(c); i<end; i++){
+			const uint32_t b = entities.alive[i] ?
+				uint32_t(hash.bucket(floor_to_int(entities.x[i]/cell_size), floor_to_int(entities.y[i]/cell_size))) :
+				UINT32_MAX;
+			hash.bucket_of[i] = b;
+			if(b != UINT32_MAX) counts[b]++;
+		}
+	});
+	//each range turns its counts into offsets from the start of the range,
+	//bucket by bucket and within a bucket chunk by chunk
+	run(ranges, [&](const size_t r){
+		uint32_t offset = 0;
+		uint32_t *counts = hash.chunk_counts.data();
+		for(size_t b=r*range_size; b<(r + 1)*range_size; b++){
+			hash.start[b] = offset;
+			for(size_t c=0; c<chunks; c++){
+				uint32_t &n = counts[c*buckets + b];
+				const uint32_t here = n;
+				n = offset;
+				offset += here;
+			}
+		}
+		hash.range_base[r + 1] = offset;
+	});
+	t = clock::now();
+	hash.range_base[0] = 0;
+	for(size_t r=0; r<ranges; r++) hash.range_base[r + 1] += hash.range_base[r];
+	const size_t live = hash.range_base[ranges];
+	hash.start[buckets] = uint32_t(live);
+	hash.entries.resize(live);
+	hash.serial_us += us_since(t);
+	//each chunk scatters its entities in index order, and moves the starts
+	//of its share of the ranges by the range base
+	run(chunks, [&](const size_t c){
+		uint32_t *counts = &hash.chunk_counts[c*buckets];
+		const uint32_t *base = hash.range_base.data();
+		const size_t end = chunk_begin(c + 1);
+		for(size_t i=chunk_begin(c); i<end; i++){
+			const uint32_t b = hash.bucket_of[i];
+			if(b != UINT32_MAX) hash.entries[base[b >> range_shift] + counts[b]++] = uint32_t(i);
+		}
+		for(size_t r=c; r<ranges; r+=chunks)
+			if(base[r])
+				for(size_t b=r*range_size; b<(r + 1)*range_size; b++) hash.start[b] += base[r];
+	});
+}
+
+
+/*-------------------------------------
+Name: EntityTickStats, update_entities
+Description: Advances every entity by dt seconds in three passes: the
+	spatial hash is rebuilt and the entities are reordered by bucket, so
+	the entities a query visits sit next to each other and next to the
+	one asking (which keeps the queries in cache; entity indices do not
+	survive a tick); then, in parallel chunks of chunk entities,
+	NPCs head for the center of the next cell of field, when one is given
+	and has a way on from their cell, and are pushed apart from the NPCs
+	they overlap (keeping their speed) and projectiles overlapping an NPC
+	die; then, again in parallel chunks,
+	every entity moves with move_circle, NPCs reflecting off the walls they
+	hit and projectiles dying on them. Each pass writes only the fields of
+	its own entities and reads the others' fields no pass is writing, so
+	the chunks need no locks and the result does not depend on the thread
+	count. Dead entities are removed at the end. Returns what the tick did
+	and how long each pass took; hash_serial_us is the part of hash_us the
+	hash build spent outside its parallel passes.
+
+Purpose: The simulation step of the entity system, run once per frame.
+--------------------------------------*/
+struct EntityTickStats {
+	size_t live = 0;
+	size_t wall_hits = 0;
+	size_t entity_hits = 0;
+	double hash_us = 0;
+	double hash_serial_us = 0;
+	double steer_us = 0;
+	double move_us = 0;
+
+	double total_us() const { return hash_us + steer_us + move_us; }
+};
+
+constexpr float entity_hash_cell = 2*npc_radius;
+
+inline EntityTickStats update_entities(Entities &entities,
+			SpatialHash &hash,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float dt,
+			TileWorkers &workers,
+			const FlowField *field = nullptr,
+			const size_t chunk = 4096){
+	typedef std::chrono::steady_clock clock;
+	auto us_since = [](const clock::time_point t){
+		return std::chrono::duration<double, std::micro>(clock::now() - t).count();
+	};
+	EntityTickStats stats;
+
+	auto t = clock::now();
+	build_spatial_hash(hash, entities, entity_hash_cell, &workers);
+	entities.reorder(hash.entries, &workers);
+	const size_t live = hash.entries.size();
+	workers.run((live + chunk - 1)/chunk, [&](const size_t c){
+		const size_t end = std::min(live, (c + 1)*chunk);
+		for(size_t k=c*chunk; k<end; k++) hash.entries[k] = uint32_t(k);
+	});
+	stats.hash_us = us_since(t);
+	stats.hash_serial_us = hash.serial_us;
+	const size_t count = entities.size();
+	const size_t chunks = (count + chunk - 1)/chunk;
+
+	std::atomic<size_t> entity_hits(0), wall_hits(0), projectile_deaths(0);
+	t = clock::now();
+	workers.run(chunks, [&](const size_t c){
+		size_t hits = 0;
+		const size_t end = std::min(count, (c + 1)*chunk);
+		for(size_t i=c*chunk; i<end; i++){
+			if(!entities.alive[i]) continue;
+			const float x = entities.x[i], y = entities.y[i], r = entities.radius[i];
+			if(field && entities.type[i] == EntityType::npc){
+				const int cx = floor_to_int(x), cy = floor_to_int(y);
+				const size_t d = cx >= 0 && cy >= 0 && size_t(cx) < field->width && size_t(cy) < field->height ?
+					field->direction[cx + cy*field->width] : no_direction;
+				if(d != no_direction){
+					const float to_x = cx + path_dx[d] + .5f - x, to_y = cy + path_dy[d] + .5f - y;
+					const float length = std::sqrt(to_x*to_x + to_y*to_y);
+					const float speed = std::sqrt(entities.vx[i]*entities.vx[i] + entities.vy[i]*entities.vy[i]);
+					if(length > 0){
+						entities.vx[i] = to_x/length*speed;
+						entities.vy[i] = to_y/length*speed;
+						entities.heading[i] = std::atan2(entities.vy[i], entities.vx[i]);
+					}
+				}
+			}
+			float push_x = 0, push_y = 0;
+			bool hit = false;
+			hash.query(x, y, r + npc_radius, [&](const uint32_t j){
+				if(j == i || entities.type[j] != EntityType::npc) return;
+				const float dx = x - entities.x[j], dy = y - entities.y[j];
+				const float reach = r + entities.radius[j];
+				const float d2 = dx*dx + dy*dy;
+				if(d2 >= reach*reach) return;
+				hit = true;
+				const float d = std::sqrt(d2);
+				if(d > 0){
+					push_x += dx/d*(reach - d);
+					push_y += dy/d*(reach - d);
+				}
+			});
+			if(!hit) continue;
+			if(entities.type[i] == EntityType::projectile){
+				entities.alive[i] = 0;
+				hits++;
+				continue;
+			}
+			if(push_x == 0 && push_y == 0) continue;
+			const float vx = entities.vx[i] + push_x/dt, vy = entities.vy[i] + push_y/dt;
+			const float speed = std::sqrt(entities.vx[i]*entities.vx[i] + entities.vy[i]*entities.vy[i]);
+			const float length = std::sqrt(vx*vx + vy*vy);
+			if(length == 0) continue;
+			entities.vx[i] = vx/length*speed;
+			entities.vy[i] = vy/length*speed;
+			entities.heading[i] = std::atan2(entities.vy[i], entities.vx[i]);
+		}
+		entity_hits += hits;
+	});
+	stats.steer_us = us_since(t);
+
+	t = clock::now();
+	workers.run(chunks, [&](const size_t c){
+		size_t hits = 0, deaths = 0;
+		const size_t end = std::min(count, (c + 1)*chunk);
+		for(size_t i=c*chunk; i<end; i++){
+			if(!entities.alive[i]) continue;
+			const uint8_t blocked = move_circle(map, map_width, map_height, entities.x[i], entities.y[i],
+							    entities.vx[i]*dt, entities.vy[i]*dt, entities.radius[i]);
+			if(!blocked) continue;
+			hits++;
+			if(entities.type[i] == EntityType::projectile){
+				entities.alive[i] = 0;
+				deaths++;
+				continue;
+			}
+			if(blocked & 1) entities.vx[i] = -entities.vx[i];
+			if(blocked & 2) entities.vy[i] = -entities.vy[i];
+			entities.heading[i] = std::atan2(entities.vy[i], entities.vx[i]);
+		}
+		wall_hits += hits;
+		projectile_deaths += deaths;
+	});
+	stats.move_us = us_since(t);
+
+	stats.entity_hits = entity_hits;
+	stats.wall_hits = wall_hits;
+	if(entity_hits + projectile_deaths > 0) entities.remove_dead();
+	stats.live = entities.size();
+	return stats;
+}
+
+
+/*-------------------------------------
+Name: spawn_entities
+Description: Adds count entities at random free spots of the map's empty
+	cells, heading in random directions: NPCs, and a projectile_share of
+	projectiles. The same seed spawns the same entities. Adds nothing if the
+	map has no empty cell.
+
+Purpose: Populates a level for the demo and the benchmark.
+--------------------------------------*/
+inline void spawn_entities(Entities &entities,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const size_t count,
+			const float projectile_share = .1f,
+			const unsigned seed = 1){
+	std::vector<size_t> empty;
+	for(size_t i=0; i<map_width*map_height; i++) if(map[i] == ' ') empty.push_back(i);
+	if(empty.empty()) return;
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<size_t> pick(0, empty.size() - 1);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	entities.reserve(entities.size() + count);
+	for(size_t n=0; n<count; n++){
+		const bool projectile = unit(rng) < projectile_share;
+		const float r = projectile ? projectile_radius : npc_radius;
+		const size_t cell = empty[pick(rng)];
+		const float x = cell%map_width + r + unit(rng)*(1 - 2*r);
+		const float y = cell/map_width + r + unit(rng)*(1 - 2*r);
+		const float angle = unit(rng)*2*float(M_PI);
+		entities.add(projectile ? EntityType::projectile : EntityType::npc, x, y, angle,
+			     projectile ? projectile_speed : npc_speed, r);
+	}
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include <algorithm>
+#include "mapfile.h"
+#include "entities.h"
+
+/*-------------------------------------
+Name: main
+Description: Tiles the map tiles x tiles times into one large level, spawns
+	count entities in it (a tenth of them projectiles) and runs 300 ticks
+	of 1/60 s, once with the calling thread only and once with every core
+	(at least four threads).
+	Dead projectiles are fired again by random NPCs after each tick, so
+	the count stays put. Prints the time per tick, split into hash build
+	(and the serial part of it), NPC/projectile queries and movement,
+	against the 2 ms budget, and
+	checks both runs end in exactly the same state.
+
+	usage: entity_bench [count] [map file] [tiles]
+
+Purpose: Shows how many actors the entity system can update per frame, and
+	that the parallel update is deterministic.
+--------------------------------------*/
+int main(int argc, char **argv){
+	const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::string tile;
+	size_t tile_width = 0, tile_height = 0;
+	if(!load_map_file(argc > 2 ? argv[2] : "maps/level1.map", tile, tile_width, tile_height)) return 1;
+	const size_t tiles = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+	const size_t map_width = tile_width*tiles, map_height = tile_height*tiles;
+	std::string map(map_width*map_height, ' ');
+	for(size_t y=0; y<map_height; y++)
+		for(size_t x=0; x<map_width; x++)
+			map[x + y*map_width] = tile[x%tile_width + (y%tile_height)*tile_width];
+	std::cout << count << " entities on a " << map_width << "x" << map_height << " map\n";
+
+	const size_t ticks = 300;
+	const float dt = 1/60.f;
+	//at least four threads, so the chunked hash build is split even on one core
+	TileWorkers single(1), all(std::max(4u, std::thread::hardware_concurrency()));
+	Entities final_state[2];
+	for(int mode=0; mode<2; mode++){
+		TileWorkers &workers = mode ? all : single;
+		Entities entities;
+		spawn_entities(entities, map.data(), map_width, map_height, count);
+		SpatialHash hash;
+		std::mt19937 rng(3);
+		EntityTickStats total;
+		double worst_us = 0;
+		for(size_t t=0; t<ticks; t++){
+			const EntityTickStats stats = update_entities(entities, hash, map.data(), map_width, map_height, dt,
+								      workers);
+			total.hash_us += stats.hash_us;
+			total.hash_serial_us += stats.hash_serial_us;
+			total.steer_us += stats.steer_us;
+			total.move_us += stats.move_us;
+			total.wall_hits += stats.wall_hits;
+			total.entity_hits += stats.entity_hits;
+			worst_us = std::max(worst_us, stats.total_us());
+
+			//keep the count up: fire the lost projectiles from random NPCs
+			std::uniform_real_distribution<float> unit(0.f, 1.f);
+			for(size_t tries=0; entities.size() < count && tries < count; tries++){
+				const size_t shooter = size_t(unit(rng)*entities.size()) % entities.size();
+				if(entities.type[shooter] != EntityType::npc) continue;
+				const float a = entities.heading[shooter], reach = npc_radius + projectile_radius + .01f;
+				const float x = entities.x[shooter] + std::cos(a)*reach, y = entities.y[shooter] + std::sin(a)*reach;
+				if(circle_hits_walls(map.data(), map_width, map_height, x, y, projectile_radius)) continue;
+				entities.add(EntityType::projectile, x, y, a, projectile_speed, projectile_radius);
+			}
+		}
+		std::cout << "  " << workers.size() << (workers.size() == 1 ? " thread: " : " threads: ")
+			  << total.total_us()/ticks/1000 << " ms per tick (hash " << total.hash_us/ticks/1000
+			  << " of which serial " << total.hash_serial_us/ticks/1000 << ", queries " << total.steer_us/ticks/1000 << ", movement " << total.move_us/ticks/1000
+			  << "), worst " << worst_us/1000 << " ms, budget 2 ms; "
+			  << total.wall_hits/ticks << " wall hits and " << total.entity_hits/ticks << " projectile hits per tick\n";
+		final_state[mode] = entities;
+	}
+	const bool same = final_state[0].x == final_state[1].x && final_state[0].y == final_state[1].y &&
+		final_state[0].vx == final_state[1].vx && final_state[0].vy == final_state[1].vy;
+	std::cout << "  single and multi-threaded runs " << (same ? "end in the same state" : "DIFFER") << "\n";
+	return same ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+#define COUNT_ALLOCATIONS
+#include "arena.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "visibility.h"
+#include "pvs.h"
+#include "heights.h"
+#include "voxel.h"
+#include "recording.h"
+#include "entities.h"
+#include "palette.h"
+#include "gridframe.h"
+
+/*-------------------------------------
+Name: main
+Description: Runs the per-frame work of gameloop without a window (frame arena
+	reset, an entity tick, draw_grid_frame as the window draws it, with
+	view cone visibility, PVS lookup, cached ray casting with a panorama,
+	the minimap and lit, shaded wall columns, every eighth frame the voxel
+	view on two tile workers instead and every eighth frame an indexed
+	frame, then handing the frame to a recorder) over a pose session, with
+	every call to operator new counted. After a warm-up that lets the
+	containers reach their steady-state size, any frame that still
+	allocates is reported and the program exits with 1. It also exits with
+	1 if the count misses a form of operator new or the frame arena hands
+	out a misaligned over-aligned array.
+
+	usage: frame_alloc_check [map file] [session file]
+
+Purpose: Guards the zero-allocation frame loop; run it after touching anything
+	the frame calls.
+--------------------------------------*/
+int main(int argc, char **argv){
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	std::vector<Pose> poses;
+	if(argc > 2){
+		if(!load_poses(argv[2], poses)) return 1;
+	} else {
+		poses = scripted_session();
+	}
+
+	//the count must see every form of operator new, over-aligned and array
+	//too (called directly, as the optimizer may drop a new expression whose
+	//result is never used)
+	const size_t allocations_before = allocation_count();
+	operator delete(operator new(64, std::align_val_t(64)), std::align_val_t(64));
+	operator delete[](operator new[](64, std::align_val_t(64)), std::align_val_t(64));
+	operator delete[](operator new[](64));
+	operator delete(operator new(64, std::align_val_t(64), std::nothrow), std::align_val_t(64));
+	if(allocation_count() - allocations_before != 4){
+		std::cerr << "operator new counted " << allocation_count() - allocations_before << " of 4 allocations\n";
+		return 1;
+	}
+
+	//over-aligned arrays from the arena must be aligned in memory, whatever
+	//the alignment of the arena's block
+	{
+		struct alignas(64) Line { uint8_t bytes[64]; };
+		FrameArena arena(4096);
+		for(size_t k=0; k<200; k++){
+			arena.alloc_array<uint8_t>(k % 7 + 1);
+			if(reinterpret_cast<uintptr_t>(arena.alloc_array<Line>(3)) % alignof(Line)){
+				std::cerr << "the frame arena returned a misaligned alignas(64) array\n";
+				return 1;
+			}
+		}
+	}
+
+	const size_t window_width = 1024;
+	const size_t window_height = 512;
+	const size_t warmup = 60;
+	Framebuffer<uint32_t> framebuffer(window_width, window_height, true);
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const PvsTable pvs = build_pvs(map.data(), map_width, map_height);
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+	FrameArena frame_arena(4 << 20);
+	const HeightMap heights = build_height_map(map.data(), map_width, map_height, extra);
+	const VoxelVolume voxels = voxels_from_map(map.data(), map_width, map_height, heights, 4);
+	TileWorkers voxel_workers(2);
+	Entities entities;
+	SpatialHash entity_hash;
+	spawn_entities(entities, map.data(), map_width, map_height, 2000);
+	FrameRecorder recorder;
+	if(!recorder.open("./outAllocCheck.rec", window_width, window_height)) return 1;
+
+	//the scene, colors and views gameloop draws with
+	Palette palette;
+	const GridColors<uint32_t> colors = {packcolor(200, 200, 200),
+		{packcolor(0, 255, 255), packcolor(0, 128, 128), packcolor(0, 64, 64)}, packcolor(255, 255, 255),
+		packcolor(160, 160, 160), {packcolor(255, 128, 0), packcolor(255, 0, 0)}, packcolor(0, 255, 255)};
+	GridColors<uint8_t> indexed_colors;
+	indexed_colors.clear = palette.add(colors.clear);
+	for(size_t k=0; k<3; k++) indexed_colors.minimap[k] = palette.add(colors.minimap[k]);
+	indexed_colors.player = palette.add(colors.player);
+	indexed_colors.trace = palette.add(colors.trace);
+	for(size_t k=0; k<2; k++) indexed_colors.entity[k] = palette.add(colors.entity[k]);
+	indexed_colors.wall = 0;
+	const uint8_t wall_ramp = add_wall_ramp(palette, colors.wall, colors.clear);
+	const IndexedShading indexed_shading = build_indexed_shading(palette, wall_ramp, colors.wall, &shading);
+	Framebuffer<uint8_t> indexed_frame(window_width, window_height);
+	const FrameView<uint32_t> frame = framebuffer.view();
+	const FrameView<uint8_t> indexed = indexed_frame.view();
+	GridFrame grid;
+	grid.ray_cache.panorama = true;
+	GridScene scene;
+	scene.map = map.data();
+	scene.map_width = map_width;
+	scene.map_height = map_height;
+	scene.pvs = &pvs;
+	scene.lighting = &lighting;
+	scene.shading = &shading;
+	scene.indexed_shading = &indexed_shading;
+	scene.entities = &entities;
+	scene.heights = &heights;
+	scene.voxels = &voxels;
+	scene.workers = &voxel_workers;
+
+	size_t allocating_frames = 0, total_allocations = 0;
+	for(size_t f=0; f<poses.size(); f++){
+		const Pose &p = poses[f];
+		const size_t allocations_at_start = allocation_count();
+		frame_arena.reset();
+
+		update_entities(entities, entity_hash, map.data(), map_width, map_height, 1/60.f, voxel_workers);
+		scene.voxel_view = f % 8 == 0;
+		if(f % 8 == 4){
+			draw_grid_frame(grid, scene, indexed_colors, indexed.sub_view(0, 0, window_width/2, window_height),
+					indexed.sub_view(window_width/2, 0, window_width/2, window_height), p.x, p.y, p.a);
+			for(size_t y=0; y<window_height; y++)
+				expand_indexed(indexed.row(y), palette, frame.row(y), window_width);
+		} else {
+			draw_grid_frame(grid, scene, colors, frame.sub_view(0, 0, window_width/2, window_height),
+					frame.sub_view(window_width/2, 0, window_width/2, window_height), p.x, p.y, p.a);
+		}
+
+		//a screenshot's worth of per-frame scratch, taken from the arena
+		uint8_t *rgb = frame_arena.alloc_array<uint8_t>(window_width*window_height*3);
+		for(size_t y=0; y<window_height; y++)
+			convert_to_rgb24<FramebufferFormat>(frame.row(y), rgb + y*window_width*3, window_width);
+		recorder.submit(frame);
+
+		const size_t allocations = allocation_count() - allocations_at_start;
+		if(f >= warmup && allocations > 0){
+			if(allocating_frames < 10)
+				std::cerr << "frame " << f << " called operator new " << allocations << " times\n";
+			allocating_frames++;
+			total_allocations += allocations;
+		}
+	}
+
+	recorder.close();
+	std::remove("./outAllocCheck.rec");
+	std::cout << "frames " << poses.size() << " (" << warmup << " warm-up), "
+		  << "frames that allocated " << allocating_frames << ", allocations " << total_allocations << "\n"
+		  << "frame arena peak " << frame_arena.peak() << " bytes of " << frame_arena.capacity() << "\n";
+	return allocating_frames ? 1 : 0;
+}
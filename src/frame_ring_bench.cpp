@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "raycache.h"
+#include "lighting.h"
+#include "session.h"
+#include "framering.h"
+
+/*-------------------------------------
+Name: slow_reader
+Description: Reads the newest frame of the ring in place again and again,
+	taking sleep_us between looking at its first and its last pixel, for
+	seconds seconds. The producer stamps the frame index into both pixels,
+	so a read that frame_still_valid accepts must see the same index in
+	both. Prints how many frames were read, dropped as overwritten, and
+	accepted although torn (which must be 0).
+
+Purpose: The consumer side of the benchmark, slow enough to be lapped.
+--------------------------------------*/
+int slow_reader(const char *name, const double seconds, const int sleep_us){
+	FrameRing ring;
+	for(int tries=0; tries<100 && !ring.open(); tries++){
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if(open_frame_ring(name, ring)) break;
+	}
+	if(!ring.open()) return 1;
+	const FrameRingHeader &header = ring.header();
+	const size_t last = size_t(header.width)*header.height - 1;
+	size_t read = 0, dropped = 0, torn = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds){
+		uint64_t ticket;
+		const FrameSlotHeader *slot = latest_frame(ring, ticket);
+		if(!slot) continue;
+		const uint32_t *pixels = reinterpret_cast<const uint32_t*>(ring.pixels(*slot));
+		const uint32_t first_stamp = pixels[0];
+		std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+		const uint32_t last_stamp = pixels[last];
+		if(!frame_still_valid(*slot, ticket)){
+			dropped++;
+			continue;
+		}
+		read++;
+		if(first_stamp != last_stamp || first_stamp != uint32_t(slot->frame_index)) torn++;
+	}
+	std::cout << "  reader, " << sleep_us << " us per frame: " << read << " frames read, " << dropped
+		  << " dropped as overwritten, " << torn << " torn" << std::endl;
+	close_frame_ring(ring);
+	return torn == 0 ? 0 : 1;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Renders the demo map headless at 1024x512 along the scripted
+	session and publishes every frame to a 4-slot shared memory ring, first
+	with no reader, then with a forked reader that holds each frame for
+	3 ms, within the time the ring takes to come round, and then for 20 ms,
+	far longer. Prints the render and publish time per frame of each run
+	and what the readers saw, and exits with 1 if the reader ever accepted
+	a torn frame, or if a ring with no slots, or with a header claiming
+	more slots than the object holds, can be made or opened.
+
+	usage: frame_ring_bench [map file]
+
+Purpose: Shows that publishing costs one framebuffer copy and that a slow
+	reader neither slows the renderer nor sees half-written frames.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+	const std::vector<Pose> poses = scripted_session();
+	const size_t width = 1024, height = 512;
+	const float fov = M_PI/3.;
+	const char *name = "/raycaster_frame_ring_bench";
+	std::vector<uint32_t> framebuffer(width*height);
+	std::vector<RayHit> hits(width/2);
+	int status = 0;
+
+	//rings that must be refused
+	{
+		FrameRing ring, reader;
+		if(create_frame_ring(name, width, height, 0, ring)){
+			std::cerr << "made a frame ring with no slots\n";
+			return 1;
+		}
+		if(!create_frame_ring(name, width, height, 4, ring)) return 1;
+		for(const uint32_t slot_count : {0u, 5u, UINT32_MAX}){
+			ring.header().slot_count = slot_count;
+			if(open_frame_ring(name, reader)){
+				std::cerr << "opened a frame ring claiming " << slot_count << " slots\n";
+				status = 1;
+				close_frame_ring(reader);
+			}
+		}
+		close_frame_ring(ring);
+	}
+
+	for(const int reader_us : {0, 3000, 20000}){
+		FrameRing ring;
+		if(!create_frame_ring(name, width, height, 4, ring)) return 1;
+		pid_t reader = -1;
+		if(reader_us > 0){
+			std::cout.flush();
+			reader = fork();
+			if(reader == 0) _exit(slow_reader(name, 2, reader_us));
+		}
+		double render_s = 0, publish_s = 0;
+		size_t frames = 0;
+		auto start = clock::now();
+		while(std::chrono::duration<double>(clock::now() - start).count() < 2){
+			const Pose &p = poses[frames % poses.size()];
+			auto t0 = clock::now();
+			std::fill(framebuffer.begin(), framebuffer.end(), packcolor(200, 200, 200));
+			for(size_t i=0; i<width/2; i++)
+				hits[i] = cast_ray_grid(map.data(), map_width, map_height, p.x, p.y,
+							p.a - fov/2 + fov*i/float(width/2));
+			draw_wall_columns(framebuffer, width, height, width/2, hits, packcolor(0, 255, 255), &shading, &lighting);
+			framebuffer[0] = framebuffer[width*height - 1] = uint32_t(frames);
+			auto t1 = clock::now();
+			publish_frame(ring, frame_view(framebuffer, width, height), p);
+			auto t2 = clock::now();
+			render_s += std::chrono::duration<double>(t1 - t0).count();
+			publish_s += std::chrono::duration<double>(t2 - t1).count();
+			frames++;
+		}
+		if(reader > 0){
+			int reader_status = 0;
+			waitpid(reader, &reader_status, 0);
+			if(!WIFEXITED(reader_status) || WEXITSTATUS(reader_status) != 0) status = 1;
+		}
+		std::cout << (reader_us == 0 ? "no reader" : "with reader") << ": " << frames << " frames, render "
+			  << render_s*1000/frames << " ms, publish " << publish_s*1e6/frames << " us per frame\n";
+		close_frame_ring(ring);
+	}
+	return status;
+}
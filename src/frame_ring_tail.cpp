@@ -0,0 +1,82 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include "pixelformat.h"
+#include "framering.h"
+
+/*-------------------------------------
+Name: main
+Description: Attaches to the frame ring of a running `gameloop --publish <name>`
+	and follows it for a number of frames, reading each newest frame in
+	place. Prints the frame rate, the latency from publish to read, the
+	frames it skipped and the reads it had to drop because the renderer had
+	already reused the slot. With a file name it also saves the last frame
+	it read as a PPM.
+
+	usage: frame_ring_tail <name> [frames] [snapshot.ppm]
+
+Purpose: A minimal reader, and a template for tools that analyse frames
+	without going through image files.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 2){
+		std::cerr << "usage: " << argv[0] << " <name> [frames] [snapshot.ppm]\n";
+		return 1;
+	}
+	const size_t frames = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 300;
+	FrameRing ring;
+	if(!open_frame_ring(argv[1], ring)) return 1;
+	const FrameRingHeader &header = ring.header();
+	std::cout << argv[1] << ": " << header.width << "x" << header.height << ", "
+		  << header.slot_count << " slots\n";
+
+	std::vector<uint32_t> snapshot;
+	Pose pose;
+	uint64_t last_index = UINT64_MAX, first_index = 0, skipped = 0, dropped = 0;
+	double latency_ms = 0;
+	size_t read = 0;
+	auto start = std::chrono::steady_clock::now();
+	while(read < frames){
+		uint64_t ticket;
+		const FrameSlotHeader *slot = latest_frame(ring, ticket);
+		if(!slot || slot->frame_index == last_index){
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		//work on the pixels in place; here a copy for the snapshot
+		const uint64_t index = slot->frame_index;
+		const int64_t published_ns = slot->timestamp_ns;
+		const Pose slot_pose = slot->pose;
+		if(argc > 3){
+			const uint32_t *pixels = reinterpret_cast<const uint32_t*>(ring.pixels(*slot));
+			snapshot.assign(pixels, pixels + header.width*header.height);
+		}
+		if(!frame_still_valid(*slot, ticket)){
+			dropped++;
+			continue;
+		}
+		const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		latency_ms += (now_ns - published_ns)/1e6;
+		if(read == 0) first_index = index;
+		else skipped += index - last_index - 1;
+		last_index = index;
+		pose = slot_pose;
+		read++;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << read << " frames (" << first_index << " to " << last_index << ") in " << seconds << " s, "
+		  << read/seconds << " fps, " << latency_ms/read << " ms latency, " << skipped << " skipped, "
+		  << dropped << " dropped\n"
+		  << "last pose " << pose.x << " " << pose.y << " " << pose.a << "\n";
+	if(argc > 3 && header.r_shift == FramebufferFormat::r_shift && header.b_shift == FramebufferFormat::b_shift){
+		drop_ppm_image(argv[3], snapshot, header.width, header.height);
+		std::cout << "Saved " << argv[3] << "\n";
+	}
+	close_frame_ring(ring);
+	return 0;
+}
@@ -0,0 +1,189 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cassert>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FRAMEBUFFER_MMAP 1
+#include <sys/mman.h>
+#endif
+
+/*-------------------------------------
+Name: FrameView
+Description: A rectangle of pixels that does not own them: the top left
+	pixel, the width and height in pixels and the pitch, the distance in
+	pixels from the start of one row to the next. sub_view gives the part
+	of a view at x, y, clipped to it, sharing the pixels and the pitch,
+	so the left and right halves of a frame, or the tiles given to worker
+	threads, are views of the same image. Copying a view is free.
+
+	frame_view views a packed std::vector image (pitch == width).
+
+Purpose: Lets draw functions take any region of any image, with its bounds
+	carried along instead of passed and checked next to the vector.
+--------------------------------------*/
+template<typename Pixel>
+struct FrameView {
+	Pixel *pixels = nullptr;
+	size_t width = 0;
+	size_t height = 0;
+	size_t pitch = 0;
+
+	FrameView() = default;
+	FrameView(Pixel *pixels, const size_t width, const size_t height, const size_t pitch)
+		: pixels(pixels), width(width), height(height), pitch(pitch){
+		assert(pitch >= width || height == 0);
+	}
+
+	Pixel *row(const size_t y) const { return pixels + y*pitch; }
+	Pixel &at(const size_t x, const size_t y) const { return pixels[x + y*pitch]; }
+	bool empty() const { return width == 0 || height == 0; }
+
+	FrameView sub_view(const size_t x, const size_t y, const size_t w, const size_t h) const {
+		const size_t x0 = std::min(x, width), y0 = std::min(y, height);
+		return FrameView(pixels + x0 + y0*pitch, std::min(w, width - x0), std::min(h, height - y0), pitch);
+	}
+
+	void fill(const Pixel color) const {
+		for(size_t y=0; y<height; y++) std::fill(row(y), row(y) + width, color);
+	}
+};
+
+template<typename Pixel>
+inline FrameView<Pixel> frame_view(std::vector<Pixel> &image, const size_t width, const size_t height){
+	assert(image.size() == width*height);
+	return FrameView<Pixel>(image.data(), width, height, width);
+}
+
+
+/*-------------------------------------
+Name: Framebuffer
+Description: An image that owns its pixels, with every row starting on a
+	64-byte boundary. The pitch is the row size rounded up to 64 bytes,
+	plus one more cache line when that is a multiple of 4 KB: with a
+	power-of-two pitch, the pixels of a column (as a wall slice writes
+	them) all fall in the same few cache sets and evict each other.
+	Padding can be turned off for images that must be packed.
+
+	With huge_pages the storage is first asked for as explicit huge pages
+	and, failing that, as ordinary pages the kernel is advised to back
+	with transparent huge pages, which saves TLB misses on large frames.
+	huge_pages() tells whether it got the explicit ones. Where there is no
+	mmap (not a POSIX system) the storage comes from aligned operator new
+	on 4 KB boundaries and huge_pages is ignored.
+
+Purpose: A frame SIMD kernels can assume is aligned, whose rows and
+	sub-views never share a cache line with a neighbor's, so threads can
+	each write their own view without false sharing.
+--------------------------------------*/
+template<typename Pixel>
+class Framebuffer {
+public:
+	static constexpr size_t row_alignment = 64;
+	static constexpr size_t page_alignment = 4096;
+
+	Framebuffer() = default;
+	Framebuffer(const size_t width, const size_t height, const bool huge_pages = false, const bool pad = true){
+		allocate(width, height, huge_pages, pad);
+	}
+	~Framebuffer(){ release(); }
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer &operator=(const Framebuffer&) = delete;
+	Framebuffer(Framebuffer &&other){ *this = std::move(other); }
+	Framebuffer &operator=(Framebuffer &&other){
+		if(this != &other){
+			release();
+			full = other.full;
+			bytes = other.bytes;
+			mapped = other.mapped;
+			huge = other.huge;
+			other.full = FrameView<Pixel>();
+			other.bytes = 0;
+			other.mapped = other.huge = false;
+		}
+		return *this;
+	}
+
+	//pitch in pixels for a row of width pixels
+	static size_t padded_pitch(const size_t width, const bool pad = true){
+		const size_t row_bytes = (width*sizeof(Pixel) + row_alignment - 1)/row_alignment*row_alignment;
+		const size_t bytes = pad && row_bytes % 4096 == 0 ? row_bytes + row_alignment : row_bytes;
+		return bytes/sizeof(Pixel);
+	}
+
+	void allocate(const size_t width, const size_t height, const bool huge_pages = false, const bool pad = true){
+		static_assert(row_alignment % sizeof(Pixel) == 0, "pixels must tile a cache line");
+		release();
+		const size_t pitch = padded_pitch(width, pad);
+		bytes = std::max<size_t>(pitch*height*sizeof(Pixel), row_alignment);
+		void *memory = nullptr;
+#if defined(FRAMEBUFFER_MMAP) && defined(MAP_HUGETLB)
+		if(huge_pages){
+			const size_t huge_page = 2 << 20;
+			const size_t rounded = (bytes + huge_page - 1)/huge_page*huge_page;
+			memory = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if(memory == MAP_FAILED) memory = nullptr;
+			else {
+				bytes = rounded;
+				mapped = huge = true;
+			}
+		}
+#endif
+		if(!memory){
+#ifdef FRAMEBUFFER_MMAP
+			const size_t alignment = huge_pages ? size_t(2 << 20) : page_alignment;
+			const size_t rounded = (bytes + alignment - 1)/alignment*alignment;
+			memory = std::aligned_alloc(alignment, rounded);
+			if(!memory) throw std::bad_alloc();
+			bytes = rounded;
+#ifdef MADV_HUGEPAGE
+			if(huge_pages) madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+#else
+			bytes = (bytes + page_alignment - 1)/page_alignment*page_alignment;
+			memory = ::operator new(bytes, std::align_val_t(page_alignment));
+#endif
+		}
+		full = FrameView<Pixel>(static_cast<Pixel*>(memory), width, height, pitch);
+		std::fill(full.pixels, full.pixels + pitch*height, Pixel());
+	}
+
+	const FrameView<Pixel> &view() const { return full; }
+	FrameView<Pixel> sub_view(const size_t x, const size_t y, const size_t w, const size_t h) const {
+		return full.sub_view(x, y, w, h);
+	}
+	Pixel *data() const { return full.pixels; }
+	size_t width() const { return full.width; }
+	size_t height() const { return full.height; }
+	size_t pitch() const { return full.pitch; }
+	size_t pitch_bytes() const { return full.pitch*sizeof(Pixel); }
+	bool huge_pages() const { return huge; }
+
+private:
+	void release(){
+		if(!full.pixels) return;
+#ifdef FRAMEBUFFER_MMAP
+		if(mapped) munmap(full.pixels, bytes);
+		else std::free(full.pixels);
+#else
+		::operator delete(full.pixels, std::align_val_t(page_alignment));
+#endif
+		full = FrameView<Pixel>();
+		bytes = 0;
+		mapped = huge = false;
+	}
+
+	FrameView<Pixel> full;
+	size_t bytes = 0;
+	bool mapped = false;
+	bool huge = false;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "framebuffer.h"
+
+/*-------------------------------------
+Name: main
+Description: Draws the walls of the scripted session column by column with
+	draw_wall_columns into the 3D half of three frames at each of 1024x512,
+	2048x1024 and 4096x2160: a packed std::vector (a 4, 8 or 16 KB pitch),
+	a Framebuffer with its padded pitch and one also backed by huge pages.
+	Prints the time per frame of each and checks every row of the padded
+	frames against the packed one.
+
+	usage: framebuffer_bench [map file]
+
+Purpose: Shows what the padded pitch saves when a power-of-two row size makes
+	the pixels of a column share cache sets.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const uint32_t clear = packcolor(200, 200, 200), wall = packcolor(0, 255, 255);
+	const ShadeTable shading = build_shade_table(20.f, 256, clear);
+	const std::vector<Pose> poses = scripted_session(240);
+	const float fov = M_PI/3.;
+
+	for(const size_t width : {size_t(1024), size_t(2048), size_t(4096)}){
+		const size_t height = width == 4096 ? 2160 : width/2;
+		std::vector<uint32_t> packed(width*height, clear);
+		Framebuffer<uint32_t> padded(width, height), huge(width, height, true);
+		const FrameView<uint32_t> views[3] = {frame_view(packed, width, height), padded.view(), huge.view()};
+		for(const FrameView<uint32_t> &view : views) view.fill(clear);
+		std::vector<RayHit> hits;
+		RayCache ray_cache;
+		double seconds[3] = {0, 0, 0};
+		size_t mismatched_rows = 0;
+		for(const Pose &p : poses){
+			cast_columns_cached(ray_cache, map.data(), map_width, map_height, p.x, p.y, p.a, fov, width/2, hits);
+			for(int mode=0; mode<3; mode++){
+				const FrameView<uint32_t> world = views[mode].sub_view(width/2, 0, width/2, height);
+				const auto t = clock::now();
+				draw_wall_columns(world, hits, wall, &shading, &lighting);
+				seconds[mode] += std::chrono::duration<double>(clock::now() - t).count();
+			}
+			for(int mode=1; mode<3; mode++)
+				for(size_t y=0; y<height; y++)
+					if(std::memcmp(views[0].row(y), views[mode].row(y), width*sizeof(uint32_t)))
+						mismatched_rows++;
+		}
+		const char *names[3] = {"packed: ", "padded: ", huge.huge_pages() ? "huge pages: " : "transparent huge pages: "};
+		std::cout << width << "x" << height << "\n";
+		for(int mode=0; mode<3; mode++)
+			std::cout << "  " << names[mode] << "pitch " << views[mode].pitch*sizeof(uint32_t) << " bytes, "
+				  << seconds[mode]*1000/poses.size() << " ms per frame\n";
+		std::cout << "  rows that differ " << mismatched_rows << "\n";
+	}
+	return 0;
+}
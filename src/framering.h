@@ -0,0 +1,297 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include "pixelformat.h"
+#include "session.h"
+#include "framebuffer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FRAME_RING_AVAILABLE 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------
+Name: FrameRingHeader, FrameSlotHeader
+Description: The layout of a frame ring in shared memory: a FrameRingHeader,
+	then slot_count slots of slot_bytes each. A slot is a FrameSlotHeader
+	followed by height rows of pitch bytes of pixels, whose channels sit at
+	the bit positions in r_shift, g_shift, b_shift and a_shift of a
+	little-endian uint32_t.
+
+	published is the number of frames published so far. Each slot has a
+	sequence number that is odd while the renderer writes into it and
+	2*(frame index + 1) once frame index is complete, so a reader can tell a
+	finished frame from one being overwritten without any lock. Everything
+	is 64-byte aligned so the counters never share a cache line with pixels.
+
+Purpose: The contract between the renderer and any local process reading its
+	frames; bump version whenever it changes.
+--------------------------------------*/
+struct alignas(64) FrameRingHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint8_t r_shift, g_shift, b_shift, a_shift;
+	uint64_t slot_bytes;
+	alignas(64) std::atomic<uint64_t> published;
+};
+
+struct alignas(64) FrameSlotHeader {
+	std::atomic<uint64_t> sequence;
+	uint64_t frame_index;
+	uint64_t timestamp_ns; //steady clock
+	Pose pose;
+};
+
+constexpr char frame_ring_magic[8] = {'R', 'C', 'F', 'R', 'I', 'N', 'G', '1'};
+constexpr uint32_t frame_ring_version = 1;
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the frame ring needs lock-free 64-bit atomics");
+
+
+/*-------------------------------------
+Name: FrameRing
+Description: One process's mapping of a frame ring. The renderer creates it
+	with create_frame_ring and is its owner: closing it removes the shared
+	memory object. Readers attach with open_frame_ring.
+
+Purpose: Keeps the mapping and its name together so close_frame_ring can
+	undo both.
+--------------------------------------*/
+struct FrameRing {
+	std::string name;
+	uint8_t *base = nullptr;
+	size_t bytes = 0;
+	bool owner = false;
+
+	bool open() const { return base != nullptr; }
+	FrameRingHeader &header() const { return *reinterpret_cast<FrameRingHeader*>(base); }
+	FrameSlotHeader &slot(const uint64_t frame_index) const {
+		return *reinterpret_cast<FrameSlotHeader*>(base + sizeof(FrameRingHeader) +
+							  (frame_index % header().slot_count)*header().slot_bytes);
+	}
+	uint8_t *pixels(const FrameSlotHeader &slot) const {
+		return reinterpret_cast<uint8_t*>(const_cast<FrameSlotHeader*>(&slot)) + sizeof(FrameSlotHeader);
+	}
+};
+
+
+/*-------------------------------------
+Name: close_frame_ring
+Description: Unmaps the ring, and removes the shared memory object if this
+	process created it. Readers that still have it mapped keep their view.
+
+Purpose: Cleanup for both ends.
+--------------------------------------*/
+inline void close_frame_ring(FrameRing &ring){
+#ifdef FRAME_RING_AVAILABLE
+	if(ring.base) munmap(ring.base, ring.bytes);
+	if(ring.owner) shm_unlink(ring.name.c_str());
+#endif
+	ring.base = nullptr;
+	ring.bytes = 0;
+	ring.owner = false;
+}
+
+
+/*-------------------------------------
+Name: create_frame_ring
+Description: Creates (or replaces) the POSIX shared memory object name, e.g.
+	"/raycaster", sized for slot_count frames of width x height pixels in
+	the framebuffer's format, and maps it. Returns false, with a message,
+	if shared memory is not available or the ring would have no slots or
+	not fit in memory.
+
+Purpose: The renderer's end of the ring; slot_count - 1 frames stay readable
+	while the next one is written.
+--------------------------------------*/
+inline bool create_frame_ring(const std::string name,
+			const size_t width,
+			const size_t height,
+			const size_t slot_count,
+			FrameRing &ring){
+#ifdef FRAME_RING_AVAILABLE
+	const size_t pitch = width*sizeof(uint32_t);
+	const size_t max_pixels = SIZE_MAX - sizeof(FrameRingHeader) - sizeof(FrameSlotHeader) - 63;
+	if(slot_count == 0 || slot_count > UINT32_MAX || width > UINT32_MAX/sizeof(uint32_t) || height > UINT32_MAX ||
+	   (height > 0 && pitch > max_pixels/height)){
+		std::cerr << "Cannot make a frame ring of " << slot_count << " slots of " << width << "x" << height << "\n";
+		return false;
+	}
+	const size_t slot_bytes = (sizeof(FrameSlotHeader) + pitch*height + 63) & ~size_t(63);
+	if(slot_bytes > (SIZE_MAX - sizeof(FrameRingHeader))/slot_count){
+		std::cerr << "Cannot make a frame ring of " << slot_count << " slots of " << width << "x" << height << "\n";
+		return false;
+	}
+	const size_t bytes = sizeof(FrameRingHeader) + slot_count*slot_bytes;
+	shm_unlink(name.c_str());
+	const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd < 0 || ftruncate(fd, bytes) != 0){
+		std::cerr << "Failed to create shared memory " << name << ": " << std::strerror(errno) << "\n";
+		if(fd >= 0){
+			close(fd);
+			shm_unlink(name.c_str());
+		}
+		return false;
+	}
+	void *base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED){
+		std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << "\n";
+		shm_unlink(name.c_str());
+		return false;
+	}
+	ring.name = name;
+	ring.base = static_cast<uint8_t*>(base);
+	ring.bytes = bytes;
+	ring.owner = true;
+
+	//a fresh object is zero filled: every slot reads as empty
+	FrameRingHeader &header = ring.header();
+	header.version = frame_ring_version;
+	header.slot_count = uint32_t(slot_count);
+	header.width = uint32_t(width);
+	header.height = uint32_t(height);
+	header.pitch = uint32_t(pitch);
+	header.r_shift = FramebufferFormat::r_shift;
+	header.g_shift = FramebufferFormat::g_shift;
+	header.b_shift = FramebufferFormat::b_shift;
+	header.a_shift = FramebufferFormat::a_shift;
+	header.slot_bytes = slot_bytes;
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header.magic, frame_ring_magic, sizeof(header.magic));
+	return true;
+#else
+	std::cerr << "Shared memory frame rings are not supported on this platform\n";
+	return false;
+#endif
+}
+
+
+/*-------------------------------------
+Name: open_frame_ring
+Description: Maps an existing frame ring read-only. Fails if name does not
+	exist, is not a frame ring of this version, or describes slots (none,
+	or more than the object holds) or frames that do not fit in it.
+
+Purpose: The reader's end of the ring.
+--------------------------------------*/
+inline bool open_frame_ring(const std::string name, FrameRing &ring){
+#ifdef FRAME_RING_AVAILABLE
+	const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	struct stat info;
+	if(fd < 0 || fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(FrameRingHeader)){
+		std::cerr << "Failed to open shared memory " << name << "\n";
+		if(fd >= 0) close(fd);
+		return false;
+	}
+	void *base = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED){
+		std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno) << "\n";
+		return false;
+	}
+	ring.name = name;
+	ring.base = static_cast<uint8_t*>(base);
+	ring.bytes = info.st_size;
+	ring.owner = false;
+	//every slot, and the pixels in it, must lie inside the mapping; the
+	//sizes come from another process, so they are checked without
+	//multiplying anything that could overflow
+	const FrameRingHeader &header = ring.header();
+	const uint64_t slot_space = ring.bytes - sizeof(FrameRingHeader);
+	if(std::memcmp(header.magic, frame_ring_magic, sizeof(header.magic)) != 0 ||
+	   header.version != frame_ring_version || header.slot_count == 0 ||
+	   header.slot_bytes > slot_space/header.slot_count || header.slot_bytes < sizeof(FrameSlotHeader) ||
+	   uint64_t(header.width)*sizeof(uint32_t) > header.pitch ||
+	   uint64_t(header.pitch)*header.height > header.slot_bytes - sizeof(FrameSlotHeader)){
+		std::cerr << name << " is not a valid version " << frame_ring_version << " frame ring\n";
+		close_frame_ring(ring);
+		return false;
+	}
+	return true;
+#else
+	std::cerr << "Shared memory frame rings are not supported on this platform\n";
+	return false;
+#endif
+}
+
+
+/*-------------------------------------
+Name: publish_frame
+Description: Copies a finished frame into the next slot of the ring with its
+	index, pose and a timestamp, and makes it visible to readers. The frame
+	is copied row by row, so its pitch need not be the ring's. It never
+	waits: a reader still busy with the slot being reused simply finds it
+	overwritten when it checks (see frame_still_valid).
+
+Purpose: Called by the renderer once per frame; the cost is one copy of the
+	framebuffer into shared memory and no system call.
+--------------------------------------*/
+inline void publish_frame(FrameRing &ring, const FrameView<uint32_t> frame, const Pose &pose){
+	FrameRingHeader &header = ring.header();
+	assert(frame.width == header.width && frame.height == header.height);
+	const uint64_t frame_index = header.published.load(std::memory_order_relaxed);
+	FrameSlotHeader &slot = ring.slot(frame_index);
+	slot.sequence.store(2*frame_index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.frame_index = frame_index;
+	slot.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	slot.pose = pose;
+	uint8_t *pixels = ring.pixels(slot);
+	for(size_t y=0; y<frame.height; y++)
+		std::memcpy(pixels + y*size_t(header.pitch), frame.row(y), frame.width*sizeof(uint32_t));
+	slot.sequence.store(2*frame_index + 2, std::memory_order_release);
+	header.published.store(frame_index + 1, std::memory_order_release);
+}
+
+
+/*-------------------------------------
+Name: latest_frame, frame_still_valid
+Description: latest_frame returns the slot of the newest complete frame, or
+	nullptr if none has been published yet (or the renderer has already
+	started overwriting it, which only happens to a reader that is very
+	late), and puts the slot's sequence number in ticket. The pixels can be
+	read in place, straight out of shared memory; afterwards
+	frame_still_valid tells whether the renderer reused the slot meanwhile,
+	in which case whatever was read may be torn and must be dropped. No
+	copies are needed unless a reader wants to keep a frame.
+
+	frame_at does the same for a given frame index, for readers that want
+	every frame and can keep up.
+
+Purpose: Lock-free reading that can never hold the renderer back.
+--------------------------------------*/
+inline const FrameSlotHeader *frame_at(const FrameRing &ring, const uint64_t frame_index, uint64_t &ticket){
+	const FrameSlotHeader &slot = ring.slot(frame_index);
+	ticket = slot.sequence.load(std::memory_order_acquire);
+	if(ticket != 2*frame_index + 2) return nullptr;
+	return &slot;
+}
+
+inline const FrameSlotHeader *latest_frame(const FrameRing &ring, uint64_t &ticket){
+	const uint64_t published = ring.header().published.load(std::memory_order_acquire);
+	if(published == 0) return nullptr;
+	return frame_at(ring, published - 1, ticket);
+}
+
+inline bool frame_still_valid(const FrameSlotHeader &slot, const uint64_t ticket){
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot.sequence.load(std::memory_order_relaxed) == ticket;
+}
+
+#endif
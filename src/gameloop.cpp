@@ -3,99 +3,44 @@
 #include <fstream>
 #include <vector>
 #include <cstdint>
+#include <cstdlib>
 #include <cassert>
-
-/*-------------------------------------
-Name: packcolor
-Description: This function packs separate RGBA components into a single 32-bit integer
-	in ABGR format, with alpha as the highest byte and red as the lowest byte. 
-
-Purpose: This renderer builds a 2d array of pixels into an image in in memory, saving
-	or writing out to an image file or displaying to the screen is done per pixel, 
-	usually a single uint32_t and often using formats (e.g. BMP, PNG, PPM) that 
-	expect packed pixels
---------------------------------------*/
-uint32_t packcolor(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a=255){
-	return (a<<24) + (r<<16) + (g<<8) + b;
-}
-
-
-/*-------------------------------------
-Name: unpack_color
-Description: This function separates an ABGR component stored as a single 32-bit 
-	integer into 4 RGBA components stored with 8-bit integers, with alpha as 
-	the highest byte and red as the lowest byte. 
-
-Purpose: This is useful when needing to modify, inspect, or output individual 
-	color components from a packed pixel. For example, when applying 
-	image effects, blending, or exporting to formats that expect raw RGB(A) 
-	values. 
---------------------------------------*/
-void unpack_color(const uint32_t &color, uint8_t &r, uint8_t &g, uint8_t &b, uint8_t &a){
-	r = (color >> 0) & 255;
-	g = (color >> 8) & 255; 
-	b = (color >> 16) & 255; 
-	a = (color >> 24) & 255; 
-}
-
-
-/*-------------------------------------
-Name: drop_ppm_image
-Description: Takes a filename, size variables, and a 2d image represented by a 
-	flattened 1D of packed 32-bit pixels. This function writes the pixel data 
-	to a PPM image file by using the RGB channels retrieved from unpacking each 
-	pixel in the image array. 
-	
-Purpose: To export the renderer's pixel buffer as a standard image file. The PPM 
-	(Portable Pixmap) format is simple and widely supported, making it 
-	useful for debugging or viewing output without needing external image 
-	libraries.
---------------------------------------*/
-void drop_ppm_image(const std::string filename,
-		    const std::vector<uint32_t> &image,
-		    const size_t width,
-		    const size_t height){
-	assert(image.size() == width *height);
-	std::ofstream ofs(filename, std::ios::binary);
-	ofs << "P6\n" << width << " " << height << "\n255\n";
-	for (size_t i = 0; i < width*height; i++){
-		uint8_t r, g, b, a;
-		unpack_color(image[i], r, g, b, a);
-		ofs << static_cast<char>(r) << static_cast<char>(g) << static_cast<char>(b); 
-	}
-	ofs.close();
-}
-
-
-
-/*-------------------------------------
-Name: draw_rectangle 
-Description: Draws a solid-colored rectangle on a 1D framebuffer image.
-The rectangle starts at (x_pos, y_pos) and spans rect_width × rect_height pixels.
-
-
-Purpose: Enables pixel-level rectangle drawing into a linear framebuffer. 
---------------------------------------*/
-void draw_rectangle(std::vector<uint32_t> &image,
-			const size_t image_width,
-			const size_t image_height,
-			const size_t x_pos,
-			const size_t y_pos,
-			const size_t rect_width,
-			const size_t rect_height,
-			const uint32_t color){
-	assert(image.size() == image_width * image_height);
-	for(size_t i=0; i<rect_width;i++){
-		for(size_t j=0; j<rect_height; j++){
-			size_t cx = x_pos+i;
-			size_t cy = y_pos+j;
-			if(cx>image_width || cy>=image_height) continue;
-			image[cx + cy*image_width] = color;
-		}
-	}
-
-}
-
+#include <type_traits>
+#include <chrono>
+#include <memory>
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "arena.h"
+#include "visibility.h"
+#include "mapfile.h"
+#include "pvs.h"
+#include "builtin_map.h"
+#include "static_map.h"
+#include "map_edit.h"
+#include "bsp.h"
+#include "heights.h"
+#include "voxel.h"
+#include "terrain.h"
+#include "framering.h"
+#include "recording.h"
+#include "assets.h"
+#include "palette.h"
+#include "entities.h"
+#include "pathfinding.h"
+#include "pacing.h"
+#include "hotreload.h"
+#include "gridframe.h"
+
+#ifdef STATIC_RENDER
+//The built in map baked by the compiler, used when no map file is given
+constexpr auto baked_map = bake_map<builtin_map_width, builtin_map_height>(builtin_map);
+//and the copy that is drawn, which follows edits to the map
+auto live_map = baked_map;
+#endif
 
 /*-------------------------------------
 Name: main
@@ -106,43 +51,194 @@ Description: Initializes a 512×512 framebuffer and fills it with a vertical–h
 
 Purpose: Acts as a minimal test program for the software renderer, demonstrating 
     the use of the framebuffer, color packing, and image output
+
+    An optional map file can be given on the command line (see maps/level1.map),
+    otherwise the built in map is used. If a PVS file built by pvs_build sits
+    next to the map file with a .pvs extension it is loaded as well, in the
+    background like a BSP level or terrain.
+    --record-poses <file> writes the player's pose every frame, for replaying
+    the session in the benchmarks. Built with -DSTATIC_RENDER the built in
+    map is drawn by the kernels of static_map.h, specialized at compile time
+    for the map and the window size.
+    --bsp <file> draws the 3D view from a segment level compiled by
+    bsp_build instead of the grid; given with the map file it was built
+    from, the grid's lighting still applies. Doors and wall edits are off
+    in this mode, since they would change the grid and not the BSP drawn.
+    --record-frames <file> records the frames themselves, delta encoded on a
+    background thread; session_decode turns the file back into images.
+    --indexed draws the grid view as 8-bit palette indices, with palette
+    ramps for the shaded walls, and expands them to colors at upload.
+    --entities <count> populates the map with count NPCs and projectiles,
+    simulated every frame and shown on the minimap; the NPCs walk toward
+    the player along a flow field from the path service.
+    --panorama makes the ray cache cast the full circle of rays once the
+    player stands still, so turning in place casts no new rays.
+    --on-demand draws a frame only when there is input, a simulation
+    running or an asset arriving, and otherwise sleeps in the event queue;
+    --refresh <seconds> redraws at least that often while idle. Every 10
+    seconds the demo prints its processor use and the frames it drew.
+    --spin <microseconds> sets how long before each frame's deadline the
+    pacer stops sleeping and yields instead (1000 by default, 0 to only
+    sleep).
+    A map file given on the command line is watched while the demo runs:
+    saving it reloads it in the background and changes the cells that
+    differ from the last version loaded, as edits, without moving the
+    camera. Doors follow the file too; lights, heights and a new map size
+    take a restart.
 --------------------------------------*/
-int main(){
-	const size_t window_width = 1024; 
-	const size_t window_height = 512;
-	std::vector<uint32_t> framebuffer(window_width * window_height,
-					packcolor(255, 255, 255));
+int main(int argc, char **argv){
+	const auto startup = std::chrono::steady_clock::now();
+	bool indexed_mode = false;
+	bool panorama = false;
+	bool on_demand = false;
+	double refresh_seconds = 0;
+	long spin_us = 1000;
+	size_t entity_count = 0;
+	std::string map_file, pose_file, bsp_file, terrain_height_file, terrain_color_file, ring_name, recording_file;
+	for(int i=1; i<argc; i++){
+		std::string arg = argv[i];
+		if(arg == "--record-poses" && i+1 < argc) pose_file = argv[++i];
+		else if(arg == "--bsp" && i+1 < argc) bsp_file = argv[++i];
+		else if(arg == "--publish" && i+1 < argc) ring_name = argv[++i];
+		else if(arg == "--record-frames" && i+1 < argc) recording_file = argv[++i];
+		else if(arg == "--indexed") indexed_mode = true;
+		else if(arg == "--panorama") panorama = true;
+		else if(arg == "--on-demand") on_demand = true;
+		else if(arg == "--refresh" && i+1 < argc) refresh_seconds = std::strtod(argv[++i], nullptr);
+		else if(arg == "--spin" && i+1 < argc) spin_us = std::max(0L, std::strtol(argv[++i], nullptr, 10));
+		else if(arg == "--entities" && i+1 < argc) entity_count = std::strtoul(argv[++i], nullptr, 10);
+		else if(arg == "--terrain" && i+2 < argc){
+			terrain_height_file = argv[++i];
+			terrain_color_file = argv[++i];
+		}
+		else map_file = arg;
+	}
+
+	constexpr size_t window_width = 1024; 
+	constexpr size_t window_height = 512;
+	//Rows 64-byte aligned and padded off the 4 KB a 1024 pixel row takes,
+	//on transparent huge pages where the kernel has them
+	Framebuffer<uint32_t> framebuffer(window_width, window_height, true);
+	framebuffer.view().fill(packcolor(255, 255, 255));
 	
 	
 	/*
 	 Additions to main() function: A map structure with size variables has been added.
-	 This map is represented by 16 16 character strings and a null terminator;. Empty
+	 The built in map lives in builtin_map.h, 16 rows of 16 characters. Empty
 	 spaces represent an empty space on the map, 0, 1, 2, and 3, represent different 
 	 types of wall textures to be included. 
 	*/
-	const size_t map_width = 16; 
-	const size_t map_height = 16;
-	const char map[] =  "0000222222220000"\
-                      	    "1              0"\
-                            "1   11 11111   0"\
-                    	    "1     0        0"\
-                       	    "0     0  1110000"\
-                            "0     3        0"\
-                            "0   10000      0"\
-                            "0   0   11100  0"\
-                            "0   0   0      0"\
-                            "0   0   1  00000"\
-                            "0       1      0"\
-                            "2       1111   0"\
-                            "0       0      0"\
-                            "0 0000000      0"\
-                            "0              0"\
-                            "0002222222200000"; 
-	assert(sizeof(map) == map_width * map_height+1);
+	size_t map_width = builtin_map_width; 
+	size_t map_height = builtin_map_height;
+	std::string map = builtin_map;
+	//Lights for the built in map, a map file brings its own
+	std::vector<Light> lights = {{3.5f, 2.5f, 8.f, 1.f}, {12.5f, 12.5f, 8.f, 1.f}, {6.5f, 9.5f, 6.f, .8f}};
+	//Doors of the built in map, likewise
+	std::vector<Door> doors = {{8, 10, map[8 + 10*map_width], false}};
+	std::vector<std::string> map_extras;
+	if(!map_file.empty()){
+		if(!load_map_file(map_file, map, map_width, map_height, &map_extras)) return 1;
+		lights = parse_lights(map_extras);
+		doors = parse_doors(map_extras, map, map_width, map_height);
+	}
+	assert(map.size() == map_width * map_height);
+
+	//Bake the light map once, moving a light later only relights its radius
+	LightMap lighting = bake_lighting(map.data(), map_width, map_height, lights);
+
+	//Files beyond the map are read and decoded in the background while the
+	//window already draws; each stands in with a placeholder until the
+	//frame loop swaps it in
+	AssetLoader asset_loader;
+
+	//Precomputed visibility for the map, if one was built for it
+	PvsTable pvs;
+	AssetHandle<PvsTable> pvs_asset;
+	if(!map_file.empty()){
+		std::string pvs_file = map_file;
+		size_t dot = pvs_file.find_last_of('.');
+		if(dot != std::string::npos && pvs_file.find('/', dot) == std::string::npos)
+			pvs_file.erase(dot);
+		pvs_file += ".pvs";
+		if(std::ifstream(pvs_file).good())
+			pvs_asset = asset_loader.load<PvsTable>("PVS " + pvs_file, {pvs_file},
+				[pvs_file, map, map_width, map_height](const std::vector<std::vector<uint8_t>> &files, PvsTable &out){
+					ByteStream stream(files[0]);
+					return parse_pvs(stream, pvs_file, map.data(), map_width, map_height, out);
+				});
+	}
 	
+	//The map file reloaded when it is saved, diffed on a loader thread
+	//against the last version loaded so edits made in play are kept
+	FileWatcher map_watcher;
+	std::shared_ptr<std::string> map_baseline;
+	AssetHandle<MapReload> reload_asset;
+	bool reload_queued = false;
+	if(!map_file.empty() && map_watcher.watch(map_file)){
+		map_baseline = std::make_shared<std::string>(map);
+		std::cout << "Watching " << map_file << " for changes\n";
+	}
+	
+	//Segment level drawn instead of the grid, if one was given; until it
+	//arrives the view is empty inside the grid map's bounds
+	BspTree world_bsp;
+	AssetHandle<BspTree> bsp_asset;
+	const bool use_bsp = !bsp_file.empty();
+	if(use_bsp){
+		world_bsp.nodes.resize(1);
+		world_bsp.nodes[0].max_x = map_width;
+		world_bsp.nodes[0].max_y = map_height;
+		bsp_asset = asset_loader.load<BspTree>("BSP " + bsp_file, {bsp_file},
+			[bsp_file](const std::vector<std::vector<uint8_t>> &files, BspTree &out){
+				ByteStream stream(files[0]);
+				return parse_bsp(stream, bsp_file, out);
+			});
+	}
+	const LightMap *wall_lighting = (use_bsp && map_file.empty()) ? nullptr : &lighting;
+
+	//Per-cell heights from the map file; a map with any step, low wall or
+	//ceiling in it is drawn by the multi-level renderer
+	const HeightMap heights = build_height_map(map.data(), map_width, map_height, map_extras);
+	const bool use_heights = !heights.uniform && !use_bsp;
+
+	//The same map as voxels for the full 3D view, toggled with v; built
+	//the first time the view is shown, from the map as edited by then
+	const size_t voxels_per_cell = std::max<size_t>(1, std::min<size_t>(8, 512/std::max(map_width, map_height)));
+	VoxelVolume voxels;
+	TileWorkers voxel_workers;
+	bool voxel_view = false;
+	float view_pitch = 0;
+
+	//Outdoor heightmap terrain drawn instead of the map, if one was given,
+	//flat and plain until its images have loaded; the player's position
+	//is scaled up to texels
+	Terrain terrain;
+	AssetHandle<Terrain> terrain_asset;
+	const bool use_terrain = !terrain_height_file.empty();
+	if(use_terrain){
+		terrain = flat_terrain(packcolor(96, 112, 80));
+		terrain_asset = asset_loader.load<Terrain>("terrain " + terrain_height_file,
+			{terrain_height_file, terrain_color_file},
+			[terrain_height_file, terrain_color_file](const std::vector<std::vector<uint8_t>> &files, Terrain &out){
+				ByteStream height_stream(files[0]), color_stream(files[1]);
+				return parse_terrain(height_stream, terrain_height_file, color_stream, terrain_color_file, out);
+			});
+	}
+	const float texels_per_unit = 8;
+	const float terrain_distance = 2000;
+	const ShadeTable terrain_shading = use_terrain ?
+		build_shade_table(terrain_distance, 256, packcolor(200, 200, 200), terrain_distance*.4f, 1.f, 1.f) :
+		ShadeTable();
+
 	float player_x = 5.956; //player x position 
 	float player_y = 11.345; // player y position 
 	float player_a = -1.500; //direction of the players gaze 
+	Pose start_pose;
+	if(parse_start_pose(map_extras, start_pose)){
+		player_x = start_pose.x;
+		player_y = start_pose.y;
+		player_a = start_pose.a;
+	}
 	const float fov = M_PI/3.;	
 
 
@@ -211,8 +307,12 @@ int main(){
 	}
 
 
+	//The texture takes the framebuffer as is, so its format follows the
+	//framebuffer's pixel format tag
+	const uint32_t texture_format = std::is_same<FramebufferFormat, FormatARGB8888>::value ?
+		SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_ABGR8888;
 	SDL_Texture* texture = SDL_CreateTexture(renderer,
-						SDL_PIXELFORMAT_ARGB8888,
+						texture_format,
 						SDL_TEXTUREACCESS_STREAMING, 
 						window_width,
 						window_height);
@@ -228,18 +328,131 @@ int main(){
 	
 
 	// Time manegment
-	uint32_t last_time = SDL_GetTicks();
 	const int FPS = 60;
 	const int frame_delay = 1000/FPS;
+	FramePacer pacer(FPS, std::chrono::microseconds(spin_us));
+	OnDemandWait idle(uint32_t(refresh_seconds*1000), frame_delay, SDL_GetTicks());
+	bool redraw = true;
+
+	//Processor use of the whole process, and frames drawn, every 10 s
+	CpuMeter cpu_meter;
+	size_t frames_drawn = 0;
+	auto report_cpu = [&](){
+		if(cpu_meter.seconds_since_sample() < 10) return;
+		const double seconds = cpu_meter.seconds_since_sample();
+		std::cout << "CPU: " << 100*cpu_meter.sample() << "% of a core, " << frames_drawn << " frames drawn in "
+			  << seconds << " s" << (on_demand ? " (on demand)\n" : "\n");
+		frames_drawn = 0;
+	};
 
 	// Keep the window open until the user closes it
 	bool running = true;
+	int exit_status = 0;
 	SDL_Event event;
+	//The grid view's scratch and the cache of its rays, which the other
+	//views cast into as well
+	GridFrame grid;
+	std::vector<RayHit> &hits = grid.hits;
+	RayCache &ray_cache = grid.ray_cache;
+	ray_cache.panorama = panorama;
+	RayCacheStats ray_stats;
+	//NPCs and projectiles, updated on the voxel view's worker threads
+	Entities entities;
+	SpatialHash entity_hash;
+	EntityTickStats entity_stats;
+	size_t entity_ticks = 0;
+	spawn_entities(entities, map.data(), map_width, map_height, entity_count);
+	//and the flow field they follow toward the player, asked of the path
+	//service again whenever the player changes cell or the map is edited
+	std::unique_ptr<PathService> path_service;
+	if(entity_count > 0) path_service.reset(new PathService(map, map_width, map_height));
+	AssetHandle<std::shared_ptr<const FlowField>> player_field_asset;
+	std::shared_ptr<const FlowField> player_field;
+	size_t player_field_cell = map.size();
+	std::ofstream pose_log;
+	if(!pose_file.empty()) pose_log.open(pose_file);
+
+	//Distance shading and fog for the walls, toggled with f
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+	bool shading_enabled = true;
+
+	//Indexed mode: the grid view is drawn as one byte per pixel into
+	//indexed_frame and expanded through the palette at upload; the other
+	//views, which need more colors, still draw 32-bit
+	Palette palette;
+	const uint8_t clear_index = palette.add(packcolor(200, 200, 200));
+	const uint8_t minimap_index[3] = {palette.add(packcolor(0, 255, 255)), palette.add(packcolor(0, 128, 128)),
+					  palette.add(packcolor(0, 64, 64))};
+	const uint8_t player_index = palette.add(packcolor(255, 255, 255));
+	const uint8_t trace_index = palette.add(packcolor(160, 160, 160));
+	const uint8_t entity_index[2] = {palette.add(packcolor(255, 128, 0)), palette.add(packcolor(255, 0, 0))};
+	const uint8_t wall_ramp = add_wall_ramp(palette, packcolor(0, 255, 255), packcolor(200, 200, 200));
+	const IndexedShading indexed_shading = build_indexed_shading(palette, wall_ramp, packcolor(0, 255, 255), &shading);
+	const IndexedShading indexed_unshaded = build_indexed_shading(palette, wall_ramp, packcolor(0, 255, 255), nullptr);
+	Framebuffer<uint8_t> indexed_frame(indexed_mode ? window_width : 0, window_height);
+	indexed_frame.view().fill(clear_index);
+	const GridColors<uint32_t> grid_colors = {packcolor(200, 200, 200), // light gray
+		{packcolor(0, 255, 255), packcolor(0, 128, 128), packcolor(0, 64, 64)}, packcolor(255, 255, 255),
+		packcolor(160, 160, 160), {packcolor(255, 128, 0), packcolor(255, 0, 0)}, packcolor(0, 255, 255)};
+	const GridColors<uint8_t> indexed_colors = {clear_index, {minimap_index[0], minimap_index[1], minimap_index[2]},
+		player_index, trace_index, {entity_index[0], entity_index[1]}, 0};
+	GridScene grid_scene;
+	grid_scene.map_width = map_width;
+	grid_scene.map_height = map_height;
+	grid_scene.pvs = &pvs;
+	grid_scene.lighting = &lighting;
+	grid_scene.entities = &entities;
+	grid_scene.heights = &heights;
+	grid_scene.voxels = &voxels;
+	grid_scene.workers = &voxel_workers;
+	grid_scene.fov = fov;
+
+	//The minimap half and the 3D half of either frame, as views of it
+	const FrameView<uint32_t> frame = framebuffer.view();
+	const FrameView<uint32_t> map_view = frame.sub_view(0, 0, window_width/2, window_height);
+	const FrameView<uint32_t> world_view = frame.sub_view(window_width/2, 0, window_width/2, window_height);
+	const FrameView<uint8_t> indexed = indexed_frame.view();
+	const FrameView<uint8_t> indexed_map_view = indexed.sub_view(0, 0, window_width/2, window_height);
+	const FrameView<uint8_t> indexed_world_view = indexed.sub_view(window_width/2, 0, window_width/2, window_height);
+
+	//Scratch memory for a single frame, reset at the top of every frame
+	FrameArena frame_arena(4 << 20);
+	size_t frame_index = 0;
+	size_t composed_pixels = 0, composed_frames = 0;
+	bool screenshot_requested = false;
+
+	//Map cells changed this frame, derived data is updated once after input
+	MapEdits map_edits;
+
+	//Finished frames published to shared memory for local readers
+	FrameRing frame_ring;
+	if(!ring_name.empty() && create_frame_ring(ring_name, window_width, window_height, 4, frame_ring))
+		std::cout << "Publishing frames to shared memory " << ring_name << "\n";
+
+	//Finished frames recorded to a file, encoded off the frame loop
+	FrameRecorder recorder;
+	if(!recording_file.empty() && recorder.open(recording_file, window_width, window_height))
+		std::cout << "Recording frames to " << recording_file << "\n";
 
 	while (running) {
-		uint32_t frame_start = SDL_GetTicks();
+		//On demand, with nothing moving, sleep in the event queue until
+		//input arrives, polling at the frame rate while assets load and
+		//waking for the periodic refresh
+		const bool animating = entities.size() > 0;
+		if(on_demand && !redraw && !animating){
+			//inotify does not wake the event queue, look at the map file
+			//a few times a second
+			const int timeout = idle.timeout(asset_loader.pending() > 0, map_watcher.watching(), SDL_GetTicks());
+			if(timeout < 0) SDL_WaitEvent(nullptr);
+			else SDL_WaitEventTimeout(nullptr, timeout);
+			pacer.restart();
+		}
+		frame_arena.reset();
+		const size_t allocations_at_start = allocation_count();
+		bool had_input = false;
 
 		while(SDL_PollEvent(&event)){
+			had_input = true;
 			if(event.type == SDL_QUIT)running = false; 
 			if(event.type == SDL_KEYDOWN){
 				switch(event.key.keysym.sym){
@@ -253,82 +466,366 @@ int main(){
 						break;
 					case SDLK_a: player_a -=.05; break; 
 					case SDLK_d: player_a +=.05; break;
+					case SDLK_f: shading_enabled = !shading_enabled; break;
+					case SDLK_v:
+						if(!voxel_view && voxels.empty())
+							voxels = voxels_from_map(map.data(), map_width, map_height,
+										 heights, voxels_per_cell);
+						voxel_view = !voxel_view && !voxels.empty();
+						break;
+					case SDLK_r: view_pitch = std::min(view_pitch + .05f, 1.2f); break; //look up
+					case SDLK_c: view_pitch = std::max(view_pitch - .05f, -1.2f); break; //look down
+					case SDLK_p: screenshot_requested = true; break;
+					case SDLK_l: //carry the first light to the player
+						if(!lighting.lights.empty()){
+							uint64_t start = SDL_GetPerformanceCounter();
+							move_light(lighting, map.data(), 0, player_x, player_y);
+							uint64_t ticks = SDL_GetPerformanceCounter() - start;
+							std::cout << "Light moved, relit " << lighting.cells_relit << " cells in "
+								  << ticks*1e6/SDL_GetPerformanceFrequency() << " us\n";
+						}
+						break;
+					case SDLK_e: //open or shut a door within reach, not the one the player stands in
+						if(use_bsp){
+							std::cout << "Doors and walls of a BSP level are compiled in, rebuild it with bsp_build\n";
+							break;
+						}
+						for(Door &door : doors){
+							if(std::hypot(door.x + .5f - player_x, door.y + .5f - player_y) > 1.6f) continue;
+							if(door.open && size_t(player_x) == door.x && size_t(player_y) == door.y &&
+							   player_x >= 0 && player_y >= 0)
+								std::cout << "Step out of the doorway to shut the door\n";
+							else toggle_door(door, map, map_width, map_height, map_edits);
+							break;
+						}
+						break;
+					case SDLK_x: //knock out the wall in front, not the outer wall
+					case SDLK_b: //build a wall in front
+					{
+						if(use_bsp){
+							std::cout << "Doors and walls of a BSP level are compiled in, rebuild it with bsp_build\n";
+							break;
+						}
+						const size_t fx = size_t(player_x + cos(player_a));
+						const size_t fy = size_t(player_y + sin(player_a));
+						const bool inner = fx > 0 && fy > 0 && fx + 1 < map_width && fy + 1 < map_height;
+						const bool own_cell = fx == size_t(player_x) && fy == size_t(player_y);
+						if(inner && !own_cell)
+							set_map_cell(map, map_width, map_height, fx, fy,
+								event.key.keysym.sym == SDLK_x ? ' ' : '3', map_edits);
+						break;
+					}
 				}	
 			}	
 		}
 
-		const size_t rect_width = window_width/(map_width*2);
-		const size_t rect_height = window_height/map_height;
-
-		for(size_t j=0; j<map_height; j++){
-			for(size_t i=0; i<map_width; i++){
-				if(map[i+j*map_width]==' ') continue;
-				size_t rect_x = i*rect_width;
-				size_t rect_y = j*rect_height;
-				draw_rectangle(framebuffer,
-						window_width,
-						window_height,
-						rect_x,
-						rect_y,
-						rect_width,
-						rect_height,
-						packcolor(0, 255, 255));
+		//Swap in assets that finished loading, between frames so no frame
+		//draws half of one
+		{
+			auto report = [&](const AssetStatus *status){
+				std::cout << "Loaded " << status->name << ": read " << status->read_ms << " ms, decoded "
+					  << status->decode_ms << " ms, in use at frame " << frame_index << ", "
+					  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count()
+					  << " ms after startup\n";
+			};
+			//the loader has already said what went wrong; a level or terrain
+			//that cannot load ends the demo, as it did when they loaded
+			//before the window opened, the PVS is only an optimization
+			for(const AssetStatus *status : {terrain_asset.failed() ? terrain_asset.status() : nullptr,
+							 bsp_asset.failed() ? bsp_asset.status() : nullptr}){
+				if(!status) continue;
+				std::cerr << "Failed to load " << status->name << ", exiting\n";
+				running = false;
+				exit_status = 1;
+			}
+			if(!running) continue;
+			if(pvs_asset.failed()){
+				std::cerr << "Failed to load " << pvs_asset.status()->name << ", drawing without it\n";
+				pvs_asset = AssetHandle<PvsTable>();
+			}
+			if(terrain_asset.take(terrain)){
+				report(terrain_asset.status());
+				redraw = true;
+			}
+			if(bsp_asset.take(world_bsp)){
+				report(bsp_asset.status());
+				redraw = true;
+			}
+			if(pvs_asset.take(pvs)){
+				redraw = true;
+				//edits made while it loaded are not in it
+				if(pvs.map_hash == map_hash(map.data(), map_width, map_height)) report(pvs_asset.status());
+				else {
+					std::cout << "Dropped " << pvs_asset.status()->name << ", the map changed while it loaded\n";
+					pvs = PvsTable();
+				}
+			}
+			//Saves in quick succession make one reload after the one in flight
+			if(map_watcher.changed()) reload_queued = true;
+			if(reload_queued && !reload_asset.pending()){
+				reload_queued = false;
+				reload_asset = asset_loader.load<MapReload>("map " + map_file, {map_file},
+					[map_file, map_baseline, map_width, map_height](const std::vector<std::vector<uint8_t>> &files,
+								MapReload &out){
+						return decode_map_reload(files[0], map_file, *map_baseline, map_width, map_height, out);
+					});
+			}
+			if(reload_asset.failed()){
+				std::cerr << "Failed to reload " << map_file << ", keeping the map as it is\n";
+				reload_asset = AssetHandle<MapReload>();
+			}
+			MapReload reload;
+			if(reload_asset.take(reload)){
+				redraw = true;
+				if(reload.width != map_width || reload.height != map_height)
+					std::cout << "Not reloading " << map_file << ": it is now " << reload.width << "x"
+						  << reload.height << ", restart to load a map of a new size\n";
+				else {
+					for(const std::pair<uint32_t, char> &change : reload.changes)
+						set_map_cell(map, map_width, map_height, change.first % map_width,
+							     change.first / map_width, change.second, map_edits);
+					if(reload.extra_lines != map_extras){
+						//doors the player opened stay open if the file kept them
+						std::vector<Door> reloaded = parse_doors(reload.extra_lines, reload.cells, map_width, map_height);
+						for(Door &door : reloaded)
+							for(const Door &old : doors)
+								if(old.open && old.x == door.x && old.y == door.y){
+									set_map_cell(map, map_width, map_height, door.x, door.y, ' ', map_edits);
+									door.open = true;
+								}
+						doors = std::move(reloaded);
+						map_extras = std::move(reload.extra_lines);
+					}
+					std::cout << "Reloaded " << map_file << ": " << reload.changes.size() << " cells changed, read "
+						  << reload_asset.status()->read_ms << " ms, diffed " << reload_asset.status()->decode_ms
+						  << " ms\n";
+				}
 			}
-
 		}
 
-		draw_rectangle(framebuffer,
-				window_width,
-				window_height,
-				player_x*rect_width,
-				player_y*rect_height,
-				5,
-				5,
-				packcolor(255,255,255));//draw the player rectangle
-
-
-
-		//Draw the 2D to the framebuffer
-		for(size_t i=0; i<window_width/2;i++){
-
+		//Nothing to show that the last frame does not already
+		const bool refresh_due = idle.refresh_due(SDL_GetTicks());
+		if(on_demand && !redraw && !had_input && !animating && !refresh_due){
+			report_cpu();
+			continue;
 		}
-		//Draw the 3D to the framebuffer
-		for(size_t i=0; i<window_width/2; i++){
-			float angle = player_a-fov/2 + fov*i/float(window_width/2);
-			for(float t=0; t<20; t+=.05){
-				float cx = player_x + t*cos(angle);
-				float cy = player_y + t*sin(angle);
-				if(map[int(cx)+int(cy)*map_width] != ' '){
-					size_t column_height = window_height / t;
-					draw_rectangle(framebuffer, 
-							window_width, 
-							window_height, 
-							window_width/2 + i,
-							window_height/2 - column_height/2,
-							1,
-							column_height,
-							packcolor(0, 255, 255)); // cyan wall
-					break;
-				}	
-				size_t pix_x = cx * rect_width;
-				size_t pix_y = cy * rect_width; 
-				framebuffer[pix_x + pix_y * window_width] = packcolor(160, 160, 160); // floor/trace
+		redraw = false;
+
+		//Bring lighting, the PVS and the ray cache up to date with this
+		//frame's edits, only around the cells that changed
+		if(!map_edits.empty()){
+#ifdef STATIC_RENDER
+			for(uint32_t cell : map_edits.cells)
+				live_map.set_cell(cell % map_width, cell / map_width, map[cell]);
+#endif
+			if(!voxels.empty())
+				for(uint32_t cell : map_edits.cells)
+					voxel_fill_cell(voxels, map.data(), map_width, heights, cell % map_width, cell / map_width);
+			if(path_service){
+				path_service->map_changed(map, map_edits.cells);
+				player_field_cell = map.size();
 			}
+			const MapEditStats edit = apply_map_edits(map_edits, map, &lighting, &pvs, &ray_cache);
+			std::cout << "Map edit: " << edit.cells << " cells, relit " << edit.cells_relit
+				  << ", " << edit.pvs_lists << " PVS lists, " << edit.rays_dropped << " rays dropped in "
+				  << edit.update_us << " us\n";
 		}
 
+		//Advance the entities one frame, on the map as edited so far; the
+		//field in use stays until its replacement is ready
+		if(path_service){
+			const size_t cell = player_x >= 0 && player_y >= 0 && size_t(player_x) < map_width &&
+				size_t(player_y) < map_height ? size_t(player_x) + size_t(player_y)*map_width : map.size();
+			if(cell != player_field_cell && cell < map.size() && map[cell] == ' ' && !player_field_asset.pending()){
+				player_field_asset = path_service->flow_field(uint32_t(cell));
+				player_field_cell = cell;
+			}
+			player_field_asset.take(player_field);
+		}
+		if(entities.size() > 0){
+			const EntityTickStats tick = update_entities(entities, entity_hash, map.data(), map_width, map_height,
+					frame_delay/1000.f, voxel_workers, player_field.get());
+			entity_stats.hash_us += tick.hash_us;
+			entity_stats.steer_us += tick.steer_us;
+			entity_stats.move_us += tick.move_us;
+			if(++entity_ticks == 600){
+				std::cout << "Entities: " << tick.live << " live, " << entity_stats.total_us()/entity_ticks
+					  << " us/tick\n";
+				entity_stats = EntityTickStats();
+				entity_ticks = 0;
+			}
+		}
 
+		//The grid minimap and the grid or voxel view are composed in one
+		//pass that writes every pixel once; the other views draw over a
+		//cleared frame
+		const bool composed = !use_terrain && !use_bsp && !use_heights;
+		const bool draw_indexed = indexed_mode && composed && !voxel_view;
+#ifdef STATIC_RENDER
+		//the built in map's 32-bit grid view is cast and drawn by the
+		//kernels specialized for it
+		const bool static_grid = composed && map_file.empty() && !draw_indexed && !voxel_view;
+		static RayHit static_hits[window_width/2];
+#else
+		const bool static_grid = false;
+#endif
+		grid_scene.map = map.data();
+		grid_scene.shading = shading_enabled ? &shading : nullptr;
+		grid_scene.indexed_shading = shading_enabled ? &indexed_shading : &indexed_unshaded;
+		grid_scene.pitch = view_pitch;
+		grid_scene.voxel_view = voxel_view;
+		size_t pixels_written = 0;
+		if(composed && !static_grid){
+			if(draw_indexed)
+				pixels_written += draw_grid_frame(grid, grid_scene, indexed_colors, indexed_map_view,
+						indexed_world_view, player_x, player_y, player_a);
+			else pixels_written += draw_grid_frame(grid, grid_scene, grid_colors, map_view, world_view,
+						player_x, player_y, player_a);
+		} else {
+			if(!composed){
+				frame.fill(grid_colors.clear);
+				pixels_written += window_width*window_height;
+			}
+			const size_t rect_width = use_bsp ? size_t(window_width/(2*std::max(world_bsp.nodes[0].max_x, 1.f))) :
+				window_width/(map_width*2);
+			const size_t rect_height = use_bsp ? size_t(window_height/std::max(world_bsp.nodes[0].max_y, 1.f)) :
+				window_height/map_height;
+
+			if(use_terrain){
+				draw_terrain_map(map_view, terrain, player_x*texels_per_unit, player_y*texels_per_unit, 2);
+				draw_rectangle(map_view, window_width/4, window_height/2, 5, 5, grid_colors.player);
+				pixels_written += 25;
+			} else if(use_bsp){
+				draw_segments(map_view, world_bsp, rect_width, rect_height, packcolor(0, 255, 255));
+				draw_rectangle(map_view, player_x*rect_width, player_y*rect_height, 5, 5, grid_colors.player);
+				for(size_t i=0; i<entities.size(); i++)
+					draw_rectangle(map_view, entities.x[i]*rect_width, entities.y[i]*rect_height, 2, 2,
+						       grid_colors.entity[size_t(entities.type[i])]);
+				pixels_written += 25 + entities.size()*4;
+			}
+#ifdef STATIC_RENDER
+			else if(static_grid)
+				pixels_written += draw_grid_minimap(grid, grid_scene, grid_colors, map_view, player_x, player_y,
+						player_a, [&](auto color_of){
+					return compose_minimap_static<window_width/2, window_height>(map_view, live_map,
+							grid_colors.clear, color_of);
+				});
+#endif
+			else pixels_written += draw_grid_minimap(grid, grid_scene, grid_colors, map_view,
+						player_x, player_y, player_a);
+
+			//Cast one ray per column of the 3D view
+			if(use_terrain){
+				hits.clear(); //the terrain has no walls to trace
+			} else if(use_bsp){
+				cast_columns_bsp(world_bsp, player_x, player_y, player_a, fov, window_width/2, hits);
+			} else if(use_heights && voxel_view){
+				//the voxels cover the whole 3D view, so only the rays for the
+				//minimap are cast, stopping at the first wall they meet
+				cast_columns(map.data(), map_width, map_height, player_x, player_y, player_a, fov,
+					     window_width/2, hits);
+			} else if(use_heights){
+				//casts and draws in one pass, the hits are only for the minimap
+				draw_columns_multilevel(world_view, map.data(), heights, player_x, player_y, player_a, fov,
+						window_width/2, packcolor(0, 255, 255), hits,
+						shading_enabled ? &shading : nullptr, &lighting);
+			}
+#ifdef STATIC_RENDER
+			else {
+				cast_columns_static(live_map, player_x, player_y, player_a, fov, static_hits);
+				hits.assign(static_hits, static_hits + window_width/2);
+			}
+#endif
+
+			//Draw the traced rays on the minimap
+			pixels_written += draw_ray_traces(map_view, hits, player_x, player_y, rect_width, rect_height,
+							  grid_colors.trace);
+
+			//Draw the 3D to the framebuffer
+			if(use_terrain){
+				TerrainCamera camera;
+				camera.x = player_x*texels_per_unit;
+				camera.y = player_y*texels_per_unit;
+				camera.height = terrain.height_at(camera.x, camera.y) + 40;
+				camera.angle = player_a;
+				camera.horizon = window_height/2 + view_pitch*window_height;
+				camera.scale = window_height/2;
+				camera.fov = fov;
+				render_terrain(world_view, terrain, camera, terrain_distance, .01f,
+					       shading_enabled ? &terrain_shading : nullptr);
+			} else if(voxel_view){
+				render_voxels(world_view, voxels, grid_voxel_camera(grid_scene, player_x, player_y, player_a),
+					      voxel_workers, grid_scene.shading, &lighting);
+			}
+#ifdef STATIC_RENDER
+			else if(static_grid)
+				pixels_written += compose_wall_columns_static<window_width, window_height>(frame,
+						window_width/2, static_hits, packcolor(0, 255, 255), packcolor(200, 200, 200),
+						packcolor(200, 200, 200), shading_enabled ? &shading : nullptr, &lighting);
+#endif
+			else if(use_bsp)
+				draw_wall_columns(world_view, hits,
+						packcolor(0, 255, 255), shading_enabled ? &shading : nullptr, wall_lighting); // cyan wall
+		}
+		//only frames that went through the ray cache count toward its stats
+		if(composed && !static_grid) ray_stats.add(ray_cache.last_frame);
+		if(ray_stats.frames == 600){
+			std::cout << "Rays: " << 100*ray_stats.reuse_rate() << "% reused, " << ray_stats.reprojected
+				  << " reprojected, " << ray_stats.cast_us/ray_stats.frames << " us/frame";
+			if(ray_cache.panorama) std::cout << ", " << ray_stats.panorama << " cast for panoramas";
+			std::cout << "\n";
+			ray_stats = RayCacheStats();
+		}
+		if(pose_log.is_open()) save_pose(pose_log, {player_x, player_y, player_a});
+
+		//An indexed frame only becomes colors here when something besides
+		//the window needs them; otherwise it is expanded into the texture
+		const bool expand_now = draw_indexed && (screenshot_requested || frame_ring.open() || recorder.recording());
+		if(expand_now)
+			for(size_t y=0; y<window_height; y++)
+				expand_indexed(indexed.row(y), palette, frame.row(y), window_width);
+
+		//Screenshot of the finished frame, converted in the frame arena
+		if(screenshot_requested){
+			uint8_t *rgb = frame_arena.alloc_array<uint8_t>(window_width*window_height*3);
+			for(size_t y=0; y<window_height; y++)
+				convert_to_rgb24<FramebufferFormat>(frame.row(y), rgb + y*window_width*3, window_width);
+			write_ppm_rgb("./outGameloop.ppm", rgb, window_width, window_height);
+			std::cout << "Saved outGameloop.ppm\n";
+			screenshot_requested = false;
+		}
 
+		if(frame_ring.open()) publish_frame(frame_ring, frame, {player_x, player_y, player_a});
+		if(recorder.recording()) recorder.submit(frame);
 
-
-		
 		//Render
-		SDL_UpdateTexture(texture, nullptr, framebuffer.data(), window_width * sizeof(uint32_t));
+		void *texture_pixels = nullptr;
+		int texture_pitch = 0;
+		if(draw_indexed && !expand_now && SDL_LockTexture(texture, nullptr, &texture_pixels, &texture_pitch) == 0){
+			for(size_t y=0; y<window_height; y++)
+				expand_indexed(indexed.row(y), palette,
+					       reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(texture_pixels) + y*texture_pitch),
+					       window_width);
+			SDL_UnlockTexture(texture);
+		} else SDL_UpdateTexture(texture, nullptr, framebuffer.data(), framebuffer.pitch_bytes());
 		SDL_RenderClear(renderer);
 		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 		SDL_RenderPresent(renderer);
-		
-		uint32_t clear_color = packcolor(200, 200, 200); // light gray
-		std::fill(framebuffer.begin(), framebuffer.end(), clear_color);
+		if(frame_index == 0)
+			std::cout << "First frame after " << std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - startup).count() << " ms, "
+				  << asset_loader.pending() << " assets still loading\n";
+
+		//Pixels written by composed frames, against the framebuffer size
+		if(composed){
+			composed_pixels += pixels_written;
+			if(++composed_frames == 600){
+				std::cout << "Pixels written: " << composed_pixels/composed_frames << " per frame ("
+					  << double(composed_pixels)/composed_frames/(window_width*window_height)
+					  << " per framebuffer pixel)\n";
+				composed_pixels = composed_frames = 0;
+			}
+		}
 
 
 		//Close window and exit process
@@ -338,12 +835,28 @@ int main(){
             		}
         	}
 
+		//Built with -DCOUNT_ALLOCATIONS, report any operator new in a frame
+		//that had no input once the caches have warmed up
+		const size_t frame_allocations = allocation_count() - allocations_at_start;
+		if(++frame_index > 120 && !had_input && frame_allocations > 0)
+			std::cerr << "Frame " << frame_index << " called operator new "
+				  << frame_allocations << " times\n";
+
         	//Frame Timing 
-		uint32_t frame_time = SDL_GetTicks() - frame_start;
-		if (frame_delay > frame_time)
-			SDL_Delay(frame_delay - frame_time);
+		idle.drew(SDL_GetTicks());
+		frames_drawn++;
+		report_cpu();
+		pacer.wait();
 			       
     	}
     // Clean up
-    return 0; 
+    close_frame_ring(frame_ring);
+    if(recorder.recording()){
+	recorder.close();
+	const RecordingStats &stats = recorder.stats();
+	std::cout << "Recorded " << stats.frames << " frames (" << stats.dropped << " dropped), "
+		  << stats.bytes/1e6 << " MB, " << stats.bytes/1e6/std::max(stats.wall_seconds, 1e-9) << " MB/s, "
+		  << stats.encode_seconds*1000/std::max<size_t>(stats.frames, 1) << " ms encoding per frame\n";
+    }
+    return exit_status;
 }
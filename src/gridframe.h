@@ -0,0 +1,254 @@
+#ifndef GRIDFRAME_H
+#define GRIDFRAME_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include "framebuffer.h"
+#include "raycaster.h"
+#include "raycache.h"
+#include "visibility.h"
+#include "pvs.h"
+#include "palette.h"
+#include "heights.h"
+#include "voxel.h"
+#include "entities.h"
+#include "workers.h"
+
+/*-------------------------------------
+Name: GridFrame
+Description: What the grid view keeps from one frame to the next: the cells
+	inside the player's view cone, the cells in the PVS of the player's
+	cell, the rays of the last frame and the cache they came from.
+
+Purpose: The scratch of draw_grid_frame, sized once and reused, so a
+	steady-state frame allocates nothing.
+--------------------------------------*/
+struct GridFrame {
+	CellBitset visible_cells;
+	CellBitset pvs_cells;
+	std::vector<RayHit> hits;
+	RayCache ray_cache;
+};
+
+
+/*-------------------------------------
+Name: GridScene
+Description: What draw_grid_frame draws: the map and what was built from
+	it, and the options of the view. pvs, lighting, shading and entities
+	may be null when there are none; indexed_shading is needed for indexed
+	frames and heights, voxels and workers for the voxel view, which only
+	32-bit frames have.
+
+Purpose: One argument for the inputs of a frame instead of a dozen.
+--------------------------------------*/
+struct GridScene {
+	const char *map = nullptr;
+	size_t map_width = 0;
+	size_t map_height = 0;
+	const PvsTable *pvs = nullptr;
+	const LightMap *lighting = nullptr;
+	const ShadeTable *shading = nullptr;
+	const IndexedShading *indexed_shading = nullptr;
+	const Entities *entities = nullptr;
+	const HeightMap *heights = nullptr;
+	const VoxelVolume *voxels = nullptr;
+	TileWorkers *workers = nullptr;
+	float fov = M_PI/3.;
+	float pitch = 0;
+	bool voxel_view = false;
+};
+
+
+/*-------------------------------------
+Name: GridColors
+Description: The colors of a grid frame, as the frame's pixel type: the
+	background of the minimap and the ceiling and floor of the 3D view,
+	the minimap's walls inside the view cone, outside it and outside the
+	PVS, the player, the traced rays and the entities by type. wall is
+	the wall color of 32-bit frames; indexed frames take theirs from the
+	scene's IndexedShading.
+
+Purpose: Lets one draw function serve both the 32-bit and indexed frames.
+--------------------------------------*/
+template<typename Pixel>
+struct GridColors {
+	Pixel clear;
+	Pixel minimap[3];
+	Pixel player;
+	Pixel trace;
+	Pixel entity[2];
+	Pixel wall;
+};
+
+
+/*-------------------------------------
+Name: grid_voxel_camera
+Description: The voxel view's camera for a player at x, y facing a: half a
+	cell above the floor of the player's cell, pitched and as wide as the
+	scene says.
+
+Purpose: The eye of the voxel view, standing where the grid view stands.
+--------------------------------------*/
+inline VoxelCamera grid_voxel_camera(const GridScene &scene, const float x, const float y, const float a){
+	VoxelCamera camera;
+	camera.x = x;
+	camera.y = y;
+	camera.z = .5f;
+	if(scene.heights && x >= 0 && y >= 0 && size_t(x) < scene.map_width && size_t(y) < scene.map_height)
+		camera.z += scene.heights->floor_at(scene.map, size_t(x) + size_t(y)*scene.map_width);
+	camera.yaw = a;
+	camera.pitch = scene.pitch;
+	camera.fov = scene.fov;
+	return camera;
+}
+
+
+/*-------------------------------------
+Name: draw_ray_traces
+Description: Draws the path of every ray in hits from (x, y) to its hit onto
+	a minimap view whose cells are rect_width x rect_height pixels, in .05
+	steps, stopping each at the edge of the view. Returns the number of
+	pixels written.
+
+Purpose: Shows on the minimap what the 3D view is drawn from.
+--------------------------------------*/
+template<typename Pixel>
+inline size_t draw_ray_traces(const FrameView<Pixel> view,
+			const std::vector<RayHit> &hits,
+			const float x,
+			const float y,
+			const size_t rect_width,
+			const size_t rect_height,
+			const Pixel color){
+	size_t written = 0;
+	for(size_t i=0; i<hits.size(); i++){
+		const float dx = (hits[i].x - x)/std::max(hits[i].distance, .001f);
+		const float dy = (hits[i].y - y)/std::max(hits[i].distance, .001f);
+		for(float t=0; t<hits[i].distance; t+=.05){
+			const size_t pix_x = (x + t*dx)*rect_width;
+			const size_t pix_y = (y + t*dy)*rect_height;
+			if(pix_x >= view.width || pix_y >= view.height) break;
+			view.at(pix_x, pix_y) = color;
+			written++;
+		}
+	}
+	return written;
+}
+
+
+/*-------------------------------------
+Name: draw_grid_minimap
+Description: The minimap half of a grid frame: finds the cells inside the
+	view cone and decodes the PVS of the player's cell into grid, then
+	composes the map with every wall shaded by which of the two it is in,
+	and draws the player and the entities over it. Returns the number of
+	pixels written. The map is composed by compose_minimap, or by
+	compose(color_of) when one is given, which must write the same pixels.
+
+Purpose: Shared by the grid frame and the views that draw their 3D half
+	some other way but keep the grid minimap.
+--------------------------------------*/
+template<typename Pixel, typename Compose>
+inline size_t draw_grid_minimap(GridFrame &grid,
+			const GridScene &scene,
+			const GridColors<Pixel> &colors,
+			const FrameView<Pixel> view,
+			const float player_x,
+			const float player_y,
+			const float player_a,
+			Compose compose){
+	const size_t rect_width = view.width/scene.map_width;
+	const size_t rect_height = view.height/scene.map_height;
+	ViewCone cone;
+	cone.enabled = true;
+	cone.angle = player_a;
+	cone.fov = scene.fov;
+	compute_visible_cells(scene.map, scene.map_width, scene.map_height, player_x, player_y, grid.visible_cells, cone);
+	const bool in_map = player_x >= 0 && player_y >= 0 &&
+		size_t(player_x) < scene.map_width && size_t(player_y) < scene.map_height;
+	if(scene.pvs && !scene.pvs->empty() && in_map) pvs_decode(*scene.pvs, player_x, player_y, grid.pvs_cells);
+
+	size_t written = compose([&](const size_t i, const size_t j){
+		return colors.minimap[grid.visible_cells.test(i, j) ? 0 :
+				      (grid.pvs_cells.width && !grid.pvs_cells.test(i, j)) ? 2 : 1];
+	});
+	written += draw_rectangle(view, player_x*rect_width, player_y*rect_height, 5, 5, colors.player);
+
+	//Entities as 2x2 dots
+	if(scene.entities){
+		const Entities &entities = *scene.entities;
+		for(size_t i=0; i<entities.size(); i++)
+			written += draw_rectangle(view, entities.x[i]*rect_width, entities.y[i]*rect_height, 2, 2,
+						  colors.entity[size_t(entities.type[i])]);
+	}
+	return written;
+}
+
+template<typename Pixel>
+inline size_t draw_grid_minimap(GridFrame &grid,
+			const GridScene &scene,
+			const GridColors<Pixel> &colors,
+			const FrameView<Pixel> view,
+			const float player_x,
+			const float player_y,
+			const float player_a){
+	return draw_grid_minimap(grid, scene, colors, view, player_x, player_y, player_a, [&](auto color_of){
+		return compose_minimap(view, scene.map, scene.map_width, scene.map_height, view.width/scene.map_width,
+				       view.height/scene.map_height, colors.clear, color_of);
+	});
+}
+
+
+/*-------------------------------------
+Name: draw_grid_frame
+Description: Draws one frame of the grid view, as gameloop does: the
+	minimap into map_view (draw_grid_minimap), one cached ray per column
+	of world_view, the traced rays on the minimap, and the 3D view into
+	world_view, composed as lit, shaded wall columns or, for a 32-bit frame
+	with scene.voxel_view, rendered from the voxel volume. Every pixel of
+	the two views is written. Returns the number of pixels written.
+
+Purpose: The per-frame work of the demo in one place, so frame_alloc_check
+	runs the very code the window shows.
+--------------------------------------*/
+template<typename Pixel>
+inline size_t draw_grid_frame(GridFrame &grid,
+			const GridScene &scene,
+			const GridColors<Pixel> &colors,
+			const FrameView<Pixel> map_view,
+			const FrameView<Pixel> world_view,
+			const float player_x,
+			const float player_y,
+			const float player_a){
+	size_t written = draw_grid_minimap(grid, scene, colors, map_view, player_x, player_y, player_a);
+
+	//Cast one ray per column of the 3D view
+	//reusing last frame's rays where the player only turned
+	cast_columns_cached(grid.ray_cache, scene.map, scene.map_width, scene.map_height, player_x, player_y, player_a,
+			    scene.fov, world_view.width, grid.hits);
+	written += draw_ray_traces(map_view, grid.hits, player_x, player_y, map_view.width/scene.map_width,
+				   map_view.height/scene.map_height, colors.trace);
+
+	if constexpr(std::is_same<Pixel, uint8_t>::value){
+		written += compose_wall_columns_indexed(world_view, grid.hits, *scene.indexed_shading, colors.clear,
+							colors.clear, scene.lighting);
+	} else {
+		if(scene.voxel_view){
+			//one ray per pixel, each writing its pixel
+			VoxelStats stats;
+			render_voxels(world_view, *scene.voxels, grid_voxel_camera(scene, player_x, player_y, player_a),
+				      *scene.workers, scene.shading, scene.lighting, &stats);
+			written += stats.rays;
+		} else {
+			written += compose_wall_columns(world_view, grid.hits, colors.wall, colors.clear, colors.clear,
+							scene.shading, scene.lighting);
+		}
+	}
+	return written;
+}
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef HEIGHTS_H
+#define HEIGHTS_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "pixelformat.h"
+#include "shading.h"
+#include "lighting.h"
+#include "raycaster.h"
+
+/*-------------------------------------
+Name: HeightMap
+Description: Per-cell heights for a grid map, in wall heights (a default wall
+	is 1 tall). top is how high a wall cell rises, floor is the height of the
+	floor of an empty cell (a step or ledge when above 0) and ceiling the
+	height of a ceiling over an empty cell (INFINITY for open sky). Which of
+	top and floor applies is decided by the map cell when it is read, so
+	map edits need no update here. max_floor and min_ceiling bound every
+	height in the map and let the renderer stop rays early; uniform is true
+	when every wall is wall_height tall, every floor 0 and there are no
+	ceilings. A uniform map keeps top, floor and ceiling empty, and the
+	accessors return those defaults for it.
+
+Purpose: Steps, low walls, ledges and overhangs on top of the same grid.
+--------------------------------------*/
+struct HeightMap {
+	size_t width = 0;
+	size_t height = 0;
+	std::vector<float> top;
+	std::vector<float> floor;
+	std::vector<float> ceiling;
+	float wall_height = 1;
+	float max_floor = 1;
+	float min_ceiling = INFINITY;
+	bool uniform = true;
+
+	float floor_at(const char *map, const size_t cell) const {
+		if(top.empty()) return map[cell] != ' ' ? wall_height : 0.f;
+		return map[cell] != ' ' ? top[cell] : floor[cell];
+	}
+	float ceiling_at(const size_t cell) const {
+		return ceiling.empty() ? INFINITY : ceiling[cell];
+	}
+};
+
+
+/*-------------------------------------
+Name: build_height_map
+Description: Builds the heights of a map from the extra lines of its map file:
+	"height <x0> <y0> <x1> <y1> <h>" sets the top of the wall cells and the
+	floor of the empty cells in the inclusive rectangle, "ceiling <x0> <y0>
+	<x1> <y1> <h>" the ceiling of the empty cells in it. Everything else
+	keeps walls wall_height tall, floors at 0 and the sky open. The per-cell
+	arrays are only filled in while a line applies to some cell, and
+	dropped again if the map turns out uniform.
+
+Purpose: Lets map files describe multi-level geometry next to the grid.
+--------------------------------------*/
+inline HeightMap build_height_map(const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const std::vector<std::string> &lines,
+				const float wall_height = 1){
+	HeightMap heights;
+	heights.width = map_width;
+	heights.height = map_height;
+	heights.wall_height = wall_height;
+	heights.max_floor = std::max(wall_height, 0.f);
+	for(const std::string &line : lines){
+		std::istringstream iss(line);
+		std::string kind;
+		long x0, y0, x1, y1;
+		float h;
+		if(!(iss >> kind) || (kind != "height" && kind != "ceiling")) continue;
+		if(!(iss >> x0 >> y0 >> x1 >> y1 >> h)) continue;
+		if(heights.top.empty() && x0 <= x1 && y0 <= y1 && x1 >= 0 && y1 >= 0 &&
+		   x0 < long(map_width) && y0 < long(map_height)){
+			heights.top.assign(map_width*map_height, wall_height);
+			heights.floor.assign(map_width*map_height, 0.f);
+			heights.ceiling.assign(map_width*map_height, INFINITY);
+		}
+		for(long y = std::max(0L, y0); y <= std::min(long(map_height) - 1, y1); y++){
+			for(long x = std::max(0L, x0); x <= std::min(long(map_width) - 1, x1); x++){
+				const size_t cell = x + y*map_width;
+				if(kind == "ceiling") heights.ceiling[cell] = h;
+				else if(map[cell] != ' ') heights.top[cell] = h;
+				else heights.floor[cell] = h;
+			}
+		}
+	}
+	if(heights.top.empty()) return heights;
+	heights.max_floor = 0;
+	for(size_t i=0; i<map_width*map_height; i++){
+		heights.max_floor = std::max({heights.max_floor, heights.top[i], heights.floor[i]});
+		heights.min_ceiling = std::min(heights.min_ceiling, heights.ceiling[i]);
+		if(heights.top[i] != wall_height || heights.floor[i] != 0 || heights.ceiling[i] != INFINITY)
+			heights.uniform = false;
+	}
+	if(heights.uniform){
+		heights.max_floor = std::max(wall_height, 0.f);
+		std::vector<float>().swap(heights.top);
+		std::vector<float>().swap(heights.floor);
+		std::vector<float>().swap(heights.ceiling);
+	}
+	return heights;
+}
+
+
+/*-------------------------------------
+Name: MultilevelStats
+Description: Work done by the last draw_columns_multilevel call: columns drawn,
+	cells the rays stepped through and spans drawn.
+
+Purpose: Shows how quickly the open-span buffer ends rays.
+--------------------------------------*/
+struct MultilevelStats {
+	size_t columns = 0;
+	size_t cells_stepped = 0;
+	size_t spans_drawn = 0;
+};
+
+
+/*-------------------------------------
+Name: draw_columns_multilevel
+Description: Draws the 3D view of a map with per-cell heights straight into the
+	framebuffer, one column per ray, starting at view_x. Each ray walks the
+	grid cell by cell (a DDA traversal) from the player, whose eye is half a
+	wall above the floor they stand on. Every cell boundary can show a riser
+	where the floor steps up and a face where the ceiling steps down; inside
+	a cell the top of a raised floor below the eye and the underside of a
+	ceiling above it are drawn as well, in a darker shade. Everything is
+	drawn front to back, clipped to the open span of the column: the rows
+	between the lowest ceiling and the highest floor drawn so far.
+
+	The ray ends when the open span closes, when it leaves the map or
+	max_distance, or as soon as no floor or ceiling in the map (max_floor,
+	min_ceiling) could still reach into the open span from further away. In
+	a map of full-height walls that is right after the first wall, so the
+	cost stays that of a single-height caster. hits receives where each ray
+	ended and the first wall it met, for the minimap. The view form draws
+	the first columns columns of a view; the vector form draws into the
+	packed image_width x image_height image starting at column view_x.
+
+Purpose: Steps, ledges, low walls with walls visible behind them and
+	overhangs, drawn through the same shading and light map as flat walls.
+--------------------------------------*/
+inline void draw_columns_multilevel(const FrameView<uint32_t> view,
+				const char *map,
+				const HeightMap &heights,
+				const float player_x,
+				const float player_y,
+				const float player_a,
+				const float fov,
+				const size_t columns,
+				const uint32_t wall_color,
+				std::vector<RayHit> &hits,
+				const ShadeTable *shading = nullptr,
+				const LightMap *lighting = nullptr,
+				MultilevelStats *stats = nullptr,
+				const float max_distance = 20){
+	const size_t map_width = heights.width, map_height = heights.height;
+	const size_t image_height = view.height;
+	const float H = float(image_height);
+	const long player_cell_x = long(std::floor(player_x)), player_cell_y = long(std::floor(player_y));
+	const bool player_in_map = player_cell_x >= 0 && player_cell_y >= 0 &&
+		size_t(player_cell_x) < map_width && size_t(player_cell_y) < map_height;
+	const size_t player_cell = player_in_map ? player_cell_x + player_cell_y*map_width : 0;
+	const float eye = (player_in_map && map[player_cell] == ' ' ? heights.floor_at(map, player_cell) : 0.f) + .5f;
+	const bool has_ceilings = heights.min_ceiling != INFINITY;
+	MultilevelStats local;
+	local.columns = columns;
+	hits.assign(columns, RayHit());
+
+	//screen row of height z at distance t, clamped to the image
+	auto row_of = [&](const float z, const float t) -> long {
+		const float y = t > 0 ? H/2 - (z - eye)*H/t : (z > eye ? -INFINITY : INFINITY);
+		return y <= 0 ? 0 : y >= H ? long(image_height) : long(std::lround(y));
+	};
+	auto color_for = [&](const float t, const uint8_t side, const long light_x, const long light_y,
+			     const bool surface){
+		uint32_t color = surface ? scale_color(wall_color, 160) : wall_color;
+		if(lighting && light_x >= 0 && light_y >= 0 && size_t(light_x) < lighting->width &&
+		   size_t(light_y) < lighting->height)
+			color = scale_color(color, lighting->light_at(light_x, light_y));
+		if(shading) color = shade_color(*shading, color, t, side);
+		return color;
+	};
+
+	for(size_t i=0; i<columns && i < view.width; i++){
+		const float angle = player_a - fov/2 + fov*i/float(columns);
+		const float dx = cos(angle), dy = sin(angle);
+		long cell_x = player_cell_x, cell_y = player_cell_y;
+		const int step_x = dx < 0 ? -1 : 1, step_y = dy < 0 ? -1 : 1;
+		const float delta_x = dx != 0 ? std::fabs(1/dx) : INFINITY;
+		const float delta_y = dy != 0 ? std::fabs(1/dy) : INFINITY;
+		float next_x = dx < 0 ? (player_x - cell_x)*delta_x : (cell_x + 1 - player_x)*delta_x;
+		float next_y = dy < 0 ? (player_y - cell_y)*delta_y : (cell_y + 1 - player_y)*delta_y;
+
+		long open_top = 0, open_bottom = long(image_height);
+		uint32_t *column = view.pixels + i;
+		auto fill = [&](long from, long to, const uint32_t color){
+			from = std::max(from, open_top);
+			to = std::min(to, open_bottom);
+			if(from >= to) return;
+			local.spans_drawn++;
+			uint32_t *pixel = column + from*view.pitch;
+			for(long j = from; j < to; j++, pixel += view.pitch) *pixel = color;
+		};
+
+		float floor_here = player_in_map ? heights.floor_at(map, player_cell) : 0.f;
+		float ceiling_here = player_in_map && map[player_cell] == ' ' ? heights.ceiling_at(player_cell) : INFINITY;
+		float t_in = 0, t = 0;
+		RayHit &hit = hits[i];
+		while(true){
+			uint8_t side;
+			const long prev_x = cell_x, prev_y = cell_y;
+			if(next_x < next_y){
+				t = next_x; next_x += delta_x; cell_x += step_x; side = 0;
+			} else {
+				t = next_y; next_y += delta_y; cell_y += step_y; side = 1;
+			}
+			local.cells_stepped++;
+			const float t_out = std::min(t, max_distance);
+
+			//the top of a raised floor and the underside of a ceiling
+			//across the cell the ray is leaving
+			if(floor_here > 0 && floor_here < eye){
+				fill(row_of(floor_here, t_out), row_of(floor_here, t_in),
+				     color_for(t_out, 1, prev_x, prev_y, true));
+				open_bottom = std::min(open_bottom, row_of(floor_here, t_out));
+			}
+			if(ceiling_here != INFINITY && ceiling_here > eye){
+				fill(row_of(ceiling_here, t_in), row_of(ceiling_here, t_out),
+				     color_for(t_out, 1, prev_x, prev_y, true));
+				open_top = std::max(open_top, row_of(ceiling_here, t_out));
+			}
+			if(t >= max_distance || cell_x < 0 || cell_y < 0 ||
+			   size_t(cell_x) >= map_width || size_t(cell_y) >= map_height || open_top >= open_bottom)
+				break;
+
+			//a riser where the floor steps up, a face where the ceiling
+			//steps down
+			const size_t cell = cell_x + cell_y*map_width;
+			const float floor_next = heights.floor_at(map, cell);
+			const float ceiling_next = map[cell] == ' ' ? heights.ceiling_at(cell) : INFINITY;
+			if(floor_next > floor_here){
+				fill(row_of(floor_next, t), row_of(floor_here, t), color_for(t, side, prev_x, prev_y, false));
+				open_bottom = std::min(open_bottom, row_of(floor_next, t));
+			}
+			if(ceiling_next < ceiling_here){
+				fill(row_of(ceiling_here, t), row_of(ceiling_next, t), color_for(t, side, prev_x, prev_y, false));
+				open_top = std::max(open_top, row_of(ceiling_next, t));
+			}
+			if(map[cell] != ' ' && hit.cell == 0){
+				hit.cell = map[cell];
+				hit.side = side;
+				hit.face_x = int(prev_x);
+				hit.face_y = int(prev_y);
+			}
+			if(open_top >= open_bottom) break;
+
+			//nothing further away can reach into the open span: floors
+			//beyond t stay below row_of(max_floor, t) (or the horizon) and
+			//ceilings above row_of(min_ceiling, t)
+			const long floors_from = heights.max_floor > eye ? row_of(heights.max_floor, t) : long(image_height/2);
+			const long ceilings_to = !has_ceilings ? 0 :
+				heights.min_ceiling < eye ? row_of(heights.min_ceiling, t) : long(image_height/2);
+			if(open_bottom <= floors_from && open_top >= ceilings_to) break;
+
+			floor_here = floor_next;
+			ceiling_here = ceiling_next;
+			t_in = t;
+		}
+		t = std::min(t, max_distance);
+		hit.distance = t;
+		hit.x = player_x + t*dx;
+		hit.y = player_y + t*dy;
+	}
+	if(stats) *stats = local;
+}
+
+inline void draw_columns_multilevel(std::vector<uint32_t> &image,
+				const size_t image_width,
+				const size_t image_height,
+				const size_t view_x,
+				const char *map,
+				const HeightMap &heights,
+				const float player_x,
+				const float player_y,
+				const float player_a,
+				const float fov,
+				const size_t columns,
+				const uint32_t wall_color,
+				std::vector<RayHit> &hits,
+				const ShadeTable *shading = nullptr,
+				const LightMap *lighting = nullptr,
+				MultilevelStats *stats = nullptr,
+				const float max_distance = 20){
+	draw_columns_multilevel(frame_view(image, image_width, image_height).sub_view(view_x, 0, image_width, image_height),
+				map, heights, player_x, player_y, player_a, fov, columns, wall_color, hits, shading,
+				lighting, stats, max_distance);
+}
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#else
+#include <filesystem>
+#endif
+#include "mapfile.h"
+#include "assets.h"
+
+/*-------------------------------------
+Name: FileWatcher
+Description: Tells when a file has been written. On Linux an inotify watch
+	is put on the file's directory, not the file, since editors often save
+	by writing a new file and renaming it over the old one; a close after
+	writing, or a rename onto the file's name, counts as a change. changed
+	reads the pending notifications without blocking, so it can be called
+	every frame, and folds however many there were into one answer.
+	Elsewhere changed compares the file's modification time.
+
+	watch returns false, with a message, if the file cannot be watched.
+
+Purpose: Lets the demo pick up a map saved in an editor while it runs.
+--------------------------------------*/
+class FileWatcher {
+public:
+	FileWatcher() = default;
+	~FileWatcher(){ stop(); }
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher &operator=(const FileWatcher&) = delete;
+
+	bool watch(const std::string &path){
+		stop();
+		const size_t slash = path.find_last_of('/');
+		const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+		name = slash == std::string::npos ? path : path.substr(slash + 1);
+#ifdef __linux__
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+			std::cerr << "Cannot watch " << directory << " for changes to " << name << ": " << std::strerror(errno) << "\n";
+			stop();
+			return false;
+		}
+#else
+		file = path;
+		std::error_code error;
+		modified = std::filesystem::last_write_time(file, error);
+		if(error){
+			std::cerr << "Cannot watch " << path << ": " << error.message() << "\n";
+			file.clear();
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	bool watching() const {
+#ifdef __linux__
+		return fd >= 0;
+#else
+		return !file.empty();
+#endif
+	}
+
+	bool changed(){
+		bool hit = false;
+#ifdef __linux__
+		if(fd < 0) return false;
+		alignas(inotify_event) char buffer[4096];
+		while(true){
+			const ssize_t bytes = read(fd, buffer, sizeof(buffer));
+			if(bytes <= 0) break;
+			for(ssize_t offset=0; offset<bytes; ){
+				const inotify_event *event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				if(event->len > 0 && name == event->name) hit = true;
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+#else
+		if(file.empty()) return false;
+		std::error_code error;
+		const auto time = std::filesystem::last_write_time(file, error);
+		if(!error && time != modified){
+			modified = time;
+			hit = true;
+		}
+#endif
+		return hit;
+	}
+
+private:
+	void stop(){
+#ifdef __linux__
+		if(fd >= 0) close(fd);
+		fd = -1;
+#else
+		file.clear();
+#endif
+	}
+
+	std::string name;
+#ifdef __linux__
+	int fd = -1;
+#else
+	std::string file;
+	std::filesystem::file_time_type modified;
+#endif
+};
+
+
+/*-------------------------------------
+Name: MapReload, decode_map_reload
+Description: A map file read again, as the cells it changed. decode_map_reload
+	parses the file's bytes and compares the grid with baseline, the grid
+	as it was last loaded (not as it has been edited in play since), so
+	changes holds (cell, new character) for exactly the cells the file
+	changed, and baseline becomes the new grid. cells and extra_lines are
+	the whole new grid and its extra lines. A file whose size differs from
+	width x height is not diffed: changes stays empty and width and height
+	say what the file holds.
+
+	It runs on a loader thread, one reload at a time, so baseline needs no
+	lock as long as only the loader touches it.
+
+Purpose: Parsing and diffing off the frame loop; applying the result is one
+	set_map_cell per changed cell between frames.
+--------------------------------------*/
+struct MapReload {
+	size_t width = 0;
+	size_t height = 0;
+	std::string cells;
+	std::vector<std::string> extra_lines;
+	std::vector<std::pair<uint32_t, char>> changes;
+};
+
+inline bool decode_map_reload(const std::vector<uint8_t> &bytes,
+			const std::string &name,
+			std::string &baseline,
+			const size_t map_width,
+			const size_t map_height,
+			MapReload &out){
+	ByteStream stream(bytes);
+	if(!parse_map_text(stream, name, out.cells, out.width, out.height, &out.extra_lines)) return false;
+	out.changes.clear();
+	if(out.width != map_width || out.height != map_height) return true;
+	for(size_t i=0; i<out.cells.size(); i++)
+		if(out.cells[i] != baseline[i]) out.changes.emplace_back(uint32_t(i), out.cells[i]);
+	baseline = out.cells;
+	return true;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "palette.h"
+
+/*-------------------------------------
+Name: main
+Description: Renders the scripted session (minimap and lit, shaded walls on a
+	clear) into a 32-bit framebuffer and into an 8-bit indexed one, at
+	1024x512 and at 3840x2160, and uploads each frame to a separate texture
+	buffer: a copy for the 32-bit frame, expand_indexed for the indexed one.
+	Prints the time of the render stage and of the upload, the bytes the
+	render stage writes per frame, and the largest channel difference
+	between the two outputs. First checks expand_indexed at every length
+	and offset up to a few blocks, and exits with 1 if it writes a wrong
+	or stray pixel.
+
+	usage: indexed_bench [map file]
+
+Purpose: Shows what writing one byte per pixel saves, and what the palette
+	ramps cost in accuracy.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const uint32_t clear = packcolor(200, 200, 200), wall = packcolor(0, 255, 255);
+	const ShadeTable shading = build_shade_table(20.f, 256, clear);
+	Palette palette;
+	const uint8_t clear_index = palette.add(clear), wall_index = palette.add(wall);
+	const IndexedShading shades = build_indexed_shading(palette, add_wall_ramp(palette, wall, clear), wall, &shading);
+	const std::vector<Pose> poses = scripted_session(240);
+	const float fov = M_PI/3.;
+#if defined(__AVX2__)
+	std::cout << "expansion with AVX2 gathers\n";
+#elif defined(__SSE2__)
+	std::cout << "expansion with table loads and SSE2 stores\n";
+#else
+	std::cout << "expansion with table loads\n";
+#endif
+
+	//every length and alignment around the eight pixel blocks must expand
+	//exactly, tail included
+	{
+		std::vector<uint8_t> src(80);
+		std::vector<uint32_t> dst(80);
+		for(size_t k=0; k<src.size(); k++) src[k] = uint8_t(k*37 % palette.used);
+		for(size_t offset=0; offset<8; offset++){
+			for(size_t count=0; offset + count < src.size(); count++){
+				std::fill(dst.begin(), dst.end(), 0xdeadbeef);
+				expand_indexed(src.data() + offset, palette, dst.data() + offset, count);
+				for(size_t k=0; k<dst.size(); k++){
+					const bool inside = k >= offset && k < offset + count;
+					if(dst[k] != (inside ? palette.colors[src[k]] : 0xdeadbeef)){
+						std::cerr << "expand_indexed of " << count << " pixels at " << offset
+							  << " is wrong at " << k << "\n";
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	for(const size_t width : {size_t(1024), size_t(3840)}){
+		const size_t height = width == 1024 ? 512 : 2160;
+		const size_t rect_width = width/(map_width*2), rect_height = height/map_height;
+		std::vector<uint32_t> framebuffer(width*height), texture(width*height), expanded(width*height);
+		std::vector<uint8_t> indexed(width*height);
+		std::vector<RayHit> hits;
+		RayCache ray_cache;
+		double render_s[2] = {0, 0}, upload_s[2] = {0, 0};
+		size_t wall_pixels = 0;
+		int max_error = 0;
+		for(size_t f=0; f<poses.size(); f++){
+			const Pose &p = poses[f];
+			cast_columns_cached(ray_cache, map.data(), map_width, map_height, p.x, p.y, p.a, fov, width/2, hits);
+			for(const RayHit &hit : hits)
+				if(hit.cell) wall_pixels += std::min(float(height)/std::max(hit.distance, .01f), float(height));
+
+			auto t0 = clock::now();
+			std::fill(framebuffer.begin(), framebuffer.end(), clear);
+			for(size_t j=0; j<map_height; j++)
+				for(size_t i=0; i<map_width; i++)
+					if(map[i + j*map_width] != ' ')
+						draw_rectangle(framebuffer, width, height, i*rect_width, j*rect_height,
+							       rect_width, rect_height, wall);
+			draw_wall_columns(framebuffer, width, height, width/2, hits, wall, &shading, &lighting);
+			auto t1 = clock::now();
+			std::memcpy(texture.data(), framebuffer.data(), width*height*sizeof(uint32_t));
+			auto t2 = clock::now();
+			std::memset(indexed.data(), clear_index, indexed.size());
+			for(size_t j=0; j<map_height; j++)
+				for(size_t i=0; i<map_width; i++)
+					if(map[i + j*map_width] != ' ')
+						draw_rectangle(indexed, width, height, i*rect_width, j*rect_height,
+							       rect_width, rect_height, wall_index);
+			draw_wall_columns_indexed(indexed, width, height, width/2, hits, shades, &lighting);
+			auto t3 = clock::now();
+			expand_indexed(indexed.data(), palette, expanded.data(), indexed.size());
+			auto t4 = clock::now();
+			render_s[0] += std::chrono::duration<double>(t1 - t0).count();
+			upload_s[0] += std::chrono::duration<double>(t2 - t1).count();
+			render_s[1] += std::chrono::duration<double>(t3 - t2).count();
+			upload_s[1] += std::chrono::duration<double>(t4 - t3).count();
+
+			if(f % 16 == 0){
+				for(size_t k=0; k<width*height; k++){
+					uint8_t a[4], b[4];
+					unpack_color(texture[k], a[0], a[1], a[2], a[3]);
+					unpack_color(expanded[k], b[0], b[1], b[2], b[3]);
+					for(int c=0; c<3; c++) max_error = std::max(max_error, std::abs(int(a[c]) - int(b[c])));
+				}
+			}
+		}
+		const double frames = poses.size();
+		const double pixels = double(width)*height + rect_width*rect_height*map_width*map_height/2 + wall_pixels/frames;
+		for(int mode=0; mode<2; mode++){
+			std::cout << "  " << width << "x" << height << (mode ? " indexed:" : " 32-bit: ")
+				  << " render " << render_s[mode]*1000/frames << " ms, upload "
+				  << upload_s[mode]*1000/frames << " ms, about "
+				  << pixels*(mode ? 1 : 4)/1e6 << " MB written by the render stage per frame\n";
+		}
+		std::cout << "  largest channel difference " << max_error << "\n";
+	}
+	return 0;
+}
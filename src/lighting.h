@@ -0,0 +1,234 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "pixelformat.h"
+#include "visibility.h"
+
+/*-------------------------------------
+Name: Light
+Description: A point light placed in the map at (x, y). It lights every cell it
+	can see within radius, with a brightness that starts at intensity (0 to 1)
+	and falls off quadratically to nothing at the radius.
+
+Purpose: The light sources baked into a LightMap.
+--------------------------------------*/
+struct Light {
+	float x = 0;
+	float y = 0;
+	float radius = 8;
+	float intensity = 1;
+};
+
+
+/*-------------------------------------
+Name: parse_lights
+Description: Picks the "light <x> <y> <radius> <intensity>" lines out of the
+	extra lines of a map file. Lines for other things are ignored, and a
+	missing intensity defaults to 1.
+
+Purpose: Lets lights be placed in map files next to the grid.
+--------------------------------------*/
+inline std::vector<Light> parse_lights(const std::vector<std::string> &lines){
+	std::vector<Light> lights;
+	for(const std::string &line : lines){
+		std::istringstream iss(line);
+		std::string kind;
+		Light light;
+		if(!(iss >> kind) || kind != "light") continue;
+		if(!(iss >> light.x >> light.y >> light.radius)) continue;
+		if(!(iss >> light.intensity)) light.intensity = 1;
+		lights.push_back(light);
+	}
+	return lights;
+}
+
+
+/*-------------------------------------
+Name: LightMap
+Description: Baked per-cell lighting for a grid map. Every light keeps the list
+	of (cell, amount) pairs it contributes, in 8.8 fixed point, and accum holds
+	their sum per cell. level is the final 0-255 light level of each cell,
+	ambient plus accum, and is what the renderer reads.
+
+	Because contributions are integers, a light can be taken back out exactly
+	by subtracting its list, so moving a light or changing a cell only touches
+	the cells inside the radius of the lights involved.
+
+Purpose: Lit scenes at the cost of one lookup per ray hit, with no light
+	tracing during frames.
+--------------------------------------*/
+struct LightMap {
+	size_t width = 0;
+	size_t height = 0;
+	uint8_t ambient = 96;
+	std::vector<Light> lights;
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> contributions;
+	std::vector<uint32_t> accum;
+	std::vector<uint8_t> level;
+	std::vector<uint32_t> stamp;
+	uint32_t stamp_counter = 0;
+	size_t cells_relit = 0; //cells touched by the last bake or update
+
+	bool empty() const { return width == 0; }
+	uint8_t light_at(const size_t x, const size_t y) const {
+		return level[x + y*width];
+	}
+};
+
+
+/*-------------------------------------
+Name: refresh_light_level
+Description: Recomputes the 0-255 level of one cell from its accumulated light.
+
+Purpose: Shared by every path that changes accum.
+--------------------------------------*/
+inline void refresh_light_level(LightMap &lighting, const uint32_t cell){
+	lighting.level[cell] = uint8_t(std::min<uint32_t>(255, lighting.ambient + (lighting.accum[cell] >> 8)));
+}
+
+
+/*-------------------------------------
+Name: remove_light_contribution, add_light_contribution
+Description: Take a light's current contribution out of the map, or compute it
+	afresh from the light's position and the map and add it in. The new
+	contribution is found by shadowcasting from the light out to its radius,
+	so walls occlude it; walls themselves receive light on the side facing it.
+
+Purpose: The two halves of every incremental update.
+--------------------------------------*/
+inline void remove_light_contribution(LightMap &lighting, const size_t index){
+	for(const auto &c : lighting.contributions[index]){
+		lighting.accum[c.first] -= c.second;
+		refresh_light_level(lighting, c.first);
+	}
+	lighting.cells_relit += lighting.contributions[index].size();
+	lighting.contributions[index].clear();
+}
+
+inline void add_light_contribution(LightMap &lighting,
+				const char *map,
+				const size_t index){
+	const Light &light = lighting.lights[index];
+	auto &list = lighting.contributions[index];
+	list.clear();
+	if(++lighting.stamp_counter == 0){
+		std::fill(lighting.stamp.begin(), lighting.stamp.end(), 0);
+		lighting.stamp_counter = 1;
+	}
+	const uint32_t stamp = lighting.stamp_counter;
+	auto mark = [&](size_t x, size_t y){
+		const uint32_t cell = x + y*lighting.width;
+		if(lighting.stamp[cell] == stamp) return;
+		lighting.stamp[cell] = stamp;
+		const float dx = x + .5f - light.x;
+		const float dy = y + .5f - light.y;
+		const float d = std::sqrt(dx*dx + dy*dy);
+		if(d >= light.radius) return;
+		const float falloff = 1.f - d/light.radius;
+		const uint32_t amount = uint32_t(light.intensity*falloff*falloff*255*256);
+		if(amount == 0) return;
+		list.emplace_back(cell, amount);
+		lighting.accum[cell] += amount;
+		refresh_light_level(lighting, cell);
+	};
+	for_each_visible_cell(map, lighting.width, lighting.height, light.x, light.y,
+		mark, ViewCone(), size_t(std::ceil(light.radius)) + 1);
+	lighting.cells_relit += list.size();
+}
+
+
+/*-------------------------------------
+Name: bake_lighting
+Description: Builds the light map for a map and a set of lights from scratch.
+
+Purpose: Called once when a map is loaded.
+--------------------------------------*/
+inline LightMap bake_lighting(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const std::vector<Light> &lights,
+			const uint8_t ambient = 96){
+	LightMap lighting;
+	lighting.width = map_width;
+	lighting.height = map_height;
+	lighting.ambient = ambient;
+	lighting.lights = lights;
+	lighting.contributions.resize(lights.size());
+	lighting.accum.assign(map_width*map_height, 0);
+	lighting.level.assign(map_width*map_height, ambient);
+	lighting.stamp.assign(map_width*map_height, 0);
+	for(size_t i=0; i<lights.size(); i++) add_light_contribution(lighting, map, i);
+	return lighting;
+}
+
+
+/*-------------------------------------
+Name: move_light
+Description: Moves light index to (x, y) and relights only the cells inside its
+	old and new radius.
+
+Purpose: Dynamic lights without rebaking the map.
+--------------------------------------*/
+inline void move_light(LightMap &lighting, const char *map,
+			const size_t index, const float x, const float y){
+	lighting.cells_relit = 0;
+	remove_light_contribution(lighting, index);
+	lighting.lights[index].x = x;
+	lighting.lights[index].y = y;
+	add_light_contribution(lighting, map, index);
+}
+
+
+/*-------------------------------------
+Name: relight_region, relight_cell
+Description: Call after map cells inside the rectangle [x0, x1) x [y0, y1)
+	have changed between empty and wall. Every light whose radius reaches the
+	rectangle is recomputed, since the change can open or close sight lines
+	anywhere inside that radius; lights further away are untouched.
+	relight_cell is the single cell case.
+
+Purpose: Keeps baked lighting correct for doors and destructible walls at a
+	cost bounded by the lights near the change.
+--------------------------------------*/
+inline void relight_region(LightMap &lighting, const char *map,
+			const size_t x0, const size_t y0,
+			const size_t x1, const size_t y1){
+	lighting.cells_relit = 0;
+	for(size_t i=0; i<lighting.lights.size(); i++){
+		const Light &light = lighting.lights[i];
+		const float dx = std::max({x0 - light.x, light.x - x1, 0.f});
+		const float dy = std::max({y0 - light.y, light.y - y1, 0.f});
+		if(dx*dx + dy*dy > light.radius*light.radius) continue;
+		remove_light_contribution(lighting, i);
+		add_light_contribution(lighting, map, i);
+	}
+}
+
+inline void relight_cell(LightMap &lighting, const char *map,
+			const size_t x, const size_t y){
+	relight_region(lighting, map, x, y, x + 1, y + 1);
+}
+
+
+/*-------------------------------------
+Name: scale_color
+Description: Multiplies the RGB channels of a framebuffer color by level/255,
+	keeping alpha.
+
+Purpose: Applies a light level to a wall color once per column.
+--------------------------------------*/
+inline uint32_t scale_color(const uint32_t color, const uint8_t level){
+	uint8_t r, g, b, a;
+	unpack_color(color, r, g, b, a);
+	return packcolor(r*level/255, g*level/255, b*level/255, a);
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef MAP_EDIT_H
+#define MAP_EDIT_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "lighting.h"
+#include "raycache.h"
+#include "pvs.h"
+
+/*-------------------------------------
+Name: MapEdits
+Description: The map cells changed since the derived data was last brought up to
+	date. cells holds the index of every changed cell once, opened the ones
+	that went from a wall to empty, and (x0, y0)-(x1, y1) is the half-open
+	rectangle bounding all of them. A cell is known to be in cells when its
+	entry of stamp holds the current generation; clear starts a new
+	generation instead of wiping stamp, so adding an edit is constant time
+	and clearing costs nothing per cell. stamp grows to the highest cell
+	edited and is then reused.
+
+Purpose: Collects edits during a frame so lighting, visibility and the ray
+	cache can be updated once, for just the region that changed.
+--------------------------------------*/
+struct MapEdits {
+	std::vector<uint32_t> cells;
+	std::vector<uint32_t> opened;
+	size_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	std::vector<uint32_t> stamp;
+	uint32_t generation = 1;
+
+	bool empty() const { return cells.empty(); }
+	void clear(){
+		cells.clear();
+		opened.clear();
+		x0 = y0 = x1 = y1 = 0;
+		if(++generation == 0){
+			std::fill(stamp.begin(), stamp.end(), 0);
+			generation = 1;
+		}
+	}
+	void add(const size_t x, const size_t y, const size_t map_width, const bool was_opened){
+		const uint32_t cell = uint32_t(x + y*map_width);
+		if(cell >= stamp.size()) stamp.resize(size_t(cell) + 1, 0);
+		if(stamp[cell] != generation){
+			stamp[cell] = generation;
+			cells.push_back(cell);
+		}
+		if(was_opened) opened.push_back(cell);
+		if(x1 == x0){
+			x0 = x; y0 = y; x1 = x + 1; y1 = y + 1;
+		} else {
+			x0 = std::min(x0, x); y0 = std::min(y0, y);
+			x1 = std::max(x1, x + 1); y1 = std::max(y1, y + 1);
+		}
+	}
+};
+
+
+/*-------------------------------------
+Name: set_map_cell
+Description: Changes map cell (x, y) to c and records the change in edits.
+	Returns false, and records nothing, if (x, y) is outside the map or the
+	cell already holds c.
+
+Purpose: The one way gameplay code changes the map, so nothing derived
+	from it can miss an edit.
+--------------------------------------*/
+inline bool set_map_cell(std::string &map,
+			const size_t map_width,
+			const size_t map_height,
+			const size_t x,
+			const size_t y,
+			const char c,
+			MapEdits &edits){
+	if(x >= map_width || y >= map_height) return false;
+	char &cell = map[x + y*map_width];
+	if(cell == c) return false;
+	const bool opened = cell != ' ' && c == ' ';
+	cell = c;
+	edits.add(x, y, map_width, opened);
+	return true;
+}
+
+
+/*-------------------------------------
+Name: Door
+Description: A map cell that can be opened and closed. closed is the wall
+	character the cell shows while shut.
+
+Purpose: Doors are placed in map files with "door <x> <y>" lines on a wall
+	cell of the grid, and start out shut.
+--------------------------------------*/
+struct Door {
+	size_t x = 0;
+	size_t y = 0;
+	char closed = '0';
+	bool open = false;
+};
+
+
+/*-------------------------------------
+Name: parse_doors
+Description: Picks the "door <x> <y>" lines out of the extra lines of a map file.
+	Doors outside the map or on an empty cell are skipped.
+
+Purpose: The door counterpart of parse_lights.
+--------------------------------------*/
+inline std::vector<Door> parse_doors(const std::vector<std::string> &lines,
+				const std::string &map,
+				const size_t map_width,
+				const size_t map_height){
+	std::vector<Door> doors;
+	for(const std::string &line : lines){
+		std::istringstream iss(line);
+		std::string kind;
+		Door door;
+		if(!(iss >> kind) || kind != "door") continue;
+		if(!(iss >> door.x >> door.y)) continue;
+		if(door.x >= map_width || door.y >= map_height) continue;
+		door.closed = map[door.x + door.y*map_width];
+		if(door.closed == ' ') continue;
+		doors.push_back(door);
+	}
+	return doors;
+}
+
+
+/*-------------------------------------
+Name: toggle_door
+Description: Opens a shut door or shuts an open one, through set_map_cell.
+
+Purpose: What the use key does to a door.
+--------------------------------------*/
+inline void toggle_door(Door &door,
+			std::string &map,
+			const size_t map_width,
+			const size_t map_height,
+			MapEdits &edits){
+	door.open = !door.open;
+	set_map_cell(map, map_width, map_height, door.x, door.y, door.open ? ' ' : door.closed, edits);
+}
+
+
+/*-------------------------------------
+Name: MapEditStats
+Description: What the last apply_map_edits call did: cells changed, cells
+	relit, PVS lists rewritten, cached rays dropped and the time it took.
+
+Purpose: Shows that a door costs microseconds and not a rebuild.
+--------------------------------------*/
+struct MapEditStats {
+	size_t cells = 0;
+	size_t cells_relit = 0;
+	size_t pvs_lists = 0;
+	size_t rays_dropped = 0;
+	double update_us = 0;
+};
+
+
+/*-------------------------------------
+Name: apply_map_edits
+Description: Brings everything derived from the map up to date with the edits
+	collected so far, then clears them. Each structure is optional (pass
+	nullptr to skip it) and is updated only for the dirty rectangle:
+
+	* lighting: the lights whose radius reaches the rectangle are recomputed.
+	* pvs: every opened cell is patched in with pvs_open_cell;
+	  pvs_max_distance should match the one the table was built with, 0 is
+	  always safe. Closed cells need nothing.
+	* ray cache: only the cached rays that pass through the rectangle are
+	  dropped.
+
+	Per-frame visibility and the minimap read the map directly and need
+	nothing.
+
+Purpose: The single place that keeps derived data in step with map edits.
+--------------------------------------*/
+inline MapEditStats apply_map_edits(MapEdits &edits,
+				const std::string &map,
+				LightMap *lighting,
+				PvsTable *pvs,
+				RayCache *ray_cache,
+				const size_t pvs_max_distance = 0){
+	auto start = std::chrono::steady_clock::now();
+	MapEditStats stats;
+	stats.cells = edits.cells.size();
+	if(edits.empty()) return stats;
+	if(lighting && !lighting->empty()){
+		relight_region(*lighting, map.data(), edits.x0, edits.y0, edits.x1, edits.y1);
+		stats.cells_relit = lighting->cells_relit;
+	}
+	if(pvs && !pvs->empty()){
+		for(uint32_t cell : edits.opened){
+			if(map[cell] != ' ') continue; //opened and shut again since
+			stats.pvs_lists += pvs_open_cell(*pvs, map.data(), cell % pvs->map_width,
+							 cell / pvs->map_width, pvs_max_distance);
+		}
+	}
+	if(ray_cache) stats.rays_dropped = invalidate_region(*ray_cache, edits.x0, edits.y0, edits.x1, edits.y1);
+	edits.clear();
+	stats.update_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+#endif
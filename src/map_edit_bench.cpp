@@ -0,0 +1,181 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include "mapfile.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "pvs.h"
+#include "map_edit.h"
+
+/*-------------------------------------
+Name: pvs_covers
+Description: Returns true if every cluster pair visible in reference is also
+	visible in pvs, or at least every pair of cells with a line of sight
+	between them: the shadowcaster a fresh build samples with reports some
+	cells no line reaches, and an update need not reproduce those.
+
+Purpose: An incrementally updated PVS may see more than a fresh build, never
+	less of what can really be seen.
+--------------------------------------*/
+bool pvs_covers(const PvsTable &pvs, const PvsTable &reference, const std::string &map){
+	CellBitset updated, fresh;
+	for(size_t c=0; c<reference.entries.size(); c++){
+		const size_t x = (c % reference.clusters_x)*reference.cluster_size;
+		const size_t y = (c / reference.clusters_x)*reference.cluster_size;
+		pvs_decode(reference, x, y, fresh);
+		pvs_decode(pvs, x, y, updated);
+		for(size_t k=0; k<fresh.words.size(); k++){
+			const uint64_t missing = fresh.words[k] & ~updated.words[k];
+			for(size_t bit=0; bit<64; bit++){
+				if(!(missing >> bit & 1)) continue;
+				const size_t cell = k*64 + bit, tx = cell % pvs.map_width, ty = cell / pvs.map_width;
+				//from 32x32 points of the source cluster to 4x4 of the target
+				for(size_t s=0; s<32*32; s++)
+					for(size_t t=0; t<16; t++)
+						if(line_of_sight(map.data(), pvs.map_width, pvs.map_height,
+								 x + (s % 32 + .5)*reference.cluster_size/32,
+								 y + (s / 32 + .5)*reference.cluster_size/32,
+								 tx + (t % 4 + .5)/4, ty + (t / 4 + .5)/4))
+							return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Opens and shuts every door of a map and knocks out and rebuilds
+	every inner wall cell, then builds and clears a wall in every open cell
+	the player is not in, one edit at a time, bringing lighting, the PVS and
+	a warm ray cache up to date with apply_map_edits after each. Every update
+	is checked against rebuilding from scratch: the light map must match a
+	fresh bake exactly, the PVS must cover a fresh build (see pvs_covers)
+	without its data growing past twice the lists in use, and the cached
+	rays must match a full cast, both in place and after a step short
+	enough for them to be reprojected. Reports the average
+	incremental update time next to the time of the full rebuild.
+
+	Then collects 160k edits on a 1024x1024 map, as a hot reload of a
+	regenerated map does, every cell set twice, and reports the time
+	taken; it fails unless each cell is recorded once.
+
+	usage: map_edit_bench [map file]
+
+Purpose: Shows that a door costs microseconds instead of a rebuild, and
+	that the incremental paths stay correct.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const std::vector<Light> lights = parse_lights(extra);
+	std::vector<Door> doors = parse_doors(extra, map, map_width, map_height);
+
+	LightMap lighting = bake_lighting(map.data(), map_width, map_height, lights);
+	PvsTable pvs = build_pvs(map.data(), map_width, map_height);
+	RayCache cache;
+	std::vector<RayHit> hits, reference;
+	const float fov = M_PI/3., player_x = 5.956f, player_y = 11.345f;
+	const size_t columns = 512;
+	MapEdits edits;
+
+	size_t updates = 0, failures = 0;
+	double update_us = 0, rebuild_us = 0;
+	auto check = [&](const MapEditStats &stats, const char *what, size_t x, size_t y){
+		updates++;
+		update_us += stats.update_us;
+		auto t0 = clock::now();
+		const LightMap fresh_lighting = bake_lighting(map.data(), map_width, map_height, lights);
+		const PvsTable fresh_pvs = build_pvs(map.data(), map_width, map_height);
+		rebuild_us += std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+
+		//replaced PVS lists may pile up only until they outweigh the live ones
+		size_t in_use = 0;
+		for(const PvsEntry &entry : pvs.entries) in_use += entry.length;
+		bool ok = fresh_lighting.level == lighting.level && pvs_covers(pvs, fresh_pvs, map) &&
+			pvs.data.size() <= 2*in_use;
+		//a turn in place, so every column comes from the cache
+		cast_columns_cached(cache, map.data(), map_width, map_height, player_x, player_y, -1.5f, fov, columns, hits);
+		RayCache full;
+		cast_columns_cached(full, map.data(), map_width, map_height, player_x, player_y, -1.5f, fov, columns, reference);
+		for(size_t i=0; i<columns; i++)
+			ok = ok && hits[i].cell == reference[i].cell && hits[i].distance == reference[i].distance;
+		//a step of a fraction of a cell, so the columns are reprojected
+		cast_columns_cached(cache, map.data(), map_width, map_height, player_x + .25f, player_y - .125f, -1.5f, fov,
+				    columns, hits);
+		full.invalidate();
+		cast_columns_cached(full, map.data(), map_width, map_height, player_x + .25f, player_y - .125f, -1.5f, fov,
+				    columns, reference);
+		for(size_t i=0; i<columns; i++)
+			ok = ok && hits[i].cell == reference[i].cell && hits[i].distance == reference[i].distance;
+		if(!ok){
+			failures++;
+			std::cerr << what << " at " << x << " " << y << " left stale data\n";
+		}
+	};
+
+	cast_columns_cached(cache, map.data(), map_width, map_height, player_x, player_y, -1.5f, fov, columns, hits);
+	for(Door &door : doors){
+		for(int k=0; k<2; k++){
+			toggle_door(door, map, map_width, map_height, edits);
+			check(apply_map_edits(edits, map, &lighting, &pvs, &cache), "door", door.x, door.y);
+		}
+	}
+	for(size_t y=1; y+1<map_height; y++){
+		for(size_t x=1; x+1<map_width; x++){
+			const char wall = map[x + y*map_width];
+			if(wall == ' ') continue;
+			set_map_cell(map, map_width, map_height, x, y, ' ', edits);
+			check(apply_map_edits(edits, map, &lighting, &pvs, &cache), "removing wall", x, y);
+			set_map_cell(map, map_width, map_height, x, y, wall, edits);
+			check(apply_map_edits(edits, map, &lighting, &pvs, &cache), "placing wall", x, y);
+		}
+	}
+	//walls built in the open, where rays were clear before
+	for(size_t y=1; y+1<map_height; y++){
+		for(size_t x=1; x+1<map_width; x++){
+			if(map[x + y*map_width] != ' ' || (y == size_t(player_y) && (x == size_t(player_x) ||
+			   x == size_t(player_x + .25f)))) continue;
+			set_map_cell(map, map_width, map_height, x, y, '0', edits);
+			check(apply_map_edits(edits, map, &lighting, &pvs, &cache), "building wall", x, y);
+			set_map_cell(map, map_width, map_height, x, y, ' ', edits);
+			check(apply_map_edits(edits, map, &lighting, &pvs, &cache), "clearing wall", x, y);
+		}
+	}
+
+	//collecting a large diff must stay linear in the cells changed
+	{
+		const size_t side = 1024, count = 160000;
+		std::string big(side*side, ' ');
+		MapEdits big_edits;
+		auto t0 = clock::now();
+		for(int pass=0; pass<2; pass++)
+			for(size_t k=0; k<count; k++){
+				const size_t cell = k*7 % (side*side);
+				set_map_cell(big, side, side, cell % side, cell / side, pass ? ' ' : '1', big_edits);
+			}
+		const double collect_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+		std::cout << "collecting " << 2*count << " edits of " << count << " cells on a " << side << "x" << side
+			  << " map " << collect_ms << " ms\n";
+		if(big_edits.cells.size() != count){
+			std::cerr << big_edits.cells.size() << " cells recorded for " << count << " edited\n";
+			failures++;
+		}
+	}
+
+	std::cout << "map " << map_width << "x" << map_height << ", " << doors.size() << " doors, "
+		  << updates << " edits\n"
+		  << "incremental update " << update_us/updates << " us/edit\n"
+		  << "full rebuild       " << rebuild_us/updates << " us/edit\n"
+		  << "PVS data grew to " << pvs.data.size() << " bytes\n"
+		  << "edits with stale data " << failures << "\n";
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "mapfile.h"
+#include "session.h"
+
+/*-------------------------------------
+Name: generate_maze
+Description: A perfect maze of one cell wide corridors (every empty cell
+	reachable by exactly one way) by depth-first backtracking over the
+	cells at odd coordinates. Instead of a stack, each visited cell keeps
+	the direction it was entered from in one byte, so the walk back costs
+	a quarter byte per map cell however long the corridors get.
+
+Purpose: Many short walls close to the player; long winding paths.
+--------------------------------------*/
+void generate_maze(std::string &map, const size_t width, const size_t height, std::mt19937 &rng){
+	const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+	const size_t rooms_x = (width - 1)/2, rooms_y = (height - 1)/2;
+	const uint8_t unvisited = 255, root = 4;
+	std::vector<uint8_t> came_from(rooms_x*rooms_y, unvisited);
+	std::fill(map.begin(), map.end(), '1');
+	size_t x = 0, y = 0;
+	came_from[0] = root;
+	map[1 + width] = ' ';
+	while(true){
+		int options[4], count = 0;
+		for(int d=0; d<4; d++){
+			const long nx = long(x) + dx[d], ny = long(y) + dy[d];
+			if(nx < 0 || ny < 0 || nx >= long(rooms_x) || ny >= long(rooms_y)) continue;
+			if(came_from[nx + ny*rooms_x] == unvisited) options[count++] = d;
+		}
+		if(count > 0){
+			const int d = options[rng() % count];
+			map[(2*x + 1 + dx[d]) + (2*y + 1 + dy[d])*width] = ' ';
+			x += dx[d];
+			y += dy[d];
+			came_from[x + y*rooms_x] = uint8_t(d);
+			map[(2*x + 1) + (2*y + 1)*width] = ' ';
+			continue;
+		}
+		const uint8_t d = came_from[x + y*rooms_x];
+		if(d == root) break;
+		x -= dx[d];
+		y -= dy[d];
+	}
+}
+
+
+/*-------------------------------------
+Name: generate_caverns
+Description: Open caves by cellular automaton: 45% of the cells start as
+	rock, then five times over a cell becomes rock if five or more of the
+	nine cells around it (itself included) are. Counts are taken from a
+	running sum of three rows, so a pass is a few adds per cell. Small
+	pockets may be cut off from the rest.
+
+Purpose: Large irregular open spaces, where rays travel far at every angle.
+--------------------------------------*/
+void generate_caverns(std::string &map, const size_t width, const size_t height, std::mt19937 &rng){
+	std::vector<uint8_t> rock(width*height), next(width*height);
+	std::uniform_int_distribution<int> percent(0, 99);
+	for(uint8_t &cell : rock) cell = percent(rng) < 45;
+	std::vector<uint8_t> column(width);
+	for(int pass=0; pass<5; pass++){
+		for(size_t y=0; y<height; y++){
+			//rock in this column over the rows y-1..y+1, out of the map counting as rock
+			for(size_t x=0; x<width; x++){
+				column[x] = rock[x + y*width] + (y > 0 ? rock[x + (y - 1)*width] : 1) +
+					(y + 1 < height ? rock[x + (y + 1)*width] : 1);
+			}
+			for(size_t x=0; x<width; x++){
+				const int around = column[x] + (x > 0 ? column[x - 1] : 3) + (x + 1 < width ? column[x + 1] : 3);
+				next[x + y*width] = around >= 5;
+			}
+		}
+		rock.swap(next);
+	}
+	for(size_t i=0; i<map.size(); i++) map[i] = rock[i] ? '0' : ' ';
+}
+
+
+/*-------------------------------------
+Name: generate_offices
+Description: Densely packed rooms by recursive division: a room wider or
+	taller than 8 cells is split by a wall across it at a random place,
+	with one doorway, and each half is split again. Doorways are kept out
+	of the line of the walls that meet them. Rooms to split wait on a
+	stack, which holds at most a few entries per level of splitting.
+
+Purpose: Many rooms behind many doors; most rays stop within a few cells.
+--------------------------------------*/
+void generate_offices(std::string &map, const size_t width, const size_t height, std::mt19937 &rng){
+	struct Room { size_t x0, y0, x1, y1; };	//inner cells, inclusive
+	std::fill(map.begin(), map.end(), ' ');
+	std::vector<Room> rooms = {{1, 1, width - 2, height - 2}};
+	const size_t smallest = 8;
+	while(!rooms.empty()){
+		const Room room = rooms.back();
+		rooms.pop_back();
+		const size_t w = room.x1 - room.x0 + 1, h = room.y1 - room.y0 + 1;
+		if(w <= smallest && h <= smallest) continue;
+		const bool vertical = w > h || (w == h && rng() % 2);
+		//the wall goes at an odd offset from the room's edge and the doorway at
+		//an even one, so a wall never ends in another room's doorway
+		const size_t span = vertical ? w : h, across = vertical ? h : w;
+		const size_t wall = 2 + 2*(rng() % ((span - 3)/2));
+		const size_t door = 2*(rng() % ((across + 1)/2));
+		for(size_t k=0; k<across; k++){
+			if(k == door) continue;
+			if(vertical) map[room.x0 + wall - 1 + (room.y0 + k)*width] = '2';
+			else map[room.x0 + k + (room.y0 + wall - 1)*width] = '2';
+		}
+		if(vertical){
+			rooms.push_back({room.x0, room.y0, room.x0 + wall - 2, room.y1});
+			rooms.push_back({room.x0 + wall, room.y0, room.x1, room.y1});
+		}
+		else {
+			rooms.push_back({room.x0, room.y0, room.x1, room.y0 + wall - 2});
+			rooms.push_back({room.x0, room.y0 + wall, room.x1, room.y1});
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: generate_corridors
+Description: One serpentine corridor: one cell wide rows running the whole
+	width of the map, divided by one cell walls, each joined to the next at
+	alternate ends.
+
+Purpose: The worst case for ray casting: looking along a corridor, every ray
+	crosses most of the map before it hits anything.
+--------------------------------------*/
+void generate_corridors(std::string &map, const size_t width, const size_t height, std::mt19937&){
+	std::fill(map.begin(), map.end(), ' ');
+	for(size_t y=2; y+1<height; y+=2){
+		const size_t gap = (y/2) % 2 ? width - 2 : 1;
+		for(size_t x=1; x+1<width; x++)
+			if(x != gap) map[x + y*width] = '3';
+	}
+}
+
+
+/*-------------------------------------
+Name: open_distance
+Description: How far a point can travel from x, y at angle a before it
+	reaches a wall, up to limit, in steps of .1.
+--------------------------------------*/
+float open_distance(const std::string &map, const size_t width, const size_t height,
+		    const float x, const float y, const float a, const float limit){
+	for(float t=0; t<limit; t+=.1f){
+		const float px = x + std::cos(a)*t, py = y + std::sin(a)*t;
+		if(px < 0 || py < 0 || size_t(px) >= width || size_t(py) >= height || map[size_t(px) + size_t(py)*width] != ' ')
+			return t;
+	}
+	return limit;
+}
+
+
+/*-------------------------------------
+Name: camera_path
+Description: A fixed walk through the map for the benchmarks, one pose per
+	frame, starting at the empty cell nearest the center. The camera walks
+	forward .05 per frame while the way ahead is clear and otherwise turns,
+	.05 per frame like the keyboard controls, toward whichever of the eight
+	compass directions is most open (the way back only as a last resort).
+	Every 300 frames it also looks for a more open direction. Depends only
+	on the map and the seed.
+
+Purpose: Gives every generated map a repeatable session to replay, so the
+	renderer modes can be compared on the same frames.
+--------------------------------------*/
+std::vector<Pose> camera_path(const std::string &map, const size_t width, const size_t height, const size_t frames,
+			      std::mt19937 &rng){
+	std::vector<Pose> poses;
+	Pose pose;
+	bool found = false;
+	const long cx = long(width/2), cy = long(height/2);
+	for(long r=0; r<long(std::max(width, height)) && !found; r++){
+		for(long y=cy - r; y<=cy + r && !found; y++){
+			//the whole top and bottom row of the ring, the ends of the others
+			const long x_step = y == cy - r || y == cy + r ? 1 : std::max(2*r, 1L);
+			for(long x=cx - r; x<=cx + r && !found; x+=x_step){
+				if(x < 0 || y < 0 || x >= long(width) || y >= long(height) || map[x + y*width] != ' ') continue;
+				pose.x = x + .5f;
+				pose.y = y + .5f;
+				found = true;
+			}
+		}
+	}
+	if(!found) return poses;
+	const float step = .05f, turn = .05f, probe = 32;
+	auto pick_heading = [&](){
+		float best = pose.a, best_open = -1;
+		const int first = int(rng() % 8);
+		for(int k=0; k<8; k++){
+			const float a = float(((first + k) % 8)*M_PI/4);
+			float open = open_distance(map, width, height, pose.x, pose.y, a, probe);
+			if(std::cos(a - pose.a) < -.9f) open *= .1f;
+			if(open > best_open){
+				best_open = open;
+				best = a;
+			}
+		}
+		return best;
+	};
+	pose.a = pick_heading();
+	float target = pose.a;
+	for(size_t f=0; f<frames; f++){
+		if(f % 300 == 299) target = pick_heading();
+		const float diff = std::remainder(target - pose.a, float(2*M_PI));
+		if(std::fabs(diff) > turn) pose.a = std::remainder(pose.a + (diff > 0 ? turn : -turn), float(2*M_PI));
+		else {
+			pose.a = target;
+			if(open_distance(map, width, height, pose.x, pose.y, pose.a, .6f) >= .6f){
+				pose.x += std::cos(pose.a)*step;
+				pose.y += std::sin(pose.a)*step;
+			}
+			else target = pick_heading();
+		}
+		poses.push_back(pose);
+	}
+	return poses;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Writes a generated map of the given kind and size (square unless
+	a height is given) to a map file, walled all around, with a "start" line
+	for where the player begins. With a session file, also writes a camera
+	path of frames poses through the map, in the format of
+	gameloop --record-poses. The same kind, size and seed always make the
+	same files.
+
+	usage: map_gen <maze|caverns|offices|corridors> <map file> [size] [seed]
+		[session file] [frames] [height]
+
+Purpose: Makes maps from 64x64 up to 16384x16384 to see how the renderer
+	modes scale, where the hand-made map is only 16x16.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " <maze|caverns|offices|corridors> <map file> [size] [seed]"
+			  << " [session file] [frames] [height]\n";
+		return 1;
+	}
+	const std::string kind = argv[1];
+	const size_t width = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+	const unsigned seed = argc > 4 ? unsigned(std::strtoul(argv[4], nullptr, 10)) : 1;
+	const std::string session_file = argc > 5 ? argv[5] : "";
+	const size_t frames = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : 1200;
+	const size_t height = argc > 7 ? std::strtoul(argv[7], nullptr, 10) : width;
+	if(width < 16 || height < 16){
+		std::cerr << "maps must be at least 16x16\n";
+		return 1;
+	}
+	void (*generate)(std::string&, size_t, size_t, std::mt19937&) = nullptr;
+	if(kind == "maze") generate = generate_maze;
+	else if(kind == "caverns") generate = generate_caverns;
+	else if(kind == "offices") generate = generate_offices;
+	else if(kind == "corridors") generate = generate_corridors;
+	else {
+		std::cerr << "Unknown map kind: " << kind << "\n";
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	std::string map(width*height, ' ');
+	generate(map, width, height, rng);
+	for(size_t x=0; x<width; x++) map[x] = map[x + (height - 1)*width] = '0';
+	for(size_t y=0; y<height; y++) map[y*width] = map[width - 1 + y*width] = '0';
+	const size_t empty = std::count(map.begin(), map.end(), ' ');
+
+	const std::vector<Pose> poses = camera_path(map, width, height, std::max<size_t>(frames, 1), rng);
+	if(poses.empty()){
+		std::cerr << "The generated map has no empty cell\n";
+		return 1;
+	}
+	std::ostringstream start;
+	start << "start " << poses[0].x << " " << poses[0].y << " " << poses[0].a;
+	if(!save_map_file(argv[2], map.data(), width, height, {start.str()})) return 1;
+	std::cout << "Wrote " << width << "x" << height << " " << kind << " to " << argv[2] << ", "
+		  << 100.*empty/map.size() << "% empty\n";
+	if(!session_file.empty()){
+		std::ofstream ofs(session_file);
+		for(size_t f=0; f<frames; f++) save_pose(ofs, poses[f]);
+		if(!ofs){
+			std::cerr << "Failed to write session file: " << session_file << "\n";
+			return 1;
+		}
+		std::cout << "Wrote a " << frames << " frame camera path to " << session_file << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*-------------------------------------
+Name: parse_map_text, load_map_file
+Description: Reads a map from plain text with one map row per line, using
+	the same characters as the map literal in gameloop.cpp (a space is an
+	empty cell, anything else is a wall). Every row must have the same length.
+	A trailing carriage return on a line is ignored. On success the cells are
+	stored row-major in map with its dimensions in map_width and map_height.
+
+	The grid ends at the first empty line or at the end of the file. Any
+	lines after that describe things placed in the map (for example
+	"light 3.5 2.5 8 1"); they are returned untouched in extra_lines, and
+	blank ones are skipped.
+
+	parse_map_text reads from a stream, naming it name in errors;
+	load_map_file opens a file and parses it.
+
+Purpose: Lets maps live on disk next to data derived from them (such as the
+	PVS table) instead of only as a string literal compiled into the program.
+--------------------------------------*/
+inline bool parse_map_text(std::istream &in,
+			const std::string &name,
+			std::string &map,
+			size_t &map_width,
+			size_t &map_height,
+			std::vector<std::string> *extra_lines = nullptr){
+	std::string cells, line;
+	size_t width = 0, height = 0;
+	std::vector<std::string> extra;
+	bool in_grid = true;
+	while(std::getline(in, line)){
+		if(!line.empty() && line.back() == '\r') line.pop_back();
+		if(in_grid && line.empty() && height > 0) in_grid = false;
+		if(!in_grid){
+			if(!line.empty()) extra.push_back(line);
+			continue;
+		}
+		if(height == 0) width = line.size();
+		if(line.size() != width || width == 0){
+			std::cerr << "Map row " << height << " of " << name
+				  << " has " << line.size() << " cells, expected " << width << "\n";
+			return false;
+		}
+		cells += line;
+		height++;
+	}
+	if(height == 0){
+		std::cerr << "Map file is empty: " << name << "\n";
+		return false;
+	}
+	map = cells;
+	map_width = width;
+	map_height = height;
+	if(extra_lines) *extra_lines = extra;
+	return true;
+}
+
+inline bool load_map_file(const std::string filename,
+			std::string &map,
+			size_t &map_width,
+			size_t &map_height,
+			std::vector<std::string> *extra_lines = nullptr){
+	std::ifstream ifs(filename);
+	if(!ifs){
+		std::cerr << "Failed to open map file: " << filename << "\n";
+		return false;
+	}
+	return parse_map_text(ifs, filename, map, map_width, map_height, extra_lines);
+}
+
+
+/*-------------------------------------
+Name: save_map_file
+Description: Writes a row-major map back out in the format load_map_file reads,
+	followed by extra_lines (after an empty line) if there are any.
+
+Purpose: Used by tools that generate or edit maps.
+--------------------------------------*/
+inline bool save_map_file(const std::string filename,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const std::vector<std::string> &extra_lines = {}){
+	std::ofstream ofs(filename, std::ios::binary);
+	if(!ofs){
+		std::cerr << "Failed to write map file: " << filename << "\n";
+		return false;
+	}
+	for(size_t j=0; j<map_height; j++){
+		ofs.write(map + j*map_width, map_width);
+		ofs << "\n";
+	}
+	if(!extra_lines.empty()) ofs << "\n";
+	for(const std::string &line : extra_lines) ofs << line << "\n";
+	return bool(ofs);
+}
+
+
+/*-------------------------------------
+Name: map_hash
+Description: 64-bit FNV-1a hash of the map dimensions and cells.
+
+Purpose: Data baked offline from a map stores this hash so it can be
+	rejected at load time if the map has changed since it was built.
+--------------------------------------*/
+inline uint64_t map_hash(const char *map, const size_t map_width, const size_t map_height){
+	uint64_t h = 14695981039346656037ull;
+	auto mix = [&h](uint8_t byte){ h ^= byte; h *= 1099511628211ull; };
+	for(int k=0; k<8; k++) mix(uint8_t(uint64_t(map_width) >> (8*k)));
+	for(int k=0; k<8; k++) mix(uint8_t(uint64_t(map_height) >> (8*k)));
+	for(size_t i=0; i<map_width*map_height; i++) mix(uint8_t(map[i]));
+	return h;
+}
+
+#endif
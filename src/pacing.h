@@ -0,0 +1,136 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+/*-------------------------------------
+Name: FramePacer
+Description: Holds frames to a fixed rate with deadlines on a grid of
+	1/rate seconds: wait sleeps until spin_margin before the next
+	deadline, then yields until it passes, so a frame starts within
+	microseconds of its deadline instead of up to a millisecond and more
+	after it, as a whole-millisecond delay does (16 ms per frame is also
+	62.5 frames a second, not 60). A frame that runs past its deadline
+	starts the grid again from now rather than rushing to catch up, as
+	does restart after the loop sat idle. late is how far past the
+	deadline the last wait returned.
+
+	The yield loop keeps a core busy for up to spin_margin of every frame,
+	1 ms by default: at 60 frames a second up to 6% of a core, spent to
+	absorb the lateness of the sleep's wakeup. A margin of 0 sleeps all
+	the way to the deadline and costs nothing, but a frame then starts as
+	late as the scheduler wakes the thread (pacing_bench measures both).
+
+Purpose: Steady frame pacing for the frame loop, with the processor asleep
+	for all but the last moments of each wait.
+--------------------------------------*/
+class FramePacer {
+public:
+	typedef std::chrono::steady_clock clock;
+
+	explicit FramePacer(const double rate, const std::chrono::microseconds spin_margin = std::chrono::microseconds(1000))
+		: period(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1/rate))),
+		  margin(spin_margin), deadline(clock::now() + period){}
+
+	void wait(){
+		const clock::time_point now = clock::now();
+		if(now >= deadline){
+			late = now - deadline;
+			deadline = now + period;
+			return;
+		}
+		if(deadline - now > margin) std::this_thread::sleep_until(deadline - margin);
+		while(clock::now() < deadline) std::this_thread::yield();
+		late = clock::now() - deadline;
+		deadline += period;
+	}
+
+	void restart(){ deadline = clock::now() + period; }
+
+	clock::duration frame_period() const { return period; }
+	clock::duration spin_margin() const { return margin; }
+	clock::duration late{0};
+
+private:
+	clock::duration period;
+	clock::duration margin;
+	clock::time_point deadline;
+};
+
+
+/*-------------------------------------
+Name: OnDemandWait
+Description: What the on-demand frame loop decides while nothing moves, on
+	a millisecond clock (SDL_GetTicks in the demo). timeout is how long
+	the loop may sleep in its event queue: -1 for until an event arrives,
+	frame_ms while assets are loading, at most 250 ms while a file is
+	watched (its changes do not wake the queue), and never past the next
+	refresh. refresh_due tells whether the refresh is due; drew records
+	the time a frame was drawn, which the refresh counts from.
+
+Purpose: The idle policy of the frame loop in one place, so the bench that
+	measures its cost runs the loop's own decisions.
+--------------------------------------*/
+class OnDemandWait {
+public:
+	OnDemandWait(const uint32_t refresh_ms, const int frame_ms, const uint32_t now_ms)
+		: refresh(refresh_ms), frame(frame_ms), last_draw(now_ms){}
+
+	int timeout(const bool loading, const bool watching, const uint32_t now_ms) const {
+		int timeout = loading ? frame : -1;
+		if(watching) timeout = timeout < 0 ? 250 : std::min(timeout, 250);
+		if(refresh > 0){
+			const uint32_t since = now_ms - last_draw;
+			const int remaining = since < refresh ? int(refresh - since) : 0;
+			timeout = timeout < 0 ? remaining : std::min(timeout, remaining);
+		}
+		return timeout;
+	}
+
+	bool refresh_due(const uint32_t now_ms) const { return refresh > 0 && now_ms - last_draw >= refresh; }
+	void drew(const uint32_t now_ms){ last_draw = now_ms; }
+
+private:
+	uint32_t refresh;
+	int frame;
+	uint32_t last_draw;
+};
+
+
+/*-------------------------------------
+Name: CpuMeter
+Description: The processor time used by the whole process (every thread),
+	against the wall time, between two calls of sample: 1 is one core
+	busy the whole time.
+
+Purpose: Reports what the frame loop costs while nothing happens on screen.
+--------------------------------------*/
+class CpuMeter {
+public:
+	CpuMeter(){ sample(); }
+
+	double sample(){
+		const std::clock_t cpu = std::clock();
+		const auto now = std::chrono::steady_clock::now();
+		const double wall = std::chrono::duration<double>(now - last_wall).count();
+		const double used = double(cpu - last_cpu)/CLOCKS_PER_SEC;
+		last_cpu = cpu;
+		last_wall = now;
+		return wall > 0 ? used/wall : 0;
+	}
+
+	double seconds_since_sample() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - last_wall).count();
+	}
+
+private:
+	std::clock_t last_cpu = 0;
+	std::chrono::steady_clock::time_point last_wall;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "pacing.h"
+
+/*-------------------------------------
+Name: StubEvents
+Description: An event queue no input ever arrives in, standing in for SDL's
+	in the demo's on-demand loop. wait blocks for timeout_ms, or with -1
+	until an event, as SDL_WaitEventTimeout and SDL_WaitEvent do; the only
+	event is close, the quit at the end of a run, which wakes the waiter.
+	poll finds no input.
+
+Purpose: Lets the bench run the frame loop's idle path without a window.
+--------------------------------------*/
+struct StubEvents {
+	std::mutex mutex;
+	std::condition_variable event;
+	std::atomic<bool> closed{false};
+
+	void wait(const int timeout_ms){
+		std::unique_lock<std::mutex> lock(mutex);
+		if(timeout_ms < 0) event.wait(lock, [&]{ return bool(closed); });
+		else event.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{ return bool(closed); });
+	}
+
+	bool poll(){ return false; }
+
+	void close(){
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		event.notify_all();
+	}
+};
+
+
+/*-------------------------------------
+Name: main
+Description: Draws the demo's composed grid frame (cached rays, minimap and
+	lit, shaded walls at 1024x512) with the player standing still, and
+	1. paces 120 frames at 60 a second with a whole-millisecond delay after
+	   each frame, as the demo did with SDL_Delay, with FramePacer and with
+	   a FramePacer that only sleeps (no spin margin), printing the frames
+	   per second each reaches and how far the frame intervals stray from
+	   1/60 s;
+	2. measures the processor use over seconds seconds of standing still:
+	   drawing every frame, with and without the spin margin, and the
+	   demo's on-demand loop (OnDemandWait deciding the waits, the pacer
+	   restarted after each and waited on after each frame) over a
+	   StubEvents queue, with no refresh and with one every second.
+	   SDL's own wait is not part of the figure.
+
+	usage: pacing_bench [seconds] [map file]
+
+Purpose: Shows the idle cost of the on-demand mode against drawing every
+	frame, what the spin margin costs, and the pacing it buys.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	const double seconds = argc > 1 ? std::stod(argv[1]) : 3;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 2 ? argv[2] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const uint32_t clear = packcolor(200, 200, 200), wall = packcolor(0, 255, 255);
+	const ShadeTable shading = build_shade_table(20.f, 256, clear);
+	const size_t width = 1024, height = 512;
+	const Pose pose = scripted_session(1)[0];
+	const float fov = M_PI/3.;
+	std::vector<uint32_t> framebuffer(width*height);
+	const FrameView<uint32_t> frame = frame_view(framebuffer, width, height);
+	std::vector<RayHit> hits;
+	RayCache ray_cache;
+	auto draw_frame = [&](){
+		cast_columns_cached(ray_cache, map.data(), map_width, map_height, pose.x, pose.y, pose.a, fov, width/2, hits);
+		compose_minimap(frame.sub_view(0, 0, width/2, height), map.data(), map_width, map_height,
+				width/(map_width*2), height/map_height, clear, [&](size_t, size_t){ return wall; });
+		compose_wall_columns(frame.sub_view(width/2, 0, width/2, height), hits, wall, clear, clear, &shading,
+				     &lighting);
+	};
+
+	//1. pacing
+	const int frame_delay = 1000/60;
+	const double target = 1/60.;
+	for(int mode=0; mode<3; mode++){
+		FramePacer pacer(60, std::chrono::microseconds(mode == 2 ? 0 : 1000));
+		std::vector<double> intervals;
+		clock::time_point previous = clock::now();
+		for(int f=0; f<120; f++){
+			const auto start = clock::now();
+			draw_frame();
+			if(mode == 0){
+				//SDL_GetTicks and SDL_Delay both count whole milliseconds
+				const int frame_time = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+					clock::now() - start).count());
+				if(frame_delay > frame_time)
+					std::this_thread::sleep_for(std::chrono::milliseconds(frame_delay - frame_time));
+			}
+			else pacer.wait();
+			const clock::time_point now = clock::now();
+			intervals.push_back(std::chrono::duration<double>(now - previous).count());
+			previous = now;
+		}
+		double total = 0, worst = 0, mean_error = 0;
+		for(const double t : intervals){
+			total += t;
+			worst = std::max(worst, std::fabs(t - target));
+			mean_error += std::fabs(t - target);
+		}
+		const char *names[3] = {"millisecond delay: ", "FramePacer:        ", "FramePacer, no spin:"};
+		std::cout << names[mode] << " " << intervals.size()/total
+			  << " frames per second, intervals off 1/60 s by " << mean_error/intervals.size()*1e6
+			  << " us on average, " << worst*1e6 << " us at worst\n";
+	}
+
+	//2. standing still
+	const auto bench_start = clock::now();
+	auto ticks = [&](){
+		return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - bench_start).count());
+	};
+	for(int mode=0; mode<4; mode++){
+		CpuMeter meter;
+		size_t frames = 0;
+		const auto end = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+		if(mode < 2){
+			FramePacer pacer(60, std::chrono::microseconds(mode == 1 ? 0 : 1000));
+			while(clock::now() < end){
+				draw_frame();
+				frames++;
+				pacer.wait();
+			}
+		} else {
+			//the frame loop of gameloop with --on-demand, nothing moving
+			StubEvents events;
+			std::thread quit([&]{
+				std::this_thread::sleep_until(end);
+				events.close();
+			});
+			FramePacer pacer(60);
+			OnDemandWait idle(mode == 3 ? 1000 : 0, 1000/60, ticks());
+			bool redraw = true;
+			while(!events.closed){
+				if(!redraw){
+					events.wait(idle.timeout(false, false, ticks()));
+					pacer.restart();
+				}
+				const bool had_input = events.poll();
+				if(!redraw && !had_input && !idle.refresh_due(ticks())) continue;
+				redraw = false;
+				draw_frame();
+				frames++;
+				idle.drew(ticks());
+				pacer.wait();
+			}
+			quit.join();
+		}
+		const double used = meter.sample();
+		const char *names[4] = {"every frame:          ", "every frame, no spin: ", "on demand:            ",
+					"on demand, 1 s refresh:"};
+		std::cout << names[mode] << " " << 100*used << "% of a core, " << frames << " frames in " << seconds << " s\n";
+	}
+	return 0;
+}
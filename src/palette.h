@@ -0,0 +1,274 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include "pixelformat.h"
+#include "shading.h"
+#include "lighting.h"
+#include "raycaster.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*-------------------------------------
+Name: Palette
+Description: The 256 colors an indexed framebuffer can show, in the
+	framebuffer's packed format. Flat colors (clear, minimap, player) are
+	added one by one with add; a wall color gets a ramp from add_wall_ramp.
+	Entries past used stay black.
+
+Purpose: Lets the renderer write one byte per pixel and leave the colors to
+	a single expansion pass at upload.
+--------------------------------------*/
+struct Palette {
+	uint32_t colors[256] = {};
+	size_t used = 0;
+
+	uint8_t add(const uint32_t color){
+		for(size_t i=0; i<used; i++) if(colors[i] == color) return uint8_t(i);
+		assert(used < 256);
+		colors[used] = color;
+		return uint8_t(used++);
+	}
+};
+
+constexpr size_t palette_brightness_levels = 24;
+constexpr size_t palette_fog_levels = 10;
+
+
+/*-------------------------------------
+Name: add_wall_ramp
+Description: Adds palette_fog_levels x palette_brightness_levels entries for
+	wall_color: every brightness from black to full, blended toward
+	fog_color by every fog weight from none to full, which covers anything
+	lighting and distance shading can turn the wall into. Returns the index
+	of the first entry.
+
+Purpose: The shaded palette ramp one wall color needs (240 entries, so one
+	wall color and up to 16 flat colors fit).
+--------------------------------------*/
+inline uint8_t add_wall_ramp(Palette &palette, const uint32_t wall_color, const uint32_t fog_color){
+	assert(palette.used + palette_fog_levels*palette_brightness_levels <= 256);
+	const uint8_t base = uint8_t(palette.used);
+	uint8_t wall[4], fog[4];
+	unpack_color(wall_color, wall[0], wall[1], wall[2], wall[3]);
+	unpack_color(fog_color, fog[0], fog[1], fog[2], fog[3]);
+	for(size_t f=0; f<palette_fog_levels; f++){
+		const float fogged = float(f)/(palette_fog_levels - 1);
+		for(size_t b=0; b<palette_brightness_levels; b++){
+			const float lit = float(b)/(palette_brightness_levels - 1);
+			uint8_t c[3];
+			for(size_t k=0; k<3; k++) c[k] = uint8_t(wall[k]*lit*(1 - fogged) + fog[k]*fogged + .5f);
+			palette.colors[palette.used++] = packcolor(c[0], c[1], c[2], wall[3]);
+		}
+	}
+	return base;
+}
+
+
+/*-------------------------------------
+Name: IndexedShading, build_indexed_shading
+Description: For a wall color, the palette index of every combination of
+	distance bucket, wall side and light level (in 32 steps): the ramp entry
+	nearest to what draw_wall_columns would draw for it with the same
+	ShadeTable (or with none, for unshaded walls). Built once, it makes
+	shading an indexed wall column a single table lookup.
+
+Purpose: Distance shading, side shading and the light map, for walls drawn
+	as palette indices.
+--------------------------------------*/
+struct IndexedShading {
+	size_t buckets = 1;
+	float buckets_per_unit = 0;
+	std::vector<uint8_t> indices; //((bucket*2 + side) << 5) + (light >> 3)
+
+	uint8_t index(const float distance, const size_t side, const uint8_t light) const {
+		const float b = distance*buckets_per_unit;
+		const size_t bucket = b <= 0 ? 0 : std::min(buckets - 1, size_t(b));
+		return indices[((bucket*2 + side) << 5) + (light >> 3)];
+	}
+};
+
+inline IndexedShading build_indexed_shading(const Palette &palette,
+				const uint8_t ramp_base,
+				const uint32_t wall_color,
+				const ShadeTable *shading){
+	IndexedShading table;
+	if(shading){
+		table.buckets = shading->buckets;
+		table.buckets_per_unit = shading->buckets_per_unit;
+	}
+	const size_t ramp_size = palette_fog_levels*palette_brightness_levels;
+	table.indices.resize(table.buckets*2*32);
+	for(size_t bucket=0; bucket<table.buckets; bucket++){
+		for(size_t side=0; side<2; side++){
+			for(size_t level=0; level<32; level++){
+				uint32_t color = scale_color(wall_color, uint8_t(level*255/31));
+				if(shading){
+					const float distance = (bucket + .5f)/table.buckets_per_unit;
+					color = shade_color(*shading, color, distance, side);
+				}
+				uint8_t r, g, b, a;
+				unpack_color(color, r, g, b, a);
+				size_t best = 0;
+				int best_error = INT32_MAX;
+				for(size_t i=0; i<ramp_size; i++){
+					uint8_t pr, pg, pb, pa;
+					unpack_color(palette.colors[ramp_base + i], pr, pg, pb, pa);
+					const int error = (pr - r)*(pr - r) + (pg - g)*(pg - g) + (pb - b)*(pb - b);
+					if(error < best_error){
+						best_error = error;
+						best = i;
+					}
+				}
+				table.indices[((bucket*2 + side) << 5) + level] = uint8_t(ramp_base + best);
+			}
+		}
+	}
+	return table;
+}
+
+
+/*-------------------------------------
+Name: draw_wall_columns_indexed
+Description: draw_wall_columns for an indexed framebuffer: the same columns,
+	each filled with the palette index shades gives for its distance, side
+	and light level (full light without a light map).
+
+Purpose: The wall pass of the indexed mode, writing a quarter of the bytes.
+--------------------------------------*/
+inline void draw_wall_columns_indexed(const FrameView<uint8_t> view,
+			const std::vector<RayHit> &hits,
+			const IndexedShading &shades,
+			const LightMap *lighting = nullptr){
+	const size_t columns = std::min(hits.size(), view.width);
+	for(size_t i=0; i<columns; i++){
+		const RayHit &hit = hits[i];
+		if(hit.cell == 0) continue;
+		const size_t column_height = std::min(float(view.height)/std::max(hit.distance, .01f),
+						      float(view.height));
+		const size_t top = view.height/2 - column_height/2;
+		uint8_t light = 255;
+		if(lighting && hit.face_x >= 0 && hit.face_y >= 0 && size_t(hit.face_x) < lighting->width &&
+		   size_t(hit.face_y) < lighting->height)
+			light = lighting->light_at(hit.face_x, hit.face_y);
+		const uint8_t index = shades.index(hit.distance, hit.side, light);
+		uint8_t *pixel = &view.at(i, top);
+		for(size_t j=0; j<column_height; j++, pixel += view.pitch) *pixel = index;
+	}
+}
+
+inline void draw_wall_columns_indexed(std::vector<uint8_t> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t view_x,
+			const std::vector<RayHit> &hits,
+			const IndexedShading &shades,
+			const LightMap *lighting = nullptr){
+	draw_wall_columns_indexed(frame_view(image, image_width, image_height).sub_view(view_x, 0, image_width,
+											 image_height),
+				  hits, shades, lighting);
+}
+
+
+/*-------------------------------------
+Name: compose_wall_columns_indexed
+Description: compose_wall_columns for an indexed framebuffer: ceiling, wall
+	and floor spans of palette indices, every pixel of the view written
+	once. Returns the number of pixels written.
+
+Purpose: The single-pass 3D view of the indexed mode.
+--------------------------------------*/
+inline size_t compose_wall_columns_indexed(const FrameView<uint8_t> view,
+			const std::vector<RayHit> &hits,
+			const IndexedShading &shades,
+			const uint8_t ceiling_index,
+			const uint8_t floor_index,
+			const LightMap *lighting = nullptr){
+	const size_t columns = std::min(hits.size(), view.width);
+	const size_t height = view.height;
+	static thread_local std::vector<uint32_t> top, bottom;
+	static thread_local std::vector<uint8_t> index;
+	top.resize(columns);
+	bottom.resize(columns);
+	index.resize(columns);
+	wall_column_spans(hits, columns, height, top.data(), bottom.data());
+	for(size_t i=0; i<columns; i++){
+		const RayHit &hit = hits[i];
+		if(hit.cell == 0) continue;
+		uint8_t light = 255;
+		if(lighting && hit.face_x >= 0 && hit.face_y >= 0 && size_t(hit.face_x) < lighting->width &&
+		   size_t(hit.face_y) < lighting->height)
+			light = lighting->light_at(hit.face_x, hit.face_y);
+		index[i] = shades.index(hit.distance, hit.side, light);
+	}
+	return compose_column_spans(view, columns, top.data(), bottom.data(), index.data(), ceiling_index, floor_index);
+}
+
+inline size_t compose_wall_columns_indexed(std::vector<uint8_t> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t view_x,
+			const std::vector<RayHit> &hits,
+			const IndexedShading &shades,
+			const uint8_t ceiling_index,
+			const uint8_t floor_index,
+			const LightMap *lighting = nullptr){
+	return compose_wall_columns_indexed(frame_view(image, image_width, image_height).sub_view(view_x, 0, image_width,
+												  image_height),
+					    hits, shades, ceiling_index, floor_index, lighting);
+}
+
+
+/*-------------------------------------
+Name: expand_indexed
+Description: Turns count palette indices into packed framebuffer pixels,
+	eight at a time and then one at a time for the last count % 8. With
+	AVX2 the eight are widened and fetched from the palette with one
+	gather. SSE2 (and SSSE3 and NEON) have no 256-entry lookup, so there
+	the eight colors are loaded one by one, assembled in two 128-bit
+	registers and written with two vector stores; without SSE2 an
+	unrolled loop loads and stores them. The palette is 1 KB and stays in
+	L1, so every path is bound by the bytes written.
+
+Purpose: The one place indices become colors, run at upload straight into
+	the streaming texture.
+--------------------------------------*/
+inline void expand_indexed(const uint8_t *src, const Palette &palette, uint32_t *dst, const size_t count){
+	const uint32_t *colors = palette.colors;
+	const size_t blocks = count & ~size_t(7);
+#if defined(__AVX2__)
+	for(size_t i=0; i<blocks; i+=8){
+		const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+		const __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(colors), index, 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), pixels);
+	}
+#elif defined(__SSE2__)
+	for(size_t i=0; i<blocks; i+=8){
+		const uint8_t *s = src + i;
+		const __m128i low = _mm_setr_epi32(int(colors[s[0]]), int(colors[s[1]]), int(colors[s[2]]),
+						   int(colors[s[3]]));
+		const __m128i high = _mm_setr_epi32(int(colors[s[4]]), int(colors[s[5]]), int(colors[s[6]]),
+						    int(colors[s[7]]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), low);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), high);
+	}
+#else
+	for(size_t i=0; i<blocks; i+=8){
+		uint32_t c[8];
+		for(size_t k=0; k<8; k++) c[k] = colors[src[i + k]];
+		std::memcpy(dst + i, c, sizeof(c));
+	}
+#endif
+	for(size_t i = blocks; i < count; i++) dst[i] = colors[src[i]];
+}
+
+#endif
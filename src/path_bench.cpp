@@ -0,0 +1,173 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include "mapfile.h"
+#include "pathfinding.h"
+
+/*-------------------------------------
+Name: astar_cost
+Description: Plain A* over every cell with the moves of path_can_step,
+	returning the path length (or -1) and counting the cells it expanded.
+
+Purpose: The reference jump point search is checked and timed against.
+--------------------------------------*/
+float astar_cost(const std::string &map, const size_t map_width, const size_t map_height, const uint32_t start,
+		 const uint32_t goal, PathScratch &scratch, size_t &expanded){
+	const int goal_x = goal % map_width, goal_y = goal / map_width;
+	scratch.begin(map.size());
+	scratch.g[start] = 0;
+	scratch.stamp[start] = scratch.generation;
+	scratch.push(0, start);
+	while(!scratch.open.empty()){
+		const uint32_t cell = scratch.pop();
+		if(scratch.is_closed(cell)) continue;
+		scratch.closed[cell] = scratch.generation;
+		expanded++;
+		if(cell == goal) return scratch.g[goal];
+		const int x = cell % map_width, y = cell / map_width;
+		for(size_t d=0; d<8; d++){
+			if(!path_can_step(map.data(), map_width, map_height, x, y, d)) continue;
+			const uint32_t next = uint32_t(x + path_dx[d] + (y + path_dy[d])*map_width);
+			const float g = scratch.g[cell] + path_step_cost(d);
+			if(scratch.is_closed(next) || (scratch.seen(next) && g >= scratch.g[next])) continue;
+			scratch.g[next] = g;
+			scratch.stamp[next] = scratch.generation;
+			scratch.push(g + octile_distance(x + path_dx[d], y + path_dy[d], goal_x, goal_y), next);
+		}
+	}
+	return -1;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Tiles the map tiles x tiles times into one large level, with a
+	gap in the middle of every tile edge so the tiles connect, and
+	1. runs queries random path queries with A* and with jump point
+	   search, checking both find the same lengths;
+	2. builds a flow field, then closes and reopens cells one at a time,
+	   repairing the field after each edit and checking it against a
+	   field rebuilt from scratch;
+	3. hands the same queries to a PathService as one batch and reports
+	   how long the calling thread was busy and how long the answer took.
+
+	usage: path_bench [queries] [map file] [tiles]
+
+Purpose: Shows what jump point search and incremental flow field repair
+	save, and that neither changes the answers.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	auto ms_since = [](const clock::time_point t){
+		return std::chrono::duration<double, std::milli>(clock::now() - t).count();
+	};
+	const size_t query_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+	std::string tile;
+	size_t tile_width = 0, tile_height = 0;
+	if(!load_map_file(argc > 2 ? argv[2] : "maps/level1.map", tile, tile_width, tile_height)) return 1;
+	const size_t tiles = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+	const size_t map_width = tile_width*tiles, map_height = tile_height*tiles;
+	std::string map(map_width*map_height, ' ');
+	for(size_t y=0; y<map_height; y++)
+		for(size_t x=0; x<map_width; x++)
+			map[x + y*map_width] = tile[x%tile_width + (y%tile_height)*tile_width];
+	//a gap in the middle of every tile edge joins the tiles into one level
+	for(size_t y=0; y<map_height; y++){
+		for(size_t x=0; x<map_width; x++){
+			const size_t tx = x%tile_width, ty = y%tile_height;
+			if(((tx == 0 || tx == tile_width - 1) && ty == tile_height/2) ||
+			   ((ty == 0 || ty == tile_height - 1) && tx == tile_width/2))
+				map[x + y*map_width] = ' ';
+		}
+	}
+	std::vector<uint32_t> empty;
+	for(size_t i=0; i<map.size(); i++) if(map[i] == ' ') empty.push_back(uint32_t(i));
+	std::mt19937 rng(5);
+	std::uniform_int_distribution<size_t> pick(0, empty.size() - 1);
+	std::vector<PathQuery> queries(query_count);
+	for(PathQuery &q : queries){
+		q.start = empty[pick(rng)];
+		q.goal = empty[pick(rng)];
+	}
+	std::cout << map_width << "x" << map_height << " map, " << query_count << " queries\n";
+
+	//1. A* against jump point search
+	PathScratch scratch;
+	std::vector<float> reference(query_count);
+	size_t expanded = 0;
+	auto t = clock::now();
+	for(size_t i=0; i<query_count; i++)
+		reference[i] = astar_cost(map, map_width, map_height, queries[i].start, queries[i].goal, scratch, expanded);
+	const double astar_ms = ms_since(t);
+	std::vector<uint32_t> waypoints;
+	size_t mismatches = 0, found = 0, jump_points = 0;
+	t = clock::now();
+	for(size_t i=0; i<query_count; i++){
+		float cost = 0;
+		const bool ok = find_path(map.data(), map_width, map_height, queries[i].start, queries[i].goal,
+					  waypoints, cost, scratch);
+		found += ok;
+		jump_points += waypoints.size();
+		if(ok != (reference[i] >= 0) || (ok && std::fabs(cost - reference[i]) > 1e-3f*std::max(1.f, cost)))
+			mismatches++;
+	}
+	const double jps_ms = ms_since(t);
+	std::cout << "  A*: " << astar_ms/query_count << " ms per query, " << expanded/query_count
+		  << " cells expanded\n  JPS: " << jps_ms/query_count << " ms per query, "
+		  << double(jump_points)/std::max<size_t>(found, 1) << " waypoints per path, " << found << " found, "
+		  << mismatches << " lengths differ from A*\n";
+
+	//2. flow field repair against rebuild
+	FlowField field, rebuilt;
+	const uint32_t target = empty[pick(rng)];
+	t = clock::now();
+	build_flow_field(field, map.data(), map_width, map_height, target);
+	const double build_ms = ms_since(t);
+	double repair_ms = 0;
+	size_t repaired = 0, edits = 0, field_mismatches = 0;
+	for(size_t e=0; e<40; e++){
+		const uint32_t cell = empty[pick(rng)];
+		if(cell == target) continue;
+		for(const char c : {'0', ' '}){
+			map[cell] = c;
+			t = clock::now();
+			repaired += repair_flow_field(field, map.data(), {cell});
+			repair_ms += ms_since(t);
+			edits++;
+			build_flow_field(rebuilt, map.data(), map_width, map_height, target);
+			for(size_t i=0; i<map.size(); i++){
+				if(std::fabs(field.cost[i] - rebuilt.cost[i]) > 1e-3f) field_mismatches++;
+				else if(field.direction[i] != no_direction){
+					const size_t d = field.direction[i];
+					const uint32_t next = uint32_t(i + path_dx[d] + path_dy[d]*int(map_width));
+					if(std::fabs(field.cost[i] - field.cost[next] - path_step_cost(d)) > 1e-3f) field_mismatches++;
+				}
+			}
+		}
+	}
+	std::cout << "  flow field: build " << build_ms << " ms, repair " << repair_ms/edits << " ms per edit ("
+		  << repaired/edits << " cells), " << field_mismatches << " cells differ from a rebuild over "
+		  << edits << " edits\n";
+
+	//3. the same queries as one batch on the service
+	PathService service(map, map_width, map_height, std::max(2u, std::thread::hardware_concurrency()));
+	t = clock::now();
+	AssetHandle<std::vector<PathResult>> batch = service.find_paths(queries);
+	const double submit_ms = ms_since(t);
+	std::vector<PathResult> results;
+	while(!batch.take(results)) std::this_thread::sleep_for(std::chrono::microseconds(100));
+	size_t batch_mismatches = 0;
+	for(size_t i=0; i<query_count; i++)
+		if(results[i].found != (reference[i] >= 0) ||
+		   (results[i].found && std::fabs(results[i].cost - reference[i]) > 1e-3f*std::max(1.f, reference[i])))
+			batch_mismatches++;
+	std::cout << "  service batch: caller busy " << submit_ms << " ms, answered after "
+		  << batch.status()->ready_ms << " ms, " << batch_mismatches << " lengths differ from A*\n";
+	return mismatches || field_mismatches || batch_mismatches ? 1 : 0;
+}
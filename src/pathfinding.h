@@ -0,0 +1,638 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include "assets.h"
+#include "workers.h"
+
+/*-------------------------------------
+Name: path_dx, path_dy, path_can_step
+Description: The eight moves on the map grid, straight ones first: direction d
+	steps by (path_dx[d], path_dy[d]) at a cost of 1, or the square root of
+	2 for the diagonals (d >= 4). path_reverse[d] is the opposite move.
+	path_can_step tells whether direction d is a legal move from cell x, y:
+	the target cell must be empty (' '), and a diagonal also needs both
+	cells beside it empty, so no path cuts the corner of a wall. A legal
+	move is legal in reverse as well.
+
+Purpose: The movement rules jump point search and the flow fields share.
+--------------------------------------*/
+constexpr int path_dx[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+constexpr int path_dy[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+constexpr uint8_t path_reverse[8] = {2, 3, 0, 1, 6, 7, 4, 5};
+constexpr uint8_t no_direction = 8;
+constexpr float path_diagonal = 1.41421356f;
+constexpr float path_unreachable = 1e30f;
+
+inline float path_step_cost(const size_t d){ return d < 4 ? 1.f : path_diagonal; }
+
+inline bool path_walkable(const char *map, const size_t map_width, const size_t map_height, const int x, const int y){
+	return x >= 0 && y >= 0 && size_t(x) < map_width && size_t(y) < map_height && map[x + y*map_width] == ' ';
+}
+
+inline bool path_can_step(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const int x,
+			const int y,
+			const size_t d){
+	if(!path_walkable(map, map_width, map_height, x + path_dx[d], y + path_dy[d])) return false;
+	return d < 4 || (path_walkable(map, map_width, map_height, x + path_dx[d], y) &&
+			 path_walkable(map, map_width, map_height, x, y + path_dy[d]));
+}
+
+//the distance with straight and diagonal moves, ignoring walls
+inline float octile_distance(const int x0, const int y0, const int x1, const int y1){
+	const int dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+	return std::max(dx, dy) + (path_diagonal - 1)*std::min(dx, dy);
+}
+
+
+/*-------------------------------------
+Name: PathScratch
+Description: The per-query state of a search, kept between queries: cost so
+	far and parent of every cell, valid only where stamp matches the current
+	query's generation (so a query does not clear the arrays), and the open
+	list as a binary heap. One per thread.
+
+Purpose: Makes a path query cost nothing beyond the cells it visits.
+--------------------------------------*/
+struct PathScratch {
+	std::vector<float> g;
+	std::vector<uint32_t> parent;
+	std::vector<uint32_t> stamp;
+	std::vector<uint32_t> closed;
+	std::vector<std::pair<float, uint32_t>> open;
+	uint32_t generation = 0;
+
+	void begin(const size_t cells){
+		if(stamp.size() != cells || generation == UINT32_MAX){
+			g.assign(cells, 0);
+			parent.assign(cells, 0);
+			stamp.assign(cells, 0);
+			closed.assign(cells, 0);
+			generation = 0;
+		}
+		generation++;
+		open.clear();
+	}
+	bool seen(const uint32_t cell) const { return stamp[cell] == generation; }
+	bool is_closed(const uint32_t cell) const { return closed[cell] == generation; }
+	void push(const float f, const uint32_t cell){
+		open.emplace_back(f, cell);
+		std::push_heap(open.begin(), open.end(), std::greater<std::pair<float, uint32_t>>());
+	}
+	uint32_t pop(){
+		std::pop_heap(open.begin(), open.end(), std::greater<std::pair<float, uint32_t>>());
+		const uint32_t cell = open.back().second;
+		open.pop_back();
+		return cell;
+	}
+};
+
+
+/*-------------------------------------
+Name: jps_jump
+Description: Steps from cell x, y in direction d until it reaches a jump
+	point: the goal, a cell with a forced neighbor (an empty cell beside
+	the line whose cell one step back is a wall, so a path may have to turn
+	there), or, going diagonally, a cell from which one of the two straight
+	directions making up the diagonal reaches a jump point. Returns that
+	cell, or -1 if a wall or the map edge comes first.
+
+Purpose: The pruned expansion of jump point search: the cells in between are
+	never put on the open list.
+--------------------------------------*/
+inline int64_t jps_jump(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			int x,
+			int y,
+			const size_t d,
+			const int goal_x,
+			const int goal_y){
+	const int dx = path_dx[d], dy = path_dy[d];
+	auto open = [&](const int cx, const int cy){ return path_walkable(map, map_width, map_height, cx, cy); };
+	while(true){
+		if(!path_can_step(map, map_width, map_height, x, y, d)) return -1;
+		x += dx;
+		y += dy;
+		const int64_t cell = x + int64_t(y)*map_width;
+		if(x == goal_x && y == goal_y) return cell;
+		if(dx && dy){
+			if(jps_jump(map, map_width, map_height, x, y, dx > 0 ? 0 : 2, goal_x, goal_y) >= 0 ||
+			   jps_jump(map, map_width, map_height, x, y, dy > 0 ? 1 : 3, goal_x, goal_y) >= 0)
+				return cell;
+		} else if(dx){
+			if((open(x, y - 1) && !open(x - dx, y - 1)) || (open(x, y + 1) && !open(x - dx, y + 1))) return cell;
+		} else {
+			if((open(x - 1, y) && !open(x - 1, y - dy)) || (open(x + 1, y) && !open(x + 1, y - dy))) return cell;
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: find_path
+Description: Jump point search from cell start to cell goal (indices into
+	the map) with the moves of path_can_step. On success fills waypoints
+	with the jump points from start to goal, both included, and cost with
+	the path length, and returns true; consecutive waypoints are joined by
+	a straight or a diagonal line. Returns false if either cell is a wall
+	or the goal cannot be reached. The path is as short as A* would find
+	on the same grid.
+
+Purpose: Single path queries, visiting a fraction of the cells A* would.
+--------------------------------------*/
+inline bool find_path(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const uint32_t start,
+			const uint32_t goal,
+			std::vector<uint32_t> &waypoints,
+			float &cost,
+			PathScratch &scratch){
+	waypoints.clear();
+	cost = 0;
+	const int goal_x = goal % map_width, goal_y = goal / map_width;
+	if(!path_walkable(map, map_width, map_height, start % map_width, start / map_width) ||
+	   !path_walkable(map, map_width, map_height, goal_x, goal_y))
+		return false;
+	scratch.begin(map_width*map_height);
+	scratch.g[start] = 0;
+	scratch.parent[start] = start;
+	scratch.stamp[start] = scratch.generation;
+	scratch.push(octile_distance(start % map_width, start / map_width, goal_x, goal_y), start);
+	bool found = false;
+	while(!scratch.open.empty()){
+		const uint32_t cell = scratch.pop();
+		if(scratch.is_closed(cell)) continue;
+		scratch.closed[cell] = scratch.generation;
+		if(cell == goal){
+			found = true;
+			break;
+		}
+		const int x = cell % map_width, y = cell / map_width;
+		//the directions worth jumping in, given the one we came from
+		size_t directions[8], count = 0;
+		if(cell == start){
+			for(size_t d=0; d<8; d++) directions[count++] = d;
+		} else {
+			const uint32_t parent = scratch.parent[cell];
+			const int dx = (x > int(parent % map_width)) - (x < int(parent % map_width));
+			const int dy = (y > int(parent / map_width)) - (y < int(parent / map_width));
+			auto direction_of = [](const int ddx, const int ddy) -> size_t {
+				for(size_t d=0; d<8; d++) if(path_dx[d] == ddx && path_dy[d] == ddy) return d;
+				return 0;
+			};
+			if(dx && dy){
+				directions[count++] = direction_of(dx, 0);
+				directions[count++] = direction_of(0, dy);
+				directions[count++] = direction_of(dx, dy);
+			} else if(dx){
+				directions[count++] = direction_of(dx, 0);
+				directions[count++] = direction_of(dx, 1);
+				directions[count++] = direction_of(dx, -1);
+				directions[count++] = direction_of(0, 1);
+				directions[count++] = direction_of(0, -1);
+			} else {
+				directions[count++] = direction_of(0, dy);
+				directions[count++] = direction_of(1, dy);
+				directions[count++] = direction_of(-1, dy);
+				directions[count++] = direction_of(1, 0);
+				directions[count++] = direction_of(-1, 0);
+			}
+		}
+		for(size_t k=0; k<count; k++){
+			const int64_t jump = jps_jump(map, map_width, map_height, x, y, directions[k], goal_x, goal_y);
+			if(jump < 0 || scratch.is_closed(uint32_t(jump))) continue;
+			const uint32_t next = uint32_t(jump);
+			const int nx = next % map_width, ny = next / map_width;
+			const float g = scratch.g[cell] + octile_distance(x, y, nx, ny);
+			if(scratch.seen(next) && g >= scratch.g[next]) continue;
+			scratch.g[next] = g;
+			scratch.parent[next] = cell;
+			scratch.stamp[next] = scratch.generation;
+			scratch.push(g + octile_distance(nx, ny, goal_x, goal_y), next);
+		}
+	}
+	if(!found) return false;
+	cost = scratch.g[goal];
+	for(uint32_t cell = goal; ; cell = scratch.parent[cell]){
+		waypoints.push_back(cell);
+		if(cell == start) break;
+	}
+	std::reverse(waypoints.begin(), waypoints.end());
+	return true;
+}
+
+
+/*-------------------------------------
+Name: FlowField, build_flow_field
+Description: Directions toward one target cell for the whole map. cost is
+	the integration field, the path length from every cell to the target
+	(path_unreachable for walls and cells that cannot reach it); direction
+	is the move to take from each cell, no_direction at the target and
+	where there is no way. open is the map as the field was last brought
+	up to date with, one byte per cell.
+
+	build_flow_field runs Dijkstra outward from the target with the moves
+	of path_can_step.
+
+Purpose: One field serves every agent heading to the same target: each only
+	looks up its own cell.
+--------------------------------------*/
+struct FlowField {
+	uint32_t target = 0;
+	size_t width = 0;
+	size_t height = 0;
+	std::vector<float> cost;
+	std::vector<uint8_t> direction;
+	std::vector<uint8_t> open;
+
+	bool valid() const { return !cost.empty(); }
+};
+
+typedef std::vector<std::pair<float, uint32_t>> FlowQueue;
+
+//Dijkstra from the cells in queue, lowering costs (and pointing directions
+//at the neighbor that lowered them) until nothing improves; returns the
+//cells lowered
+inline size_t flow_propagate(FlowField &field, const char *map, FlowQueue &queue){
+	const std::greater<std::pair<float, uint32_t>> later;
+	std::make_heap(queue.begin(), queue.end(), later);
+	size_t lowered = 0;
+	while(!queue.empty()){
+		std::pop_heap(queue.begin(), queue.end(), later);
+		const float c = queue.back().first;
+		const uint32_t cell = queue.back().second;
+		queue.pop_back();
+		if(c > field.cost[cell]) continue;
+		const int x = cell % field.width, y = cell / field.width;
+		for(size_t d=0; d<8; d++){
+			if(!path_can_step(map, field.width, field.height, x, y, d)) continue;
+			const uint32_t next = uint32_t(x + path_dx[d] + (y + path_dy[d])*field.width);
+			const float next_cost = c + path_step_cost(d);
+			if(next_cost >= field.cost[next]) continue;
+			field.cost[next] = next_cost;
+			field.direction[next] = path_reverse[d];
+			queue.emplace_back(next_cost, next);
+			std::push_heap(queue.begin(), queue.end(), later);
+			lowered++;
+		}
+	}
+	return lowered;
+}
+
+inline void build_flow_field(FlowField &field,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const uint32_t target){
+	field.target = target;
+	field.width = map_width;
+	field.height = map_height;
+	field.open.resize(map_width*map_height);
+	for(size_t i=0; i<field.open.size(); i++) field.open[i] = map[i] == ' ';
+	if(target >= field.open.size() || !field.open[target]){
+		field.cost.clear();
+		field.direction.clear();
+		return;
+	}
+	field.cost.assign(map_width*map_height, path_unreachable);
+	field.direction.assign(map_width*map_height, no_direction);
+	field.cost[target] = 0;
+	FlowQueue queue(1, {0.f, target});
+	flow_propagate(field, map, queue);
+}
+
+
+/*-------------------------------------
+Name: repair_flow_field
+Description: Brings a flow field up to date with the map after the cells
+	listed changed, without rebuilding it:
+
+	* Cells that became walls, and neighbors whose move became illegal
+	  (a diagonal past a new wall corner), lose their cost, and so does
+	  every cell whose directions lead through them: the subtree of the
+	  shortest-path tree, found by following the directions backward.
+	  Every other cost is still exact, since closing a cell only makes
+	  paths longer and theirs avoid it.
+	* Those cells, and every opened cell and its neighbors (whose diagonals
+	  may have become legal), are seeded with the best cost their
+	  neighbors offer, and Dijkstra lowers costs outward from the seeds
+	  until nothing improves.
+
+	The result matches build_flow_field on the new map. A field whose
+	target became a wall is cleared (valid() turns false). Returns the
+	number of cells whose cost was recomputed.
+
+Purpose: Keeps cached fields correct as doors open and walls go up, at a
+	cost proportional to the region that changed.
+--------------------------------------*/
+inline size_t repair_flow_field(FlowField &field, const char *map, const std::vector<uint32_t> &cells){
+	if(!field.valid()) return 0;
+	const size_t w = field.width, h = field.height;
+	std::vector<uint32_t> closed, opened;
+	for(uint32_t cell : cells){
+		const uint8_t now = map[cell] == ' ';
+		if(now == field.open[cell]) continue;
+		field.open[cell] = now;
+		(now ? opened : closed).push_back(cell);
+	}
+	if(!field.open[field.target]){
+		field.cost.clear();
+		field.direction.clear();
+		return 0;
+	}
+	if(closed.empty() && opened.empty()) return 0;
+
+	//cells whose path is gone: the closed ones, the ones whose move became
+	//illegal, and everything upstream of them
+	std::vector<uint32_t> affected;
+	std::vector<uint8_t> marked(w*h, 0);
+	auto neighbor = [&](const uint32_t cell, const size_t d, uint32_t &out){
+		const int x = cell % w + path_dx[d], y = cell / w + path_dy[d];
+		if(x < 0 || y < 0 || size_t(x) >= w || size_t(y) >= h) return false;
+		out = uint32_t(x + y*w);
+		return true;
+	};
+	auto mark = [&](const uint32_t cell){
+		if(marked[cell]) return;
+		marked[cell] = 1;
+		affected.push_back(cell);
+	};
+	for(uint32_t cell : closed){
+		mark(cell);
+		for(size_t d=0; d<8; d++){
+			uint32_t n;
+			if(!neighbor(cell, d, n) || field.direction[n] == no_direction) continue;
+			if(!path_can_step(map, w, h, n % w, n / w, field.direction[n])) mark(n);
+		}
+	}
+	for(size_t i=0; i<affected.size(); i++){
+		const uint32_t cell = affected[i];
+		for(size_t d=0; d<8; d++){
+			uint32_t n;
+			if(!neighbor(cell, d, n) || marked[n]) continue;
+			//n leads into cell if its direction is the reverse of d
+			if(field.direction[n] == path_reverse[d]) mark(n);
+		}
+	}
+	for(uint32_t cell : affected){
+		field.cost[cell] = path_unreachable;
+		field.direction[cell] = no_direction;
+	}
+
+	//seed what can be reached again, or sooner, from the cells around it
+	FlowQueue queue;
+	auto seed = [&](const uint32_t cell){
+		if(map[cell] != ' ' || cell == field.target) return;
+		for(size_t d=0; d<8; d++){
+			if(!path_can_step(map, w, h, cell % w, cell / w, d)) continue;
+			const uint32_t n = uint32_t(cell % w + path_dx[d] + (cell / w + path_dy[d])*w);
+			const float c = field.cost[n] + path_step_cost(d);
+			if(c >= field.cost[cell]) continue;
+			field.cost[cell] = c;
+			field.direction[cell] = uint8_t(d);
+		}
+		if(field.cost[cell] < path_unreachable) queue.emplace_back(field.cost[cell], cell);
+	};
+	for(uint32_t cell : affected) seed(cell);
+	for(uint32_t cell : opened){
+		seed(cell);
+		for(size_t d=0; d<8; d++){
+			uint32_t n;
+			if(neighbor(cell, d, n)) seed(n);
+		}
+	}
+	return affected.size() + flow_propagate(field, map, queue);
+}
+
+
+/*-------------------------------------
+Name: FlowFieldCache
+Description: The flow fields of the last capacity targets asked for, least
+	recently used first out. get returns the field for a target, building
+	it on a miss. apply_edits repairs every cached field for the changed
+	cells and drops those whose target became a wall. Fields are handed out
+	as shared pointers to const: a field someone still holds is copied
+	before it is repaired, so holders keep a consistent, if stale, field
+	until they ask again.
+
+Purpose: Shares one field among all agents with the same target, across
+	frames and across map edits.
+--------------------------------------*/
+class FlowFieldCache {
+public:
+	explicit FlowFieldCache(const size_t capacity = 8) : capacity(std::max<size_t>(capacity, 1)) {}
+
+	std::shared_ptr<const FlowField> get(const char *map,
+					const size_t map_width,
+					const size_t map_height,
+					const uint32_t target){
+		for(size_t i=0; i<fields.size(); i++){
+			if(fields[i]->target != target) continue;
+			std::rotate(fields.begin() + i, fields.begin() + i + 1, fields.end());
+			hits++;
+			return fields.back();
+		}
+		std::shared_ptr<FlowField> field = std::make_shared<FlowField>();
+		build_flow_field(*field, map, map_width, map_height, target);
+		builds++;
+		if(!field->valid()) return field;
+		if(fields.size() == capacity) fields.erase(fields.begin());
+		fields.push_back(field);
+		return field;
+	}
+
+	//returns the cells recomputed over all fields
+	size_t apply_edits(const char *map, const std::vector<uint32_t> &cells){
+		size_t repaired = 0;
+		for(size_t i=0; i<fields.size();){
+			std::shared_ptr<FlowField> field = fields[i].use_count() == 1 ?
+				std::const_pointer_cast<FlowField>(fields[i]) : std::make_shared<FlowField>(*fields[i]);
+			repaired += repair_flow_field(*field, map, cells);
+			if(!field->valid()){
+				fields.erase(fields.begin() + i);
+				continue;
+			}
+			fields[i++] = field;
+		}
+		return repaired;
+	}
+
+	size_t size() const { return fields.size(); }
+	size_t hits = 0;
+	size_t builds = 0;
+
+private:
+	size_t capacity;
+	std::vector<std::shared_ptr<const FlowField>> fields;
+};
+
+
+/*-------------------------------------
+Name: PathQuery, PathResult, PathService
+Description: Pathfinding off the frame loop. The service keeps its own copy
+	of the map and a FlowFieldCache, owned by one service thread, and
+	answers requests in order:
+
+	* find_paths takes a batch of start/goal queries and runs find_path
+	  on them in parallel chunks on its TileWorkers.
+	* flow_field returns the cached or newly built field for a target.
+
+	Both return at once with an AssetHandle that the frame loop polls, as
+	for a loading asset (decode_ms is the compute time). map_changed hands
+	over the new contents of cells edited on the main thread; the service
+	thread copies them into its map and repairs its fields before the next
+	request, so a request made after an edit sees it.
+
+Purpose: Lets every actor ask for paths without the render loop ever
+	waiting on a search.
+--------------------------------------*/
+struct PathQuery {
+	uint32_t start = 0;
+	uint32_t goal = 0;
+};
+
+struct PathResult {
+	bool found = false;
+	float cost = 0;
+	std::vector<uint32_t> waypoints;
+};
+
+class PathService {
+public:
+	PathService(const std::string &map, const size_t map_width, const size_t map_height,
+		    const size_t threads = 2, const size_t field_capacity = 8)
+		: map(map), map_width(map_width), map_height(map_height), workers(threads), fields(field_capacity){
+		thread = std::thread([this](){ serve(); });
+	}
+	~PathService(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+			for(auto &job : jobs) job.status->state.store(AssetState::failed, std::memory_order_release);
+		}
+		ready.notify_all();
+		thread.join();
+	}
+	PathService(const PathService&) = delete;
+	PathService &operator=(const PathService&) = delete;
+
+	void map_changed(const std::string &new_map, const std::vector<uint32_t> &cells){
+		std::lock_guard<std::mutex> lock(mutex);
+		for(uint32_t cell : cells) edits.emplace_back(cell, new_map[cell]);
+	}
+
+	AssetHandle<std::vector<PathResult>> find_paths(std::vector<PathQuery> queries){
+		std::shared_ptr<AssetSlot<std::vector<PathResult>>> slot = std::make_shared<AssetSlot<std::vector<PathResult>>>();
+		slot->name = "paths";
+		AssetSlot<std::vector<PathResult>> *target = slot.get();
+		submit(slot, [this, target, queries = std::move(queries)](){
+			std::vector<PathResult> &results = target->value;
+			results.resize(queries.size());
+			const size_t chunk = 64;
+			workers.run((queries.size() + chunk - 1)/chunk, [&](const size_t c){
+				static thread_local PathScratch scratch;
+				const size_t end = std::min(queries.size(), (c + 1)*chunk);
+				for(size_t i=c*chunk; i<end; i++)
+					results[i].found = find_path(map.data(), map_width, map_height, queries[i].start,
+								     queries[i].goal, results[i].waypoints, results[i].cost, scratch);
+			});
+			return true;
+		});
+		return AssetHandle<std::vector<PathResult>>(slot);
+	}
+
+	AssetHandle<std::shared_ptr<const FlowField>> flow_field(const uint32_t target_cell){
+		typedef std::shared_ptr<const FlowField> Field;
+		std::shared_ptr<AssetSlot<Field>> slot = std::make_shared<AssetSlot<Field>>();
+		slot->name = "flow field";
+		AssetSlot<Field> *target = slot.get();
+		submit(slot, [this, target, target_cell](){
+			target->value = fields.get(map.data(), map_width, map_height, target_cell);
+			return target->value->valid();
+		});
+		return AssetHandle<Field>(slot);
+	}
+
+	//requests not yet answered
+	size_t pending() const { return in_flight.load(); }
+
+private:
+	struct Job {
+		std::shared_ptr<AssetStatus> status;
+		std::function<bool()> run;
+		std::chrono::steady_clock::time_point requested;
+	};
+
+	void submit(std::shared_ptr<AssetStatus> status, std::function<bool()> run){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({status, std::move(run), std::chrono::steady_clock::now()});
+			in_flight++;
+		}
+		ready.notify_one();
+	}
+
+	void serve(){
+		typedef std::chrono::steady_clock clock;
+		std::vector<std::pair<uint32_t, char>> changes;
+		std::vector<uint32_t> changed_cells;
+		while(true){
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready.wait(lock, [this](){ return quit || !jobs.empty(); });
+				if(quit) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				changes.swap(edits);
+			}
+			if(!changes.empty()){
+				changed_cells.clear();
+				for(const auto &change : changes){
+					map[change.first] = change.second;
+					changed_cells.push_back(change.first);
+				}
+				fields.apply_edits(map.data(), changed_cells);
+				changes.clear();
+			}
+			const auto start = clock::now();
+			const bool ok = job.run();
+			job.status->decode_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			job.status->ready_ms = std::chrono::duration<double, std::milli>(clock::now() - job.requested).count();
+			job.status->state.store(ok ? AssetState::ready : AssetState::failed, std::memory_order_release);
+			in_flight--;
+		}
+	}
+
+	std::string map;
+	const size_t map_width, map_height;
+	TileWorkers workers;
+	FlowFieldCache fields;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<Job> jobs;
+	std::vector<std::pair<uint32_t, char>> edits;
+	std::atomic<size_t> in_flight{0};
+	bool quit = false;
+};
+
+#endif
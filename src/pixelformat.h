@@ -0,0 +1,233 @@
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*-------------------------------------
+Name: FormatARGB8888, FormatABGR8888
+Description: Compile-time tags describing how the four 8-bit channels are laid
+	out inside a packed uint32_t pixel. The shifts give each channel's bit
+	position; on a little-endian machine shift/8 is also the byte offset of
+	the channel in memory. ARGB8888 has blue in the lowest byte and matches
+	SDL_PIXELFORMAT_ARGB8888; ABGR8888 has red in the lowest byte and matches
+	SDL_PIXELFORMAT_ABGR8888.
+
+Purpose: Every packing, unpacking and bulk conversion is written once against
+	a tag, so the live view and exported images can never disagree about
+	where red and blue are.
+--------------------------------------*/
+struct FormatARGB8888 {
+	static constexpr int r_shift = 16;
+	static constexpr int g_shift = 8;
+	static constexpr int b_shift = 0;
+	static constexpr int a_shift = 24;
+};
+
+struct FormatABGR8888 {
+	static constexpr int r_shift = 0;
+	static constexpr int g_shift = 8;
+	static constexpr int b_shift = 16;
+	static constexpr int a_shift = 24;
+};
+
+//The format of the renderer's framebuffer, shared by the SDL texture
+typedef FormatARGB8888 FramebufferFormat;
+
+
+/*-------------------------------------
+Name: pack_pixel, unpack_pixel
+Description: Pack separate RGBA components into a 32-bit pixel of the given
+	format, and split such a pixel back into its components.
+
+Purpose: The single definition of the channel layout for per-pixel code.
+--------------------------------------*/
+template<typename Format>
+constexpr uint32_t pack_pixel(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a=255){
+	return (uint32_t(a) << Format::a_shift) | (uint32_t(r) << Format::r_shift) |
+	       (uint32_t(g) << Format::g_shift) | (uint32_t(b) << Format::b_shift);
+}
+
+template<typename Format>
+inline void unpack_pixel(const uint32_t color, uint8_t &r, uint8_t &g, uint8_t &b, uint8_t &a){
+	r = (color >> Format::r_shift) & 255;
+	g = (color >> Format::g_shift) & 255;
+	b = (color >> Format::b_shift) & 255;
+	a = (color >> Format::a_shift) & 255;
+}
+
+
+/*-------------------------------------
+Name: packcolor
+Description: This function packs separate RGBA components into a single 32-bit integer
+	in the framebuffer's format (ARGB, alpha in the highest byte and blue in the
+	lowest byte).
+
+Purpose: This renderer builds a 2d array of pixels into an image in in memory, saving
+	or writing out to an image file or displaying to the screen is done per pixel,
+	usually a single uint32_t and often using formats (e.g. BMP, PNG, PPM) that
+	expect packed pixels
+--------------------------------------*/
+constexpr uint32_t packcolor(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a=255){
+	return pack_pixel<FramebufferFormat>(r, g, b, a);
+}
+
+
+/*-------------------------------------
+Name: unpack_color
+Description: This function separates a framebuffer pixel into 4 RGBA components
+	stored with 8-bit integers. It is the inverse of packcolor.
+
+Purpose: This is useful when needing to modify, inspect, or output individual
+	color components from a packed pixel. For example, when applying
+	image effects or blending. Whole images should go through the bulk
+	converters below instead.
+--------------------------------------*/
+inline void unpack_color(const uint32_t &color, uint8_t &r, uint8_t &g, uint8_t &b, uint8_t &a){
+	unpack_pixel<FramebufferFormat>(color, r, g, b, a);
+}
+
+
+/*-------------------------------------
+Name: convert_to_rgb24
+Description: Converts count packed pixels of the given format into tightly packed
+	R, G, B bytes (3 bytes per pixel), dropping alpha. Uses SSSE3 byte
+	shuffles (16 pixels per iteration) or NEON de-interleaving loads when the
+	compiler targets them, with a scalar loop for the remainder.
+
+Purpose: Exporting (PPM and similar) needs RGB24. Doing it in bulk keeps the
+	conversion limited by memory bandwidth rather than by per-pixel calls.
+--------------------------------------*/
+template<typename Format>
+void convert_to_rgb24(const uint32_t *src, uint8_t *dst, const size_t count){
+	constexpr int r = Format::r_shift/8, g = Format::g_shift/8, b = Format::b_shift/8;
+	size_t i = 0;
+#if defined(__SSSE3__)
+	const __m128i shuffle = _mm_setr_epi8(r, g, b, 4+r, 4+g, 4+b, 8+r, 8+g, 8+b,
+					      12+r, 12+g, 12+b, -1, -1, -1, -1);
+	for(; i + 16 <= count; i += 16){
+		const __m128i *in = reinterpret_cast<const __m128i*>(src + i);
+		__m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128(in + 0), shuffle);
+		__m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), shuffle);
+		__m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), shuffle);
+		__m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), shuffle);
+		__m128i *out = reinterpret_cast<__m128i*>(dst + 3*i);
+		_mm_storeu_si128(out + 0, _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+		_mm_storeu_si128(out + 1, _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+		_mm_storeu_si128(out + 2, _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+	}
+#elif defined(__ARM_NEON)
+	for(; i + 16 <= count; i += 16){
+		uint8x16x4_t in = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+		uint8x16x3_t out;
+		out.val[0] = in.val[r];
+		out.val[1] = in.val[g];
+		out.val[2] = in.val[b];
+		vst3q_u8(dst + 3*i, out);
+	}
+#endif
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>(src);
+	for(; i < count; i++){
+		dst[3*i + 0] = bytes[4*i + r];
+		dst[3*i + 1] = bytes[4*i + g];
+		dst[3*i + 2] = bytes[4*i + b];
+	}
+}
+
+
+/*-------------------------------------
+Name: convert_to_rgba
+Description: Converts count packed pixels of the given format into R, G, B, A
+	bytes in memory order (4 bytes per pixel), which is also a uint32_t in
+	FormatABGR8888 on little-endian machines. Same SIMD paths as
+	convert_to_rgb24.
+
+Purpose: Most upload paths outside SDL (and image libraries) expect RGBA byte
+	order, and swapping red and blue between the two packed formats is the
+	same operation.
+--------------------------------------*/
+template<typename Format>
+void convert_to_rgba(const uint32_t *src, uint8_t *dst, const size_t count){
+	constexpr int r = Format::r_shift/8, g = Format::g_shift/8;
+	constexpr int b = Format::b_shift/8, a = Format::a_shift/8;
+	size_t i = 0;
+#if defined(__SSSE3__)
+	const __m128i shuffle = _mm_setr_epi8(r, g, b, a, 4+r, 4+g, 4+b, 4+a,
+					      8+r, 8+g, 8+b, 8+a, 12+r, 12+g, 12+b, 12+a);
+	for(; i + 4 <= count; i += 4){
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4*i), _mm_shuffle_epi8(p, shuffle));
+	}
+#elif defined(__ARM_NEON)
+	for(; i + 16 <= count; i += 16){
+		uint8x16x4_t in = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+		uint8x16x4_t out;
+		out.val[0] = in.val[r];
+		out.val[1] = in.val[g];
+		out.val[2] = in.val[b];
+		out.val[3] = in.val[a];
+		vst4q_u8(dst + 4*i, out);
+	}
+#endif
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>(src);
+	for(; i < count; i++){
+		dst[4*i + 0] = bytes[4*i + r];
+		dst[4*i + 1] = bytes[4*i + g];
+		dst[4*i + 2] = bytes[4*i + b];
+		dst[4*i + 3] = bytes[4*i + a];
+	}
+}
+
+
+/*-------------------------------------
+Name: write_ppm_rgb
+Description: Writes an image that is already RGB24 to a binary PPM file with a
+	single write.
+
+Purpose: The output half of drop_ppm_image, for callers that convert into a
+	buffer of their own (such as a frame arena).
+--------------------------------------*/
+inline void write_ppm_rgb(const std::string filename,
+			const uint8_t *rgb,
+			const size_t width,
+			const size_t height){
+	std::ofstream ofs(filename, std::ios::binary);
+	ofs << "P6\n" << width << " " << height << "\n255\n";
+	ofs.write(reinterpret_cast<const char*>(rgb), width*height*3);
+	ofs.close();
+}
+
+
+/*-------------------------------------
+Name: drop_ppm_image
+Description: Takes a filename, size variables, and a 2d image represented by a
+	flattened 1D of packed 32-bit framebuffer pixels. The image is converted to
+	RGB24 in one bulk pass and written to a PPM image file with a single write.
+
+Purpose: To export the renderer's pixel buffer as a standard image file. The PPM
+	(Portable Pixmap) format is simple and widely supported, making it
+	useful for debugging or viewing output without needing external image
+	libraries.
+--------------------------------------*/
+inline void drop_ppm_image(const std::string filename,
+			const std::vector<uint32_t> &image,
+			const size_t width,
+			const size_t height){
+	assert(image.size() == width *height);
+	std::vector<uint8_t> rgb(width*height*3);
+	convert_to_rgb24<FramebufferFormat>(image.data(), rgb.data(), width*height);
+	write_ppm_rgb(filename, rgb.data(), width, height);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include "pixelformat.h"
+
+/*-------------------------------------
+Name: per_pixel_rgb24
+Description: The conversion drop_ppm_image used to do, one unpack_pixel call per
+	pixel.
+
+Purpose: Baseline for the bulk converters, and the reference their output is
+	checked against.
+--------------------------------------*/
+template<typename Format>
+void per_pixel_rgb24(const std::vector<uint32_t> &image, std::vector<uint8_t> &rgb){
+	for(size_t i=0; i<image.size(); i++){
+		uint8_t r, g, b, a;
+		unpack_pixel<Format>(image[i], r, g, b, a);
+		rgb[3*i + 0] = r;
+		rgb[3*i + 1] = g;
+		rgb[3*i + 2] = b;
+	}
+}
+
+
+/*-------------------------------------
+Name: check_format
+Description: Converts random pixels of one format to RGB24 and RGBA and compares
+	the results against unpack_pixel, including a count that is not a
+	multiple of the SIMD width.
+
+Purpose: Makes sure both byte orders take the same path through the SIMD and
+	scalar code.
+--------------------------------------*/
+template<typename Format>
+void check_format(const char *name){
+	std::mt19937 rng(7);
+	std::vector<uint32_t> image(1027);
+	for(uint32_t &p : image) p = rng();
+	std::vector<uint8_t> rgb(image.size()*3), expected(image.size()*3), rgba(image.size()*4);
+	convert_to_rgb24<Format>(image.data(), rgb.data(), image.size());
+	convert_to_rgba<Format>(image.data(), rgba.data(), image.size());
+	per_pixel_rgb24<Format>(image, expected);
+	assert(rgb == expected);
+	for(size_t i=0; i<image.size(); i++){
+		uint8_t r, g, b, a;
+		unpack_pixel<Format>(image[i], r, g, b, a);
+		assert(rgba[4*i] == r && rgba[4*i+1] == g && rgba[4*i+2] == b && rgba[4*i+3] == a);
+	}
+	assert(pack_pixel<Format>(1, 2, 3, 4) != pack_pixel<Format>(3, 2, 1, 4));
+	std::cout << name << " conversions match unpack_pixel\n";
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Checks both formats, then times per-pixel unpacking against the
+	bulk RGB24 and RGBA converters on a 1920x1080 frame and reports the
+	throughput in GB/s of source pixels.
+
+Purpose: Shows the bulk path is bound by memory bandwidth, not per-pixel
+	work. Build with -march=native (or -mssse3) to enable the SIMD path on
+	x86; arm64 uses NEON by default.
+--------------------------------------*/
+int main(){
+	check_format<FormatARGB8888>("ARGB8888");
+	check_format<FormatABGR8888>("ABGR8888");
+
+	typedef std::chrono::steady_clock clock;
+	const size_t width = 1920, height = 1080;
+	const int iterations = 50;
+	std::vector<uint32_t> image(width*height);
+	for(size_t i=0; i<image.size(); i++) image[i] = uint32_t(i*2654435761u);
+	std::vector<uint8_t> rgb(image.size()*3), rgba(image.size()*4);
+
+	auto report = [&](const char *name, double seconds){
+		double bytes = double(image.size())*4*iterations;
+		std::cout << name << "\t" << seconds*1000/iterations << " ms/frame\t"
+			  << bytes/seconds/1e9 << " GB/s\n";
+	};
+	auto t0 = clock::now();
+	for(int k=0; k<iterations; k++) per_pixel_rgb24<FramebufferFormat>(image, rgb);
+	auto t1 = clock::now();
+	for(int k=0; k<iterations; k++) convert_to_rgb24<FramebufferFormat>(image.data(), rgb.data(), image.size());
+	auto t2 = clock::now();
+	for(int k=0; k<iterations; k++) convert_to_rgba<FramebufferFormat>(image.data(), rgba.data(), image.size());
+	auto t3 = clock::now();
+	report("per pixel rgb24", std::chrono::duration<double>(t1-t0).count());
+	report("bulk rgb24     ", std::chrono::duration<double>(t2-t1).count());
+	report("bulk rgba      ", std::chrono::duration<double>(t3-t2).count());
+	return 0;
+}
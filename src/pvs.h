@@ -0,0 +1,552 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "visibility.h"
+#include "mapfile.h"
+
+/*-------------------------------------
+Name: PvsTable
+Description: A potentially visible set for a static map. The map is split into
+	square clusters of cluster_size x cluster_size cells (cluster_size 1 means
+	one entry per cell). For every cluster, entries holds the offset and length
+	of a run-length encoded list of the clusters that can be seen from
+	anywhere inside it. The encoding is a sequence of varint pairs (gap, run):
+	skip gap clusters, then run clusters are visible, with cluster indices in
+	row-major order. Identical lists are stored once and shared.
+
+Purpose: Turns "what can be seen from here" into a table lookup at runtime.
+	The run-length lists stay small because visible regions are made of long
+	horizontal spans, and clustering trades precision for size on very large
+	maps.
+--------------------------------------*/
+struct PvsEntry {
+	uint64_t offset;
+	uint32_t length;
+};
+
+struct PvsTable {
+	size_t map_width = 0;
+	size_t map_height = 0;
+	size_t cluster_size = 1;
+	size_t clusters_x = 0;
+	size_t clusters_y = 0;
+	uint64_t map_hash = 0;
+	std::vector<PvsEntry> entries;
+	std::vector<uint8_t> data;
+
+	bool empty() const { return entries.empty(); }
+	size_t cluster_of(const size_t x, const size_t y) const {
+		return x/cluster_size + (y/cluster_size)*clusters_x;
+	}
+};
+
+
+/*-------------------------------------
+Name: put_varint, get_varint
+Description: LEB128 style variable length integers, seven bits per byte with the
+	high bit set on every byte except the last.
+
+	get_varint reads only up to end, and returns false, with p left where
+	it was, on a varint cut short or longer than ten bytes.
+
+Purpose: Most gaps and runs in a PVS list are small, so they fit in a single
+	byte.
+--------------------------------------*/
+inline void put_varint(std::vector<uint8_t> &out, uint64_t value){
+	while(value >= 0x80){
+		out.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+	out.push_back(uint8_t(value));
+}
+
+inline bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value){
+	uint64_t result = 0;
+	const uint8_t *q = p;
+	for(int shift=0; shift<70; shift+=7){
+		if(q >= end) return false;
+		const uint8_t byte = *q++;
+		result |= uint64_t(byte & 0x7f) << shift;
+		if(!(byte & 0x80)){
+			value = result;
+			p = q;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*-------------------------------------
+Name: encode_cluster_list
+Description: Sorts a list of visible cluster indices, drops duplicates and
+	appends it to out as (gap, run) varint pairs.
+
+Purpose: Shared by the builder for every cluster.
+--------------------------------------*/
+inline void encode_cluster_list(std::vector<uint32_t> &clusters, std::vector<uint8_t> &out){
+	std::sort(clusters.begin(), clusters.end());
+	clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+	uint64_t next = 0;
+	size_t i = 0;
+	while(i < clusters.size()){
+		size_t j = i + 1;
+		while(j < clusters.size() && clusters[j] == clusters[j-1] + 1) j++;
+		put_varint(out, clusters[i] - next);
+		put_varint(out, j - i);
+		next = uint64_t(clusters[j-1]) + 1;
+		i = j;
+	}
+}
+
+
+/*-------------------------------------
+Name: collect_cluster_pvs
+Description: Collects the clusters visible from cluster c into seen, unsorted
+	and without duplicates. Visibility from anywhere inside the cluster is
+	taken from the borders of its empty cells: a line of sight from a point
+	inside a cell leaves it through its border, and the rest of that line
+	is a line of sight from the border point. So each empty cell is
+	shadowcast from its center and from pvs_border_samples + 1 points
+	along every edge that opens onto another empty cell (a line leaving
+	through an edge onto a wall sees only that wall, which the other
+	samples see too), and the results are merged; a cluster with no empty
+	cell sees nothing.
+
+	What remains approximate is the spacing of the border samples: a cell
+	seen only along lines that pass between two neighboring samples and
+	then through a gap narrower than the spacing can be missed. The
+	shadowcaster widens every beam to whole cells, which covers most of
+	those, and pvs_build checks a table against random viewpoints.
+
+	stamp must hold one entry per cluster, and must not already hold the
+	value c for any of them; UINT32_MAX is a safe fill.
+
+Purpose: The work for a single cluster, shared by build_pvs and by the
+	incremental update after a map edit.
+--------------------------------------*/
+constexpr size_t pvs_border_samples = 8;
+
+inline void collect_cluster_pvs(const PvsTable &pvs,
+				const char *map,
+				const size_t c,
+				const size_t max_distance,
+				std::vector<uint32_t> &stamp,
+				std::vector<uint32_t> &seen){
+	seen.clear();
+	const size_t x0 = (c % pvs.clusters_x)*pvs.cluster_size;
+	const size_t y0 = (c / pvs.clusters_x)*pvs.cluster_size;
+	auto mark = [&](size_t x, size_t y){
+		const uint32_t target = pvs.cluster_of(x, y);
+		if(stamp[target] == uint32_t(c)) return;
+		stamp[target] = uint32_t(c);
+		seen.push_back(target);
+	};
+	for(size_t y = y0; y < std::min(y0 + pvs.cluster_size, pvs.map_height); y++){
+		for(size_t x = x0; x < std::min(x0 + pvs.cluster_size, pvs.map_width); x++){
+			if(map[x + y*pvs.map_width] != ' ') continue;
+			auto open = [&](const long nx, const long ny){
+				return nx >= 0 && ny >= 0 && size_t(nx) < pvs.map_width && size_t(ny) < pvs.map_height &&
+					map[nx + ny*pvs.map_width] == ' ';
+			};
+			auto cast = [&](const float sx, const float sy){
+				for_each_visible_cell(map, pvs.map_width, pvs.map_height,
+					x + sx, y + sy, mark, ViewCone(), max_distance);
+			};
+			//inset so every sample stays inside the cell
+			const float inset = .001f;
+			const bool west = open(long(x) - 1, y), east = open(x + 1, y);
+			const bool north = open(x, long(y) - 1), south = open(x, y + 1);
+			cast(.5f, .5f);
+			for(size_t k=0; k<=pvs_border_samples; k++){
+				const float t = std::min(std::max(float(k)/pvs_border_samples, inset), 1 - inset);
+				if(north) cast(t, inset);
+				if(south) cast(t, 1 - inset);
+				if(west) cast(inset, t);
+				if(east) cast(1 - inset, t);
+			}
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: build_pvs
+Description: Computes the PVS for every cluster of the map with
+	collect_cluster_pvs. max_distance (0 for no limit) bounds the shadowcast
+	radius. Clusters are handed out to
+	thread_count workers through an atomic counter; each worker keeps a
+	stamp array so no per-sample bitset has to be cleared.
+
+Purpose: The offline step behind the PVS. It is embarrassingly parallel, so
+	build time scales with the number of cores.
+--------------------------------------*/
+inline PvsTable build_pvs(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const size_t cluster_size = 1,
+			const size_t max_distance = 0,
+			size_t thread_count = 0){
+	PvsTable pvs;
+	pvs.map_width = map_width;
+	pvs.map_height = map_height;
+	pvs.cluster_size = std::max<size_t>(cluster_size, 1);
+	pvs.clusters_x = (map_width + pvs.cluster_size - 1)/pvs.cluster_size;
+	pvs.clusters_y = (map_height + pvs.cluster_size - 1)/pvs.cluster_size;
+	pvs.map_hash = map_hash(map, map_width, map_height);
+
+	const size_t cluster_count = pvs.clusters_x*pvs.clusters_y;
+	std::vector<std::vector<uint8_t>> lists(cluster_count);
+	std::atomic<size_t> next_cluster(0);
+	if(thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	auto worker = [&](){
+		std::vector<uint32_t> stamp(cluster_count, UINT32_MAX);
+		std::vector<uint32_t> seen;
+		for(size_t c = next_cluster++; c < cluster_count; c = next_cluster++){
+			collect_cluster_pvs(pvs, map, c, max_distance, stamp, seen);
+			encode_cluster_list(seen, lists[c]);
+		}
+	};
+	std::vector<std::thread> threads;
+	for(size_t t=0; t<thread_count; t++) threads.emplace_back(worker);
+	for(std::thread &t : threads) t.join();
+
+	//pack the lists, sharing storage between identical ones
+	std::unordered_map<std::string, size_t> shared;
+	pvs.entries.resize(cluster_count);
+	for(size_t c=0; c<cluster_count; c++){
+		std::string key(lists[c].begin(), lists[c].end());
+		auto found = shared.find(key);
+		if(found == shared.end()){
+			found = shared.emplace(key, pvs.data.size()).first;
+			pvs.data.insert(pvs.data.end(), lists[c].begin(), lists[c].end());
+		}
+		pvs.entries[c] = {found->second, uint32_t(lists[c].size())};
+		std::vector<uint8_t>().swap(lists[c]);
+	}
+	return pvs;
+}
+
+
+/*-------------------------------------
+Name: pvs_can_see
+Description: Returns true if the cluster holding cell (to_x, to_y) is in the
+	PVS of the cluster holding cell (from_x, from_y). Walks the run list of
+	the source cluster and stops as soon as it passes the target.
+
+Purpose: The runtime query for culling and entity updates: one lookup and a
+	short scan instead of a visibility traversal.
+--------------------------------------*/
+inline bool pvs_can_see(const PvsTable &pvs,
+			const size_t from_x, const size_t from_y,
+			const size_t to_x, const size_t to_y){
+	const PvsEntry &entry = pvs.entries[pvs.cluster_of(from_x, from_y)];
+	const uint64_t target = pvs.cluster_of(to_x, to_y);
+	const uint8_t *p = pvs.data.data() + entry.offset;
+	const uint8_t *end = p + entry.length;
+	uint64_t position = 0, gap, run;
+	while(get_varint(p, end, gap) && get_varint(p, end, run)){
+		position += gap;
+		if(target < position) return false;
+		position += run;
+		if(target < position) return true;
+	}
+	return false;
+}
+
+
+/*-------------------------------------
+Name: pvs_decode
+Description: Expands the PVS of the cluster holding cell (x, y) into a per-cell
+	bitset, setting every cell of every visible cluster.
+
+Purpose: For callers that test many cells against the same source, such as
+	the minimap.
+--------------------------------------*/
+inline void pvs_decode(const PvsTable &pvs, const size_t x, const size_t y, CellBitset &visible){
+	visible.resize(pvs.map_width, pvs.map_height);
+	const PvsEntry &entry = pvs.entries[pvs.cluster_of(x, y)];
+	const uint8_t *p = pvs.data.data() + entry.offset;
+	const uint8_t *end = p + entry.length;
+	uint64_t position = 0, gap, run;
+	while(get_varint(p, end, gap) && get_varint(p, end, run)){
+		position += gap;
+		for(uint64_t c = position; c < position + run; c++){
+			const size_t cx0 = (c % pvs.clusters_x)*pvs.cluster_size;
+			const size_t cy0 = (c / pvs.clusters_x)*pvs.cluster_size;
+			for(size_t cy = cy0; cy < std::min(cy0 + pvs.cluster_size, pvs.map_height); cy++)
+				for(size_t cx = cx0; cx < std::min(cx0 + pvs.cluster_size, pvs.map_width); cx++)
+					visible.set(cx, cy);
+		}
+		position += run;
+	}
+}
+
+
+/*-------------------------------------
+Name: compact_pvs
+Description: Rewrites data with only the bytes the entries point to, in the
+	order they appear, keeping identical lists shared as the builder leaves
+	them.
+
+Purpose: Drops the lists pvs_open_cell replaced.
+--------------------------------------*/
+inline void compact_pvs(PvsTable &pvs){
+	std::vector<uint32_t> order(pvs.entries.size());
+	for(size_t c=0; c<order.size(); c++) order[c] = uint32_t(c);
+	std::sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b){
+		return pvs.entries[a].offset < pvs.entries[b].offset ||
+		       (pvs.entries[a].offset == pvs.entries[b].offset && pvs.entries[a].length < pvs.entries[b].length);
+	});
+	std::vector<uint8_t> data;
+	uint64_t last_offset = UINT64_MAX, placed = 0;
+	uint32_t last_length = 0;
+	for(const uint32_t c : order){
+		PvsEntry &entry = pvs.entries[c];
+		if(entry.offset != last_offset || entry.length != last_length){
+			last_offset = entry.offset;
+			last_length = entry.length;
+			placed = data.size();
+			data.insert(data.end(), pvs.data.begin() + entry.offset, pvs.data.begin() + entry.offset + entry.length);
+		}
+		entry.offset = placed;
+	}
+	pvs.data.swap(data);
+}
+
+
+/*-------------------------------------
+Name: pvs_open_cell
+Description: Updates the PVS after map cell (x, y) changed from a wall to empty,
+	for a door opening or a wall being knocked out. The cell's own cluster
+	is recomputed, and every cluster that could see the cell now also gets
+	everything visible from the cell, since anything newly visible through
+	the gap is visible from the gap itself. That is the same sampling bound
+	the builder uses, so the update is conservative, and it costs a single
+	cluster of shadowcasting plus a merge of run lists for each cluster in
+	range that saw the cell.
+
+	max_distance should be the one the table was built with; 0 is always
+	safe. Changed lists are appended to data and the old bytes are left in
+	place until data is more than twice the lists in use, when compact_pvs
+	drops them, so opening cells one after another cannot grow the table
+	without bound. A cell changing from empty to a wall
+	needs no update at all, because the existing sets stay a superset of
+	what can be seen. map_hash keeps naming the map the table was built
+	from.
+
+Purpose: Keeps culling correct when doors open, at the cost of one cluster
+	instead of a rebuild. Returns the number of lists that changed.
+--------------------------------------*/
+inline size_t pvs_open_cell(PvsTable &pvs,
+			const char *map,
+			const size_t x,
+			const size_t y,
+			const size_t max_distance = 0){
+	if(pvs.empty()) return 0;
+	const size_t cluster_count = pvs.clusters_x*pvs.clusters_y;
+	static thread_local std::vector<uint32_t> stamp;
+	if(stamp.size() != cluster_count) stamp.assign(cluster_count, UINT32_MAX);
+	std::vector<uint32_t> opened;
+	std::vector<std::pair<uint64_t, uint64_t>> opened_runs, runs, merged;
+	std::vector<uint8_t> encoded;
+
+	//decodes and encodes lists as [begin, end) runs of cluster indices
+	auto decode_runs = [&](const PvsEntry &entry, std::vector<std::pair<uint64_t, uint64_t>> &out){
+		out.clear();
+		const uint8_t *p = pvs.data.data() + entry.offset;
+		const uint8_t *end = p + entry.length;
+		uint64_t position = 0, gap, run;
+		while(get_varint(p, end, gap) && get_varint(p, end, run)){
+			position += gap;
+			out.emplace_back(position, position + run);
+			position += run;
+		}
+	};
+	auto store_runs = [&](const size_t c, const std::vector<std::pair<uint64_t, uint64_t>> &in){
+		encoded.clear();
+		uint64_t next = 0;
+		for(const auto &run : in){
+			put_varint(encoded, run.first - next);
+			put_varint(encoded, run.second - run.first);
+			next = run.second;
+		}
+		pvs.entries[c] = {pvs.data.size(), uint32_t(encoded.size())};
+		pvs.data.insert(pvs.data.end(), encoded.begin(), encoded.end());
+	};
+
+	//everything visible from the cluster holding the gap
+	const size_t target = pvs.cluster_of(x, y);
+	collect_cluster_pvs(pvs, map, target, max_distance, stamp, opened);
+	for(uint32_t c : opened) stamp[c] = UINT32_MAX;
+	encoded.clear();
+	encode_cluster_list(opened, encoded);
+	pvs.entries[target] = {pvs.data.size(), uint32_t(encoded.size())};
+	pvs.data.insert(pvs.data.end(), encoded.begin(), encoded.end());
+	decode_runs(pvs.entries[target], opened_runs);
+	size_t changed = 1;
+
+	//clusters in range that could see the cell before it opened also see
+	//what the gap sees; both run lists are sorted, so the union is a merge
+	const size_t reach = max_distance ? max_distance/pvs.cluster_size + 1 : std::max(pvs.clusters_x, pvs.clusters_y);
+	const size_t tx = target % pvs.clusters_x, ty = target / pvs.clusters_x;
+	for(size_t cy = ty > reach ? ty - reach : 0; cy < std::min(pvs.clusters_y, ty + reach + 1); cy++){
+		for(size_t cx = tx > reach ? tx - reach : 0; cx < std::min(pvs.clusters_x, tx + reach + 1); cx++){
+			const size_t c = cx + cy*pvs.clusters_x;
+			if(c == target || !pvs_can_see(pvs, cx*pvs.cluster_size, cy*pvs.cluster_size, x, y)) continue;
+			decode_runs(pvs.entries[c], runs);
+			merged.clear();
+			size_t i = 0, j = 0;
+			while(i < runs.size() || j < opened_runs.size()){
+				const auto &next = (j == opened_runs.size() ||
+					(i < runs.size() && runs[i].first <= opened_runs[j].first)) ? runs[i++] : opened_runs[j++];
+				if(!merged.empty() && next.first <= merged.back().second)
+					merged.back().second = std::max(merged.back().second, next.second);
+				else
+					merged.push_back(next);
+			}
+			if(merged == runs) continue;
+			store_runs(c, merged);
+			changed++;
+		}
+	}
+
+	size_t in_use = 0;
+	for(const PvsEntry &entry : pvs.entries) in_use += entry.length;
+	if(pvs.data.size() > 2*in_use) compact_pvs(pvs);
+	return changed;
+}
+
+
+/*-------------------------------------
+Name: save_pvs, parse_pvs, load_pvs
+Description: Binary PVS file: the magic "PVS1", then map width, map height and
+	cluster size as uint32, the map hash, entry count and data size as uint64,
+	followed by the entry table and the encoded lists. load_pvs rejects a file
+	whose dimensions or hash do not match the map it is given, and one that
+	is cut short or whose lists run outside the data or name clusters the
+	map does not have. parse_pvs does the same for a file already open as a
+	stream.
+
+Purpose: The PVS is built once offline and stored next to the map file, then
+	loaded at startup.
+--------------------------------------*/
+inline bool save_pvs(const std::string filename, const PvsTable &pvs){
+	std::ofstream ofs(filename, std::ios::binary);
+	if(!ofs){
+		std::cerr << "Failed to write PVS file: " << filename << "\n";
+		return false;
+	}
+	const uint32_t header[3] = {uint32_t(pvs.map_width), uint32_t(pvs.map_height), uint32_t(pvs.cluster_size)};
+	const uint64_t sizes[3] = {pvs.map_hash, pvs.entries.size(), pvs.data.size()};
+	ofs.write("PVS1", 4);
+	ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+	ofs.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+	for(const PvsEntry &e : pvs.entries){
+		ofs.write(reinterpret_cast<const char*>(&e.offset), sizeof(e.offset));
+		ofs.write(reinterpret_cast<const char*>(&e.length), sizeof(e.length));
+	}
+	ofs.write(reinterpret_cast<const char*>(pvs.data.data()), pvs.data.size());
+	return bool(ofs);
+}
+
+inline bool parse_pvs(std::istream &ifs,
+			const std::string filename,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			PvsTable &pvs){
+	char magic[4];
+	uint32_t header[3];
+	uint64_t sizes[3];
+	ifs.read(magic, 4);
+	ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+	ifs.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+	if(!ifs || std::memcmp(magic, "PVS1", 4) != 0){
+		std::cerr << "Not a PVS file: " << filename << "\n";
+		return false;
+	}
+	if(header[0] != map_width || header[1] != map_height ||
+	   sizes[0] != map_hash(map, map_width, map_height)){
+		std::cerr << "PVS file " << filename << " was built for a different map\n";
+		return false;
+	}
+	PvsTable loaded;
+	loaded.map_width = header[0];
+	loaded.map_height = header[1];
+	loaded.cluster_size = std::max<uint32_t>(header[2], 1);
+	loaded.clusters_x = (loaded.map_width + loaded.cluster_size - 1)/loaded.cluster_size;
+	loaded.clusters_y = (loaded.map_height + loaded.cluster_size - 1)/loaded.cluster_size;
+	loaded.map_hash = sizes[0];
+	if(sizes[1] != loaded.clusters_x*loaded.clusters_y){
+		std::cerr << "PVS file " << filename << " has a bad entry count\n";
+		return false;
+	}
+	loaded.entries.resize(sizes[1]);
+	for(PvsEntry &e : loaded.entries){
+		ifs.read(reinterpret_cast<char*>(&e.offset), sizeof(e.offset));
+		ifs.read(reinterpret_cast<char*>(&e.length), sizeof(e.length));
+		if(!ifs){
+			std::cerr << "PVS file " << filename << " is truncated\n";
+			return false;
+		}
+		if(e.offset > sizes[2] || e.length > sizes[2] - e.offset){
+			std::cerr << "PVS file " << filename << " is corrupt\n";
+			return false;
+		}
+	}
+	//read in pieces, so a corrupt data size fails at the end of the file
+	//instead of asking for that much memory up front
+	const size_t piece = 1 << 20;
+	while(loaded.data.size() < sizes[2]){
+		const size_t at = loaded.data.size();
+		loaded.data.resize(at + std::min<uint64_t>(piece, sizes[2] - at));
+		ifs.read(reinterpret_cast<char*>(loaded.data.data() + at), loaded.data.size() - at);
+		if(!ifs){
+			std::cerr << "PVS file " << filename << " is truncated\n";
+			return false;
+		}
+	}
+	//every list must decode within its bytes and name only real clusters,
+	//so the queries can walk them without further checks
+	const uint64_t cluster_count = sizes[1];
+	for(const PvsEntry &e : loaded.entries){
+		const uint8_t *p = loaded.data.data() + e.offset, *end = p + e.length;
+		uint64_t position = 0, gap, run;
+		while(p < end){
+			if(!get_varint(p, end, gap) || !get_varint(p, end, run) ||
+			   gap > cluster_count - position || run > cluster_count - position - gap){
+				std::cerr << "PVS file " << filename << " is corrupt\n";
+				return false;
+			}
+			position += gap + run;
+		}
+	}
+	pvs = std::move(loaded);
+	return true;
+}
+
+inline bool load_pvs(const std::string filename,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			PvsTable &pvs){
+	std::ifstream ifs(filename, std::ios::binary);
+	if(!ifs) return false;
+	return parse_pvs(ifs, filename, map, map_width, map_height, pvs);
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include "mapfile.h"
+#include "pvs.h"
+
+/*-------------------------------------
+Name: main
+Description: Offline PVS builder. Reads a map file, computes its potentially
+	visible set with build_pvs and writes it to the given output file, then
+	reports the build time, the compressed size and the average number of
+	visible clusters per entry. Last it looks from checks random points of
+	empty cells (1000 by default) and fails if any cell in line of sight
+	of one is missing from the table.
+
+	usage: pvs_build <map file> <pvs file> [cluster size] [max distance] [threads] [checks]
+
+Purpose: The PVS only has to be rebuilt when the map changes, so the cost is
+	paid here instead of at startup. The viewer looks for the output next to
+	the map, e.g. maps/level1.map and maps/level1.pvs.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0]
+			  << " <map file> <pvs file> [cluster size] [max distance] [threads] [checks]\n";
+		return 1;
+	}
+	const size_t cluster_size = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1;
+	const size_t max_distance = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 0;
+	const size_t threads = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0;
+	const size_t checks = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : 1000;
+
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	if(!load_map_file(argv[1], map, map_width, map_height)) return 1;
+
+	auto t0 = std::chrono::steady_clock::now();
+	PvsTable pvs = build_pvs(map.data(), map_width, map_height, cluster_size, max_distance, threads);
+	auto t1 = std::chrono::steady_clock::now();
+	if(!save_pvs(argv[2], pvs)) return 1;
+
+	uint64_t visible_total = 0;
+	for(const PvsEntry &e : pvs.entries){
+		const uint8_t *p = pvs.data.data() + e.offset;
+		const uint8_t *end = p + e.length;
+		uint64_t gap, run;
+		while(get_varint(p, end, gap) && get_varint(p, end, run)) visible_total += run;
+	}
+
+	//the table must hold every cell seen from anywhere in a cell, not just
+	//from the points it was built from
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> offset(0.f, 1.f);
+	size_t viewpoints = 0, missed_cells = 0;
+	for(size_t tries=0; tries<checks*20 && viewpoints<checks; tries++){
+		const size_t x = rng() % map_width, y = rng() % map_height;
+		if(map[x + y*map_width] != ' ') continue;
+		viewpoints++;
+		const float px = x + offset(rng), py = y + offset(rng);
+		for_each_visible_cell(map.data(), map_width, map_height, px, py,
+			[&](size_t vx, size_t vy){
+				if(pvs_can_see(pvs, x, y, vx, vy)) return;
+				//the shadowcaster also reports some cells that cannot be
+				//seen; only count those a line of sight reaches
+				for(int s=0; s<16; s++)
+					if(line_of_sight(map.data(), map_width, map_height, px, py,
+							 vx + (s % 4 + .5)/4, vy + (s / 4 + .5)/4)){
+						missed_cells++;
+						return;
+					}
+			}, ViewCone(), max_distance);
+	}
+	const size_t file_size = 40 + pvs.entries.size()*12 + pvs.data.size();
+	std::cout << "map " << map_width << "x" << map_height
+		  << ", cluster " << pvs.cluster_size
+		  << ", " << pvs.entries.size() << " entries\n"
+		  << "build time " << std::chrono::duration<double>(t1-t0).count() << " s\n"
+		  << "list data " << pvs.data.size() << " bytes, file " << file_size << " bytes\n"
+		  << "average visible clusters " << double(visible_total)/pvs.entries.size() << "\n"
+		  << "checked from " << viewpoints << " random viewpoints, " << missed_cells << " visible cells missing\n";
+	return missed_cells ? 1 : 0;
+}
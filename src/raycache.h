@@ -0,0 +1,494 @@
+#ifndef RAYCACHE_H
+#define RAYCACHE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include "raycaster.h"
+
+/*-------------------------------------
+Name: RayCacheStats
+Description: Counters for the column rays of one or more frames: how many were
+	taken from the cache untouched, because the player only turned or
+	stood still, and how many had to be cast. reprojected counts the casts
+	that started partway along the ray, past where an earlier cast showed
+	it clear. panorama counts the rays cast to fill the rest of the ring
+	while the player stood still. cast_us is the time spent producing the
+	hits, panorama fills included.
+
+Purpose: Shows how much work the cache saves over a session.
+--------------------------------------*/
+struct RayCacheStats {
+	size_t frames = 0;
+	size_t columns = 0;
+	size_t reused = 0;
+	size_t recast = 0;
+	size_t reprojected = 0;
+	size_t panorama = 0;
+	double cast_us = 0;
+
+	void add(const RayCacheStats &o){
+		frames += o.frames;
+		columns += o.columns;
+		reused += o.reused;
+		recast += o.recast;
+		reprojected += o.reprojected;
+		panorama += o.panorama;
+		cast_us += o.cast_us;
+	}
+	double reuse_rate() const {
+		return columns ? double(reused)/columns : 0;
+	}
+};
+
+
+/*-------------------------------------
+Name: RayClearance
+Description: How far a slot's ray was clear when it was last cast in full:
+	from (x, y), every cell it crossed before distance had no wall in the
+	3x3 block around it (see cast_ray_grid). 0 when nothing is known.
+
+Purpose: What a column is reprojected from after the player moves.
+--------------------------------------*/
+struct RayClearance {
+	float x = 0;
+	float y = 0;
+	float distance = 0;
+};
+
+
+/*-------------------------------------
+Name: RayCache
+Description: A ring of ray hits indexed by world angle. Column angles are
+	snapped to a global grid of step 2*pi/slots (close to fov/columns), and
+	slot k is always cast at angle k*angle_step, so its ray points the same
+	way, to the bit, no matter where the view is turned. Every slot remembers the generation it was cast in; the generation
+	changes whenever the player moves, and only slots of the current
+	generation are used. clearance keeps, per slot, how far its ray was
+	clear from the position it was last cast in full from, which outlives
+	the generation. dir_x and dir_y hold the direction of every slot's
+	ray, worked out once as cast_ray does.
+
+	With panorama set, the first frame the player stands still also casts
+	every slot not yet cast at that position, the full 360 degrees at the
+	current angular resolution; from then on any turn in place is a slice
+	of the ring with no new rays, until the player moves again.
+	panorama_generation is the generation the ring was last completed in.
+
+Purpose: Turning by SDLK_a/SDLK_d shifts the view by a whole number of
+	slots, so nearly every column of the previous frame can be reused as is.
+--------------------------------------*/
+struct RayCache {
+	size_t slots = 0;
+	float angle_step = 0;
+	float x = 0;
+	float y = 0;
+	uint32_t generation = 0;
+	std::vector<RayHit> hits;
+	std::vector<uint32_t> cast_in;
+	std::vector<RayClearance> clearance;
+	std::vector<float> dir_x;
+	std::vector<float> dir_y;
+	bool panorama = false;
+	uint32_t panorama_generation = 0;
+	RayCacheStats last_frame;
+
+	void invalidate(){
+		generation++;
+		for(RayClearance &clear : clearance) clear.distance = 0;
+	}
+};
+
+
+/*-------------------------------------
+Name: segment_meets_rect
+Description: True if the segment from (x0, y0) to (x1, y1) passes through or
+	ends in the rectangle [lo_x, hi_x] x [lo_y, hi_y], clipped one slab per
+	axis.
+
+Purpose: The test invalidate_region runs for every cached ray.
+--------------------------------------*/
+inline bool segment_meets_rect(const float x0, const float y0,
+			const float x1, const float y1,
+			const float lo_x, const float lo_y,
+			const float hi_x, const float hi_y){
+	const float start[2] = {x0, y0};
+	const float delta[2] = {x1 - x0, y1 - y0};
+	const float lo[2] = {lo_x, lo_y};
+	const float hi[2] = {hi_x, hi_y};
+	float t0 = 0, t1 = 1;
+	for(int k=0; k<2 && t0 <= t1; k++){
+		if(delta[k] == 0){
+			if(start[k] < lo[k] || start[k] > hi[k]) return false;
+			continue;
+		}
+		float a = (lo[k] - start[k])/delta[k], b = (hi[k] - start[k])/delta[k];
+		if(a > b) std::swap(a, b);
+		t0 = std::max(t0, a);
+		t1 = std::min(t1, b);
+	}
+	return t0 <= t1;
+}
+
+
+/*-------------------------------------
+Name: invalidate_region
+Description: Drops the cached hits that a change to the map cells inside the
+	rectangle [x0, x1) x [y0, y1) can affect: those whose ray from the
+	cache position to the hit passes through or ends in the rectangle. Hits
+	from older positions are left alone, they are never used again. The
+	clearance of any slot whose clear stretch comes within a cell of the
+	rectangle is dropped as well, whatever position it was measured from.
+
+Purpose: A door opening only recasts the columns that looked at or through
+	it, instead of invalidate() recasting the whole view.
+--------------------------------------*/
+inline size_t invalidate_region(RayCache &cache,
+				const size_t x0, const size_t y0,
+				const size_t x1, const size_t y1){
+	size_t dropped = 0;
+	for(size_t slot=0; slot<cache.slots; slot++){
+		RayClearance &clear = cache.clearance[slot];
+		if(clear.distance > 0){
+			if(segment_meets_rect(clear.x, clear.y, clear.x + clear.distance*cache.dir_x[slot],
+					      clear.y + clear.distance*cache.dir_y[slot], float(x0) - 1.01f, float(y0) - 1.01f,
+					      float(x1) + 1.01f, float(y1) + 1.01f))
+				clear.distance = 0;
+		}
+		if(cache.cast_in[slot] != cache.generation) continue;
+		const RayHit &hit = cache.hits[slot];
+		if(!segment_meets_rect(cache.x, cache.y, hit.x, hit.y, float(x0) - .01f, float(y0) - .01f,
+				       float(x1) + .01f, float(y1) + .01f))
+			continue;
+		cache.cast_in[slot] = cache.generation - 1;
+		dropped++;
+	}
+	if(dropped) cache.panorama_generation = cache.generation - 1;
+	return dropped;
+}
+
+
+/*-------------------------------------
+Name: cast_ray_grid, cast_ray_grid_along
+Description: Walks the map cells a ray passes through (a DDA grid traversal) and
+	returns the first non-empty cell, with the exact distance and point at
+	which the ray enters it, in the same RayHit form as cast_ray. The walk
+	starts in the cell at clear_distance along the ray; the cells before it
+	must be known to be empty.
+
+	Given open_distance, the walk also measures how far along the ray every
+	cell it crosses has no wall, and no map edge, in the 3x3 block of cells
+	around it: the distance at which it enters the first cell that does,
+	less a small margin. Each step only reads the three cells the block
+	gains. A ray along the same angle from any point less than a cell away
+	in x and in y stays inside those blocks up to that distance, so it
+	crosses no wall before it. The along form takes the ray's direction,
+	the cos and sin of its angle, where the other works them out.
+
+Purpose: A much cheaper traversal than the .05 march, which finds where the
+	march will stop for cast_ray_traversed.
+--------------------------------------*/
+inline RayHit cast_ray_grid_along(const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const float origin_x,
+				const float origin_y,
+				const float dx,
+				const float dy,
+				const float max_distance = 20,
+				const float clear_distance = 0,
+				float *open_distance = nullptr){
+	int cell_x = int(origin_x + clear_distance*dx), cell_y = int(origin_y + clear_distance*dy);
+	const int step_x = dx < 0 ? -1 : 1, step_y = dy < 0 ? -1 : 1;
+	//the 3x3 block around a cell, or the row or column of it a step adds,
+	//holds only empty cells inside the map
+	auto open_cells = [&](const int x0, const int y0, const int x1, const int y1){
+		if(x0 < 0 || y0 < 0 || size_t(x1) >= map_width || size_t(y1) >= map_height) return false;
+		for(int y = y0; y <= y1; y++)
+			for(int x = x0; x <= x1; x++)
+				if(map[x + y*map_width] != ' ') return false;
+		return true;
+	};
+	bool open = false;
+	if(open_distance){
+		*open_distance = 0;
+		open = origin_x >= 0 && origin_y >= 0 && open_cells(cell_x - 1, cell_y - 1, cell_x + 1, cell_y + 1);
+	}
+	const float delta_x = dx != 0 ? std::fabs(1/dx) : INFINITY;
+	const float delta_y = dy != 0 ? std::fabs(1/dy) : INFINITY;
+	float next_x = dx < 0 ? (origin_x - cell_x)*delta_x : (cell_x + 1 - origin_x)*delta_x;
+	float next_y = dy < 0 ? (origin_y - cell_y)*delta_y : (cell_y + 1 - origin_y)*delta_y;
+	RayHit hit;
+	float t = 0;
+	uint8_t side = 0;
+	while(t < max_distance){
+		int prev_x = cell_x, prev_y = cell_y;
+		if(next_x < next_y){
+			t = next_x;
+			next_x += delta_x;
+			cell_x += step_x;
+			side = 0;
+		} else {
+			t = next_y;
+			next_y += delta_y;
+			cell_y += step_y;
+			side = 1;
+		}
+		if(open){
+			const int x = cell_x + (side == 0 ? step_x : 0), y = cell_y + (side == 1 ? step_y : 0);
+			open = side == 0 ? open_cells(x, cell_y - 1, x, cell_y + 1) : open_cells(cell_x - 1, y, cell_x + 1, y);
+			if(!open) *open_distance = std::max(0.f, std::min(t, max_distance) - .01f);
+		}
+		if(t >= max_distance) break;
+		hit.distance = t;
+		hit.x = origin_x + t*dx;
+		hit.y = origin_y + t*dy;
+		if(cell_x < 0 || cell_y < 0 || size_t(cell_x) >= map_width || size_t(cell_y) >= map_height)
+			return hit;
+		if(map[cell_x + cell_y*map_width] != ' '){
+			hit.cell = map[cell_x + cell_y*map_width];
+			hit.side = side;
+			hit.face_x = prev_x;
+			hit.face_y = prev_y;
+			return hit;
+		}
+	}
+	if(open) *open_distance = max_distance;
+	hit = RayHit();
+	hit.distance = max_distance;
+	hit.x = origin_x + max_distance*dx;
+	hit.y = origin_y + max_distance*dy;
+	return hit;
+}
+
+inline RayHit cast_ray_grid(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float origin_x,
+			const float origin_y,
+			const float angle,
+			const float max_distance = 20,
+			const float clear_distance = 0,
+			float *open_distance = nullptr){
+	return cast_ray_grid_along(map, map_width, map_height, origin_x, origin_y, cos(angle), sin(angle),
+				   max_distance, clear_distance, open_distance);
+}
+
+
+/*-------------------------------------
+Name: march_step_distances, cast_ray_traversed, cast_ray_traversed_along
+Description: cast_ray_traversed returns exactly what cast_ray returns, bit for
+	bit, for a fraction of the cost. The grid traversal of cast_ray_grid
+	finds where the ray first enters a wall; every step of the .05 march
+	before that lies in the empty cells the traversal crossed, so the march
+	is started two steps short of it and run to the end as cast_ray runs
+	it. march_step_distances holds the distances the march reaches after
+	each step, accumulated the way cast_ray accumulates them, so starting
+	partway gives the same distances as stepping there. A march that steps
+	over a wall corner the traversal stops at simply marches on, as
+	cast_ray does. A clear_distance the ray is known to cross no wall
+	before lets the traversal start there, and open_distance is measured
+	by the traversal as in cast_ray_grid (0 when it is not run). The along
+	form is given the direction of angle, as cast_ray_grid_along is.
+
+Purpose: Lets the cache cast its columns with the march's distances, the
+	ones every other path draws with, at the cost of a traversal and a few
+	steps.
+--------------------------------------*/
+inline const std::vector<float> &march_step_distances(){
+	static const std::vector<float> steps = [](){
+		std::vector<float> out;
+		for(float t=0; t<64; t+=.05) out.push_back(t);
+		return out;
+	}();
+	return steps;
+}
+
+inline RayHit cast_ray_traversed_along(const char *map,
+					const size_t map_width,
+					const size_t map_height,
+					const float origin_x,
+					const float origin_y,
+					const float angle,
+					const float dx,
+					const float dy,
+					const float max_distance = 20,
+					const float clear_distance = 0,
+					float *open_distance = nullptr){
+	const std::vector<float> &steps = march_step_distances();
+	//the traversal starts past the origin's cell, the march stops in it
+	const bool origin_open = origin_x >= 0 && origin_y >= 0 && size_t(origin_x) < map_width &&
+		size_t(origin_y) < map_height && map[size_t(origin_x) + size_t(origin_y)*map_width] == ' ';
+	if(!origin_open || max_distance >= steps.back()){
+		if(open_distance) *open_distance = 0;
+		return cast_ray(map, map_width, map_height, origin_x, origin_y, angle, max_distance);
+	}
+	const RayHit wall = cast_ray_grid_along(map, map_width, map_height, origin_x, origin_y, dx, dy, max_distance,
+						clear_distance, open_distance);
+	size_t k = std::lower_bound(steps.begin(), steps.end(), wall.distance) - steps.begin();
+	k = k > 2 ? k - 2 : 0;
+	//the same loop as cast_ray, entered at step k
+	RayHit hit;
+	int prev_x = int(origin_x);
+	int prev_y = int(origin_y);
+	if(k > 0){
+		prev_x = int(origin_x + steps[k-1]*dx);
+		prev_y = int(origin_y + steps[k-1]*dy);
+	}
+	for(float t=steps[k]; t<max_distance; t+=.05){
+		float cx = origin_x + t*dx;
+		float cy = origin_y + t*dy;
+		if(cx < 0 || cy < 0 || size_t(cx) >= map_width || size_t(cy) >= map_height){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			return hit;
+		}
+		if(map[int(cx)+int(cy)*map_width] != ' '){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			hit.cell = map[int(cx)+int(cy)*map_width];
+			hit.side = int(cx) == prev_x ? 1 : 0;
+			hit.face_x = prev_x;
+			hit.face_y = prev_y;
+			return hit;
+		}
+		prev_x = int(cx);
+		prev_y = int(cy);
+	}
+	hit.distance = max_distance;
+	hit.x = origin_x + max_distance*dx;
+	hit.y = origin_y + max_distance*dy;
+	return hit;
+}
+
+inline RayHit cast_ray_traversed(const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const float origin_x,
+				const float origin_y,
+				const float angle,
+				const float max_distance = 20,
+				const float clear_distance = 0,
+				float *open_distance = nullptr){
+	return cast_ray_traversed_along(map, map_width, map_height, origin_x, origin_y, angle, cos(angle), sin(angle),
+					max_distance, clear_distance, open_distance);
+}
+
+
+/*-------------------------------------
+Name: cast_columns_cached
+Description: Produces the same per-column hits as cast_columns, using angles
+	snapped to the cache's grid, while reusing earlier results:
+
+	* player did not move: every slot already cast at this position is used
+	  as is, only columns that newly came into view are cast.
+	* player moved: every column is cast again, from the new position, as
+	  the hit itself moves with the player. A column is reprojected when
+	  its slot was last cast in full from less than a cell away in x and
+	  in y (.99 of one, for rounding): the ray from here runs within a
+	  cell of that one, through the open blocks its traversal found (see
+	  cast_ray_grid), so it crosses no wall before the clearance and its
+	  traversal starts there. Other columns are cast in full and measure a
+	  new clearance on the way. Either way the cast goes through
+	  cast_ray_traversed_along, which gives the march's exact hit.
+	* first frame or invalidate(): every column is cast in full.
+
+	When the cache keeps a panorama and the player did not move, the rest
+	of the ring is then cast as well (see RayCache).
+
+	Statistics for the frame are left in cache.last_frame; reused counts
+	only the columns taken from the cache.
+
+Purpose: Most frames of normal play are pure turns or standing still; this
+	casts only the columns that actually changed, and casts those cheaply.
+--------------------------------------*/
+inline void cast_columns_cached(RayCache &cache,
+				const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const float player_x,
+				const float player_y,
+				const float player_a,
+				const float fov,
+				const size_t columns,
+				std::vector<RayHit> &hits){
+	auto start = std::chrono::steady_clock::now();
+	const size_t slots = size_t(std::lround(2*M_PI/(fov/columns)));
+	if(cache.slots != slots){
+		cache.slots = slots;
+		cache.angle_step = 2*M_PI/slots;
+		cache.hits.assign(slots, RayHit());
+		cache.cast_in.assign(slots, 0);
+		cache.clearance.assign(slots, RayClearance());
+		cache.dir_x.resize(slots);
+		cache.dir_y.resize(slots);
+		for(size_t slot=0; slot<slots; slot++){
+			const float angle = slot*cache.angle_step;
+			cache.dir_x[slot] = cos(angle);
+			cache.dir_y[slot] = sin(angle);
+		}
+		cache.invalidate();
+	}
+
+	RayCacheStats &stats = cache.last_frame;
+	stats = RayCacheStats();
+	stats.frames = 1;
+	stats.columns = columns;
+
+	const bool same_place = player_x == cache.x && player_y == cache.y;
+	if(!same_place){
+		cache.generation++;
+		cache.x = player_x;
+		cache.y = player_y;
+	}
+
+	//casts a slot from the player, reprojected if its clearance allows
+	auto cast_slot = [&](const size_t slot){
+		const float angle = slot*cache.angle_step;
+		const float dx = cache.dir_x[slot], dy = cache.dir_y[slot];
+		RayClearance &clear = cache.clearance[slot];
+		if(clear.distance > 0 && std::fabs(player_x - clear.x) < .99f && std::fabs(player_y - clear.y) < .99f){
+			stats.reprojected++;
+			cache.hits[slot] = cast_ray_traversed_along(map, map_width, map_height, player_x, player_y, angle,
+								    dx, dy, 20, clear.distance);
+		} else {
+			cache.hits[slot] = cast_ray_traversed_along(map, map_width, map_height, player_x, player_y, angle,
+								    dx, dy, 20, 0, &clear.distance);
+			clear.x = player_x;
+			clear.y = player_y;
+		}
+		cache.cast_in[slot] = cache.generation;
+	};
+
+	hits.resize(columns);
+	const long first = std::lround((player_a - fov/2)/cache.angle_step);
+	for(size_t i=0; i<columns; i++){
+		const long k = first + long(i);
+		const size_t slot = size_t(((k % long(slots)) + long(slots)) % long(slots));
+		RayHit &cached = cache.hits[slot];
+		if(cache.cast_in[slot] == cache.generation){
+			stats.reused++;
+		} else {
+			cast_slot(slot);
+			stats.recast++;
+		}
+		hits[i] = cached;
+	}
+	if(cache.panorama && same_place && cache.panorama_generation != cache.generation){
+		for(size_t slot=0; slot<slots; slot++){
+			if(cache.cast_in[slot] == cache.generation) continue;
+			cast_slot(slot);
+			stats.panorama++;
+		}
+		cache.panorama_generation = cache.generation;
+	}
+	stats.cast_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
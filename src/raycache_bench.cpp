@@ -0,0 +1,167 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "mapfile.h"
+#include "raycaster.h"
+#include "raycache.h"
+#include "session.h"
+
+/*-------------------------------------
+Name: moving_session
+Description: scripted_session with each input spread over the four frames
+	until the next one: a step moves the player an eighth of a cell a frame
+	and a turn .0125 radians, so the pose changes on every frame the
+	script is not idle.
+
+Purpose: scripted_session repeats each pose for four frames, as held keys
+	do, which a cache turns into reuse for free; this replays the same
+	walk as continuous movement.
+--------------------------------------*/
+std::vector<Pose> moving_session(const size_t frames = 1200){
+	const std::vector<Pose> keyed = scripted_session(frames + 4);
+	std::vector<Pose> poses(frames);
+	for(size_t f=0; f<frames; f++){
+		const Pose &from = keyed[f - f % 4], &to = keyed[f - f % 4 + 4];
+		const float t = (f % 4)/4.f;
+		poses[f].x = from.x + (to.x - from.x)*t;
+		poses[f].y = from.y + (to.y - from.y)*t;
+		poses[f].a = from.a + (to.a - from.a)*t;
+	}
+	return poses;
+}
+
+
+/*-------------------------------------
+Name: same_hit
+Description: True if two hits are identical in every field.
+
+Purpose: The cache promises cast_ray's hits exactly, not approximately.
+--------------------------------------*/
+bool same_hit(const RayHit &a, const RayHit &b){
+	return a.distance == b.distance && a.x == b.x && a.y == b.y && a.cell == b.cell &&
+		a.side == b.side && a.face_x == b.face_x && a.face_y == b.face_y;
+}
+
+
+/*-------------------------------------
+Name: slot_angle
+Description: The angle the cache casts column k of the snapped grid at, that
+	of its slot.
+
+Purpose: What the reference casts must be cast at for an exact comparison.
+--------------------------------------*/
+float slot_angle(const RayCache &cache, const long k){
+	const long slots = long(cache.slots);
+	return size_t(((k % slots) + slots) % slots)*cache.angle_step;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Replays a pose session through cast_columns_cached, through
+	cast_ray_traversed for every column and through cast_ray for every
+	column, and reports the share of columns taken from the cache, the
+	share of cast columns reprojected, and the ray cost per frame and per
+	moving frame. Every column of every frame is checked against cast_ray
+	at the same angle.
+
+	Then, standing at the first pose, turns a full circle .05 per frame
+	three ways: casting every column every frame, with the cache, and with
+	the cache keeping a panorama, and reports the cost of filling the
+	panorama and the time per turning frame of each, again checking every
+	column.
+
+	usage: raycache_bench [map file] [session file] [columns]
+
+Purpose: Measures what temporal reuse buys on real play. Without a session
+	file a scripted walk around the demo map is used, moving on every
+	frame; record a real one with "gameloop --record-poses session.txt".
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height)) return 1;
+	std::vector<Pose> poses;
+	if(argc > 2){
+		if(!load_poses(argv[2], poses)) return 1;
+	} else {
+		poses = moving_session();
+	}
+	const size_t columns = argc > 3 ? std::stoul(argv[3]) : 512;
+	const float fov = M_PI/3.;
+
+	RayCache cache;
+	RayCacheStats cached_total, cached_moving;
+	std::vector<RayHit> hits, all_traversed(columns), reference(columns);
+	double march_us = 0, traverse_us = 0, traverse_moving_us = 0;
+	size_t mismatches = 0, moving_frames = 0;
+	for(size_t f=0; f<poses.size(); f++){
+		const Pose &p = poses[f];
+		const bool moving = f > 0 && (p.x != poses[f-1].x || p.y != poses[f-1].y);
+		moving_frames += moving;
+		cast_columns_cached(cache, map.data(), map_width, map_height, p.x, p.y, p.a, fov, columns, hits);
+		cached_total.add(cache.last_frame);
+		if(moving) cached_moving.add(cache.last_frame);
+		const long first = std::lround((p.a - fov/2)/cache.angle_step);
+		auto t = clock::now();
+		for(size_t i=0; i<columns; i++)
+			all_traversed[i] = cast_ray_traversed(map.data(), map_width, map_height, p.x, p.y,
+							      slot_angle(cache, first + long(i)));
+		const double us = std::chrono::duration<double, std::micro>(clock::now() - t).count();
+		traverse_us += us;
+		if(moving) traverse_moving_us += us;
+		t = clock::now();
+		for(size_t i=0; i<columns; i++)
+			reference[i] = cast_ray(map.data(), map_width, map_height, p.x, p.y, slot_angle(cache, first + long(i)));
+		march_us += std::chrono::duration<double, std::micro>(clock::now() - t).count();
+		for(size_t i=0; i<columns; i++)
+			mismatches += !same_hit(hits[i], reference[i]) + !same_hit(all_traversed[i], reference[i]);
+	}
+
+	const double n = cached_total.columns;
+	std::cout << "frames " << cached_total.frames << ", " << moving_frames << " of them moving, columns per frame "
+		  << columns << "\n"
+		  << "taken from the cache " << 100*cached_total.reused/n << " %\n"
+		  << "cast                 " << 100*cached_total.recast/n << " %, "
+		  << 100.*cached_total.reprojected/std::max<size_t>(cached_total.recast, 1) << " % of them reprojected\n"
+		  << "ray cache            " << cached_total.cast_us/cached_total.frames << " us/frame, "
+		  << cached_moving.cast_us/std::max<size_t>(moving_frames, 1) << " us/moving frame\n"
+		  << "traverse every ray   " << traverse_us/poses.size() << " us/frame, "
+		  << traverse_moving_us/std::max<size_t>(moving_frames, 1) << " us/moving frame\n"
+		  << "march every ray      " << march_us/poses.size() << " us/frame\n"
+		  << "columns that differ from cast_ray " << mismatches << "\n";
+
+	//turning in place, after one frame standing still
+	const Pose &stand = poses[0];
+	const size_t turn_frames = size_t(2*M_PI/.05f) + 1;
+	RayCache turn_caches[3];
+	turn_caches[2].panorama = true;
+	const char *names[3] = {"full cast:", "ray cache:", "panorama: "};
+	size_t turn_mismatches = 0;
+	for(int mode=0; mode<3; mode++){
+		RayCache &turn_cache = turn_caches[mode];
+		RayCacheStats first, turning;
+		for(size_t f=0; f<turn_frames + 1; f++){
+			const float a = stand.a + (f ? (f - 1)*.05f : 0);
+			if(mode == 0) turn_cache.invalidate();
+			cast_columns_cached(turn_cache, map.data(), map_width, map_height, stand.x, stand.y, a, fov, columns, hits);
+			if(f < 2) first.add(turn_cache.last_frame);
+			else turning.add(turn_cache.last_frame);
+			const long first_column = std::lround((a - fov/2)/turn_cache.angle_step);
+			for(size_t i=0; i<columns; i++)
+				turn_mismatches += !same_hit(hits[i], cast_ray(map.data(), map_width, map_height, stand.x, stand.y,
+									  slot_angle(turn_cache, first_column + long(i))));
+		}
+		std::cout << names[mode] << " first two frames " << first.cast_us/1000 << " ms ("
+			  << first.recast + first.panorama << " rays, " << first.panorama << " filling the panorama), then "
+			  << turning.cast_us/turning.frames << " us and " << double(turning.recast)/turning.frames
+			  << " rays per turning frame\n";
+	}
+	std::cout << "turning columns that differ from cast_ray " << turn_mismatches << "\n";
+	return mismatches || turn_mismatches ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#ifndef RAYCASTER_H
+#define RAYCASTER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "pixelformat.h"
+#include "framebuffer.h"
+#include "shading.h"
+#include "lighting.h"
+
+/*-------------------------------------
+Name: draw_rectangle
+Description: Draws a solid-colored rectangle into a view, clipped to it.
+The rectangle starts at (x_pos, y_pos) and spans rect_width × rect_height pixels.
+The image holds packed colors or, for the indexed mode, palette indices, and
+color is of the image's pixel type. The vector form draws into a packed
+image_width x image_height image. Returns the number of pixels written,
+the part of the rectangle inside the image.
+
+
+Purpose: Enables pixel-level rectangle drawing into a linear framebuffer.
+--------------------------------------*/
+template<typename Pixel>
+inline size_t draw_rectangle(const FrameView<Pixel> image,
+			const size_t x_pos,
+			const size_t y_pos,
+			const size_t rect_width,
+			const size_t rect_height,
+			const Pixel color){
+	const FrameView<Pixel> rect = image.sub_view(x_pos, y_pos, rect_width, rect_height);
+	rect.fill(color);
+	return rect.width*rect.height;
+}
+
+template<typename Pixel>
+inline size_t draw_rectangle(std::vector<Pixel> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t x_pos,
+			const size_t y_pos,
+			const size_t rect_width,
+			const size_t rect_height,
+			const typename std::vector<Pixel>::value_type color){
+	return draw_rectangle(frame_view(image, image_width, image_height), x_pos, y_pos, rect_width, rect_height, color);
+}
+
+
+/*-------------------------------------
+Name: compose_minimap
+Description: Writes the minimap into a view in one pass, row by row: every
+	pixel is written once, either with the color color_of(i, j) gives wall
+	cell i, j or with background for empty cells and everything right of
+	and below the map. Returns the number of pixels written, summed over
+	the spans it fills. The vector
+	form writes the left view_width columns of a packed image.
+
+Purpose: The minimap without a clear beneath it, so no pixel of that half of
+	the frame is written twice.
+--------------------------------------*/
+template<typename Pixel, typename ColorOf>
+inline size_t compose_minimap(const FrameView<Pixel> view,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const size_t rect_width,
+			const size_t rect_height,
+			const Pixel background,
+			ColorOf color_of){
+	size_t written = 0;
+	for(size_t y=0; y<view.height; y++){
+		Pixel *row = view.row(y);
+		const size_t j = rect_height ? y/rect_height : map_height;
+		size_t x = 0;
+		for(size_t i=0; j<map_height && i<map_width && x<view.width; i++){
+			const Pixel color = map[i + j*map_width] == ' ' ? background : color_of(i, j);
+			const size_t end = std::min(x + rect_width, view.width);
+			std::fill(row + x, row + end, color);
+			written += end - x;
+			x = end;
+		}
+		std::fill(row + x, row + view.width, background);
+		written += view.width - x;
+	}
+	return written;
+}
+
+template<typename Pixel, typename ColorOf>
+inline size_t compose_minimap(std::vector<Pixel> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t view_width,
+			const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const size_t rect_width,
+			const size_t rect_height,
+			const typename std::vector<Pixel>::value_type background,
+			ColorOf color_of){
+	assert(view_width <= image_width);
+	return compose_minimap(frame_view(image, image_width, image_height).sub_view(0, 0, view_width, image_height),
+			       map, map_width, map_height, rect_width, rect_height, background, color_of);
+}
+
+
+/*-------------------------------------
+Name: RayHit
+Description: What a single ray found: the distance t travelled along the ray, the
+	map position where it stopped, the map character of the wall it hit (or 0
+	if it ran out of range or left the map) and which kind of cell face it
+	crossed, 0 for a face crossed along x and 1 for one crossed along y.
+	face_x and face_y are the last empty cell before the hit, the cell the
+	visible face of the wall looks into.
+
+Purpose: Splits casting from drawing, so a frame's hits can be shaded,
+	traced on the minimap or kept around without casting again.
+--------------------------------------*/
+struct RayHit {
+	float distance = 0;
+	float x = 0;
+	float y = 0;
+	char cell = 0;
+	uint8_t side = 0;
+	int face_x = -1;
+	int face_y = -1;
+};
+
+
+/*-------------------------------------
+Name: cast_ray
+Description: Marches a ray from (origin_x, origin_y) along angle in steps of .05
+	until it enters a non-empty map cell or reaches max_distance. Leaving the
+	map counts as a hit with cell 0.
+
+Purpose: The same stepping the demo has always used for its columns, wrapped
+	so every renderer mode and tool casts identical rays.
+--------------------------------------*/
+inline RayHit cast_ray(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float origin_x,
+			const float origin_y,
+			const float angle,
+			const float max_distance = 20){
+	const float dx = cos(angle);
+	const float dy = sin(angle);
+	RayHit hit;
+	int prev_x = int(origin_x);
+	int prev_y = int(origin_y);
+	for(float t=0; t<max_distance; t+=.05){
+		float cx = origin_x + t*dx;
+		float cy = origin_y + t*dy;
+		if(cx < 0 || cy < 0 || size_t(cx) >= map_width || size_t(cy) >= map_height){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			return hit;
+		}
+		if(map[int(cx)+int(cy)*map_width] != ' '){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			hit.cell = map[int(cx)+int(cy)*map_width];
+			hit.side = int(cx) == prev_x ? 1 : 0;
+			hit.face_x = prev_x;
+			hit.face_y = prev_y;
+			return hit;
+		}
+		prev_x = int(cx);
+		prev_y = int(cy);
+	}
+	hit.distance = max_distance;
+	hit.x = origin_x + max_distance*dx;
+	hit.y = origin_y + max_distance*dy;
+	return hit;
+}
+
+
+/*-------------------------------------
+Name: cast_columns
+Description: Casts one ray per screen column across the field of view, the
+	leftmost column looking at player_a - fov/2, and stores the results in
+	hits (resized to columns).
+
+Purpose: The cast half of the 3D view.
+--------------------------------------*/
+inline void cast_columns(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float player_x,
+			const float player_y,
+			const float player_a,
+			const float fov,
+			const size_t columns,
+			std::vector<RayHit> &hits){
+	hits.resize(columns);
+	for(size_t i=0; i<columns; i++){
+		float angle = player_a-fov/2 + fov*i/float(columns);
+		hits[i] = cast_ray(map, map_width, map_height, player_x, player_y, angle);
+	}
+}
+
+
+/*-------------------------------------
+Name: draw_wall_columns
+Description: Draws one vertical wall slice per hit into column i of a view,
+	each slice view.height/distance pixels tall and centered on the
+	horizon. Rays that hit nothing, and hits past the right edge, draw
+	nothing. When a light map is given the wall color is scaled by the
+	light level of the cell in front of the hit face, and when a shade
+	table is given it is then darkened and fogged by distance and face
+	side. Both are a single lookup per column. The vector form draws into
+	the view that starts at view_x of a packed image.
+
+Purpose: The draw half of the 3D view.
+--------------------------------------*/
+inline void draw_wall_columns(const FrameView<uint32_t> view,
+			const std::vector<RayHit> &hits,
+			const uint32_t wall_color,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr){
+	const size_t columns = std::min(hits.size(), view.width);
+	for(size_t i=0; i<columns; i++){
+		const RayHit &hit = hits[i];
+		if(hit.cell == 0) continue;
+		const size_t column_height = std::min(float(view.height)/std::max(hit.distance, .01f),
+						      float(view.height));
+		const size_t top = view.height/2 - column_height/2;
+		uint32_t color = wall_color;
+		if(lighting && hit.face_x >= 0 && hit.face_y >= 0 && size_t(hit.face_x) < lighting->width &&
+		   size_t(hit.face_y) < lighting->height)
+			color = scale_color(color, lighting->light_at(hit.face_x, hit.face_y));
+		if(shading) color = shade_color(*shading, color, hit.distance, hit.side);
+		uint32_t *pixel = &view.at(i, top);
+		for(size_t j=0; j<column_height; j++, pixel += view.pitch) *pixel = color;
+	}
+}
+
+inline void draw_wall_columns(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t view_x,
+			const std::vector<RayHit> &hits,
+			const uint32_t wall_color,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr){
+	draw_wall_columns(frame_view(image, image_width, image_height).sub_view(view_x, 0, image_width, image_height),
+			  hits, wall_color, shading, lighting);
+}
+
+
+
+/*-------------------------------------
+Name: wall_column_spans, compose_column_spans, compose_wall_columns
+Description: wall_column_spans sets top and bottom of the first columns
+	hits to the rows a wall slice covers in a view height pixels tall: as
+	tall as height over the distance, at most height, centered on the
+	horizon, or empty at the horizon for a ray that hit nothing.
+
+	compose_column_spans writes the first columns columns of a view,
+	one per entry of top, bottom and color: ceiling above top, color from
+	top to bottom and floor below, every pixel exactly once. It goes row by
+	row, so the writes are sequential and the inner loop is a pair of
+	selects the compiler vectorizes. Returns the number of pixels written.
+
+	compose_wall_columns is draw_wall_columns and the clear beneath it in
+	one pass: the same wall slices, lit and shaded the same way, with the
+	ceiling and floor colors above and below them. A ray that hit nothing
+	gives a column of ceiling down to the horizon and floor below it.
+
+Purpose: The 3D half of the frame with no full-frame clear and no pixel
+	written twice.
+--------------------------------------*/
+inline void wall_column_spans(const std::vector<RayHit> &hits,
+			const size_t columns,
+			const size_t height,
+			uint32_t *top,
+			uint32_t *bottom){
+	assert(columns <= hits.size());
+	for(size_t i=0; i<columns; i++){
+		const RayHit &hit = hits[i];
+		top[i] = bottom[i] = height/2;
+		if(hit.cell == 0) continue;
+		const size_t column_height = std::min(float(height)/std::max(hit.distance, .01f), float(height));
+		top[i] = height/2 - column_height/2;
+		bottom[i] = top[i] + column_height;
+	}
+}
+
+template<typename Pixel>
+inline size_t compose_column_spans(const FrameView<Pixel> view,
+			const size_t columns,
+			const uint32_t *top,
+			const uint32_t *bottom,
+			const Pixel *color,
+			const Pixel ceiling_color,
+			const Pixel floor_color){
+	assert(columns <= view.width);
+	size_t written = 0;
+	for(uint32_t j=0; j<view.height; j++){
+		Pixel *row = view.row(j);
+		for(size_t i=0; i<columns; i++)
+			row[i] = j < top[i] ? ceiling_color : j < bottom[i] ? color[i] : floor_color;
+		written += columns;
+	}
+	return written;
+}
+
+inline size_t compose_wall_columns(const FrameView<uint32_t> view,
+			const std::vector<RayHit> &hits,
+			const uint32_t wall_color,
+			const uint32_t ceiling_color,
+			const uint32_t floor_color,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr){
+	const size_t columns = std::min(hits.size(), view.width);
+	const size_t height = view.height;
+	static thread_local std::vector<uint32_t> top, bottom, color;
+	top.resize(columns);
+	bottom.resize(columns);
+	color.resize(columns);
+	wall_column_spans(hits, columns, height, top.data(), bottom.data());
+	for(size_t i=0; i<columns; i++){
+		const RayHit &hit = hits[i];
+		if(hit.cell == 0) continue;
+		color[i] = wall_color;
+		if(lighting && hit.face_x >= 0 && hit.face_y >= 0 && size_t(hit.face_x) < lighting->width &&
+		   size_t(hit.face_y) < lighting->height)
+			color[i] = scale_color(color[i], lighting->light_at(hit.face_x, hit.face_y));
+		if(shading) color[i] = shade_color(*shading, color[i], hit.distance, hit.side);
+	}
+	return compose_column_spans(view, columns, top.data(), bottom.data(), color.data(), ceiling_color, floor_color);
+}
+
+inline size_t compose_wall_columns(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t image_height,
+			const size_t view_x,
+			const std::vector<RayHit> &hits,
+			const uint32_t wall_color,
+			const uint32_t ceiling_color,
+			const uint32_t floor_color,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr){
+	return compose_wall_columns(frame_view(image, image_width, image_height).sub_view(view_x, 0, image_width,
+											  image_height),
+				    hits, wall_color, ceiling_color, floor_color, shading, lighting);
+}
+
+#endif
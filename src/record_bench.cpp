@@ -0,0 +1,183 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include "mapfile.h"
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "recording.h"
+
+/*-------------------------------------
+Name: render_frame
+Description: Draws the frame gameloop would show for pose p: the minimap and
+	the lit, shaded wall columns, on a light gray clear.
+
+Purpose: A deterministic frame source, so the decoded recording can be
+	checked against a fresh render.
+--------------------------------------*/
+void render_frame(std::vector<uint32_t> &framebuffer,
+		const size_t width,
+		const size_t height,
+		const std::string &map,
+		const size_t map_width,
+		const size_t map_height,
+		const Pose &p,
+		RayCache &ray_cache,
+		std::vector<RayHit> &hits,
+		const ShadeTable &shading,
+		const LightMap &lighting){
+	std::fill(framebuffer.begin(), framebuffer.end(), packcolor(200, 200, 200));
+	const size_t rect_width = width/(map_width*2);
+	const size_t rect_height = height/map_height;
+	for(size_t j=0; j<map_height; j++)
+		for(size_t i=0; i<map_width; i++)
+			if(map[i+j*map_width] != ' ')
+				draw_rectangle(framebuffer, width, height, i*rect_width, j*rect_height,
+						rect_width, rect_height, packcolor(0, 255, 255));
+	draw_rectangle(framebuffer, width, height, p.x*rect_width - 2, p.y*rect_height - 2, 5, 5,
+			packcolor(255, 0, 0));
+	cast_columns_cached(ray_cache, map.data(), map_width, map_height, p.x, p.y, p.a, M_PI/3.,
+			width/2, hits);
+	draw_wall_columns(framebuffer, width, height, width/2, hits, packcolor(0, 255, 255), &shading, &lighting);
+}
+
+
+/*-------------------------------------
+Name: check_corrupt_frames
+Description: Feeds decode_frame damaged data: every cut of an encoded frame
+	short of its end, a varint whose continuation runs past the data, and
+	spans whose first row plus length wrap around or pass the bottom of
+	the frame, whose column passes the right edge, or whose runs overrun
+	the span. Every one must be rejected, and none may write outside the
+	frame, which sits between guard rows that are checked afterwards.
+	Returns the number of failures.
+
+Purpose: decode_frame reads files; a corrupt one must fail, not overflow.
+--------------------------------------*/
+size_t check_corrupt_frames(const std::vector<uint32_t> &image, const size_t width, const size_t height){
+	const uint32_t guard = 0xdeadbeef;
+	std::vector<uint32_t> span, storage((height + 2)*width, guard);
+	uint32_t *frame = storage.data() + width;
+	std::vector<uint8_t> encoded;
+	encode_frame(image.data(), nullptr, width, height, span, encoded);
+
+	std::vector<std::vector<uint8_t>> corrupt;
+	for(size_t cut=0; cut<encoded.size(); cut += 1 + cut/64)
+		corrupt.emplace_back(encoded.begin(), encoded.begin() + cut);
+	corrupt.push_back({0x81, 0x80, 0x80});
+	//(first, length) spans of one column, and a run longer than its span
+	const uint64_t spans[][4] = {{0, height - 1, UINT64_MAX, 1}, {0, height - 1, 2, 2}, {0, 0, height + 1, height + 1},
+				     {width, 0, 1, 1}, {0, 0, 2, 3}};
+	for(const auto &bad : spans){
+		std::vector<uint8_t> data;
+		put_varint(data, 1);
+		for(const uint64_t v : {bad[0], bad[1], bad[2], bad[3]}) put_varint(data, v);
+		data.insert(data.end(), 4, 0);
+		corrupt.push_back(data);
+	}
+
+	size_t failures = 0;
+	for(const std::vector<uint8_t> &data : corrupt)
+		if(decode_frame(data.data(), data.size(), frame, width, height)) failures++;
+	for(size_t i=0; i<width; i++)
+		if(storage[i] != guard || storage[(height + 1)*width + i] != guard){
+			failures++;
+			break;
+		}
+	if(!decode_frame(encoded.data(), encoded.size(), frame, width, height) ||
+	   !std::equal(image.begin(), image.end(), frame))
+		failures++;
+	std::cout << corrupt.size() << " corrupt frames fed to the decoder, " << failures << " failures\n";
+	return failures;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Renders the scripted session at 1024x512, first on its own and
+	then recording every frame with keyframes only and with a keyframe
+	every 60 frames, paced at 60 frames per second like gameloop. Prints
+	for each recording the size against raw frames, the sustained bandwidth,
+	the encoder's time per frame, the render thread's time handing frames
+	over, and the process CPU time per frame against rendering alone. Each
+	recording is then decoded and compared with a fresh render of every
+	recorded frame; the program exits with 1 on any difference, or if
+	check_corrupt_frames finds the decoder accepting damaged data.
+
+	usage: record_bench [map file]
+
+Purpose: Measures what recording a session costs in disk bandwidth and CPU.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+	const std::vector<Pose> poses = scripted_session();
+	const size_t width = 1024, height = 512;
+	const char *filename = "./outSession.rec";
+	std::vector<uint32_t> framebuffer(width*height), expected(width*height);
+	std::vector<RayHit> hits;
+	RayCache ray_cache;
+
+	std::clock_t cpu_start = std::clock();
+	for(const Pose &p : poses)
+		render_frame(framebuffer, width, height, map, map_width, map_height, p, ray_cache, hits, shading, lighting);
+	const double render_cpu = double(std::clock() - cpu_start)/CLOCKS_PER_SEC/poses.size();
+	std::cout << poses.size() << " frames of " << width << "x" << height << ", "
+		  << width*height*4/1e6 << " MB raw each; render alone " << render_cpu*1000 << " ms CPU per frame\n";
+
+	int status = check_corrupt_frames(framebuffer, width, height) ? 1 : 0;
+	for(const size_t interval : {size_t(1), size_t(60)}){
+		FrameRecorder recorder;
+		if(!recorder.open(filename, width, height, interval)) return 1;
+		cpu_start = std::clock();
+		auto next = clock::now();
+		for(const Pose &p : poses){
+			render_frame(framebuffer, width, height, map, map_width, map_height, p, ray_cache, hits, shading, lighting);
+			recorder.submit(frame_view(framebuffer, width, height));
+			next += std::chrono::microseconds(16667);
+			std::this_thread::sleep_until(next);
+		}
+		recorder.close();
+		const double cpu = double(std::clock() - cpu_start)/CLOCKS_PER_SEC/poses.size();
+		const RecordingStats &stats = recorder.stats();
+		std::cout << (interval == 1 ? "keyframes only: " : "keyframe every 60: ")
+			  << stats.frames << " frames, " << stats.dropped << " dropped, "
+			  << stats.bytes/1e6 << " MB (" << double(stats.raw_bytes)/stats.bytes << ":1), "
+			  << stats.bytes/1e6/stats.wall_seconds << " MB/s sustained\n"
+			  << "  encoder " << stats.encode_seconds*1000/stats.frames << " ms per frame, submit "
+			  << stats.submit_seconds*1e6/stats.frames << " us per frame, process CPU "
+			  << cpu*1000 << " ms per frame (+" << (cpu - render_cpu)*1000 << " ms)\n";
+
+		RecordingReader reader;
+		std::vector<uint32_t> frame;
+		if(!open_recording(filename, reader, frame)) return 1;
+		uint64_t index;
+		bool keyframe;
+		size_t decoded = 0, mismatched = 0;
+		while(read_recorded_frame(reader, frame, index, keyframe)){
+			render_frame(expected, width, height, map, map_width, map_height, poses[index], ray_cache, hits,
+				     shading, lighting);
+			mismatched += frame != expected;
+			decoded++;
+		}
+		std::cout << "  decoded " << decoded << " frames, " << mismatched << " differ from a fresh render\n";
+		if(decoded != stats.frames || mismatched) status = 1;
+	}
+	std::remove(filename);
+	return status;
+}
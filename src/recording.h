@@ -0,0 +1,392 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include "pixelformat.h"
+#include "framebuffer.h"
+#include "pvs.h" //put_varint, get_varint
+
+/*-------------------------------------
+Name: encode_frame
+Description: Appends one frame of a recording to out, relative to prev (the
+	frame before it in the recording) or, with prev nullptr, on its own as a
+	keyframe. Only columns that changed are stored, and of each only the
+	span from its first to its last changed row:
+
+		varint changed column count
+		per changed column: varint gap since the previous changed column,
+		varint first row, varint span length, then (varint run length,
+		uint32 color) runs covering the span
+
+	A keyframe stores every column whole. Raycaster frames are vertical runs
+	(ceiling, one wall slice, floor) next to minimap rectangles, so a column
+	is a handful of runs, and a still or slowly turning view changes few
+	columns at all. span is scratch of two entries per column.
+
+Purpose: The codec of the recording format, run on the encoder thread.
+--------------------------------------*/
+inline void encode_frame(const uint32_t *frame,
+			const uint32_t *prev,
+			const size_t width,
+			const size_t height,
+			std::vector<uint32_t> &span,
+			std::vector<uint8_t> &out){
+	span.resize(width*2);
+	uint32_t *first = span.data(), *last = span.data() + width;
+	if(!prev){
+		std::fill(first, first + width, 0u);
+		std::fill(last, last + width, uint32_t(height));
+	} else {
+		//row by row, so both frames are read in memory order
+		std::fill(first, first + width, uint32_t(height));
+		std::fill(last, last + width, 0u);
+		for(size_t y=0; y<height; y++){
+			const uint32_t *row = frame + y*width, *prev_row = prev + y*width;
+			if(std::memcmp(row, prev_row, width*sizeof(uint32_t)) == 0) continue;
+			for(size_t x=0; x<width; x++){
+				if(row[x] == prev_row[x]) continue;
+				first[x] = std::min(first[x], uint32_t(y));
+				last[x] = uint32_t(y + 1);
+			}
+		}
+	}
+	size_t changed = 0;
+	for(size_t x=0; x<width; x++) changed += first[x] < last[x];
+	put_varint(out, changed);
+	size_t next = 0;
+	for(size_t x=0; x<width; x++){
+		if(first[x] >= last[x]) continue;
+		put_varint(out, x - next);
+		put_varint(out, first[x]);
+		put_varint(out, last[x] - first[x]);
+		next = x + 1;
+		const uint32_t *pixel = frame + x + size_t(first[x])*width;
+		for(uint32_t y = first[x]; y < last[x];){
+			const uint32_t color = *pixel;
+			uint32_t run = 0;
+			do {
+				run++;
+				pixel += width;
+			} while(y + run < last[x] && *pixel == color);
+			put_varint(out, run);
+			const size_t at = out.size();
+			out.resize(at + 4);
+			std::memcpy(out.data() + at, &color, 4);
+			y += run;
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: decode_frame
+Description: Applies one frame encoded by encode_frame to frame, which must
+	hold the frame before it (anything, for a keyframe). Returns false if the
+	data is cut short, runs on past its last column or names a column or
+	rows outside the frame; nothing outside the frame is ever written.
+
+Purpose: The inverse of encode_frame.
+--------------------------------------*/
+inline bool decode_frame(const uint8_t *data,
+			const size_t size,
+			uint32_t *frame,
+			const size_t width,
+			const size_t height){
+	//the data comes from a file: every varint is read against end, and every
+	//span is checked to lie inside the frame before a pixel is written
+	const uint8_t *p = data, *end = data + size;
+	uint64_t changed;
+	if(!get_varint(p, end, changed) || changed > width) return false;
+	size_t x = 0;
+	for(uint64_t c=0; c<changed; c++){
+		uint64_t gap, first, length;
+		if(!get_varint(p, end, gap) || !get_varint(p, end, first) || !get_varint(p, end, length)) return false;
+		if(gap >= width - x || first >= height || length > height - first) return false;
+		x += gap;
+		uint32_t *pixel = frame + x + first*width;
+		for(uint64_t y=0; y<length;){
+			uint64_t run;
+			if(!get_varint(p, end, run) || run == 0 || run > length - y || end - p < 4) return false;
+			uint32_t color;
+			std::memcpy(&color, p, 4);
+			p += 4;
+			for(uint64_t i=0; i<run; i++, pixel += width) *pixel = color;
+			y += run;
+		}
+		x++;
+	}
+	return p == end;
+}
+
+
+/*-------------------------------------
+Name: RecordingStats
+Description: What a FrameRecorder did. raw_bytes is what the recorded frames
+	would take uncompressed; encode_seconds is the time the encoder thread
+	spent encoding and writing, submit_seconds the time the render thread
+	spent handing frames over, and wall_seconds the time from the first
+	submitted frame to close.
+
+Purpose: The bandwidth and CPU cost of recording, for gameloop and
+	record_bench to report.
+--------------------------------------*/
+struct RecordingStats {
+	size_t frames = 0;
+	size_t keyframes = 0;
+	size_t dropped = 0;
+	uint64_t bytes = 0;
+	uint64_t raw_bytes = 0;
+	double encode_seconds = 0;
+	double submit_seconds = 0;
+	double wall_seconds = 0;
+};
+
+constexpr char recording_magic[4] = {'R', 'E', 'C', '1'};
+constexpr uint64_t max_recording_pixels = uint64_t(1) << 28;
+
+
+/*-------------------------------------
+Name: FrameRecorder
+Description: Streams frames to a recording file. The file starts with the
+	magic "REC1", then width, height and keyframe interval as uint32 and the
+	framebuffer's r, g, b and a shifts as bytes; each frame follows as its
+	index and payload size (uint32), a keyframe flag byte and the
+	encode_frame payload. Every keyframe_interval-th recorded frame is a
+	keyframe, so playback can start there.
+
+	submit copies a finished frame, row by row whatever its pitch, into one
+	of queue_depth preallocated buffers and returns; a background thread encodes against the previous
+	recorded frame and writes. If the encoder falls behind and every buffer
+	is taken, submit drops the frame rather than stall the renderer, and
+	returns false. Dropped frames leave a gap in the frame indices, which
+	the decoder fills by repeating the frame before.
+
+Purpose: Lets a session be recorded as it is played, at a small fraction of
+	the 2 MB a 1024x512 frame takes raw, without slowing the frame loop.
+--------------------------------------*/
+class FrameRecorder {
+public:
+	FrameRecorder() = default;
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder &operator=(const FrameRecorder&) = delete;
+	~FrameRecorder(){ close(); }
+
+	bool open(const std::string filename,
+		  const size_t frame_width,
+		  const size_t frame_height,
+		  const size_t interval = 60,
+		  const size_t queue_depth = 4){
+		close();
+		file.open(filename, std::ios::binary);
+		if(!file){
+			std::cerr << "Failed to write recording: " << filename << "\n";
+			return false;
+		}
+		width = frame_width;
+		height = frame_height;
+		keyframe_interval = std::max<size_t>(interval, 1);
+		const uint32_t header[3] = {uint32_t(width), uint32_t(height), uint32_t(keyframe_interval)};
+		const uint8_t shifts[4] = {FramebufferFormat::r_shift, FramebufferFormat::g_shift,
+					   FramebufferFormat::b_shift, FramebufferFormat::a_shift};
+		file.write(recording_magic, 4);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(shifts), sizeof(shifts));
+		counters = RecordingStats();
+		counters.bytes = 4 + sizeof(header) + sizeof(shifts);
+		//everything the two threads touch per frame is allocated here
+		slots.assign(std::max<size_t>(queue_depth, 1), std::vector<uint32_t>(width*height));
+		slot_index.assign(slots.size(), 0);
+		previous.assign(width*height, 0);
+		span.reserve(width*2);
+		//worst case: every pixel its own run, five bytes each
+		payload.reserve(width*(height*5 + 16) + 16);
+		head = tail = next_index = 0;
+		stopping = false;
+		encoder = std::thread(&FrameRecorder::encode_loop, this);
+		return true;
+	}
+
+	bool recording() const { return encoder.joinable(); }
+
+	bool submit(const FrameView<uint32_t> frame){
+		assert(frame.width == width && frame.height == height);
+		typedef std::chrono::steady_clock clock;
+		const auto start = clock::now();
+		if(next_index == 0) started = start;
+		const uint64_t index = next_index++;
+		size_t slot;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(tail - head == slots.size()){
+				counters.dropped++;
+				return false;
+			}
+			slot = tail % slots.size();
+		}
+		//the encoder only reads slots below tail, so this one is ours
+		for(size_t y=0; y<height; y++)
+			std::memcpy(slots[slot].data() + y*width, frame.row(y), width*sizeof(uint32_t));
+		slot_index[slot] = index;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tail++;
+			counters.submit_seconds += std::chrono::duration<double>(clock::now() - start).count();
+		}
+		ready.notify_one();
+		return true;
+	}
+
+	//finishes the queued frames, then closes the file
+	void close(){
+		if(!encoder.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		ready.notify_one();
+		encoder.join();
+		counters.wall_seconds = next_index ? std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() : 0;
+		file.close();
+		if(!file) std::cerr << "Failed to finish recording\n";
+	}
+
+	//consistent once close has returned
+	const RecordingStats &stats() const { return counters; }
+
+private:
+	void encode_loop(){
+		typedef std::chrono::steady_clock clock;
+		for(;;){
+			size_t slot;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready.wait(lock, [this]{ return head < tail || stopping; });
+				if(head == tail) return;
+				slot = head % slots.size();
+			}
+			const auto start = clock::now();
+			const bool keyframe = counters.frames % keyframe_interval == 0;
+			payload.clear();
+			encode_frame(slots[slot].data(), keyframe ? nullptr : previous.data(), width, height, span, payload);
+			const uint32_t record[2] = {uint32_t(slot_index[slot]), uint32_t(payload.size())};
+			const uint8_t flag = keyframe;
+			file.write(reinterpret_cast<const char*>(record), sizeof(record));
+			file.write(reinterpret_cast<const char*>(&flag), 1);
+			file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+			//the frame becomes the reference for the next; the old reference
+			//becomes a free buffer
+			previous.swap(slots[slot]);
+			std::lock_guard<std::mutex> lock(mutex);
+			counters.frames++;
+			counters.keyframes += keyframe;
+			counters.bytes += sizeof(record) + 1 + payload.size();
+			counters.raw_bytes += width*height*sizeof(uint32_t);
+			counters.encode_seconds += std::chrono::duration<double>(clock::now() - start).count();
+			head++;
+		}
+	}
+
+	std::ofstream file;
+	size_t width = 0, height = 0, keyframe_interval = 1;
+	std::vector<std::vector<uint32_t>> slots;
+	std::vector<uint64_t> slot_index;
+	std::vector<uint32_t> previous, span;
+	std::vector<uint8_t> payload;
+	size_t head = 0, tail = 0; //frames taken by the encoder, frames submitted
+	uint64_t next_index = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::thread encoder;
+	RecordingStats counters;
+	std::chrono::steady_clock::time_point started;
+};
+
+
+/*-------------------------------------
+Name: RecordingReader, open_recording, read_recorded_frame
+Description: Plays a recording back. open_recording reads the header and
+	rejects files that are not recordings or whose frames are empty or
+	over max_recording_pixels; read_recorded_frame then applies the next
+	record to frame (sized by open_recording) and reports its index and
+	whether it was a keyframe. It returns false at the end of the file,
+	and also, with a message, if a record is corrupt or longer than any
+	frame can encode to.
+
+Purpose: The decoder side of FrameRecorder.
+--------------------------------------*/
+struct RecordingReader {
+	std::ifstream file;
+	size_t width = 0;
+	size_t height = 0;
+	size_t keyframe_interval = 0;
+	uint8_t r_shift = 0, g_shift = 0, b_shift = 0, a_shift = 0;
+	std::vector<uint8_t> payload;
+};
+
+inline bool open_recording(const std::string filename, RecordingReader &reader, std::vector<uint32_t> &frame){
+	reader.file.open(filename, std::ios::binary);
+	char magic[4];
+	uint32_t header[3];
+	uint8_t shifts[4];
+	reader.file.read(magic, 4);
+	reader.file.read(reinterpret_cast<char*>(header), sizeof(header));
+	reader.file.read(reinterpret_cast<char*>(shifts), sizeof(shifts));
+	if(!reader.file || std::memcmp(magic, recording_magic, 4) != 0){
+		std::cerr << "Not a recording: " << filename << "\n";
+		return false;
+	}
+	if(header[0] == 0 || header[1] == 0 || uint64_t(header[0])*header[1] > max_recording_pixels){
+		std::cerr << "Recording " << filename << " has an impossible frame size\n";
+		return false;
+	}
+	reader.width = header[0];
+	reader.height = header[1];
+	reader.keyframe_interval = header[2];
+	reader.r_shift = shifts[0];
+	reader.g_shift = shifts[1];
+	reader.b_shift = shifts[2];
+	reader.a_shift = shifts[3];
+	frame.assign(reader.width*reader.height, 0);
+	return true;
+}
+
+inline bool read_recorded_frame(RecordingReader &reader,
+			std::vector<uint32_t> &frame,
+			uint64_t &frame_index,
+			bool &keyframe){
+	uint32_t record[2];
+	uint8_t flag;
+	reader.file.read(reinterpret_cast<char*>(record), sizeof(record));
+	if(reader.file.gcount() == 0) return false;
+	reader.file.read(reinterpret_cast<char*>(&flag), 1);
+	//no frame encodes to more than its column headers and a 14 byte run
+	//per pixel
+	if(!reader.file || record[1] > reader.width*(30 + reader.height*14) + 10){
+		std::cerr << "Recording is corrupt at frame " << record[0] << "\n";
+		return false;
+	}
+	reader.payload.resize(record[1]);
+	reader.file.read(reinterpret_cast<char*>(reader.payload.data()), record[1]);
+	if(!reader.file ||
+	   !decode_frame(reader.payload.data(), reader.payload.size(), frame.data(), reader.width, reader.height)){
+		std::cerr << "Recording is corrupt at frame " << record[0] << "\n";
+		return false;
+	}
+	frame_index = record[0];
+	keyframe = flag != 0;
+	return true;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include "mapfile.h"
+#include "lighting.h"
+#include "raycache.h"
+#include "session.h"
+#include "map_edit.h"
+#include "hotreload.h"
+
+/*-------------------------------------
+Name: main
+Description: Copies the map to a scratch file, watches it with FileWatcher
+	and saves rounds edited versions of it the way editors do, to a new
+	file renamed over the old one, each with cells inner cells flipped
+	between wall and floor. For every save it times how long the change
+	took to be noticed, the parse and diff of decode_map_reload and the
+	update of the lighting and ray cache through set_map_cell and
+	apply_map_edits, against loading the file again and rebaking the
+	lighting and ray cache from scratch. Checks that the map it keeps up
+	to date ends equal to the last file written.
+
+	usage: reload_bench [rounds] [cells] [map file]
+
+Purpose: Shows what a live reload costs the frame it lands in, and how
+	quickly a save shows up.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	const size_t rounds = argc > 1 ? std::stoul(argv[1]) : 20;
+	const size_t cells = argc > 2 ? std::stoul(argv[2]) : 8;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(argc > 3 ? argv[3] : "maps/level1.map", map, map_width, map_height, &extra)) return 1;
+	if(map_width < 3 || map_height < 3){
+		std::cerr << "The map is too small to edit inside its outer wall\n";
+		return 1;
+	}
+	const std::vector<Light> lights = parse_lights(extra);
+	const std::string file = "/tmp/reload_bench.map", scratch = file + ".new";
+	if(!save_map_file(file, map.data(), map_width, map_height, extra)) return 1;
+
+	FileWatcher watcher;
+	if(!watcher.watch(file)) return 1;
+	LightMap lighting = bake_lighting(map.data(), map_width, map_height, lights);
+	const Pose pose = scripted_session(1)[0];
+	const float fov = M_PI/3.;
+	std::vector<RayHit> hits;
+	RayCache ray_cache;
+	cast_columns_cached(ray_cache, map.data(), map_width, map_height, pose.x, pose.y, pose.a, fov, 512, hits);
+
+	std::string live = map, baseline = map, written = map;
+	MapEdits edits;
+	std::mt19937 rng(1);
+	double notify_us = 0, decode_us = 0, apply_us = 0, full_us = 0;
+	size_t changed = 0, missed = 0;
+	for(size_t r=0; r<rounds; r++){
+		for(size_t i=0; i<cells; i++){
+			const size_t x = 1 + rng() % (map_width - 2), y = 1 + rng() % (map_height - 2);
+			char &cell = written[x + y*map_width];
+			cell = cell == ' ' ? '1' : ' ';
+		}
+		if(!save_map_file(scratch, written.data(), map_width, map_height, extra)) return 1;
+		const auto saved = clock::now();
+		if(std::rename(scratch.c_str(), file.c_str()) != 0){
+			std::cerr << "Cannot rename " << scratch << " to " << file << "\n";
+			return 1;
+		}
+		bool seen = false;
+		while(!(seen = watcher.changed()) && clock::now() - saved < std::chrono::seconds(2))
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		if(!seen) missed++;
+		notify_us += std::chrono::duration<double, std::micro>(clock::now() - saved).count();
+
+		std::ifstream in(file, std::ios::binary);
+		const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		MapReload reload;
+		auto t = clock::now();
+		if(!decode_map_reload(bytes, file, baseline, map_width, map_height, reload)) return 1;
+		decode_us += std::chrono::duration<double, std::micro>(clock::now() - t).count();
+
+		t = clock::now();
+		for(const std::pair<uint32_t, char> &change : reload.changes)
+			set_map_cell(live, map_width, map_height, change.first % map_width, change.first / map_width,
+				     change.second, edits);
+		apply_map_edits(edits, live, &lighting, nullptr, &ray_cache);
+		cast_columns_cached(ray_cache, live.data(), map_width, map_height, pose.x, pose.y, pose.a, fov, 512, hits);
+		apply_us += std::chrono::duration<double, std::micro>(clock::now() - t).count();
+		changed += reload.changes.size();
+
+		t = clock::now();
+		std::string full;
+		size_t w = 0, h = 0;
+		std::vector<std::string> full_extra;
+		if(!load_map_file(file, full, w, h, &full_extra)) return 1;
+		const LightMap rebaked = bake_lighting(full.data(), w, h, parse_lights(full_extra));
+		RayCache fresh;
+		cast_columns_cached(fresh, full.data(), w, h, pose.x, pose.y, pose.a, fov, 512, hits);
+		full_us += std::chrono::duration<double, std::micro>(clock::now() - t).count();
+	}
+	std::remove(file.c_str());
+
+	std::cout << map_width << "x" << map_height << ", " << rounds << " saves of " << cells << " flipped cells, "
+		  << changed << " cells changed in all\n"
+		  << "noticed after " << notify_us/rounds << " us on average, " << missed << " saves missed\n"
+		  << "parse and diff " << decode_us/rounds << " us, update " << apply_us/rounds << " us per save\n"
+		  << "full reload and rebuild " << full_us/rounds << " us per save\n"
+		  << "map " << (live == written ? "matches" : "DOES NOT match") << " the file\n";
+	return live == written ? 0 : 1;
+}
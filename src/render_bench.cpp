@@ -0,0 +1,60 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "mapfile.h"
+
+/*-------------------------------------
+Name: main
+Description: Renders the 3D view of a map headless at 1920x1080 along a fixed
+	camera path (a slow turn in place), once with flat walls and once with
+	distance shading and fog, and reports the average cast time, the average
+	wall drawing time and the total frame time of each.
+
+	usage: render_bench [map file]
+
+Purpose: Measures what the shading tables add to a frame at 1080p; the
+	first few frames are also written out as PPM images to check the look.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	if(!load_map_file(argc > 1 ? argv[1] : "maps/level1.map", map, map_width, map_height)) return 1;
+
+	const size_t width = 1920, height = 1080;
+	const int frames = 120;
+	const float fov = M_PI/3.;
+	const float player_x = 5.956, player_y = 11.345;
+	std::vector<uint32_t> framebuffer(width*height);
+	std::vector<RayHit> hits;
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+
+	for(int shaded=0; shaded<2; shaded++){
+		double cast_s = 0, draw_s = 0, total_s = 0;
+		for(int f=0; f<frames; f++){
+			const float player_a = -1.5f + .05f*f;
+			auto t0 = clock::now();
+			std::fill(framebuffer.begin(), framebuffer.end(), packcolor(200, 200, 200));
+			auto t1 = clock::now();
+			cast_columns(map.data(), map_width, map_height, player_x, player_y, player_a, fov, width, hits);
+			auto t2 = clock::now();
+			draw_wall_columns(framebuffer, width, height, 0, hits, packcolor(0, 255, 255),
+					shaded ? &shading : nullptr);
+			auto t3 = clock::now();
+			cast_s += std::chrono::duration<double>(t2-t1).count();
+			draw_s += std::chrono::duration<double>(t3-t2).count();
+			total_s += std::chrono::duration<double>(t3-t0).count();
+			if(f == 0) drop_ppm_image(shaded ? "./outShaded.ppm" : "./outFlat.ppm", framebuffer, width, height);
+		}
+		std::cout << (shaded ? "shaded" : "flat  ")
+			  << "\tcast " << cast_s*1000/frames << " ms"
+			  << "\tdraw " << draw_s*1000/frames << " ms"
+			  << "\tframe " << total_s*1000/frames << " ms\n";
+	}
+	return 0;
+}
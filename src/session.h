@@ -0,0 +1,103 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cmath>
+
+/*-------------------------------------
+Name: Pose
+Description: The player's position and view angle for one frame.
+
+Purpose: A play session is recorded as one pose per frame, which is enough to
+	replay exactly what the renderer was asked to draw.
+--------------------------------------*/
+struct Pose {
+	float x = 0;
+	float y = 0;
+	float a = 0;
+};
+
+
+/*-------------------------------------
+Name: save_pose, load_poses
+Description: Pose sessions are text files with one "x y a" line per frame.
+	save_pose appends a single frame to an open stream; load_poses reads a
+	whole session back.
+
+Purpose: Lets gameloop record real play and lets the benchmarks replay it.
+--------------------------------------*/
+inline void save_pose(std::ofstream &ofs, const Pose &pose){
+	ofs << pose.x << " " << pose.y << " " << pose.a << "\n";
+}
+
+inline bool load_poses(const std::string filename, std::vector<Pose> &poses){
+	std::ifstream ifs(filename);
+	if(!ifs){
+		std::cerr << "Failed to open session file: " << filename << "\n";
+		return false;
+	}
+	poses.clear();
+	Pose pose;
+	while(ifs >> pose.x >> pose.y >> pose.a) poses.push_back(pose);
+	return true;
+}
+
+
+/*-------------------------------------
+Name: parse_start_pose
+Description: Picks the "start <x> <y> <a>" line out of the extra lines of a
+	map file into pose. Returns false, leaving pose alone, if there is none.
+
+Purpose: Lets a map say where the player begins, so generated maps do not
+	start the player inside a wall.
+--------------------------------------*/
+inline bool parse_start_pose(const std::vector<std::string> &lines, Pose &pose){
+	for(const std::string &line : lines){
+		std::istringstream iss(line);
+		std::string kind;
+		Pose start;
+		if(!(iss >> kind) || kind != "start") continue;
+		if(!(iss >> start.x >> start.y >> start.a)) continue;
+		pose = start;
+		return true;
+	}
+	return false;
+}
+
+
+/*-------------------------------------
+Name: scripted_session
+Description: Builds a repeatable stand-in for a recorded session on the demo
+	map: the player walks, stops, looks around and walks again, using the
+	same .5 step and .05 turn as the keyboard controls. Key repeat is slower
+	than the frame rate, so most frames repeat the previous pose.
+
+Purpose: Gives the benchmarks something realistic to replay when no recording
+	is at hand.
+--------------------------------------*/
+inline std::vector<Pose> scripted_session(const size_t frames = 1200){
+	std::vector<Pose> poses;
+	Pose pose;
+	pose.x = 5.956;
+	pose.y = 11.345;
+	pose.a = -1.5;
+	const char script[] = "wwwwddddddddddddiiiiaaaaaaaaaaaaaaaaaaaaiiiissssddddddddddddddddwwwwiiiiiiii";
+	for(size_t f=0; f<frames; f++){
+		//one input every 4 frames, like a held key at 15 repeats a second
+		if(f % 4 == 0){
+			char action = script[(f/4) % (sizeof(script) - 1)];
+			if(action == 'w'){ pose.x += cos(pose.a)*.5f; pose.y += sin(pose.a)*.5f; }
+			if(action == 's'){ pose.x -= cos(pose.a)*.5f; pose.y -= sin(pose.a)*.5f; }
+			if(action == 'a') pose.a -= .05f;
+			if(action == 'd') pose.a += .05f;
+		}
+		poses.push_back(pose);
+	}
+	return poses;
+}
+
+#endif
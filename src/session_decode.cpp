@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "pixelformat.h"
+#include "recording.h"
+
+/*-------------------------------------
+Name: main
+Description: Decodes a recording made with `gameloop --record-frames` into a
+	numbered PPM sequence, <prefix>00000.ppm, <prefix>00001.ppm and so on,
+	one image per frame index. Frames the recorder dropped are filled with
+	the frame before them (frames before the first one recorded with the
+	first), so the sequence keeps the recorded timing. With
+	a frame count only the first frames are written. Prints the frame,
+	keyframe and gap counts.
+
+	usage: session_decode <recording> [prefix] [frames]
+
+Purpose: Turns a compact recording into images any tool can read, e.g.
+	`ffmpeg -i frame%05d.ppm session.mp4`.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 2){
+		std::cerr << "usage: " << argv[0] << " <recording> [prefix] [frames]\n";
+		return 1;
+	}
+	const std::string prefix = argc > 2 ? argv[2] : "frame";
+	const size_t limit = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : SIZE_MAX;
+	RecordingReader reader;
+	std::vector<uint32_t> frame;
+	if(!open_recording(argv[1], reader, frame)) return 1;
+	if(reader.r_shift != FramebufferFormat::r_shift || reader.b_shift != FramebufferFormat::b_shift){
+		std::cerr << argv[1] << " was recorded in a different pixel format\n";
+		return 1;
+	}
+	std::cout << argv[1] << ": " << reader.width << "x" << reader.height << ", keyframe every "
+		  << reader.keyframe_interval << " frames\n";
+
+	uint64_t index = 0;
+	bool keyframe = false;
+	size_t written = 0, records = 0, keyframes = 0, filled = 0;
+	std::vector<uint8_t> rgb(reader.width*reader.height*3);
+	char name[32];
+	while(written < limit && read_recorded_frame(reader, frame, index, keyframe)){
+		if(records == 0 && !keyframe){
+			std::cerr << "Recording does not start with a keyframe\n";
+			return 1;
+		}
+		//rgb still holds the frame before this one, which the frames
+		//dropped in between repeat
+		for(; records > 0 && written < index && written < limit; written++, filled++){
+			std::snprintf(name, sizeof(name), "%05zu.ppm", written);
+			write_ppm_rgb(prefix + name, rgb.data(), reader.width, reader.height);
+		}
+		records++;
+		keyframes += keyframe;
+		convert_to_rgb24<FramebufferFormat>(frame.data(), rgb.data(), frame.size());
+		//a recording that starts late begins with copies of its first frame
+		for(; written <= index && written < limit; written++){
+			filled += written < index;
+			std::snprintf(name, sizeof(name), "%05zu.ppm", written);
+			write_ppm_rgb(prefix + name, rgb.data(), reader.width, reader.height);
+		}
+	}
+	std::cout << records << " frames decoded (" << keyframes << " keyframes), " << filled
+		  << " dropped frames filled, " << written << " images written\n";
+	return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef SHADING_H
+#define SHADING_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "pixelformat.h"
+
+/*-------------------------------------
+Name: ShadeTable
+Description: Precomputed distance shading and fog. Distances from 0 to
+	max_distance are quantized into buckets; for every bucket and wall side
+	(0 for faces crossed along x, 1 for faces crossed along y) the table holds
+	one 256-entry ramp per color channel that maps an unshaded channel value
+	to its lit and fogged value. fog_level additionally keeps the fog weight
+	of each bucket (0 none, 255 full fog) for callers that only need a
+	brightness level.
+
+Purpose: Shading a pixel becomes three byte lookups instead of a multiply and
+	a blend per channel, and a flat-colored wall slice needs only one lookup
+	for the whole span.
+--------------------------------------*/
+struct ShadeTable {
+	size_t buckets = 0;
+	float max_distance = 0;
+	float buckets_per_unit = 0;
+	std::vector<uint8_t> ramps; //(bucket*2 + side)*3 + channel, 256 entries each
+	std::vector<uint8_t> fog_level; //bucket
+
+	bool empty() const { return buckets == 0; }
+	size_t bucket_of(const float distance) const {
+		const float b = distance*buckets_per_unit;
+		return b <= 0 ? 0 : std::min(buckets - 1, size_t(b));
+	}
+	const uint8_t *ramp(const size_t bucket, const size_t side, const size_t channel) const {
+		return ramps.data() + (((bucket*2 + side)*3 + channel) << 8);
+	}
+};
+
+
+/*-------------------------------------
+Name: build_shade_table
+Description: Fills a ShadeTable. Brightness falls off linearly from 1 at distance
+	0 to min_light at max_distance, faces crossed along y are further scaled
+	by side_factor, and fog blends toward fog_color from fog_start to
+	max_distance.
+
+Purpose: Everything expensive about shading is paid once at startup (or when
+	the fog settings change), never per pixel.
+--------------------------------------*/
+inline ShadeTable build_shade_table(const float max_distance = 20.f,
+				const size_t buckets = 256,
+				const uint32_t fog_color = packcolor(200, 200, 200),
+				const float fog_start = 6.f,
+				const float min_light = .35f,
+				const float side_factor = .8f){
+	ShadeTable table;
+	table.buckets = buckets;
+	table.max_distance = max_distance;
+	table.buckets_per_unit = buckets/max_distance;
+	table.ramps.resize(buckets*2*3*256);
+	table.fog_level.resize(buckets);
+
+	uint8_t fog[4];
+	unpack_color(fog_color, fog[0], fog[1], fog[2], fog[3]);
+	for(size_t b=0; b<buckets; b++){
+		const float d = (b + .5f)/table.buckets_per_unit;
+		const float light = 1.f - (1.f - min_light)*std::min(d/max_distance, 1.f);
+		float f = (d - fog_start)/(max_distance - fog_start);
+		f = std::min(std::max(f, 0.f), 1.f);
+		f = f*f*(3 - 2*f);
+		table.fog_level[b] = uint8_t(f*255 + .5f);
+		for(size_t side=0; side<2; side++){
+			const float lit = light*(side ? side_factor : 1.f);
+			for(size_t c=0; c<3; c++){
+				uint8_t *ramp = table.ramps.data() + (((b*2 + side)*3 + c) << 8);
+				for(int v=0; v<256; v++){
+					const float shaded = v*lit*(1 - f) + fog[c]*f;
+					ramp[v] = uint8_t(std::min(shaded + .5f, 255.f));
+				}
+			}
+		}
+	}
+	return table;
+}
+
+
+/*-------------------------------------
+Name: shade_color
+Description: Returns color lit and fogged for a wall face at the given distance
+	and side, using the table's ramps.
+
+Purpose: Per-span shading for flat-colored walls.
+--------------------------------------*/
+inline uint32_t shade_color(const ShadeTable &table, const uint32_t color,
+			const float distance, const size_t side){
+	const size_t b = table.bucket_of(distance);
+	uint8_t r, g, bl, a;
+	unpack_color(color, r, g, bl, a);
+	return packcolor(table.ramp(b, side, 0)[r], table.ramp(b, side, 1)[g],
+			 table.ramp(b, side, 2)[bl], a);
+}
+
+#endif
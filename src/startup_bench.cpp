@@ -0,0 +1,111 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include "pixelformat.h"
+#include "shading.h"
+#include "terrain.h"
+#include "assets.h"
+
+/*-------------------------------------
+Name: render_view
+Description: Draws the terrain half of a 1024x512 gameloop frame from a fixed
+	camera.
+
+Purpose: The frame both startup paths have to get on screen.
+--------------------------------------*/
+void render_view(std::vector<uint32_t> &image, const Terrain &terrain, const ShadeTable &shading){
+	const size_t width = 1024, height = 512;
+	TerrainCamera camera;
+	camera.x = terrain.width/2;
+	camera.y = terrain.height/2;
+	camera.height = terrain.height_at(camera.x, camera.y) + 40;
+	camera.horizon = height/2;
+	camera.scale = height/2;
+	render_terrain(image, width, width/2, width/2, height, terrain, camera, 2000, .01f, &shading);
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Starts up the way gameloop --terrain does, several times over,
+	and measures the time to the first frame: once loading the terrain on
+	the main thread before drawing, and once through an AssetLoader, drawing
+	frames with a flat placeholder until the terrain is ready and swapping
+	it in between frames. Prints both times to first frame, when the real
+	terrain was in use and how many placeholder frames were drawn, and exits
+	with 1 unless the frame after the swap matches the synchronous one, or
+	if an asset whose decode throws does not simply fail.
+
+	usage: startup_bench <height.pgm> <color.ppm>
+
+Purpose: Shows what streaming assets in does for startup.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " <height.pgm> <color.ppm>\n"
+			  << "make a terrain with terrain_gen\n";
+		return 1;
+	}
+	const std::string height_file = argv[1], color_file = argv[2];
+	const ShadeTable shading = build_shade_table(2000, 256, packcolor(200, 200, 200), 800, 1.f, 1.f);
+	std::vector<uint32_t> sync_frame(1024*512), async_frame(1024*512);
+	auto ms = [](const clock::time_point from){
+		return std::chrono::duration<double, std::milli>(clock::now() - from).count();
+	};
+	//a decode that throws must fail its asset, not the program
+	{
+		AssetLoader loader;
+		AssetHandle<Terrain> asset = loader.load<Terrain>("throwing terrain", {height_file},
+			[](const std::vector<std::vector<uint8_t>> &, Terrain &) -> bool { throw std::bad_alloc(); });
+		while(asset.pending()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if(!asset.failed()){
+			std::cerr << "a throwing decode did not fail its asset\n";
+			return 1;
+		}
+	}
+
+	const int runs = 5;
+	double sync_first = 0, async_first = 0, async_ready = 0;
+	size_t placeholder_frames = 0;
+	bool match = true;
+	for(int run=0; run<runs; run++){
+		auto start = clock::now();
+		Terrain terrain;
+		if(!load_terrain(height_file, color_file, terrain)) return 1;
+		std::fill(sync_frame.begin(), sync_frame.end(), packcolor(200, 200, 200));
+		render_view(sync_frame, terrain, shading);
+		sync_first += ms(start);
+
+		start = clock::now();
+		AssetLoader loader;
+		Terrain shown = flat_terrain(packcolor(96, 112, 80));
+		AssetHandle<Terrain> asset = loader.load<Terrain>("terrain", {height_file, color_file},
+			[&](const std::vector<std::vector<uint8_t>> &files, Terrain &out){
+				ByteStream height_stream(files[0]), color_stream(files[1]);
+				return parse_terrain(height_stream, height_file, color_stream, color_file, out);
+			});
+		for(size_t frame=0; ; frame++){
+			const bool swapped = asset.take(shown);
+			if(swapped) async_ready += ms(start);
+			std::fill(async_frame.begin(), async_frame.end(), packcolor(200, 200, 200));
+			render_view(async_frame, shown, shading);
+			if(frame == 0) async_first += ms(start);
+			if(swapped){
+				match = match && async_frame == sync_frame;
+				break;
+			}
+			if(asset.failed()) return 1;
+			placeholder_frames++;
+		}
+	}
+	std::cout << "terrain loaded before the first frame:  first frame after " << sync_first/runs << " ms\n"
+		  << "terrain streamed in by the asset loader: first frame after " << async_first/runs
+		  << " ms, terrain in use after " << async_ready/runs << " ms, "
+		  << double(placeholder_frames)/runs << " placeholder frames\n"
+		  << "frame after the swap " << (match ? "matches" : "DIFFERS FROM") << " the synchronous one\n";
+	return match ? 0 : 1;
+}
@@ -0,0 +1,285 @@
+#ifndef STATIC_MAP_H
+#define STATIC_MAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+
+/*-------------------------------------
+Name: StaticMap
+Description: A map whose size is part of its type, baked at compile time from a
+	string literal. cells keeps the original characters and occupancy has
+	one bit per cell set for walls. wall_x lists the wall cells row by row,
+	left to right: the walls of row y are at wall_x[row_start[y]] up to
+	wall_x[row_start[y + 1]], so a loop over one row's walls skips its
+	empty cells.
+
+	A mutable copy of a baked map can be edited with set_cell, which keeps
+	the bits and the wall table in step.
+
+Purpose: The compile-time counterpart of the std::string map: with W and H as
+	constants every cell index folds to shifts and adds, and the tables cost
+	nothing at startup.
+--------------------------------------*/
+template<size_t W, size_t H>
+struct StaticMap {
+	static constexpr size_t width = W;
+	static constexpr size_t height = H;
+	static constexpr size_t words = (W*H + 63)/64;
+
+	char cells[W*H] = {};
+	uint64_t occupancy[words] = {};
+	uint16_t wall_x[W*H] = {};
+	uint32_t row_start[H + 1] = {};
+
+	constexpr bool is_wall(const size_t x, const size_t y) const {
+		return (occupancy[(x + y*W) >> 6] >> ((x + y*W) & 63)) & 1;
+	}
+	constexpr char cell(const size_t x, const size_t y) const {
+		return cells[x + y*W];
+	}
+
+	//changes one cell of a live copy; a wall that comes or goes is
+	//inserted into or removed from its row of the table in place
+	constexpr void set_cell(const size_t x, const size_t y, const char c){
+		const size_t i = x + y*W;
+		const bool was_wall = cells[i] != ' ', wall = c != ' ';
+		cells[i] = c;
+		if(was_wall == wall) return;
+		size_t k = row_start[y];
+		while(k < row_start[y + 1] && wall_x[k] < x) k++;
+		const size_t count = row_start[H];
+		if(wall){
+			occupancy[i >> 6] |= uint64_t(1) << (i & 63);
+			for(size_t m=count; m>k; m--) wall_x[m] = wall_x[m - 1];
+			wall_x[k] = uint16_t(x);
+			for(size_t r=y + 1; r<=H; r++) row_start[r]++;
+		} else {
+			occupancy[i >> 6] &= ~(uint64_t(1) << (i & 63));
+			for(size_t m=k; m + 1<count; m++) wall_x[m] = wall_x[m + 1];
+			for(size_t r=y + 1; r<=H; r++) row_start[r]--;
+		}
+	}
+};
+
+
+/*-------------------------------------
+Name: bake_map
+Description: Parses a map literal of exactly W*H characters into a StaticMap.
+	It is constexpr, so used to initialize a constexpr variable it runs
+	entirely in the compiler, and a literal of the wrong size does not
+	compile.
+
+Purpose: e.g.
+	constexpr auto level = bake_map<16, 16>(builtin_map);
+--------------------------------------*/
+template<size_t W, size_t H, size_t N>
+constexpr StaticMap<W, H> bake_map(const char (&literal)[N]){
+	static_assert(N == W*H + 1, "map literal must hold exactly W*H cells");
+	StaticMap<W, H> map;
+	size_t walls = 0;
+	for(size_t i=0; i<W*H; i++){
+		if(i % W == 0) map.row_start[i / W] = uint32_t(walls);
+		map.cells[i] = literal[i];
+		if(literal[i] == ' ') continue;
+		map.occupancy[i >> 6] |= uint64_t(1) << (i & 63);
+		map.wall_x[walls++] = uint16_t(i % W);
+	}
+	map.row_start[H] = uint32_t(walls);
+	return map;
+}
+
+
+/*-------------------------------------
+Name: cast_ray_static
+Description: The .05 march of cast_ray over a StaticMap, stepping exactly the
+	same way so the hits are identical, but testing the occupancy bits with
+	a compile-time row stride. The cost is dominated by the march itself, so
+	it runs at about the speed of cast_ray.
+
+Purpose: The casting kernel of the compile-time path.
+--------------------------------------*/
+template<size_t W, size_t H>
+inline RayHit cast_ray_static(const StaticMap<W, H> &map,
+			const float origin_x,
+			const float origin_y,
+			const float angle,
+			const float max_distance = 20){
+	const float dx = cos(angle);
+	const float dy = sin(angle);
+	RayHit hit;
+	int prev_x = int(origin_x);
+	int prev_y = int(origin_y);
+	for(float t=0; t<max_distance; t+=.05){
+		float cx = origin_x + t*dx;
+		float cy = origin_y + t*dy;
+		if(cx < 0 || cy < 0 || size_t(cx) >= W || size_t(cy) >= H){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			return hit;
+		}
+		if(map.is_wall(int(cx), int(cy))){
+			hit.distance = t;
+			hit.x = cx;
+			hit.y = cy;
+			hit.cell = map.cell(int(cx), int(cy));
+			hit.side = int(cx) == prev_x ? 1 : 0;
+			hit.face_x = prev_x;
+			hit.face_y = prev_y;
+			return hit;
+		}
+		prev_x = int(cx);
+		prev_y = int(cy);
+	}
+	hit.distance = max_distance;
+	hit.x = origin_x + max_distance*dx;
+	hit.y = origin_y + max_distance*dy;
+	return hit;
+}
+
+
+/*-------------------------------------
+Name: cast_columns_static
+Description: cast_columns with the column count fixed at compile time, filling
+	a plain array of Columns hits.
+
+Purpose: Lets the compiler unroll and schedule the column loop.
+--------------------------------------*/
+template<size_t Columns, size_t W, size_t H>
+inline void cast_columns_static(const StaticMap<W, H> &map,
+				const float player_x,
+				const float player_y,
+				const float player_a,
+				const float fov,
+				RayHit (&hits)[Columns]){
+	for(size_t i=0; i<Columns; i++){
+		float angle = player_a-fov/2 + fov*i/float(Columns);
+		hits[i] = cast_ray_static(map, player_x, player_y, angle);
+	}
+}
+
+
+/*-------------------------------------
+Name: draw_wall_columns_static
+Description: draw_wall_columns for a framebuffer of ImageWidth x ImageHeight
+	pixels known at compile time, drawing Columns hits from view_x on, with
+	the same pixels as a result. The span and color of every column is
+	worked out first; the pixels are then written row by row, each row of
+	the view a select between the wall color and what is already there, a
+	loop with constant bounds and stride that the compiler vectorizes,
+	instead of one cache line per pixel going down each column.
+
+Purpose: The drawing kernel of the compile-time path.
+--------------------------------------*/
+template<size_t ImageWidth, size_t ImageHeight, size_t Columns>
+inline void draw_wall_columns_static(uint32_t *image,
+				const size_t view_x,
+				const RayHit (&hits)[Columns],
+				const uint32_t wall_color,
+				const ShadeTable *shading = nullptr,
+				const LightMap *lighting = nullptr){
+	static_assert(Columns <= ImageWidth, "view wider than the image");
+	assert(view_x + Columns <= ImageWidth);
+	uint32_t top[Columns], bottom[Columns], color[Columns];
+	uint32_t first_row = ImageHeight/2;
+	for(size_t i=0; i<Columns; i++){
+		const RayHit &hit = hits[i];
+		top[i] = bottom[i] = 0;
+		if(hit.cell == 0) continue;
+		const size_t column_height = std::min(float(ImageHeight)/std::max(hit.distance, .01f),
+						      float(ImageHeight));
+		top[i] = ImageHeight/2 - column_height/2;
+		bottom[i] = top[i] + column_height;
+		first_row = std::min(first_row, top[i]);
+		color[i] = wall_color;
+		if(lighting && hit.face_x >= 0) color[i] = scale_color(color[i], lighting->light_at(hit.face_x, hit.face_y));
+		if(shading) color[i] = shade_color(*shading, color[i], hit.distance, hit.side);
+	}
+	for(uint32_t j=first_row; j<ImageHeight; j++){
+		uint32_t *row = image + view_x + j*ImageWidth;
+		for(size_t i=0; i<Columns; i++)
+			row[i] = (j >= top[i] && j < bottom[i]) ? color[i] : row[i];
+	}
+}
+
+
+/*-------------------------------------
+Name: compose_wall_columns_static
+Description: compose_wall_columns with the image size and column count known
+	at compile time: every row of the view written once, ceiling, wall or
+	floor, in loops with constant bounds. The image is a view, so its rows
+	may be padded. Returns the number of pixels written.
+
+Purpose: The single-pass drawing kernel of the compile-time path.
+--------------------------------------*/
+template<size_t ImageWidth, size_t ImageHeight, size_t Columns>
+inline size_t compose_wall_columns_static(const FrameView<uint32_t> image,
+				const size_t view_x,
+				const RayHit (&hits)[Columns],
+				const uint32_t wall_color,
+				const uint32_t ceiling_color,
+				const uint32_t floor_color,
+				const ShadeTable *shading = nullptr,
+				const LightMap *lighting = nullptr){
+	static_assert(Columns <= ImageWidth, "view wider than the image");
+	assert(view_x + Columns <= ImageWidth && image.width == ImageWidth && image.height == ImageHeight);
+	uint32_t top[Columns], bottom[Columns], color[Columns];
+	for(size_t i=0; i<Columns; i++){
+		const RayHit &hit = hits[i];
+		top[i] = bottom[i] = ImageHeight/2;
+		color[i] = wall_color;
+		if(hit.cell == 0) continue;
+		const size_t column_height = std::min(float(ImageHeight)/std::max(hit.distance, .01f),
+						      float(ImageHeight));
+		top[i] = ImageHeight/2 - column_height/2;
+		bottom[i] = top[i] + column_height;
+		if(lighting && hit.face_x >= 0) color[i] = scale_color(color[i], lighting->light_at(hit.face_x, hit.face_y));
+		if(shading) color[i] = shade_color(*shading, color[i], hit.distance, hit.side);
+	}
+	return compose_column_spans(image.sub_view(view_x, 0, Columns, ImageHeight), Columns,
+				    top, bottom, color, ceiling_color, floor_color);
+}
+
+
+/*-------------------------------------
+Name: compose_minimap_static
+Description: compose_minimap for a StaticMap drawn into a ViewWidth x ViewHeight
+	view, with cells ViewWidth/W x ViewHeight/H pixels. Each map row is
+	built once as a row of pixels, background with the row's walls from
+	the wall table filled in with color_of(i, j), and copied to every
+	pixel row of the cells; rows below the map are background. Every pixel
+	is written once, the same pixels compose_minimap writes. Returns the
+	number of pixels written.
+
+Purpose: The minimap of the compile-time path, which walks each row's walls
+	instead of testing every cell on every pixel row.
+--------------------------------------*/
+template<size_t ViewWidth, size_t ViewHeight, size_t W, size_t H, typename ColorOf>
+inline size_t compose_minimap_static(const FrameView<uint32_t> view,
+				const StaticMap<W, H> &map,
+				const uint32_t background,
+				ColorOf color_of){
+	constexpr size_t cell_w = ViewWidth/W;
+	constexpr size_t cell_h = ViewHeight/H;
+	static_assert(cell_w > 0 && cell_h > 0, "map too large for the minimap");
+	assert(view.width == ViewWidth && view.height == ViewHeight);
+	uint32_t line[ViewWidth];
+	for(size_t j=0; j<H; j++){
+		std::fill(line, line + ViewWidth, background);
+		for(size_t k=map.row_start[j]; k<map.row_start[j + 1]; k++){
+			const size_t i = map.wall_x[k];
+			std::fill(line + i*cell_w, line + (i + 1)*cell_w, color_of(i, j));
+		}
+		for(size_t y=j*cell_h; y<(j + 1)*cell_h; y++) std::copy(line, line + ViewWidth, view.row(y));
+	}
+	for(size_t y=H*cell_h; y<ViewHeight; y++) std::fill(view.row(y), view.row(y) + ViewWidth, background);
+	return ViewWidth*ViewHeight;
+}
+
+#endif
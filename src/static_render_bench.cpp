@@ -0,0 +1,141 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "pixelformat.h"
+#include "shading.h"
+#include "raycaster.h"
+#include "builtin_map.h"
+#include "static_map.h"
+
+//baked by the compiler, nothing of it runs at startup
+constexpr auto baked_map = bake_map<builtin_map_width, builtin_map_height>(builtin_map);
+static_assert(baked_map.is_wall(0, 0) && !baked_map.is_wall(1, 1), "map baked at compile time");
+
+/*-------------------------------------
+Name: run
+Description: Renders Frames frames of the 3D view at ImageWidth x ImageHeight
+	with Columns columns (a slow turn in place), once through the runtime
+	path (std::string map, cast_columns, draw_wall_columns) and once through
+	the compile-time path (baked_map, cast_columns_static,
+	draw_wall_columns_static), checks that both produce the same image and
+	prints the average cast and draw time of each. Returns false if the
+	images differ.
+
+Purpose: One resolution of the comparison.
+--------------------------------------*/
+template<size_t ImageWidth, size_t ImageHeight, size_t Columns>
+bool run(const ShadeTable &shading){
+	typedef std::chrono::steady_clock clock;
+	const int frames = 240;
+	const float fov = M_PI/3.;
+	const float player_x = 5.956, player_y = 11.345;
+	const std::string map = builtin_map;
+	const size_t view_x = ImageWidth - Columns;
+	std::vector<uint32_t> runtime_image(ImageWidth*ImageHeight), static_image(ImageWidth*ImageHeight);
+	std::vector<RayHit> runtime_hits;
+	static RayHit static_hits[Columns];
+
+	double runtime_cast = 0, runtime_draw = 0, static_cast_s = 0, static_draw = 0;
+	size_t differing = 0;
+	for(int f=0; f<frames; f++){
+		const float player_a = -1.5f + .05f*f;
+		std::fill(runtime_image.begin(), runtime_image.end(), packcolor(200, 200, 200));
+		std::fill(static_image.begin(), static_image.end(), packcolor(200, 200, 200));
+
+		auto t0 = clock::now();
+		cast_columns(map.data(), builtin_map_width, builtin_map_height, player_x, player_y, player_a, fov,
+			     Columns, runtime_hits);
+		auto t1 = clock::now();
+		draw_wall_columns(runtime_image, ImageWidth, ImageHeight, view_x, runtime_hits,
+				  packcolor(0, 255, 255), &shading);
+		auto t2 = clock::now();
+		cast_columns_static(baked_map, player_x, player_y, player_a, fov, static_hits);
+		auto t3 = clock::now();
+		draw_wall_columns_static<ImageWidth, ImageHeight>(static_image.data(), view_x, static_hits,
+								  packcolor(0, 255, 255), &shading);
+		auto t4 = clock::now();
+
+		runtime_cast += std::chrono::duration<double>(t1-t0).count();
+		runtime_draw += std::chrono::duration<double>(t2-t1).count();
+		static_cast_s += std::chrono::duration<double>(t3-t2).count();
+		static_draw += std::chrono::duration<double>(t4-t3).count();
+		differing += runtime_image != static_image;
+	}
+	std::cout << ImageWidth << "x" << ImageHeight << ", " << Columns << " columns\n"
+		  << "  runtime\tcast " << runtime_cast*1000/frames << " ms\tdraw " << runtime_draw*1000/frames << " ms\n"
+		  << "  static \tcast " << static_cast_s*1000/frames << " ms\tdraw " << static_draw*1000/frames << " ms\n"
+		  << "  frames that differ " << differing << "\n";
+	return differing == 0;
+}
+
+/*-------------------------------------
+Name: check_minimap
+Description: Composes the minimap of the built in map at the demo's size
+	through compose_minimap and compose_minimap_static and counts the
+	pixels that differ, first on the baked map and then on a live copy
+	while every inner cell is flipped to a wall or back to empty with
+	set_cell, the string map edited alongside. Prints the mismatches and
+	the time of each kernel; returns false if any pixel differs.
+
+Purpose: Guards the wall table and its upkeep in set_cell, which only the
+	static minimap reads.
+--------------------------------------*/
+bool check_minimap(){
+	typedef std::chrono::steady_clock clock;
+	constexpr size_t view_width = 512, view_height = 512;
+	constexpr size_t cell_w = view_width/builtin_map_width, cell_h = view_height/builtin_map_height;
+	std::string map = builtin_map;
+	auto live = baked_map;
+	std::vector<uint32_t> runtime_image(view_width*view_height), static_image(view_width*view_height);
+	const uint32_t background = packcolor(255, 255, 255);
+	auto color_of = [](const size_t i, const size_t j){ return packcolor(i*16, j*16, 128); };
+
+	double runtime_s = 0, static_s = 0;
+	size_t composes = 0, mismatches = 0;
+	auto compare = [&](){
+		auto t0 = clock::now();
+		compose_minimap(frame_view(runtime_image, view_width, view_height), map.data(), builtin_map_width, builtin_map_height, cell_w, cell_h,
+				background, color_of);
+		auto t1 = clock::now();
+		compose_minimap_static<view_width, view_height>(frame_view(static_image, view_width, view_height), live, background, color_of);
+		auto t2 = clock::now();
+		runtime_s += std::chrono::duration<double>(t1-t0).count();
+		static_s += std::chrono::duration<double>(t2-t1).count();
+		composes++;
+		mismatches += runtime_image != static_image;
+	};
+	compare();
+	for(size_t j=1; j+1<builtin_map_height; j++)
+		for(size_t i=1; i+1<builtin_map_width; i++){
+			const char c = map[i + j*builtin_map_width] == ' ' ? '0' : ' ';
+			map[i + j*builtin_map_width] = c;
+			live.set_cell(i, j, c);
+			compare();
+		}
+	std::cout << "minimap " << view_width << "x" << view_height << ", " << composes << " composes\n"
+		  << "  runtime\t" << runtime_s*1e6/composes << " us\n"
+		  << "  static \t" << static_s*1e6/composes << " us\n"
+		  << "  composes that differ " << mismatches << "\n";
+	return mismatches == 0;
+}
+
+/*-------------------------------------
+Name: main
+Description: Compares the runtime renderer with the compile-time specialized
+	one on the built in map at the demo's window size (the 3D view is the
+	right half) and at 1920x1080, and checks the static minimap.
+
+	usage: static_render_bench
+
+Purpose: Shows what baking the map and the resolution into the kernels buys,
+	and guards that both paths draw the same pixels.
+--------------------------------------*/
+int main(){
+	const ShadeTable shading = build_shade_table(20.f, 256, packcolor(200, 200, 200));
+	bool same = run<1024, 512, 512>(shading);
+	same = run<1920, 1080, 1920>(shading) && same;
+	same = check_minimap() && same;
+	return same ? 0 : 1;
+}
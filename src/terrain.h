@@ -0,0 +1,332 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include "pixelformat.h"
+#include "shading.h"
+#include "framebuffer.h"
+
+/*-------------------------------------
+Name: Terrain
+Description: An outdoor landscape as two images of the same power-of-two size:
+	heights holds the height of every texel (0-255) and colors its packed
+	color. Lookups wrap around at the edges, so the terrain repeats
+	seamlessly in every direction.
+
+Purpose: The world of the heightmap terrain mode.
+--------------------------------------*/
+struct Terrain {
+	size_t width = 0;
+	size_t height = 0;
+	std::vector<uint8_t> heights;
+	std::vector<uint32_t> colors;
+
+	bool empty() const { return width == 0; }
+	size_t index(const long x, const long y) const {
+		return (size_t(x) & (width - 1)) + (size_t(y) & (height - 1))*width;
+	}
+	float height_at(const float x, const float y) const {
+		return heights[index(long(std::floor(x)), long(std::floor(y)))];
+	}
+};
+
+
+/*-------------------------------------
+Name: flat_terrain
+Description: A terrain of a single texel of the given color and height, so
+	flat and one color everywhere.
+
+Purpose: The placeholder drawn while a real terrain is still loading.
+--------------------------------------*/
+inline Terrain flat_terrain(const uint32_t color, const uint8_t level = 0){
+	Terrain terrain;
+	terrain.width = terrain.height = 1;
+	terrain.heights.assign(1, level);
+	terrain.colors.assign(1, color);
+	return terrain;
+}
+
+
+/*-------------------------------------
+Name: parse_pnm, read_pnm
+Description: Reads a binary PGM ("P5") or PPM ("P6") image with 8-bit samples,
+	skipping comment lines in the header. magic picks the kind expected; the
+	samples (one or three bytes per pixel) are returned in data. parse_pnm
+	reads from any stream, name is only for messages; read_pnm opens a file.
+	Sides above max_pnm_side are refused before anything is sized from
+	them, and the samples are read a megabyte at a time, so a short file
+	with a huge header fails as truncated without reserving the memory
+	its header asks for.
+
+Purpose: Terrain images are stored as the same plain formats the demo writes
+	its screenshots in, readable without any image library.
+--------------------------------------*/
+constexpr size_t max_pnm_side = 65536;
+
+inline bool parse_pnm(std::istream &ifs,
+		const std::string name,
+		const std::string magic,
+		size_t &width,
+		size_t &height,
+		std::vector<uint8_t> &data){
+	std::string kind;
+	size_t header[3];
+	ifs >> kind;
+	for(size_t i=0; i<3 && ifs; i++){
+		ifs >> std::ws;
+		while(ifs.peek() == '#'){
+			std::string comment;
+			std::getline(ifs, comment);
+			ifs >> std::ws;
+		}
+		ifs >> header[i];
+	}
+	if(!ifs || kind != magic || header[2] != 255){
+		std::cerr << name << " is not an 8-bit " << magic << " image\n";
+		return false;
+	}
+	if(header[0] > max_pnm_side || header[1] > max_pnm_side){
+		std::cerr << name << " is " << header[0] << "x" << header[1] << ", more than " << max_pnm_side
+			  << " on a side\n";
+		return false;
+	}
+	ifs.get(); //the single whitespace before the samples
+	width = header[0];
+	height = header[1];
+	const size_t bytes = width*height*(magic == "P6" ? 3 : 1);
+	data.clear();
+	while(data.size() < bytes){
+		const size_t at = data.size();
+		data.resize(at + std::min<size_t>(bytes - at, 1 << 20));
+		ifs.read(reinterpret_cast<char*>(data.data() + at), data.size() - at);
+		if(size_t(ifs.gcount()) != data.size() - at){
+			std::cerr << name << " is truncated\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool read_pnm(const std::string filename,
+		const std::string magic,
+		size_t &width,
+		size_t &height,
+		std::vector<uint8_t> &data){
+	std::ifstream ifs(filename, std::ios::binary);
+	if(!ifs){
+		std::cerr << "Failed to open image file: " << filename << "\n";
+		return false;
+	}
+	return parse_pnm(ifs, filename, magic, width, height, data);
+}
+
+
+/*-------------------------------------
+Name: parse_terrain, load_terrain
+Description: Reads a terrain from a PGM heightmap and a PPM colormap. Both must
+	have the same size, a power of two on each side and at most
+	max_pnm_side. The heightmap's size is checked before the colormap is
+	read. parse_terrain takes
+	the two images as streams, load_terrain as file names.
+
+Purpose: Lets landscapes be painted or generated outside the demo.
+--------------------------------------*/
+inline bool parse_terrain(std::istream &height_stream,
+			const std::string height_name,
+			std::istream &color_stream,
+			const std::string color_name,
+			Terrain &terrain){
+	size_t width = 0, height = 0, color_width = 0, color_height = 0;
+	std::vector<uint8_t> rgb;
+	if(!parse_pnm(height_stream, height_name, "P5", width, height, terrain.heights)) return false;
+	if(width == 0 || height == 0 || (width & (width - 1)) || (height & (height - 1))){
+		std::cerr << "Terrain sides must be powers of two\n";
+		return false;
+	}
+	if(!parse_pnm(color_stream, color_name, "P6", color_width, color_height, rgb)) return false;
+	if(color_width != width || color_height != height){
+		std::cerr << "Heightmap and colormap sizes differ\n";
+		return false;
+	}
+	terrain.width = width;
+	terrain.height = height;
+	terrain.colors.resize(width*height);
+	for(size_t i=0; i<width*height; i++)
+		terrain.colors[i] = packcolor(rgb[i*3], rgb[i*3 + 1], rgb[i*3 + 2]);
+	return true;
+}
+
+inline bool load_terrain(const std::string height_file,
+			const std::string color_file,
+			Terrain &terrain){
+	std::ifstream height_stream(height_file, std::ios::binary), color_stream(color_file, std::ios::binary);
+	if(!height_stream || !color_stream){
+		std::cerr << "Failed to open image file: " << (height_stream ? color_file : height_file) << "\n";
+		return false;
+	}
+	return parse_terrain(height_stream, height_file, color_stream, color_file, terrain);
+}
+
+
+/*-------------------------------------
+Name: TerrainCamera, TerrainStats
+Description: Where the terrain is seen from, in texels: position, height above
+	the terrain's zero, view direction (as player_a), the screen row of the
+	horizon (moving it tilts the view) and the vertical scale. TerrainStats
+	counts the samples taken and the pixels written by the last render.
+
+Purpose: Inputs and counters of render_terrain.
+--------------------------------------*/
+struct TerrainCamera {
+	float x = 0;
+	float y = 0;
+	float height = 0;
+	float angle = 0;
+	float horizon = 0;
+	float scale = 240;
+	float fov = M_PI/3.;
+};
+
+struct TerrainStats {
+	size_t samples = 0;
+	size_t steps = 0;
+	size_t pixels = 0;
+};
+
+
+/*-------------------------------------
+Name: render_terrain
+Description: Draws the terrain into a view with the voxel-space technique
+	(the vector form: into the view_width x view_height rectangle of a
+	packed image at view_x). Lines across
+	the view are taken at growing distance from the camera, front to back;
+	on each line every column of the view samples the heightmap once,
+	projects the height to a screen row and draws the column from there
+	down to the highest row drawn so far in that column (its y-buffer
+	entry), then raises the entry. Nearer terrain therefore hides farther
+	terrain without any pixel being written twice, and what is left above
+	the y-buffer at the end is filled with sky_color.
+
+	The first line is one texel away and each step is lod texels longer
+	than the one before (lod = 0 gives fixed one-texel steps), so the lines
+	thin out with distance the same way texels shrink on screen, and the
+	cost grows with the square root of the view distance instead of
+	linearly. The march also stops once every column is filled to the top.
+	With shading the colors are fogged toward the sky by distance in
+	texels.
+
+Purpose: The outdoor rendering mode: hills and valleys to the horizon at the
+	cost of a few samples per column.
+--------------------------------------*/
+inline void render_terrain(const FrameView<uint32_t> view,
+			const Terrain &terrain,
+			const TerrainCamera &camera,
+			const float distance,
+			const float lod = .01f,
+			const ShadeTable *shading = nullptr,
+			const uint32_t sky_color = packcolor(200, 200, 200),
+			TerrainStats *stats = nullptr){
+	const size_t view_width = view.width, view_height = view.height;
+	static thread_local std::vector<int> ybuffer;
+	ybuffer.assign(view_width, int(view_height));
+	TerrainStats local;
+	const float c = std::cos(camera.angle), s = std::sin(camera.angle);
+	const float spread = std::tan(camera.fov/2);
+	size_t open_columns = view_width;
+	float dz = 1;
+	for(float z = 1; z < distance && open_columns > 0; z += dz, dz += lod){
+		local.steps++;
+		//the line at depth z, from the left edge of the view to the right
+		float px = camera.x + z*(c + spread*s);
+		float py = camera.y + z*(s - spread*c);
+		const float step_x = -2*z*spread*s/view_width;
+		const float step_y = 2*z*spread*c/view_width;
+		const float inv_z = camera.scale/z;
+		for(size_t i=0; i<view_width; i++, px += step_x, py += step_y){
+			int &top = ybuffer[i];
+			if(top <= 0) continue;
+			local.samples++;
+			const size_t texel = terrain.index(long(std::floor(px)), long(std::floor(py)));
+			const int row = std::max(0, int((camera.height - terrain.heights[texel])*inv_z + camera.horizon));
+			if(row >= top) continue;
+			uint32_t color = terrain.colors[texel];
+			if(shading) color = shade_color(*shading, color, z, 0);
+			uint32_t *pixel = view.row(row) + i;
+			for(int j=row; j<top; j++, pixel += view.pitch) *pixel = color;
+			local.pixels += top - row;
+			top = row;
+			if(row == 0) open_columns--;
+		}
+	}
+	for(size_t i=0; i<view_width; i++){
+		uint32_t *pixel = view.pixels + i;
+		for(int j=0; j<ybuffer[i]; j++, pixel += view.pitch) *pixel = sky_color;
+		local.pixels += ybuffer[i];
+	}
+	if(stats) *stats = local;
+}
+
+inline void render_terrain(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t view_x,
+			const size_t view_width,
+			const size_t view_height,
+			const Terrain &terrain,
+			const TerrainCamera &camera,
+			const float distance,
+			const float lod = .01f,
+			const ShadeTable *shading = nullptr,
+			const uint32_t sky_color = packcolor(200, 200, 200),
+			TerrainStats *stats = nullptr){
+	assert(view_x + view_width <= image_width && view_height*image_width <= image.size());
+	render_terrain(frame_view(image, image_width, image.size()/image_width).sub_view(view_x, 0, view_width, view_height),
+		       terrain, camera, distance, lod, shading, sky_color, stats);
+}
+
+
+/*-------------------------------------
+Name: draw_terrain_map
+Description: Draws the colormap of the terrain into every pixel of a view,
+	centered on (center_x, center_y) with texels_per_pixel texels per
+	pixel. The vector form draws map_width x map_height pixels into the
+	top left of a packed image.
+
+Purpose: The minimap of the terrain mode.
+--------------------------------------*/
+inline void draw_terrain_map(const FrameView<uint32_t> view,
+			const Terrain &terrain,
+			const float center_x,
+			const float center_y,
+			const float texels_per_pixel){
+	const float x0 = center_x - view.width*texels_per_pixel/2;
+	const float y0 = center_y - view.height*texels_per_pixel/2;
+	for(size_t j=0; j<view.height; j++){
+		uint32_t *row = view.row(j);
+		const long ty = long(std::floor(y0 + j*texels_per_pixel));
+		for(size_t i=0; i<view.width; i++)
+			row[i] = terrain.colors[terrain.index(long(std::floor(x0 + i*texels_per_pixel)), ty)];
+	}
+}
+
+inline void draw_terrain_map(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t map_width,
+			const size_t map_height,
+			const Terrain &terrain,
+			const float center_x,
+			const float center_y,
+			const float texels_per_pixel){
+	assert(map_width <= image_width && map_height*image_width <= image.size());
+	draw_terrain_map(frame_view(image, image_width, image.size()/image_width).sub_view(0, 0, map_width, map_height),
+			 terrain, center_x, center_y, texels_per_pixel);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <sstream>
+#include "pixelformat.h"
+#include "shading.h"
+#include "terrain.h"
+
+/*-------------------------------------
+Name: check_bad_headers
+Description: Feeds parse_terrain images whose headers claim sides that
+	overflow a size_t, exceed max_pnm_side, are not powers of two or are
+	far larger than the samples that follow, and returns false if any is
+	accepted.
+
+Purpose: A corrupt terrain file must be refused, not read out of bounds.
+--------------------------------------*/
+bool check_bad_headers(){
+	const char *sides[] = {"8589934592 8589934592", "4294967296 4", "131072 131072", "65536 65536", "3 4", "0 0"};
+	for(const char *side : sides){
+		std::istringstream heights("P5\n" + std::string(side) + "\n255\n" + std::string(64, 'x'));
+		std::istringstream colors("P6\n" + std::string(side) + "\n255\n" + std::string(192, 'x'));
+		Terrain terrain;
+		if(parse_terrain(heights, "heights", colors, "colors", terrain)){
+			std::cerr << "a terrain of " << side << " with 64 texels was accepted\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Renders a terrain at 1920x1080 from a camera circling over it, with
+	fixed one-texel steps and with level-of-detail steps, at view distances
+	from 250 to 4000 texels, and prints the frame time and the samples per
+	column of each. The first level-of-detail view at the longest distance
+	is written to outTerrain.ppm. First checks that terrain files with
+	bad sizes are refused (check_bad_headers) and exits with 1 if not.
+
+	usage: terrain_bench <height.pgm> <color.ppm>
+
+Purpose: Shows that level-of-detail stepping keeps long view distances
+	affordable.
+--------------------------------------*/
+int main(int argc, char **argv){
+	typedef std::chrono::steady_clock clock;
+	Terrain terrain;
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " <height.pgm> <color.ppm>\n"
+			  << "make a terrain with terrain_gen\n";
+		return 1;
+	}
+	if(!check_bad_headers()) return 1;
+	if(!load_terrain(argv[1], argv[2], terrain)) return 1;
+
+	const size_t width = 1920, height = 1080;
+	const int frames = 20;
+	std::vector<uint32_t> image(width*height);
+	std::cout << terrain.width << "x" << terrain.height << " terrain\n";
+	for(const float distance : {250.f, 1000.f, 4000.f}){
+		const ShadeTable shading = build_shade_table(distance, 256, packcolor(200, 200, 200), distance*.4f, 1.f, 1.f);
+		for(const float lod : {0.f, .01f}){
+			double seconds = 0;
+			size_t samples = 0;
+			for(int f=0; f<frames; f++){
+				TerrainCamera camera;
+				camera.angle = .1f*f;
+				camera.x = terrain.width/2 + 200*std::cos(camera.angle);
+				camera.y = terrain.height/2 + 200*std::sin(camera.angle);
+				camera.height = terrain.height_at(camera.x, camera.y) + 60;
+				camera.horizon = height/3;
+				camera.scale = height/2;
+				TerrainStats stats;
+				auto start = clock::now();
+				render_terrain(image, width, 0, width, height, terrain, camera, distance, lod, &shading,
+					       packcolor(200, 200, 200), &stats);
+				seconds += std::chrono::duration<double>(clock::now() - start).count();
+				samples += stats.samples;
+				if(f == 0 && lod > 0 && distance == 4000.f) drop_ppm_image("./outTerrain.ppm", image, width, height);
+			}
+			std::cout << "  distance " << distance << (lod > 0 ? ", lod   \t" : ", fixed \t")
+				  << seconds*1000/frames << " ms, " << double(samples)/(frames*width) << " samples per column\n";
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "pixelformat.h"
+
+/*-------------------------------------
+Name: generate_heights
+Description: Fills a size x size heightmap (size a power of two) with fractal
+	hills by diamond-square midpoint displacement. Neighbours wrap around,
+	so the map tiles seamlessly, and roughness sets how much the
+	displacement keeps at each halving of the step.
+
+Purpose: Natural-looking terrain from nothing but a seed.
+--------------------------------------*/
+std::vector<float> generate_heights(const size_t size, const unsigned seed, const float roughness = .55f){
+	std::vector<float> h(size*size, 0.f);
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> noise(-1.f, 1.f);
+	auto at = [&](const size_t x, const size_t y) -> float& {
+		return h[(x & (size - 1)) + (y & (size - 1))*size];
+	};
+	float amplitude = 1;
+	for(size_t step = size; step > 1; step /= 2, amplitude *= roughness){
+		const size_t half = step/2;
+		for(size_t y=0; y<size; y+=step)
+			for(size_t x=0; x<size; x+=step)
+				at(x + half, y + half) = (at(x, y) + at(x + step, y) + at(x, y + step) +
+							  at(x + step, y + step))/4 + noise(rng)*amplitude;
+		for(size_t y=0; y<size; y+=half)
+			for(size_t x=(y/half % 2 ? 0 : half); x<size; x+=step)
+				at(x, y) = (at(x - half, y) + at(x + half, y) + at(x, y - half) +
+					    at(x, y + half))/4 + noise(rng)*amplitude;
+	}
+	const auto bounds = std::minmax_element(h.begin(), h.end());
+	const float low = *bounds.first, range = std::max(*bounds.second - low, 1e-6f);
+	for(float &v : h) v = (v - low)/range;
+	return h;
+}
+
+
+/*-------------------------------------
+Name: terrain_color
+Description: The color of a texel from its height (0-1) and the slope of the
+	ground toward the light: water, sand, grass, rock and snow bands, lit
+	from the north west.
+
+Purpose: A colormap that matches the generated heights.
+--------------------------------------*/
+void terrain_color(const float height, const float slope, uint8_t rgb[3]){
+	float r, g, b;
+	if(height < .3f){ r = 30; g = 70; b = 150; }
+	else if(height < .34f){ r = 190; g = 175; b = 120; }
+	else if(height < .6f){ r = 60; g = 130 - 60*(height - .34f); b = 50; }
+	else if(height < .8f){ r = 110; g = 100; b = 90; }
+	else { r = 235; g = 235; b = 240; }
+	const float light = height < .3f ? 1.f : std::min(std::max(1.f + slope*6, .4f), 1.4f);
+	rgb[0] = uint8_t(std::min(r*light, 255.f));
+	rgb[1] = uint8_t(std::min(g*light, 255.f));
+	rgb[2] = uint8_t(std::min(b*light, 255.f));
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Writes a generated terrain as a PGM heightmap and a PPM colormap
+	that gameloop --terrain and terrain_bench load. Water is flattened to
+	its surface.
+
+	usage: terrain_gen <height.pgm> <color.ppm> [size] [seed]
+
+Purpose: Makes terrain assets without an image editor.
+--------------------------------------*/
+int main(int argc, char **argv){
+	if(argc < 3){
+		std::cerr << "usage: " << argv[0] << " <height.pgm> <color.ppm> [size] [seed]\n";
+		return 1;
+	}
+	const size_t size = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1024;
+	const unsigned seed = argc > 4 ? unsigned(std::strtoul(argv[4], nullptr, 10)) : 1;
+	if(size < 2 || (size & (size - 1))){
+		std::cerr << "size must be a power of two\n";
+		return 1;
+	}
+	const std::vector<float> h = generate_heights(size, seed);
+	std::vector<uint8_t> gray(size*size), rgb(size*size*3);
+	for(size_t y=0; y<size; y++){
+		for(size_t x=0; x<size; x++){
+			const size_t i = x + y*size;
+			const float slope = h[((x - 1) & (size - 1)) + ((y - 1) & (size - 1))*size] - h[i];
+			gray[i] = uint8_t(std::max(h[i], .3f)*255);
+			terrain_color(h[i], slope, rgb.data() + i*3);
+		}
+	}
+	std::ofstream ofs(argv[1], std::ios::binary);
+	ofs << "P5\n" << size << " " << size << "\n255\n";
+	ofs.write(reinterpret_cast<const char*>(gray.data()), gray.size());
+	if(!ofs){
+		std::cerr << "Failed to write " << argv[1] << "\n";
+		return 1;
+	}
+	write_ppm_rgb(argv[2], rgb.data(), size, size);
+	std::cout << "Wrote " << size << "x" << size << " terrain to " << argv[1] << " and " << argv[2] << "\n";
+	return 0;
+}
@@ -0,0 +1,319 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+/*-------------------------------------
+Name: CellBitset
+Description: A flat bitset with one bit per map cell, stored row-major in 64-bit
+	words. Cell (x, y) lives at bit x + y*width, matching the indexing used for
+	the map string.
+
+	mark sets a bit like set and also remembers the word it went into the
+	first time that word is written, so clear_marked can reset just those
+	words. As long as every bit since the last clear went in through mark,
+	clearing costs the number of words written instead of the map size;
+	set and merge make the next clear_marked clear everything.
+
+Purpose: Gives visibility queries a compact result that is cheap to clear,
+	test and combine, so AI, fog-of-war and culling code can share one
+	representation of "which cells can be seen".
+--------------------------------------*/
+struct CellBitset {
+	size_t width = 0;
+	size_t height = 0;
+	std::vector<uint64_t> words;
+	std::vector<uint32_t> marked_words;
+	bool unmarked_writes = false;
+
+	void resize(const size_t w, const size_t h){
+		width = w;
+		height = h;
+		words.assign((w*h + 63)/64, 0);
+		marked_words.clear();
+		//enough for what a frame sees on most maps, so growing is rare
+		marked_words.reserve(std::min<size_t>(words.size(), 1 << 14));
+		unmarked_writes = false;
+	}
+	void clear(){
+		std::fill(words.begin(), words.end(), 0);
+		marked_words.clear();
+		unmarked_writes = false;
+	}
+	void clear_marked(){
+		if(unmarked_writes){
+			clear();
+			return;
+		}
+		for(uint32_t w : marked_words) words[w] = 0;
+		marked_words.clear();
+	}
+	void set(const size_t x, const size_t y){
+		const size_t i = x + y*width;
+		words[i >> 6] |= uint64_t(1) << (i & 63);
+		unmarked_writes = true;
+	}
+	void mark(const size_t x, const size_t y){
+		const size_t i = x + y*width;
+		uint64_t &word = words[i >> 6];
+		if(word == 0) marked_words.push_back(uint32_t(i >> 6));
+		word |= uint64_t(1) << (i & 63);
+	}
+	bool test(const size_t x, const size_t y) const {
+		const size_t i = x + y*width;
+		return (words[i >> 6] >> (i & 63)) & 1;
+	}
+	size_t count() const {
+		size_t n = 0;
+		for(uint64_t w : words) n += __builtin_popcountll(w);
+		return n;
+	}
+	//merges every visible bit of other into this set, sizes must match
+	void merge(const CellBitset &other){
+		for(size_t i=0; i<words.size(); i++) words[i] |= other.words[i];
+		unmarked_writes = true;
+	}
+};
+
+
+/*-------------------------------------
+Name: ViewCone
+Description: An optional angular restriction for compute_visible_cells. The cone
+	is centered on angle (radians, same convention as player_a) and spans fov
+	radians in total. A cone with enabled == false sees the full 360 degrees.
+
+Purpose: Lets callers ask either "what could I see if I turned around" or
+	"what is in front of me right now" with the same routine, using the same
+	player_a and fov values the renderer uses.
+--------------------------------------*/
+struct ViewCone {
+	bool enabled = false;
+	float angle = 0;
+	float fov = 0;
+};
+
+
+/*-------------------------------------
+Name: cast_quadrant
+Description: Recursive shadowcasting over one of the four 90 degree quadrants
+	around a floating point origin. The quadrant is expressed in local (u, v)
+	coordinates where u grows away from the origin and v runs across it; every
+	row of cells at a fixed u is scanned only between the start and end slopes
+	(dv/du) that are still unblocked. When a wall cell is met, the open slope
+	range before it is pushed as a new beam for the next row and the beam
+	continues on the other side of the wall.
+
+Purpose: Each cell is touched only when a beam actually reaches it, so the
+	cost is proportional to the visible region instead of the map size. The
+	beam stack is explicit rather than recursive so deep scans on very large
+	maps cannot overflow the call stack.
+--------------------------------------*/
+template<typename Mark>
+void cast_quadrant(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float origin_x,
+			const float origin_y,
+			const int quadrant,
+			const float start_slope,
+			const float end_slope,
+			const size_t max_depth,
+			Mark &mark){
+	//quadrant 0: east  (u = x,  v = y)
+	//quadrant 1: south (u = y,  v = x)
+	//quadrant 2: west  (u = -x, v = y)
+	//quadrant 3: north (u = -y, v = x)
+	const bool u_is_x = (quadrant == 0 || quadrant == 2);
+	const bool flip_u = (quadrant >= 2);
+	const float ou = flip_u ? -(u_is_x ? origin_x : origin_y) : (u_is_x ? origin_x : origin_y);
+	const float ov = u_is_x ? origin_y : origin_x;
+	const long origin_cell_u = long(std::floor(ou));
+
+	//the beam stack is kept between calls, and starts out larger than open
+	//maps need, so steady-state frames do not allocate
+	struct Beam { size_t depth; float start, end; };
+	static thread_local std::vector<Beam> stack;
+	if(stack.capacity() == 0) stack.reserve(1024);
+	stack.clear();
+	stack.push_back({1, start_slope, end_slope});
+
+	while(!stack.empty()){
+		Beam beam = stack.back();
+		stack.pop_back();
+		if(beam.start >= beam.end || beam.depth > max_depth) continue;
+
+		const long cu = origin_cell_u + long(beam.depth);
+		const float du_near = std::max(float(cu) - ou, 1e-4f);
+		const float du_far = float(cu + 1) - ou;
+		const float v_min = ov + std::min(beam.start*du_near, beam.start*du_far);
+		const float v_max = ov + std::max(beam.end*du_near, beam.end*du_far);
+
+		//translate the local row index back into a map coordinate
+		const long cell_u = flip_u ? -cu - 1 : cu;
+		const bool row_in_map = cell_u >= 0 &&
+			size_t(cell_u) < (u_is_x ? map_width : map_height);
+		if(!row_in_map) continue;
+
+		float start = beam.start;
+		int prev = -1; //-1 nothing scanned yet, 0 open, 1 wall
+		for(long cv = long(std::floor(v_min)); cv <= long(std::floor(v_max)); cv++){
+			const float dv0 = float(cv) - ov;
+			const float dv1 = float(cv + 1) - ov;
+			const float lo = std::min(dv0/du_near, dv0/du_far);
+			const float hi = std::max(dv1/du_near, dv1/du_far);
+			if(hi <= start || lo >= beam.end) continue;
+
+			const long x = u_is_x ? cell_u : cv;
+			const long y = u_is_x ? cv : cell_u;
+			const bool in_map = x >= 0 && y >= 0 &&
+				size_t(x) < map_width && size_t(y) < map_height;
+			const bool wall = !in_map || map[x + y*map_width] != ' ';
+			if(in_map) mark(size_t(x), size_t(y));
+
+			if(wall){
+				if(prev == 0) stack.push_back({beam.depth + 1, start, lo});
+				start = hi;
+				prev = 1;
+			} else {
+				prev = 0;
+			}
+		}
+		if(prev == 0) stack.push_back({beam.depth + 1, start, beam.end});
+	}
+}
+
+
+/*-------------------------------------
+Name: for_each_visible_cell
+Description: Calls mark(x, y) for every map cell that can be seen from the point
+	(origin_x, origin_y). Walls that block sight are themselves reported,
+	empty cells behind them are not. Anything outside the map counts as a
+	wall. An optional view cone limits the result to the player's field of view
+	and max_distance bounds how many rows each quadrant scans. A cell on a
+	quadrant boundary may be reported more than once.
+
+Purpose: fov.cpp answers visibility one screen column at a time by stepping
+	along rays; this answers it per map cell in a single pass, which is what
+	AI line of sight, fog-of-war and culling need. Taking a callback lets
+	callers that only touch a few cells of a huge map avoid clearing a full
+	bitset first.
+--------------------------------------*/
+template<typename Mark>
+void for_each_visible_cell(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const float origin_x,
+			const float origin_y,
+			Mark &&mark,
+			const ViewCone cone = ViewCone(),
+			size_t max_distance = 0){
+	if(max_distance == 0) max_distance = std::max(map_width, map_height);
+	if(origin_x < 0 || origin_y < 0 ||
+	   size_t(origin_x) >= map_width || size_t(origin_y) >= map_height) return;
+	mark(size_t(origin_x), size_t(origin_y));
+
+	const float quarter = M_PI/4.;
+	//world angle of each quadrant axis and the sign that turns a relative
+	//angle into the local dv/du slope for that quadrant
+	const float axis[4] = {0.f, float(M_PI/2.), float(M_PI), float(-M_PI/2.)};
+	const float slope_sign[4] = {1.f, -1.f, -1.f, 1.f};
+
+	const bool full_circle = !cone.enabled || cone.fov >= 2*M_PI;
+	for(int q=0; q<4; q++){
+		//a cone wider than 180 degrees can cut a quadrant in two pieces, so
+		//the cone is also tested one turn to either side
+		const float rel = std::remainder(cone.angle - axis[q], float(2*M_PI));
+		for(int turn=-1; turn<=1; turn++){
+			float lo = -quarter, hi = quarter;
+			if(!full_circle){
+				const float center = rel + turn*float(2*M_PI);
+				lo = std::max(lo, center - cone.fov/2);
+				hi = std::min(hi, center + cone.fov/2);
+				if(lo >= hi) continue;
+			} else if(turn != 0) continue;
+			const float s0 = slope_sign[q]*std::tan(lo);
+			const float s1 = slope_sign[q]*std::tan(hi);
+			cast_quadrant(map, map_width, map_height, origin_x, origin_y, q,
+				std::min(s0, s1), std::max(s0, s1), max_distance, mark);
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: compute_visible_cells
+Description: Fills visible with every map cell for_each_visible_cell reports
+	from the point (origin_x, origin_y), resizing it to the map if needed.
+	Only the words the previous call wrote are cleared, so reusing one
+	bitset every frame costs the visible region, not the map size.
+
+Purpose: The common case of wanting the whole visible set as a bitset.
+--------------------------------------*/
+inline void compute_visible_cells(const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const float origin_x,
+				const float origin_y,
+				CellBitset &visible,
+				const ViewCone cone = ViewCone(),
+				const size_t max_distance = 0){
+	if(visible.width != map_width || visible.height != map_height)
+		visible.resize(map_width, map_height);
+	else
+		visible.clear_marked();
+	for_each_visible_cell(map, map_width, map_height, origin_x, origin_y,
+		[&visible](size_t x, size_t y){ visible.mark(x, y); }, cone, max_distance);
+}
+
+
+
+/*-------------------------------------
+Name: line_of_sight
+Description: Walks the cells a straight segment from (x0, y0) to (x1, y1)
+	crosses, in order, and returns false if any of them before the last is
+	a wall or outside the map. A segment through the exact corner where
+	four cells meet is blocked if either cell beside the corner is a wall,
+	since the gap between them has no width.
+
+Purpose: The exact test behind the shadowcaster's approximations, for
+	checking it and the PVS against; too slow to answer whole-map queries.
+--------------------------------------*/
+inline bool line_of_sight(const char *map,
+			const size_t map_width,
+			const size_t map_height,
+			const double x0, const double y0,
+			const double x1, const double y1){
+	long cx = long(std::floor(x0)), cy = long(std::floor(y0));
+	const long tx = long(std::floor(x1)), ty = long(std::floor(y1));
+	auto wall = [&](const long x, const long y){
+		return x < 0 || y < 0 || size_t(x) >= map_width || size_t(y) >= map_height || map[x + y*map_width] != ' ';
+	};
+	const double dx = x1 - x0, dy = y1 - y0;
+	const long step_x = dx < 0 ? -1 : 1, step_y = dy < 0 ? -1 : 1;
+	const double delta_x = dx != 0 ? std::fabs(1/dx) : 1e30, delta_y = dy != 0 ? std::fabs(1/dy) : 1e30;
+	double next_x = dx != 0 ? (dx < 0 ? x0 - cx : cx + 1 - x0)*delta_x : 1e30;
+	double next_y = dy != 0 ? (dy < 0 ? y0 - cy : cy + 1 - y0)*delta_y : 1e30;
+	while(cx != tx || cy != ty){
+		if(wall(cx, cy) || (next_x > 1 && next_y > 1)) return false;
+		if(std::fabs(next_x - next_y) < 1e-12){
+			if(wall(cx + step_x, cy) || wall(cx, cy + step_y)) return false;
+			next_x += delta_x;
+			next_y += delta_y;
+			cx += step_x;
+			cy += step_y;
+		} else if(next_x < next_y){
+			next_x += delta_x;
+			cx += step_x;
+		} else {
+			next_y += delta_y;
+			cy += step_y;
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,488 @@
+#ifndef VOXEL_H
+#define VOXEL_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include "pixelformat.h"
+#include "shading.h"
+#include "lighting.h"
+#include "heights.h"
+#include "workers.h"
+#include "framebuffer.h"
+
+/*-------------------------------------
+Name: VoxelVolume
+Description: A 3D grid of width x depth x height voxels (x, y as on the map, z
+	up), bit-packed by brick: every 4x4x4 brick of voxels is one 64-bit word
+	in bricks, so a brick with nothing in it is a zero word, and every 4x4x4
+	group of bricks (a 16x16x16 region) has one word in regions with a bit
+	per non-empty brick. Those two words are the coarse occupancy levels the
+	ray traversal skips empty space with. types holds the material of each
+	voxel (0 for empty) and is only read where a ray stops. The arrays are
+	padded to whole regions; voxels_per_unit is the number of voxels per map
+	cell, so cameras and distances stay in map units.
+
+Purpose: The world of the full 3D mode: anything from a stack of 16x16 map
+	layers to volumes of hundreds of voxels on a side.
+--------------------------------------*/
+struct VoxelVolume {
+	size_t width = 0;
+	size_t depth = 0;
+	size_t height = 0;
+	size_t bricks_x = 0, bricks_y = 0, bricks_z = 0;
+	size_t regions_x = 0, regions_y = 0, regions_z = 0;
+	float voxels_per_unit = 1;
+	std::vector<uint64_t> bricks;
+	std::vector<uint64_t> regions;
+	std::vector<uint8_t> types;
+
+	bool empty() const { return width == 0; }
+	size_t brick_index(const size_t x, const size_t y, const size_t z) const {
+		return (x >> 2) + (y >> 2)*bricks_x + (z >> 2)*bricks_x*bricks_y;
+	}
+	static uint64_t brick_bit(const size_t x, const size_t y, const size_t z){
+		return uint64_t(1) << ((x & 3) | (y & 3) << 2 | (z & 3) << 4);
+	}
+	size_t region_index(const size_t x, const size_t y, const size_t z) const {
+		return (x >> 4) + (y >> 4)*regions_x + (z >> 4)*regions_x*regions_y;
+	}
+	static uint64_t region_bit(const size_t x, const size_t y, const size_t z){
+		return uint64_t(1) << ((x >> 2 & 3) | (y >> 2 & 3) << 2 | (z >> 2 & 3) << 4);
+	}
+	bool solid(const size_t x, const size_t y, const size_t z) const {
+		return bricks[brick_index(x, y, z)] & brick_bit(x, y, z);
+	}
+	uint8_t type_at(const size_t x, const size_t y, const size_t z) const {
+		return types[x + y*bricks_x*4 + z*bricks_x*bricks_y*16];
+	}
+	void set(const size_t x, const size_t y, const size_t z, const uint8_t type){
+		types[x + y*bricks_x*4 + z*bricks_x*bricks_y*16] = type;
+		uint64_t &brick = bricks[brick_index(x, y, z)];
+		uint64_t &region = regions[region_index(x, y, z)];
+		if(type) brick |= brick_bit(x, y, z);
+		else brick &= ~brick_bit(x, y, z);
+		if(brick) region |= region_bit(x, y, z);
+		else region &= ~region_bit(x, y, z);
+	}
+};
+
+
+/*-------------------------------------
+Name: make_voxel_volume
+Description: An empty volume of width x depth x height voxels.
+
+Purpose: Sizes the padded brick, region and type arrays in one place.
+--------------------------------------*/
+inline VoxelVolume make_voxel_volume(const size_t width,
+				const size_t depth,
+				const size_t height,
+				const float voxels_per_unit = 1){
+	VoxelVolume volume;
+	volume.width = width;
+	volume.depth = depth;
+	volume.height = height;
+	volume.voxels_per_unit = voxels_per_unit;
+	volume.regions_x = (width + 15)/16;
+	volume.regions_y = (depth + 15)/16;
+	volume.regions_z = (height + 15)/16;
+	volume.bricks_x = volume.regions_x*4;
+	volume.bricks_y = volume.regions_y*4;
+	volume.bricks_z = volume.regions_z*4;
+	volume.bricks.assign(volume.bricks_x*volume.bricks_y*volume.bricks_z, 0);
+	volume.regions.assign(volume.regions_x*volume.regions_y*volume.regions_z, 0);
+	volume.types.assign(volume.bricks.size()*64, 0);
+	return volume;
+}
+
+
+/*-------------------------------------
+Name: voxel_ground, voxel_floor, voxel_ceiling
+Description: Material codes for the parts of a map that are not walls; walls
+	keep their map character as their material.
+
+Purpose: Lets voxel_color tell the ground, raised floors and ceilings apart.
+--------------------------------------*/
+constexpr uint8_t voxel_ground = '.';
+constexpr uint8_t voxel_floor = '_';
+constexpr uint8_t voxel_ceiling = '^';
+
+
+/*-------------------------------------
+Name: voxel_fill_cell
+Description: Rebuilds the voxels of map cell (cell_x, cell_y) from the map and its
+	heights: a ground layer at z = 0, then a wall up to its top, or an empty
+	cell's floor and its ceiling up to the top of the volume. World height h
+	sits at voxel 1 + h*voxels_per_unit, on top of the ground layer.
+
+Purpose: Used to build a volume from a map and to follow map edits one cell at
+	a time.
+--------------------------------------*/
+inline void voxel_fill_cell(VoxelVolume &volume,
+			const char *map,
+			const size_t map_width,
+			const HeightMap &heights,
+			const size_t cell_x,
+			const size_t cell_y){
+	const size_t n = size_t(volume.voxels_per_unit);
+	const size_t cell = cell_x + cell_y*map_width;
+	const bool wall = map[cell] != ' ';
+	const size_t top = 1 + size_t(std::lround(heights.floor_at(map, cell)*n));
+	const float ceiling_height = heights.ceiling_at(cell);
+	const size_t ceiling = wall || ceiling_height == INFINITY ? volume.height :
+		1 + size_t(std::lround(ceiling_height*n));
+	const uint8_t floor_type = wall ? uint8_t(map[cell]) : voxel_floor;
+	for(size_t y = cell_y*n; y < (cell_y + 1)*n; y++){
+		for(size_t x = cell_x*n; x < (cell_x + 1)*n; x++){
+			volume.set(x, y, 0, voxel_ground);
+			for(size_t z = 1; z < volume.height; z++){
+				const uint8_t type = z < top ? floor_type : z >= ceiling ? voxel_ceiling : 0;
+				volume.set(x, y, z, type);
+			}
+		}
+	}
+}
+
+
+/*-------------------------------------
+Name: voxel_volume_bytes, max_voxel_bytes
+Description: The memory make_voxel_volume takes for a width x depth x height
+	volume, padded to whole regions: a type byte per voxel plus the brick and
+	region words. Worked out in floating point, so absurd sizes compare as
+	too big instead of wrapping. max_voxel_bytes is the largest volume
+	voxels_from_map builds.
+
+Purpose: Lets a volume be refused before it is allocated.
+--------------------------------------*/
+inline double voxel_volume_bytes(const double width, const double depth, const double height){
+	const double regions = std::ceil(width/16)*std::ceil(depth/16)*std::ceil(height/16);
+	return regions*(4096 + 64*8 + 8);
+}
+constexpr size_t max_voxel_bytes = size_t(1) << 30;
+
+
+/*-------------------------------------
+Name: voxels_from_map
+Description: Builds a volume from a grid map and its heights with voxels_per_cell
+	voxels along each side of a cell, tall enough for the highest wall,
+	floor or ceiling in the map. A volume over max_bytes is refused with an
+	empty volume.
+
+Purpose: Lets the full 3D mode show any map the column renderers draw.
+--------------------------------------*/
+inline VoxelVolume voxels_from_map(const char *map,
+				const size_t map_width,
+				const size_t map_height,
+				const HeightMap &heights,
+				const size_t voxels_per_cell = 8,
+				const size_t max_bytes = max_voxel_bytes){
+	float top = heights.max_floor;
+	for(const float ceiling : heights.ceiling)
+		if(ceiling != INFINITY) top = std::max(top, ceiling);
+	const double height = 2 + std::ceil(double(top)*voxels_per_cell);
+	const double bytes = voxel_volume_bytes(double(map_width)*voxels_per_cell,
+						double(map_height)*voxels_per_cell, height);
+	if(bytes > double(max_bytes)){
+		std::cerr << "Voxel volume of the " << map_width << "x" << map_height << " map needs over "
+			  << max_bytes/(1 << 20) << " MB, not building it\n";
+		return VoxelVolume();
+	}
+	VoxelVolume volume = make_voxel_volume(map_width*voxels_per_cell, map_height*voxels_per_cell,
+					       size_t(height), float(voxels_per_cell));
+	for(size_t y=0; y<map_height; y++)
+		for(size_t x=0; x<map_width; x++)
+			voxel_fill_cell(volume, map, map_width, heights, x, y);
+	return volume;
+}
+
+
+/*-------------------------------------
+Name: VoxelHit
+Description: Where a voxel ray stopped: distance in voxels along the ray (or
+	INFINITY for a miss), the voxel and its material, and the axis (0 x,
+	1 y, 2 z) of the face the ray entered it through.
+
+Purpose: Everything shading a pixel needs.
+--------------------------------------*/
+struct VoxelHit {
+	float distance = INFINITY;
+	uint8_t type = 0;
+	uint8_t axis = 2;
+	long x = 0, y = 0, z = 0;
+};
+
+
+/*-------------------------------------
+Name: cast_voxel_ray
+Description: Walks a ray from (ox, oy, oz) along (dx, dy, dz), all in voxels and
+	with a unit direction, through the volume until it enters a solid voxel
+	or runs max_distance voxels. The walk is a 3D grid traversal that steps
+	a whole aligned cell at a time, from the boundary it entered by to the
+	nearest one it leaves by: the 4x4x4 brick when its word is zero and the
+	16x16x16 region when that is empty too. Inside a brick with something in
+	it the walk goes voxel by voxel, testing the bits of the brick's word.
+	Open space therefore costs a step per brick or region instead of one
+	per voxel. skip_empty = false walks every voxel, for comparison.
+	step_count is increased by the number of cells visited.
+
+Purpose: The per-pixel kernel of render_voxels.
+--------------------------------------*/
+inline VoxelHit cast_voxel_ray(const VoxelVolume &volume,
+			const float ox,
+			const float oy,
+			const float oz,
+			const float dx,
+			const float dy,
+			const float dz,
+			const float max_distance,
+			size_t &step_count,
+			const bool skip_empty = true){
+	VoxelHit hit;
+	const float o[3] = {ox, oy, oz};
+	const float d[3] = {dx, dy, dz};
+	const long size[3] = {long(volume.width), long(volume.depth), long(volume.height)};
+	float inv[3];
+	float t = 0, t_end = max_distance;
+	int axis = -1;
+	for(int a=0; a<3; a++){
+		inv[a] = d[a] != 0 ? 1/d[a] : INFINITY;
+		if(d[a] == 0){
+			if(o[a] < 0 || o[a] >= size[a]) return hit;
+			continue;
+		}
+		float near = -o[a]*inv[a], far = (size[a] - o[a])*inv[a];
+		if(near > far) std::swap(near, far);
+		if(near > t){ t = near; axis = a; }
+		t_end = std::min(t_end, far);
+	}
+	if(t >= t_end) return hit;
+
+	long p[3];
+	for(int a=0; a<3; a++)
+		p[a] = std::min(std::max(long(std::floor(o[a] + t*d[a])), 0L), size[a] - 1);
+	if(axis >= 0) p[axis] = d[axis] > 0 ? 0 : size[axis] - 1;
+
+	const long step[3] = {d[0] < 0 ? -1 : 1, d[1] < 0 ? -1 : 1, d[2] < 0 ? -1 : 1};
+	const size_t brick_row = volume.bricks_x, brick_layer = volume.bricks_x*volume.bricks_y;
+	//counted locally: a size_t& could alias the brick words
+	size_t steps = 0;
+	struct Count {
+		size_t &total, &steps;
+		~Count(){ total += steps; }
+	} count{step_count, steps};
+
+	//voxel-level state, kept across bricks and rebuilt after a skip
+	float t_max[3];
+	uint64_t brick = 0;
+	auto enter = [&](){
+		for(int a=0; a<3; a++)
+			t_max[a] = d[a] != 0 ? (p[a] + (d[a] > 0) - o[a])*inv[a] : INFINITY;
+		brick = volume.bricks[(p[0] >> 2) + (p[1] >> 2)*brick_row + (p[2] >> 2)*brick_layer];
+	};
+	enter();
+	while(true){
+		steps++;
+		if(brick || !skip_empty){
+			//voxel by voxel, testing the bits of the brick's word
+			if(brick & VoxelVolume::brick_bit(p[0], p[1], p[2])){
+				hit.distance = t;
+				hit.x = p[0];
+				hit.y = p[1];
+				hit.z = p[2];
+				hit.type = volume.type_at(p[0], p[1], p[2]);
+				hit.axis = uint8_t(axis < 0 ? 2 : axis);
+				return hit;
+			}
+			axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+			t = t_max[axis];
+			if(t >= t_end) return hit;
+			p[axis] += step[axis];
+			t_max[axis] += std::fabs(inv[axis]);
+			if(p[axis] < 0 || p[axis] >= size[axis]) return hit;
+			//reloading the word every step is cheaper than branching on
+			//brick boundaries, which the ray crosses unpredictably
+			brick = volume.bricks[(p[0] >> 2) + (p[1] >> 2)*brick_row + (p[2] >> 2)*brick_layer];
+			continue;
+		}
+
+		//leave an empty brick, or its region if that is empty too, through
+		//the nearest boundary
+		const long cell = volume.regions[volume.region_index(p[0], p[1], p[2])] ? 4 : 16;
+		long low[3];
+		float t_next = INFINITY;
+		for(int a=0; a<3; a++){
+			low[a] = p[a] & ~(cell - 1);
+			if(d[a] == 0) continue;
+			const float ta = ((d[a] > 0 ? low[a] + cell : low[a]) - o[a])*inv[a];
+			if(ta < t_next){ t_next = ta; axis = a; }
+		}
+		t = std::max(t, t_next);
+		if(t >= t_end) return hit;
+		for(int a=0; a<3; a++){
+			if(a == axis) p[a] = d[a] > 0 ? low[a] + cell : low[a] - 1;
+			else p[a] = std::min(std::max(long(o[a] + t*d[a]), low[a]), low[a] + cell - 1);
+		}
+		if(p[axis] < 0 || p[axis] >= size[axis]) return hit;
+		enter();
+	}
+}
+
+
+/*-------------------------------------
+Name: VoxelCamera, VoxelStats
+Description: A camera in map units (z up, 0 at the top of the ground layer's
+	first voxel) looking along yaw (as player_a) and pitch (up positive),
+	with a horizontal field of view fov; and the rays cast and cells
+	visited by the last render_voxels call.
+
+Purpose: Inputs and counters of render_voxels.
+--------------------------------------*/
+struct VoxelCamera {
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float yaw = 0;
+	float pitch = 0;
+	float fov = M_PI/3.;
+};
+
+struct VoxelStats {
+	size_t rays = 0;
+	size_t steps = 0;
+	size_t hits = 0;
+};
+
+
+/*-------------------------------------
+Name: voxel_color
+Description: The base color of a voxel material: the map's wall digits, the
+	ground, raised floors and ceilings.
+
+Purpose: Flat colors for the voxel view, like the minimap's.
+--------------------------------------*/
+inline uint32_t voxel_color(const uint8_t type){
+	switch(type){
+		case '0': return packcolor(0, 255, 255);
+		case '1': return packcolor(0, 200, 255);
+		case '2': return packcolor(0, 255, 180);
+		case '3': return packcolor(255, 200, 0);
+		case voxel_ground: return packcolor(110, 110, 110);
+		case voxel_floor: return packcolor(0, 170, 170);
+		case voxel_ceiling: return packcolor(90, 140, 140);
+		default: return packcolor(0, 220, 220);
+	}
+}
+
+
+/*-------------------------------------
+Name: render_voxels
+Description: Draws the volume as seen from camera into a view, one ray per
+	pixel. The view is cut into 16x16 pixel tiles that workers render in
+	parallel, each pixel written exactly once: the hit voxel's color,
+	darker on y faces and more so on z faces, lit by the light map of the
+	cell the face is seen from and run through the shade table by distance, or
+	sky_color where a ray leaves the volume. The vector form draws into the
+	view_width x view_height rectangle at (view_x, view_y) of a packed image.
+
+Purpose: The full 3D mode, interactive at 640x360 on a multi-core CPU.
+--------------------------------------*/
+inline void render_voxels(const FrameView<uint32_t> view,
+			const VoxelVolume &volume,
+			const VoxelCamera &camera,
+			TileWorkers &workers,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr,
+			VoxelStats *stats = nullptr,
+			const uint32_t sky_color = packcolor(200, 200, 200),
+			const float max_distance = 20,
+			const bool skip_empty = true){
+	constexpr size_t tile = 16;
+	const size_t view_width = view.width, view_height = view.height;
+	const float scale = volume.voxels_per_unit;
+	const float cy = std::cos(camera.yaw), sy = std::sin(camera.yaw);
+	const float cp = std::cos(camera.pitch), sp = std::sin(camera.pitch);
+	const float forward[3] = {cy*cp, sy*cp, sp};
+	const float right[3] = {-sy, cy, 0};
+	const float up[3] = {-cy*sp, -sy*sp, cp};
+	const float half_w = std::tan(camera.fov/2);
+	const float half_h = half_w*view_height/float(view_width);
+	const float ox = camera.x*scale, oy = camera.y*scale, oz = 1 + camera.z*scale;
+	const size_t tiles_x = (view_width + tile - 1)/tile;
+	const size_t tiles_y = (view_height + tile - 1)/tile;
+	std::atomic<size_t> total_rays(0), total_steps(0), total_hits(0);
+
+	auto render_tile = [&](const size_t index){
+		const size_t x0 = (index % tiles_x)*tile, y0 = (index / tiles_x)*tile;
+		const size_t x1 = std::min(x0 + tile, view_width), y1 = std::min(y0 + tile, view_height);
+		size_t rays = 0, steps = 0, hits = 0;
+		for(size_t j=y0; j<y1; j++){
+			uint32_t *row = view.row(j);
+			const float v = half_h*(1 - 2*(j + .5f)/view_height);
+			for(size_t i=x0; i<x1; i++){
+				const float u = half_w*(2*(i + .5f)/view_width - 1);
+				float d[3];
+				for(int a=0; a<3; a++) d[a] = forward[a] + u*right[a] + v*up[a];
+				const float length = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+				for(int a=0; a<3; a++) d[a] /= length;
+				rays++;
+				const VoxelHit hit = cast_voxel_ray(volume, ox, oy, oz, d[0], d[1], d[2],
+								    max_distance*scale, steps, skip_empty);
+				if(hit.distance == INFINITY){
+					row[i] = sky_color;
+					continue;
+				}
+				hits++;
+				const float distance = hit.distance/scale;
+				uint32_t color = voxel_color(hit.type);
+				if(hit.axis == 2) color = scale_color(color, 200);
+				if(lighting){
+					//light of the open voxel in front of the face, as walls
+					//take it from the cell they are seen from
+					long face_x = hit.x, face_y = hit.y;
+					if(hit.axis == 0) face_x -= d[0] > 0 ? 1 : -1;
+					if(hit.axis == 1) face_y -= d[1] > 0 ? 1 : -1;
+					const size_t cell_x = size_t(face_x/scale), cell_y = size_t(face_y/scale);
+					if(cell_x < lighting->width && cell_y < lighting->height)
+						color = scale_color(color, lighting->light_at(cell_x, cell_y));
+				}
+				row[i] = shading ? shade_color(*shading, color, distance, hit.axis == 1) : color;
+			}
+		}
+		total_rays += rays;
+		total_steps += steps;
+		total_hits += hits;
+	};
+	workers.run(tiles_x*tiles_y, render_tile);
+	if(stats){
+		stats->rays = total_rays;
+		stats->steps = total_steps;
+		stats->hits = total_hits;
+	}
+}
+
+inline void render_voxels(std::vector<uint32_t> &image,
+			const size_t image_width,
+			const size_t view_x,
+			const size_t view_y,
+			const size_t view_width,
+			const size_t view_height,
+			const VoxelVolume &volume,
+			const VoxelCamera &camera,
+			TileWorkers &workers,
+			const ShadeTable *shading = nullptr,
+			const LightMap *lighting = nullptr,
+			VoxelStats *stats = nullptr,
+			const uint32_t sky_color = packcolor(200, 200, 200),
+			const float max_distance = 20,
+			const bool skip_empty = true){
+	assert((view_y + view_height)*image_width <= image.size() && view_x + view_width <= image_width);
+	render_voxels(frame_view(image, image_width, image.size()/image_width).sub_view(view_x, view_y, view_width, view_height),
+		      volume, camera, workers, shading, lighting, stats, sky_color, max_distance, skip_empty);
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include "pixelformat.h"
+#include "shading.h"
+#include "lighting.h"
+#include "mapfile.h"
+#include "heights.h"
+#include "voxel.h"
+
+/*-------------------------------------
+Name: make_terrain_volume
+Description: A width x depth x height volume of rolling terrain with pillars and
+	floating blocks, 8 voxels per unit, built from sums of sines so every run
+	gets the same world.
+
+Purpose: A volume far larger than any grid map, with long open sight lines.
+--------------------------------------*/
+VoxelVolume make_terrain_volume(const size_t width, const size_t depth, const size_t height){
+	VoxelVolume volume = make_voxel_volume(width, depth, height, 8);
+	for(size_t y=0; y<depth; y++){
+		for(size_t x=0; x<width; x++){
+			const float ground = height*(.18f + .08f*std::sin(x*.021f) + .06f*std::cos(y*.027f) +
+						     .03f*std::sin((x + y)*.07f));
+			const bool pillar = (x/24 + y/24) % 5 == 0 && x % 24 < 6 && y % 24 < 6;
+			const size_t top = pillar ? height*3/4 : size_t(ground);
+			for(size_t z=0; z<top; z++) volume.set(x, y, z, z + 1 < top ? voxel_ground : '2');
+			if((x/40 + 2*(y/40)) % 7 == 3 && x % 40 < 20 && y % 40 < 20)
+				for(size_t z=height/2; z<height/2 + 4; z++) volume.set(x, y, z, '3');
+		}
+	}
+	return volume;
+}
+
+
+/*-------------------------------------
+Name: run
+Description: Renders frames views of volume at 640x360 while the camera turns,
+	with empty-space skipping on and off and with one thread and with every
+	core, and prints the frame time, frame rate and cells visited per ray of
+	each. The first view is written to image_name.
+
+Purpose: One volume of the benchmark.
+--------------------------------------*/
+void run(const char *name, const VoxelVolume &volume, VoxelCamera camera, const float max_distance,
+	 const LightMap *lighting, const char *image_name){
+	typedef std::chrono::steady_clock clock;
+	const size_t width = 640, height = 360;
+	const int frames = 20;
+	const ShadeTable shading = build_shade_table(max_distance, 256, packcolor(200, 200, 200),
+						     max_distance*.3f);
+	std::vector<uint32_t> image(width*height);
+	TileWorkers single(1), all;
+	std::cout << name << ": " << volume.width << "x" << volume.depth << "x" << volume.height << " voxels\n";
+	for(int mode=0; mode<4; mode++){
+		const bool skip_empty = mode < 2;
+		TileWorkers &workers = mode % 2 ? all : single;
+		if(mode % 2 && all.size() == 1) continue;
+		VoxelStats stats;
+		size_t steps = 0, rays = 0;
+		double seconds = 0;
+		for(int f=0; f<frames; f++){
+			VoxelCamera view = camera;
+			view.yaw += .05f*f;
+			auto start = clock::now();
+			render_voxels(image, width, 0, 0, width, height, volume, view, workers, &shading, lighting,
+				      &stats, packcolor(200, 200, 200), max_distance, skip_empty);
+			seconds += std::chrono::duration<double>(clock::now() - start).count();
+			steps += stats.steps;
+			rays += stats.rays;
+			if(f == 0 && mode == 0) drop_ppm_image(image_name, image, width, height);
+		}
+		std::cout << "  " << (skip_empty ? "skipping" : "every voxel") << ", " << workers.size()
+			  << (workers.size() == 1 ? " thread\t" : " threads\t") << seconds*1000/frames << " ms, "
+			  << frames/seconds << " fps, " << double(steps)/rays << " cells per ray\n";
+	}
+}
+
+
+/*-------------------------------------
+Name: main
+Description: Benchmarks the full 3D voxel renderer at 640x360 on a map file
+	turned into voxels (8 per cell, with its heights) and on a generated
+	512x512x128 terrain volume, and writes outVoxels1.ppm and outVoxels2.ppm.
+	Fails if a volume over the memory limit is built.
+
+	usage: voxel_bench [map file]
+
+Purpose: Shows what the coarse occupancy levels and the tile workers each
+	add to the frame rate.
+--------------------------------------*/
+int main(int argc, char **argv){
+	const std::string map_file = argc > 1 ? argv[1] : "maps/steps.map";
+	std::string map;
+	size_t map_width = 0, map_height = 0;
+	std::vector<std::string> extra;
+	if(!load_map_file(map_file, map, map_width, map_height, &extra)) return 1;
+	const HeightMap heights = build_height_map(map.data(), map_width, map_height, extra);
+	const LightMap lighting = bake_lighting(map.data(), map_width, map_height, parse_lights(extra));
+
+	VoxelCamera camera;
+	camera.x = 12.5f;
+	camera.y = 13.5f;
+	camera.z = .5f;
+	camera.yaw = -1.5f;
+	run(map_file.c_str(), voxels_from_map(map.data(), map_width, map_height, heights, 8), camera, 20,
+	    &lighting, "./outVoxels1.ppm");
+
+	camera.x = 4;
+	camera.y = 4;
+	camera.z = 12;
+	camera.yaw = .6f;
+	camera.pitch = -.25f;
+	run("terrain", make_terrain_volume(512, 512, 128), camera, 80, nullptr, "./outVoxels2.ppm");
+
+	//a map with a floor a billion units up must be refused, not allocated
+	HeightMap tall = heights;
+	tall.max_floor = 1e9f;
+	if(!voxels_from_map(map.data(), map_width, map_height, tall, 8).empty()){
+		std::cerr << "Oversized voxel volume was built\n";
+		return 1;
+	}
+	return 0;
+}
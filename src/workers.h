@@ -0,0 +1,93 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+
+/*-------------------------------------
+Name: TileWorkers
+Description: A fixed set of threads that run a function over tile indices
+	0..tiles-1. run hands the tiles out through an atomic counter, works on
+	them itself alongside the threads and returns once all are done. The
+	threads are started once and sleep between runs, and run takes the
+	function by reference, so a frame costs no thread start and no
+	allocation. thread_count counts the calling thread; 0 uses every core.
+
+Purpose: Spreads per-pixel rendering and entity updates across the cores
+	every frame.
+--------------------------------------*/
+class TileWorkers {
+public:
+	explicit TileWorkers(size_t thread_count = 0){
+		if(thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+		for(size_t i=1; i<thread_count; i++) threads.emplace_back([this](){ work(); });
+	}
+	~TileWorkers(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for(std::thread &t : threads) t.join();
+	}
+	TileWorkers(const TileWorkers&) = delete;
+	TileWorkers &operator=(const TileWorkers&) = delete;
+
+	size_t size() const { return threads.size() + 1; }
+
+	template<typename Fn>
+	void run(const size_t tiles, Fn &&fn){
+		typedef typename std::remove_reference<Fn>::type Task;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = [](void *context, const size_t tile){ (*static_cast<Task*>(context))(tile); };
+			context = const_cast<void*>(static_cast<const void*>(&fn));
+			tile_count = tiles;
+			next_tile = 0;
+			pending = threads.size();
+			generation++;
+		}
+		wake.notify_all();
+		drain();
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this](){ return pending == 0; });
+	}
+
+private:
+	void drain(){
+		for(size_t tile = next_tile++; tile < tile_count; tile = next_tile++) task(context, tile);
+	}
+	void work(){
+		size_t seen = 0;
+		while(true){
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&](){ return quit || generation != seen; });
+				if(quit) return;
+				seen = generation;
+			}
+			drain();
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--pending == 0) done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	void (*task)(void*, size_t) = nullptr;
+	void *context = nullptr;
+	size_t tile_count = 0;
+	std::atomic<size_t> next_tile{0};
+	size_t pending = 0;
+	size_t generation = 0;
+	bool quit = false;
+};
+
+#endif